@@ -0,0 +1,90 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/flat.hpp"
+#include "tcalc/eval.hpp"
+#include "tcalc/parser.hpp"
+#include "tcalc/visitor/eval.hpp"
+#include "tcalc/visitor/flat_eval.hpp"
+#include "tcalc/visitor/resolve.hpp"
+
+namespace {
+
+constexpr std::size_t TERMS = 10000;
+constexpr std::size_t ITERATIONS = 100;
+
+std::string
+gen_expr()
+{
+  auto expr = std::string{ "1" };
+  for (std::size_t i = 1; i < TERMS; ++i) {
+    expr += (i % 3 == 0) ? " * 1.0001" : (i % 3 == 1) ? " + x" : " - 0.5";
+  }
+
+  return expr;
+}
+
+template<typename Fn>
+double
+measure(Fn&& fn)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < ITERATIONS; ++i) {
+    fn();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+}
+
+int
+main()
+{
+  const auto expr = gen_expr();
+  auto ctx = tcalc::builtins::make_context();
+  ctx.var("x", 2);
+
+  auto parser = tcalc::ast::Parser{};
+  auto arena = tcalc::ast::Arena{};
+  auto flat_parser = tcalc::ast::FlatParser{};
+  auto flat = tcalc::ast::FlatTree{};
+
+  auto tree_parse = measure([&] {
+    arena.reset();
+    log_err_exit(parser.parse(expr, arena));
+  });
+  auto flat_parse =
+    measure([&] { log_err_exit(flat_parser.parse(expr, flat)); });
+
+  arena.reset();
+  auto root = parser.parse(expr, arena).value();
+  auto flat_root = flat_parser.parse(expr, flat).value();
+
+  auto resolver = tcalc::ast::ResolveVisitor{ &ctx };
+  log_err_exit(resolver.visit(root));
+  auto flat_resolver = tcalc::ast::FlatResolveVisitor{ flat, &ctx };
+  log_err_exit(flat_resolver.visit(flat_root));
+
+  auto tree_eval = measure([&] {
+    auto visitor = tcalc::ast::EvalVisitor{ ctx };
+    log_err_exit(visitor.visit(root));
+  });
+  auto flat_eval = measure([&] {
+    auto visitor = tcalc::ast::FlatEvalVisitor{ flat, ctx };
+    log_err_exit(visitor.visit(flat_root));
+  });
+
+  std::cout << TERMS << " terms x" << ITERATIONS << "\n"
+            << "  parse: tree " << tree_parse << " ms, flat " << flat_parse
+            << " ms\n"
+            << "  eval: tree " << tree_eval << " ms, flat " << flat_eval
+            << " ms\n"
+            << "  memory: tree arena " << arena.capacity() << " B, flat "
+            << flat.footprint() << " B\n";
+}
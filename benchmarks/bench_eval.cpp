@@ -0,0 +1,59 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+
+#include "tcalc/eval.hpp"
+
+namespace {
+
+struct Workload
+{
+  std::string_view name;
+  std::string_view setup;
+  std::string_view expr;
+  std::size_t iterations;
+};
+
+constexpr Workload WORKLOADS[] = {
+  { "fib(20)",
+    "def fib(n) if n <= 1 then n else fib(n - 1) + fib(n - 2)",
+    "fib(20)",
+    5 },
+  { "arith",
+    "let x = 1.5; let y = 2.5",
+    "(x + y) * (x - y) / (x * y + 1) + sqrt(x * x + y * y) - pow(x, 2)",
+    100000 },
+};
+
+double
+run(tcalc::Engine engine, const Workload& workload)
+{
+  auto evaluator = tcalc::Evaluator{};
+  evaluator.engine(engine);
+  log_err_exit(evaluator.eval_prog(workload.setup));
+
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < workload.iterations; ++i) {
+    log_err_exit(evaluator.eval(workload.expr));
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+}
+
+int
+main()
+{
+  for (const auto& workload : WORKLOADS) {
+    auto tree = run(tcalc::Engine::TREE, workload);
+    auto vm = run(tcalc::Engine::VM, workload);
+
+    std::cout << workload.name << " x" << workload.iterations
+              << ": tree " << tree << " ms, vm " << vm << " ms, speedup "
+              << tree / vm << "x\n";
+  }
+}
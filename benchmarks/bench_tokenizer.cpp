@@ -0,0 +1,65 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "tcalc/error.hpp"
+#include "tcalc/token.hpp"
+#include "tcalc/tokenizer.hpp"
+
+namespace {
+
+constexpr std::size_t INPUT_SIZE = 8 << 20;
+constexpr std::size_t ITERATIONS = 5;
+
+std::string
+gen_input()
+{
+  constexpr const char* LINES[] = {
+    "def scaled_distance(x_pos, y_pos) sqrt(x_pos * x_pos + y_pos * y_pos);\n",
+    "let threshold_value = 1024.5 * scaled_distance(3, 4) - 0.125;\n",
+    "if threshold_value >= 10 && threshold_value != 12 then 1 else 0;\n",
+    "let 'quoted name' = !(threshold_value <= 3 || 2 == 2) / 7;\n",
+  };
+
+  auto input = std::string{};
+  input.reserve(INPUT_SIZE + 128);
+  for (std::size_t i = 0; input.size() < INPUT_SIZE; ++i) {
+    input += LINES[i % std::size(LINES)];
+  }
+
+  return input;
+}
+
+}
+
+int
+main()
+{
+  const auto input = gen_input();
+
+  std::size_t tokens = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < ITERATIONS; ++i) {
+    auto tokenizer = tcalc::token::Tokenizer{ input };
+    while (true) {
+      auto res = tokenizer.next();
+      if (!res.has_value()) {
+        res.error().log();
+        return EXIT_FAILURE;
+      }
+      if (res.value().type == tcalc::token::TokenType::EOI) {
+        break;
+      }
+      ++tokens;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  auto seconds = std::chrono::duration<double>(end - start).count();
+  auto bytes = static_cast<double>(input.size() * ITERATIONS);
+
+  std::cout << "tokenizer: " << tokens / ITERATIONS << " tokens, "
+            << bytes / seconds / (1 << 20) << " MB/s\n";
+}
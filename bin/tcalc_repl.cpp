@@ -1,10 +1,88 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
 #include <iostream>
+#include <string_view>
 
 #include "tcalc/eval.hpp"
+#include "tcalc/pipeline.hpp"
+
+namespace {
+
+void
+usage(const char* prog)
+{
+  std::cout << "usage: " << prog << " [options]\n"
+            << "  -O0, -O1, -O2     optimization level (default -O2)\n"
+            << "  --fast-math       allow rewrites which change rounding\n"
+            << "  --<pass>          enable a pass\n"
+            << "  --no-<pass>       disable a pass\n"
+            << "  --stats           print pass statistics on exit\n"
+            << "  -h, --help        print this message\n"
+            << "passes: inline, fold, simplify, poly, cse\n";
+}
+
+bool
+set_pass(tcalc::Evaluator& evaluator, std::string_view name, bool enabled)
+{
+  for (std::size_t i = 0; i < tcalc::PASS_COUNT; ++i) {
+    if (tcalc::PASS_NAMES[i] == name) {
+      evaluator.pass(static_cast<tcalc::Pass>(i), enabled);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void
+print_stats(const tcalc::Evaluator& evaluator)
+{
+  for (std::size_t i = 0; i < tcalc::PASS_COUNT; ++i) {
+    auto pass = static_cast<tcalc::Pass>(i);
+    const auto& stats = evaluator.passes().stats(pass);
+    auto time =
+      std::chrono::duration_cast<std::chrono::microseconds>(stats.time);
+    std::cerr << tcalc::pass_name(pass) << ": " << stats.runs
+              << " runs, " << time.count() << " us, " << stats.nodes_before
+              << " -> " << stats.nodes_after << " nodes\n";
+  }
+}
+
+}
+
 int
-main()
+main(int argc, char** argv)
 {
   auto evaluator = tcalc::Evaluator{};
+  auto stats = false;
+
+  for (int i = 1; i < argc; ++i) {
+    auto arg = std::string_view{ argv[i] };
+    if (arg == "-O0") {
+      evaluator.opt_level(tcalc::OptLevel::O0);
+    } else if (arg == "-O1") {
+      evaluator.opt_level(tcalc::OptLevel::O1);
+    } else if (arg == "-O2") {
+      evaluator.opt_level(tcalc::OptLevel::O2);
+    } else if (arg == "--fast-math") {
+      evaluator.fast_math(true);
+    } else if (arg == "--stats") {
+      stats = true;
+    } else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (!(arg.starts_with("--no-") &&
+                 set_pass(evaluator, arg.substr(5), false)) &&
+               !(arg.starts_with("--") &&
+                 set_pass(evaluator, arg.substr(2), true))) {
+      std::cerr << argv[0] << ": unknown option '" << arg
+                << "', see --help\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  evaluator.collect_stats(stats);
 
   while (true) {
     std::string line;
@@ -29,4 +107,8 @@ main()
       std::cout << v << '\n';
     }
   }
+
+  if (stats) {
+    print_stats(evaluator);
+  }
 }
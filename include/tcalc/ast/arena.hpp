@@ -0,0 +1,155 @@
+/**
+ * @file arena.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Bump allocator for AST nodes.
+ * @version 0.2.0
+ * @date 2025-06-21
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tcalc/common.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Bump allocator for AST nodes, everything allocated from an arena is
+ * released at once when the arena is reset or destroyed.
+ *
+ * @note Only trivially destructible objects can be allocated, destructors are
+ * never run.
+ */
+class TCALC_PUBLIC Arena
+{
+public:
+  constexpr static std::size_t BLOCK_SIZE = 4096;   /**< First block size. */
+  constexpr static std::size_t MAX_BLOCK = 1 << 20; /**< Max block growth. */
+
+private:
+  /**
+   * @brief Memory block.
+   *
+   */
+  struct Block
+  {
+    std::unique_ptr<std::byte[]> data;
+    std::size_t size;
+  };
+
+  std::vector<Block> _blocks;
+  std::size_t _block{ 0 };
+  std::size_t _offset{ 0 };
+
+public:
+  Arena() = default;
+  ~Arena() = default;
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  Arena(Arena&&) noexcept = default;
+  Arena& operator=(Arena&&) noexcept = default;
+
+  /**
+   * @brief Allocate raw memory.
+   *
+   * @param size Size in bytes.
+   * @param align Alignment.
+   * @return void* Allocated memory.
+   */
+  void* allocate(std::size_t size, std::size_t align);
+
+  /**
+   * @brief Construct an object in the arena.
+   *
+   * @tparam T Object type.
+   * @tparam Args Constructor argument types.
+   * @param args Constructor arguments.
+   * @return T* Constructed object.
+   */
+  template<typename T, typename... Args>
+  T* make(Args&&... args)
+  {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "Arena objects are never destroyed");
+
+    return ::new (allocate(sizeof(T), alignof(T)))
+      T(std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief Copy a string into the arena.
+   *
+   * @param str String to copy.
+   * @return std::string_view Arena owned string.
+   */
+  std::string_view str(std::string_view str);
+
+  /**
+   * @brief Copy a list of objects into the arena.
+   *
+   * @tparam T Object type.
+   * @param items Objects to copy.
+   * @return std::span<T> Arena owned list.
+   */
+  template<typename T>
+  std::span<T> array(std::span<const T> items)
+  {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "Arena objects are never destroyed");
+
+    if (items.empty()) {
+      return {};
+    }
+
+    auto* data =
+      static_cast<T*>(allocate(sizeof(T) * items.size(), alignof(T)));
+    std::uninitialized_copy(items.begin(), items.end(), data);
+
+    return { data, items.size() };
+  }
+
+  /**
+   * @brief Copy a list of objects into the arena.
+   *
+   * @tparam T Object type.
+   * @param items Objects to copy.
+   * @return std::span<T> Arena owned list.
+   */
+  template<typename T>
+  TCALC_INLINE std::span<T> array(const std::vector<T>& items)
+  {
+    return array(std::span<const T>{ items });
+  }
+
+  /**
+   * @brief Release every allocation but keep the memory blocks for reuse.
+   *
+   */
+  TCALC_INLINE void reset() noexcept
+  {
+    _block = 0;
+    _offset = 0;
+  }
+
+  /**
+   * @brief Get the total size of the memory blocks.
+   *
+   * @return std::size_t Capacity in bytes.
+   */
+  [[nodiscard]] std::size_t capacity() const noexcept;
+};
+
+}
@@ -11,8 +11,6 @@
 
 #pragma once
 
-#include <utility>
-
 #include "tcalc/ast/node.hpp"
 #include "tcalc/common.hpp"
 
@@ -48,13 +46,11 @@ public:
    */
   BinaryOpNode(NodeType type, NodePtr<> left, NodePtr<> right)
     : Node{ type }
-    , _left{ std::move(left) }
-    , _right{ std::move(right) }
+    , _left{ left }
+    , _right{ right }
   {
   }
 
-  ~BinaryOpNode() override = default;
-
   /**
    * @brief Get the left subnode.
    *
@@ -74,7 +70,7 @@ public:
    *
    * @param left Left subnode.
    */
-  TCALC_INLINE void left(NodePtr<> left) noexcept { _left = std::move(left); }
+  TCALC_INLINE void left(NodePtr<> left) noexcept { _left = left; }
 
   /**
    * @brief Get the right subnode.
@@ -97,7 +93,7 @@ public:
    */
   TCALC_INLINE void right(NodePtr<> right) noexcept
   {
-    _right = std::move(right);
+    _right = right;
   }
 };
 
@@ -11,8 +11,6 @@
 
 #pragma once
 
-#include <utility>
-
 #include "tcalc/ast/node.hpp"
 #include "tcalc/common.hpp"
 
@@ -48,14 +46,12 @@ public:
    */
   IfNode(NodePtr<> cond, NodePtr<> then, NodePtr<> else_)
     : Node{ NodeType::IF }
-    , _cond{ std::move(cond) }
-    , _then{ std::move(then) }
-    , _else{ std::move(else_) }
+    , _cond{ cond }
+    , _then{ then }
+    , _else{ else_ }
   {
   }
 
-  ~IfNode() override = default;
-
   /**
    * @brief Get the condition node.
    *
@@ -75,7 +71,7 @@ public:
    *
    * @param cond Condition node.
    */
-  TCALC_INLINE void cond(NodePtr<> cond) noexcept { _cond = std::move(cond); }
+  TCALC_INLINE void cond(NodePtr<> cond) noexcept { _cond = cond; }
 
   /**
    * @brief Get the then node.
@@ -96,7 +92,7 @@ public:
    *
    * @param then Then node.
    */
-  TCALC_INLINE void then(NodePtr<> then) noexcept { _then = std::move(then); }
+  TCALC_INLINE void then(NodePtr<> then) noexcept { _then = then; }
 
   /**
    * @brief Get the else node.
@@ -119,7 +115,7 @@ public:
    */
   TCALC_INLINE void else_(NodePtr<> else_) noexcept
   {
-    _else = std::move(else_);
+    _else = else_;
   }
 };
 
@@ -0,0 +1,256 @@
+/**
+ * @file flat.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Flat, index based AST.
+ * @version 0.2.0
+ * @date 2025-06-22
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "tcalc/ast/function.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/symbol.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Index of a node in a flat tree.
+ *
+ */
+using FlatIndex = uint32_t;
+
+/**
+ * @brief Compact node record, the meaning of the operands depends on the node
+ * type:
+ *
+ * | Type      | a          | b            | c            |
+ * | --------- | ---------- | ------------ | ------------ |
+ * | BINARY_*  | left node  | right node   |              |
+ * | UNARY_*   | operand    |              |              |
+ * | NUMBER    | constant   |              |              |
+ * | VARREF    | symbol     | binding kind | slot         |
+ * | VARASSIGN | symbol     | body node    |              |
+ * | FCALL     | symbol     | args list    | call cache   |
+ * | FDEF      | symbol     | params list  | body node    |
+ * | IF        | cond node  | then node    | else node    |
+ * | PROGRAM   | stmts list |              |              |
+ * | IMPORT    | path       |              |              |
+ *
+ * Names are ids from the process wide symbol table, parameter lists hold
+ * symbols as well. Lists are offsets into the list table, the first entry is
+ * the list length.
+ * Bindings are left unresolved by the parser, see FlatResolveVisitor.
+ */
+struct FlatNode
+{
+  NodeType type;
+  FlatIndex a;
+  FlatIndex b;
+  FlatIndex c;
+};
+
+static_assert(sizeof(FlatNode) == 16, "FlatNode should stay compact");
+
+/**
+ * @brief AST stored as one contiguous array of node records plus side tables.
+ *
+ * @note Nodes are stored in post-order, children always precede their parent,
+ * the subtree of a node is a contiguous range ending at the node itself and
+ * the root is the last node.
+ */
+class TCALC_PUBLIC FlatTree
+{
+private:
+  std::vector<FlatNode> _nodes;
+  std::vector<double> _consts;
+  std::vector<FlatIndex> _lists;
+  // call sites cache their callee while the tree itself stays const
+  mutable std::vector<CallCache> _caches;
+
+public:
+  FlatTree() = default;
+  ~FlatTree() = default;
+
+  /**
+   * @brief Get node records.
+   *
+   * @return const std::vector<FlatNode>& Nodes.
+   */
+  [[nodiscard]] TCALC_INLINE auto& nodes() const noexcept { return _nodes; }
+
+  /**
+   * @brief Get a node record.
+   *
+   * @param index Node index.
+   * @return const FlatNode& Node.
+   */
+  [[nodiscard]] TCALC_INLINE auto& node(FlatIndex index) const noexcept
+  {
+    return _nodes[index];
+  }
+
+  /**
+   * @brief Get a mutable node record, used to bind it in place.
+   *
+   * @param index Node index.
+   * @return FlatNode& Node.
+   */
+  [[nodiscard]] TCALC_INLINE auto& node(FlatIndex index) noexcept
+  {
+    return _nodes[index];
+  }
+
+  /**
+   * @brief Get the root node index.
+   *
+   * @return FlatIndex Root index, only valid if the tree is not empty.
+   */
+  [[nodiscard]] TCALC_INLINE auto root() const noexcept
+  {
+    return static_cast<FlatIndex>(_nodes.size() - 1);
+  }
+
+  /**
+   * @brief Check if the tree is empty.
+   *
+   * @return true if there is no node
+   * @return false if there are nodes
+   */
+  [[nodiscard]] TCALC_INLINE auto empty() const noexcept
+  {
+    return _nodes.empty();
+  }
+
+  /**
+   * @brief Get a constant.
+   *
+   * @param index Constant index.
+   * @return double Constant value.
+   */
+  [[nodiscard]] TCALC_INLINE auto value(FlatIndex index) const noexcept
+  {
+    return _consts[index];
+  }
+
+  /**
+   * @brief Get the name of a symbol operand.
+   *
+   * @param id Symbol id.
+   * @return std::string_view Name.
+   */
+  [[nodiscard]] TCALC_INLINE static std::string_view name(SymbolId id)
+  {
+    return symbols().name(id);
+  }
+
+  /**
+   * @brief Get a list.
+   *
+   * @param offset List offset.
+   * @return std::span<const FlatIndex> List items.
+   */
+  [[nodiscard]] TCALC_INLINE auto list(FlatIndex offset) const noexcept
+  {
+    return std::span<const FlatIndex>{ _lists }.subspan(offset + 1,
+                                                        _lists[offset]);
+  }
+
+  /**
+   * @brief Get a call site cache.
+   *
+   * @param index Cache index.
+   * @return CallCache& Call site cache.
+   */
+  [[nodiscard]] TCALC_INLINE auto& cache(FlatIndex index) const noexcept
+  {
+    return _caches[index];
+  }
+
+  /**
+   * @brief Append a node.
+   *
+   * @param node Node record, its children must already be in the tree.
+   * @return FlatIndex Node index.
+   */
+  TCALC_INLINE FlatIndex emit(FlatNode node)
+  {
+    _nodes.push_back(node);
+    return static_cast<FlatIndex>(_nodes.size() - 1);
+  }
+
+  /**
+   * @brief Add a constant.
+   *
+   * @param value Constant value.
+   * @return FlatIndex Constant index.
+   */
+  FlatIndex add_const(double value);
+
+  /**
+   * @brief Add an empty call site cache.
+   *
+   * @return FlatIndex Cache index.
+   */
+  FlatIndex add_cache();
+
+  /**
+   * @brief Add a list.
+   *
+   * @param items List items.
+   * @return FlatIndex List offset.
+   */
+  FlatIndex add_list(std::span<const FlatIndex> items);
+
+  /**
+   * @brief Find the first node of a subtree.
+   *
+   * @param index Subtree root.
+   * @return FlatIndex Index of the first node emitted for the subtree.
+   */
+  [[nodiscard]] FlatIndex first(FlatIndex index) const;
+
+  /**
+   * @brief Copy a subtree into a standalone tree.
+   *
+   * @param root Subtree root.
+   * @return FlatTree Tree with only the subtree and the symbols it uses.
+   */
+  [[nodiscard]] FlatTree subtree(FlatIndex root) const;
+
+  /**
+   * @brief Drop every node but keep the memory for reuse.
+   *
+   */
+  void clear() noexcept;
+
+  /**
+   * @brief Get the memory footprint of the tree, without the spare capacity
+   * kept for reuse.
+   *
+   * @return std::size_t Size in bytes of the nodes and side tables.
+   */
+  [[nodiscard]] std::size_t footprint() const noexcept;
+
+private:
+  /**
+   * @brief Copy a node and its children from another tree.
+   *
+   * @param tree Source tree.
+   * @param index Source node index.
+   * @return FlatIndex Node index in this tree.
+   */
+  FlatIndex _copy(const FlatTree& tree, FlatIndex index);
+};
+
+}
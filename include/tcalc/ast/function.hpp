@@ -11,15 +11,30 @@
 
 #pragma once
 
-#include <string>
-#include <utility>
-#include <vector>
+#include <cstdint>
+#include <span>
+#include <string_view>
 
 #include "tcalc/ast/node.hpp"
 #include "tcalc/common.hpp"
+#include "tcalc/symbol.hpp"
 
 namespace tcalc::ast {
 
+/**
+ * @brief Inline cache of a call site, remembers the callee resolved in the
+ * last context generation it was used with.
+ *
+ * @note The entry is filled by EvalContext::func once the callee is found and
+ * the argument count is checked, generations are unique across contexts so a
+ * stale or foreign entry never matches.
+ */
+struct CallCache
+{
+  uint64_t generation{ 0 };      /**< Context generation of the entry. */
+  const void* callee{ nullptr }; /**< Resolved function. */
+};
+
 /**
  * @brief Function node.
  *
@@ -27,69 +42,78 @@ namespace tcalc::ast {
 class FcallNode : public Node
 {
 private:
-  std::string _name;
-  std::vector<NodePtr<>> _args;
+  SymbolId _symbol;
+  std::span<NodePtr<>> _args;
+  CallCache _cache{};
 
 public:
   /**
    * @brief Construct a new Function Node object.
    *
-   * @param name Function name.
+   * @param symbol Function symbol.
    */
-  explicit FcallNode(std::string name)
-    : FcallNode{ std::move(name), {} }
+  explicit FcallNode(SymbolId symbol)
+    : FcallNode{ symbol, {} }
   {
   }
 
   /**
    * @brief Construct a new Function Node object.
    *
-   * @param name Function name.
-   * @param args Function arguments.
+   * @param symbol Function symbol.
+   * @param args Function arguments, owned by the arena.
    */
-  FcallNode(std::string name, std::vector<NodePtr<>> args)
+  FcallNode(SymbolId symbol, std::span<NodePtr<>> args)
     : Node{ NodeType::FCALL }
-    , _name{ std::move(name) }
-    , _args{ std::move(args) }
+    , _symbol{ symbol }
+    , _args{ args }
   {
   }
 
-  ~FcallNode() override = default;
-
   /**
    * @brief Get function arguments.
    *
-   * @return const std::vector<NodePtr<>>& Function arguments.
+   * @return std::span<NodePtr<>> Function arguments.
    */
-  [[nodiscard]] TCALC_INLINE auto& args() const noexcept { return _args; }
+  [[nodiscard]] TCALC_INLINE auto args() const noexcept { return _args; }
 
   /**
-   * @brief Get function arguments.
+   * @brief Set function arguments.
    *
-   * @return std::vector<NodePtr<>>& Function arguments.
+   * @param args Function arguments, owned by the arena.
    */
-  TCALC_INLINE auto& args() noexcept { return _args; }
+  TCALC_INLINE void args(std::span<NodePtr<>> args) noexcept { _args = args; }
 
   /**
-   * @brief Push a function argument.
+   * @brief Get the call site cache.
    *
-   * @param arg Argument to push.
+   * @return CallCache& Call site cache.
    */
-  TCALC_INLINE void push_arg(const NodePtr<>& arg) { _args.push_back(arg); }
+  [[nodiscard]] TCALC_INLINE auto& cache() noexcept { return _cache; }
 
   /**
-   * @brief Get function name.
+   * @brief Get function symbol.
    *
-   * @return const std::string& Function name.
+   * @return SymbolId Function symbol.
    */
-  [[nodiscard]] TCALC_INLINE auto& name() const noexcept { return _name; }
+  [[nodiscard]] TCALC_INLINE auto symbol() const noexcept { return _symbol; }
 
   /**
-   * @brief Set function name.
+   * @brief Set function symbol.
    *
-   * @param name Function name.
+   * @param symbol Function symbol.
    */
-  TCALC_INLINE void name(std::string name) { _name = std::move(name); }
+  TCALC_INLINE void symbol(SymbolId symbol) noexcept { _symbol = symbol; }
+
+  /**
+   * @brief Get function name, for printing and error messages.
+   *
+   * @return std::string_view Function name.
+   */
+  [[nodiscard]] std::string_view name() const
+  {
+    return symbols().name(_symbol);
+  }
 };
 
 /**
@@ -99,58 +123,49 @@ public:
 class FdefNode : public Node
 {
 private:
-  std::string _name;
-  std::vector<std::string> _args;
+  SymbolId _symbol;
+  std::span<SymbolId> _args;
   NodePtr<> _body;
 
 public:
   /**
    * @brief Construct a new Fdef Node object only with name.
    *
-   * @param name Function name.
+   * @param symbol Function symbol.
    */
-  explicit FdefNode(std::string name)
-    : FdefNode{ std::move(name), {}, {} }
+  explicit FdefNode(SymbolId symbol)
+    : FdefNode{ symbol, {}, nullptr }
   {
   }
 
   /**
    * @brief Construct a new Fdef Node object with arguments and body.
    *
-   * @param name Function name.
-   * @param args Function arguments.
+   * @param symbol Function symbol.
+   * @param args Parameter symbols, owned by the arena.
    * @param body Function body.
    */
-  FdefNode(std::string name, std::vector<std::string> args, NodePtr<> body)
+  FdefNode(SymbolId symbol, std::span<SymbolId> args, NodePtr<> body)
     : Node{ NodeType::FDEF }
-    , _name{ std::move(name) }
-    , _args{ std::move(args) }
-    , _body{ std::move(body) }
+    , _symbol{ symbol }
+    , _args{ args }
+    , _body{ body }
   {
   }
 
-  ~FdefNode() override = default;
-
   /**
-   * @brief Get function arguments.
-   *
-   * @return const std::vector<std::string>& Function arguments.
-   */
-  [[nodiscard]] TCALC_INLINE auto& args() const noexcept { return _args; }
-
-  /**
-   * @brief Get function arguments.
+   * @brief Get function parameters.
    *
-   * @return std::vector<std::string>& Function arguments.
+   * @return std::span<SymbolId> Parameter symbols.
    */
-  TCALC_INLINE auto& args() noexcept { return _args; }
+  [[nodiscard]] TCALC_INLINE auto args() const noexcept { return _args; }
 
   /**
-   * @brief Push a function argument.
+   * @brief Set function parameters.
    *
-   * @param arg Argument to push.
+   * @param args Parameter symbols, owned by the arena.
    */
-  TCALC_INLINE void push_arg(const std::string& arg) { _args.push_back(arg); }
+  TCALC_INLINE void args(std::span<SymbolId> args) noexcept { _args = args; }
 
   /**
    * @brief Get function body.
@@ -171,21 +186,31 @@ public:
    *
    * @param body Function body.
    */
-  TCALC_INLINE void body(NodePtr<> body) { _body = std::move(body); }
+  TCALC_INLINE void body(NodePtr<> body) noexcept { _body = body; }
 
   /**
-   * @brief Get function name.
+   * @brief Get function symbol.
    *
-   * @return const std::string& Function name.
+   * @return SymbolId Function symbol.
    */
-  [[nodiscard]] TCALC_INLINE auto& name() const noexcept { return _name; }
+  [[nodiscard]] TCALC_INLINE auto symbol() const noexcept { return _symbol; }
 
   /**
-   * @brief Set function name.
+   * @brief Set function symbol.
    *
-   * @param name Function name.
+   * @param symbol Function symbol.
    */
-  TCALC_INLINE void name(std::string name) { _name = std::move(name); }
+  TCALC_INLINE void symbol(SymbolId symbol) noexcept { _symbol = symbol; }
+
+  /**
+   * @brief Get function name, for printing and error messages.
+   *
+   * @return std::string_view Function name.
+   */
+  [[nodiscard]] std::string_view name() const
+  {
+    return symbols().name(_symbol);
+  }
 };
 
 }
@@ -13,7 +13,6 @@
 
 #include <cctype>
 #include <cstdint>
-#include <memory>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
@@ -51,6 +50,7 @@ enum class NodeType : uint8_t
   IF,                   /**< If statement. */
   PROGRAM,              /**< Program. */
   IMPORT,               /**< Import statement. */
+  POLY,                 /**< Polynomial. */
 };
 
 inline const std::unordered_map<NodeType, std::string> NODE_TYPE_NAMES = {
@@ -77,11 +77,14 @@ inline const std::unordered_map<NodeType, std::string> NODE_TYPE_NAMES = {
   { NodeType::IF, "IF" },
   { NodeType::PROGRAM, "PROGRAM" },
   { NodeType::IMPORT, "IMPORT" },
+  { NodeType::POLY, "POLY" },
 }; /**< Node type names. */
 
 /**
  * @brief Base class for AST nodes.
  *
+ * @note Nodes are allocated from an Arena and never destroyed one by one, so
+ * they must stay trivially destructible.
  */
 class Node
 {
@@ -99,8 +102,6 @@ public:
   {
   }
 
-  virtual ~Node() = default;
-
   /**
    * @brief Get the node type.
    *
@@ -110,12 +111,12 @@ public:
 };
 
 /**
- * @brief Shared pointer to a node.
+ * @brief Non-owning handle to a node, nodes are owned by their Arena.
  *
  * @tparam NT Node type.
  */
 template<typename NT = Node,
          typename = std::enable_if_t<std::is_base_of_v<Node, NT>>>
-using NodePtr = std::shared_ptr<NT>;
+using NodePtr = NT*;
 
 }
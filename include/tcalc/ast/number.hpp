@@ -37,8 +37,6 @@ public:
   {
   }
 
-  ~NumberNode() override = default;
-
   /**
    * @brief Get the number value.
    *
@@ -0,0 +1,88 @@
+/**
+ * @file poly.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Polynomial node.
+ * @version 0.2.0
+ * @date 2025-06-27
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <span>
+
+#include "tcalc/ast/node.hpp"
+#include "tcalc/common.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Polynomial node, evaluated with Horner's scheme.
+ *
+ * @note The value is `c[0] + c[1] * x + ... + c[n] * x^n`, computed as
+ * `fma(fma(c[n], x, c[n - 1]), x, ...)`. The coefficients do not depend on
+ * the variable, they may be polynomials in other variables.
+ */
+class PolyNode : public Node
+{
+private:
+  NodePtr<> _var;
+  std::span<NodePtr<>> _coeffs;
+
+public:
+  /**
+   * @brief Construct a new Poly Node object.
+   *
+   * @param var Variable reference node.
+   * @param coeffs Coefficients from the constant term up, owned by the arena,
+   * at least two of them.
+   */
+  PolyNode(NodePtr<> var, std::span<NodePtr<>> coeffs)
+    : Node{ NodeType::POLY }
+    , _var{ var }
+    , _coeffs{ coeffs }
+  {
+  }
+
+  /**
+   * @brief Get the variable.
+   *
+   * @return const NodePtr<>& Variable reference node.
+   */
+  [[nodiscard]] TCALC_INLINE auto& var() const noexcept { return _var; }
+
+  /**
+   * @brief Get the variable.
+   *
+   * @return NodePtr<>& Variable reference node.
+   */
+  TCALC_INLINE auto& var() noexcept { return _var; }
+
+  /**
+   * @brief Set the variable.
+   *
+   * @param var Variable reference node.
+   */
+  TCALC_INLINE void var(NodePtr<> var) noexcept { _var = var; }
+
+  /**
+   * @brief Get the coefficients.
+   *
+   * @return std::span<NodePtr<>> Coefficients from the constant term up.
+   */
+  [[nodiscard]] TCALC_INLINE auto coeffs() const noexcept { return _coeffs; }
+
+  /**
+   * @brief Set the coefficients.
+   *
+   * @param coeffs Coefficients from the constant term up, owned by the arena.
+   */
+  TCALC_INLINE void coeffs(std::span<NodePtr<>> coeffs) noexcept
+  {
+    _coeffs = coeffs;
+  }
+};
+
+}
@@ -11,7 +11,8 @@
 
 #pragma once
 
-#include <vector>
+#include <span>
+#include <string_view>
 
 #include "tcalc/ast/node.hpp"
 #include "tcalc/common.hpp"
@@ -25,7 +26,7 @@ namespace tcalc::ast {
 class ProgramNode : public Node
 {
 private:
-  std::vector<NodePtr<>> _statements;
+  std::span<NodePtr<>> _statements;
 
 public:
   /**
@@ -40,41 +41,32 @@ public:
   /**
    * @brief Construct a new Program Node object with statements.
    *
-   * @param statements Statements.
+   * @param statements Statements, owned by the arena.
    */
-  explicit ProgramNode(std::vector<NodePtr<>> statements)
+  explicit ProgramNode(std::span<NodePtr<>> statements)
     : Node{ NodeType::PROGRAM }
-    , _statements{ std::move(statements) }
+    , _statements{ statements }
   {
   }
 
-  ~ProgramNode() override = default;
-
   /**
    * @brief Get statements.
    *
-   * @return const std::vector<NodePtr<>>& Statements.
+   * @return std::span<NodePtr<>> Statements.
    */
-  [[nodiscard]] TCALC_INLINE auto& statements() const noexcept
+  [[nodiscard]] TCALC_INLINE auto statements() const noexcept
   {
     return _statements;
   }
 
   /**
-   * @brief Get statements.
-   *
-   * @return std::vector<NodePtr<>>& Statements.
-   */
-  TCALC_INLINE auto& statements() noexcept { return _statements; }
-
-  /**
-   * @brief Push a statement.
+   * @brief Set statements.
    *
-   * @param statement Statement.
+   * @param statements Statements, owned by the arena.
    */
-  TCALC_INLINE void push_statement(NodePtr<> statement)
+  TCALC_INLINE void statements(std::span<NodePtr<>> statements) noexcept
   {
-    _statements.push_back(std::move(statement));
+    _statements = statements;
   }
 };
 
@@ -85,42 +77,33 @@ public:
 class ProgramImportNode : public Node
 {
 private:
-  std::string _path;
+  std::string_view _path;
 
 public:
   /**
    * @brief Construct a new Program Import Node object.
    *
-   * @param path Path.
+   * @param path Path, owned by the arena.
    */
-  explicit ProgramImportNode(std::string path)
+  explicit ProgramImportNode(std::string_view path)
     : Node{ NodeType::IMPORT }
-    , _path{ std::move(path) }
+    , _path{ path }
   {
   }
 
-  ~ProgramImportNode() override = default;
-
-  /**
-   * @brief Get path.
-   *
-   * @return const std::string& Path.
-   */
-  [[nodiscard]] TCALC_INLINE auto& path() const noexcept { return _path; }
-
   /**
    * @brief Get path.
    *
-   * @return std::string& Path.
+   * @return std::string_view Path.
    */
-  TCALC_INLINE auto& path() noexcept { return _path; }
+  [[nodiscard]] TCALC_INLINE auto path() const noexcept { return _path; }
 
   /**
    * @brief Set path.
    *
-   * @param path Path.
+   * @param path Path, owned by the arena.
    */
-  TCALC_INLINE void path(std::string path) noexcept { _path = std::move(path); }
+  TCALC_INLINE void path(std::string_view path) noexcept { _path = path; }
 };
 
 }
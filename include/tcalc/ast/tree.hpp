@@ -0,0 +1,67 @@
+/**
+ * @file tree.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Parsed AST with its arena.
+ * @version 0.2.0
+ * @date 2025-06-21
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <utility>
+
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/common.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Parsed AST which owns every node through its arena.
+ *
+ */
+class Tree
+{
+private:
+  Arena _arena;
+  NodePtr<> _root{ nullptr };
+
+public:
+  /**
+   * @brief Construct a new Tree object.
+   *
+   * @param arena Arena owning the nodes.
+   * @param root Root node.
+   */
+  Tree(Arena arena, NodePtr<> root)
+    : _arena{ std::move(arena) }
+    , _root{ root }
+  {
+  }
+
+  ~Tree() = default;
+
+  Tree(const Tree&) = delete;
+  Tree& operator=(const Tree&) = delete;
+  Tree(Tree&&) noexcept = default;
+  Tree& operator=(Tree&&) noexcept = default;
+
+  /**
+   * @brief Get the root node.
+   *
+   * @return NodePtr<>& Root node.
+   */
+  [[nodiscard]] TCALC_INLINE auto& root() noexcept { return _root; }
+
+  /**
+   * @brief Get the arena.
+   *
+   * @return Arena& Arena owning the nodes.
+   */
+  [[nodiscard]] TCALC_INLINE auto& arena() noexcept { return _arena; }
+};
+
+}
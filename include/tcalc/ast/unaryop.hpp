@@ -11,8 +11,6 @@
 
 #pragma once
 
-#include <utility>
-
 #include "tcalc/ast/node.hpp"
 
 namespace tcalc::ast {
@@ -45,12 +43,10 @@ public:
    */
   UnaryOpNode(NodeType type, NodePtr<> operand)
     : Node{ type }
-    , _operand{ std::move(operand) }
+    , _operand{ operand }
   {
   }
 
-  ~UnaryOpNode() override = default;
-
   /**
    * @brief Get operand.
    *
@@ -72,7 +68,7 @@ public:
    */
   TCALC_INLINE void operand(NodePtr<> operand) noexcept
   {
-    _operand = std::move(operand);
+    _operand = operand;
   }
 };
 
@@ -11,14 +11,36 @@
 
 #pragma once
 
-#include <string>
-#include <utility>
+#include <cstdint>
+#include <string_view>
 
 #include "tcalc/ast/node.hpp"
 #include "tcalc/common.hpp"
+#include "tcalc/symbol.hpp"
 
 namespace tcalc::ast {
 
+/**
+ * @brief Kind of storage a variable reference is bound to.
+ *
+ */
+enum class BindingKind : uint8_t
+{
+  UNRESOLVED, /**< Looked up by name at runtime. */
+  PARAM,      /**< Parameter slot of the enclosing function. */
+  GLOBAL,     /**< Global slot, indexed by symbol id. */
+};
+
+/**
+ * @brief Storage a variable reference is bound to.
+ *
+ */
+struct Binding
+{
+  BindingKind kind{ BindingKind::UNRESOLVED };
+  uint32_t index{ 0 }; /**< Parameter index or symbol id. */
+};
+
 /**
  * @brief Variable node.
  *
@@ -26,35 +48,61 @@ namespace tcalc::ast {
 class VarRefNode : public Node
 {
 private:
-  std::string _name;
+  SymbolId _symbol;
+  Binding _binding{};
 
 public:
   /**
    * @brief Construct a new Variable Node object.
    *
-   * @param name Variable name.
+   * @param symbol Variable symbol.
    */
-  explicit VarRefNode(std::string name)
+  explicit VarRefNode(SymbolId symbol)
     : Node{ NodeType::VARREF }
-    , _name{ std::move(name) }
+    , _symbol{ symbol }
   {
   }
 
-  ~VarRefNode() override = default;
+  /**
+   * @brief Get variable symbol.
+   *
+   * @return SymbolId Variable symbol.
+   */
+  [[nodiscard]] TCALC_INLINE auto symbol() const noexcept { return _symbol; }
+
+  /**
+   * @brief Set variable symbol.
+   *
+   * @param symbol Variable symbol.
+   */
+  TCALC_INLINE void symbol(SymbolId symbol) noexcept { _symbol = symbol; }
+
+  /**
+   * @brief Get variable name, for printing and error messages.
+   *
+   * @return std::string_view Variable name.
+   */
+  [[nodiscard]] std::string_view name() const
+  {
+    return symbols().name(_symbol);
+  }
 
   /**
-   * @brief Get variable name.
+   * @brief Get variable binding.
    *
-   * @return const std::string& Variable name.
+   * @return const Binding& Variable binding.
    */
-  [[nodiscard]] TCALC_INLINE auto& name() const noexcept { return _name; }
+  [[nodiscard]] TCALC_INLINE auto& binding() const noexcept
+  {
+    return _binding;
+  }
 
   /**
-   * @brief Set variable name.
+   * @brief Set variable binding.
    *
-   * @param name Variable name.
+   * @param binding Variable binding.
    */
-  TCALC_INLINE void name(std::string name) noexcept { _name = std::move(name); }
+  TCALC_INLINE void binding(Binding binding) noexcept { _binding = binding; }
 };
 
 /**
@@ -64,48 +112,56 @@ public:
 class VarAssignNode : public Node
 {
 private:
-  std::string _name;
+  SymbolId _symbol;
   NodePtr<> _body;
 
 public:
   /**
    * @brief Construct a new Var Assign Node object.
    *
-   * @param name Variable name.
+   * @param symbol Variable symbol.
    */
-  explicit VarAssignNode(std::string name)
-    : VarAssignNode{ std::move(name), nullptr }
+  explicit VarAssignNode(SymbolId symbol)
+    : VarAssignNode{ symbol, nullptr }
   {
   }
 
   /**
    * @brief Construct a new Var Assign Node object with body.
    *
-   * @param name Variable name.
+   * @param symbol Variable symbol.
    * @param body Variable body.
    */
-  VarAssignNode(std::string name, NodePtr<> body)
+  VarAssignNode(SymbolId symbol, NodePtr<> body)
     : Node{ NodeType::VARASSIGN }
-    , _name{ std::move(name) }
-    , _body{ std::move(body) }
+    , _symbol{ symbol }
+    , _body{ body }
   {
   }
 
-  ~VarAssignNode() override = default;
+  /**
+   * @brief Get variable symbol, which is also its global slot.
+   *
+   * @return SymbolId Variable symbol.
+   */
+  [[nodiscard]] TCALC_INLINE auto symbol() const noexcept { return _symbol; }
 
   /**
-   * @brief Get variable name.
+   * @brief Set variable symbol.
    *
-   * @return const std::string& Variable name.
+   * @param symbol Variable symbol.
    */
-  [[nodiscard]] TCALC_INLINE auto& name() const noexcept { return _name; }
+  TCALC_INLINE void symbol(SymbolId symbol) noexcept { _symbol = symbol; }
 
   /**
-   * @brief Set variable name.
+   * @brief Get variable name, for printing and error messages.
    *
-   * @param name Variable name.
+   * @return std::string_view Variable name.
    */
-  TCALC_INLINE void name(std::string name) noexcept { _name = std::move(name); }
+  [[nodiscard]] std::string_view name() const
+  {
+    return symbols().name(_symbol);
+  }
 
   /**
    * @brief Get variable body.
@@ -126,7 +182,7 @@ public:
    *
    * @param body Variable body.
    */
-  TCALC_INLINE void body(NodePtr<> body) noexcept { _body = std::move(body); }
+  TCALC_INLINE void body(NodePtr<> body) noexcept { _body = body; }
 };
 
 }
@@ -11,11 +11,21 @@
 
 #pragma once
 
+#include <cassert>
 #include <cmath> // IWYU pragma: keep
+#include <cstddef>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/flat.hpp"
 #include "tcalc/ast/function.hpp"
 #include "tcalc/ast/node.hpp"
 #include "tcalc/ast/program.hpp"
@@ -28,14 +38,158 @@ class EvalContext;
 
 }
 
+namespace tcalc::bytecode {
+
+class Chunk;
+
+}
+
 namespace tcalc::builtins {
 
 /**
- * @brief Built-in function type.
+ * @brief Built-in function type, the context is mutable so that user-defined
+ * functions can push their call frame.
+ *
+ * @note Arguments point into a stack owned by the caller, they are only valid
+ * until the function evaluates anything in the context.
+ */
+using Function =
+  std::function<error::Result<double>(std::span<const double>, EvalContext&)>;
+
+/**
+ * @brief Built-in function type of the vector calling convention.
+ *
+ */
+using VectorFunction = std::function<
+  error::Result<double>(const std::vector<double>&, EvalContext&)>;
+
+/**
+ * @brief Metadata of a function slot.
+ *
+ */
+struct FunctionInfo
+{
+  constexpr static std::size_t VARIADIC =
+    std::numeric_limits<std::size_t>::max(); /**< Any argument count. */
+
+  std::size_t arity{ VARIADIC }; /**< Expected argument count. */
+  bool pure{ false };            /**< Result only depends on the arguments. */
+};
+
+/**
+ * @brief Thunk calling a native function with unpacked arguments.
+ *
+ * @tparam Sig Native signature, every parameter is initialized from a double.
+ * @tparam F Callable type.
+ *
+ * @note The argument count is not checked here, it is checked once when a
+ * call site resolves the function, see EvalContext::func.
+ */
+template<typename Sig, typename F>
+class NativeThunk;
+
+template<typename R, typename... Args, typename F>
+class NativeThunk<R(Args...), F>
+{
+public:
+  constexpr static std::size_t ARITY = sizeof...(Args); /**< Arity. */
+
+private:
+  F _fn;
+
+public:
+  /**
+   * @brief Construct a new Native Thunk object.
+   *
+   * @param fn Native callable.
+   */
+  explicit NativeThunk(F fn)
+    : _fn{ std::move(fn) }
+  {
+  }
+
+  ~NativeThunk() = default;
+
+  /**
+   * @brief Get the native callable.
+   *
+   * @return const F& Native callable, lets passes recognize known functions.
+   */
+  [[nodiscard]] TCALC_INLINE const F& native() const noexcept { return _fn; }
+
+  /**
+   * @brief Call the native function.
+   *
+   * @param args Function arguments, exactly ARITY of them.
+   * @return error::Result<double> Function result.
+   */
+  TCALC_INLINE error::Result<double> operator()(
+    std::span<const double> args,
+    EvalContext& /*ctx*/) const
+  {
+    assert(args.size() == ARITY);
+    return _call(args, std::index_sequence_for<Args...>{});
+  }
+
+private:
+  template<std::size_t... I>
+  TCALC_INLINE double _call([[maybe_unused]] std::span<const double> args,
+                            std::index_sequence<I...> /*indices*/) const
+  {
+    return static_cast<double>(_fn(static_cast<Args>(args[I])...));
+  }
+};
+
+/**
+ * @brief Variable table type, supports lookup with std::string_view.
+ *
+ */
+using VariableMap =
+  std::unordered_map<std::string, double, StringHash, std::equal_to<>>;
+
+/**
+ * @brief Function table type, supports lookup with std::string_view.
  *
  */
-using Function = std::function<error::Result<double>(const std::vector<double>&,
-                                                     const EvalContext&)>;
+using FunctionMap =
+  std::unordered_map<std::string, Function, StringHash, std::equal_to<>>;
+
+/**
+ * @brief Adapter for functions written against the vector calling convention,
+ * the arguments are copied into a vector on every call.
+ *
+ */
+class TCALC_PUBLIC VectorFunctionAdapter
+{
+private:
+  VectorFunction _func;
+
+public:
+  /**
+   * @brief Construct a new Vector Function Adapter object.
+   *
+   * @param func Function taking its arguments in a vector.
+   */
+  explicit VectorFunctionAdapter(VectorFunction func)
+    : _func{ std::move(func) }
+  {
+  }
+
+  ~VectorFunctionAdapter() = default;
+
+  /**
+   * @brief Evaluate the function.
+   *
+   * @param args Function arguments.
+   * @param ctx Evaluation context.
+   * @return error::Result<double> Evaluation result.
+   */
+  error::Result<double> operator()(std::span<const double> args,
+                                   EvalContext& ctx) const
+  {
+    return _func(std::vector<double>(args.begin(), args.end()), ctx);
+  }
+};
 
 /**
  * @brief Wrapper for User-defined functions.
@@ -44,20 +198,102 @@ using Function = std::function<error::Result<double>(const std::vector<double>&,
 class TCALC_PUBLIC FunctionWrapper
 {
 private:
+  std::shared_ptr<ast::Arena> _arena;
   ast::NodePtr<ast::FdefNode> _node;
+  std::shared_ptr<const bytecode::Chunk> _chunk;
+  std::size_t _depth{ 0 }; /**< Native nesting of the body's walk. */
 
 public:
   /**
-   * @brief Construct a new Function Wrapper object.
+   * @brief Construct a new Function Wrapper object, the definition is copied
+   * into an arena owned by the wrapper.
+   *
+   * @param node Function definition node.
+   */
+  explicit FunctionWrapper(ast::NodePtr<ast::FdefNode> node);
+
+  /**
+   * @brief Construct a new Function Wrapper object sharing an arena.
    *
+   * @param arena Arena owning the function definition.
    * @param node Function definition node.
+   * @param chunk Compiled function body, if any.
    */
-  explicit FunctionWrapper(ast::NodePtr<ast::FdefNode> node)
-    : _node{ std::move(node) }
+  FunctionWrapper(std::shared_ptr<ast::Arena> arena,
+                  ast::NodePtr<ast::FdefNode> node,
+                  std::shared_ptr<const bytecode::Chunk> chunk = {});
+
+  ~FunctionWrapper() = default;
+
+  /**
+   * @brief Get the arena owning the function definition.
+   *
+   * @return const std::shared_ptr<ast::Arena>& Arena.
+   */
+  [[nodiscard]] TCALC_INLINE auto& arena() const noexcept { return _arena; }
+
+  /**
+   * @brief Get the function definition node.
+   *
+   * @return const ast::NodePtr<ast::FdefNode>& Function definition node.
+   */
+  [[nodiscard]] TCALC_INLINE auto& node() const noexcept { return _node; }
+
+  /**
+   * @brief Get the compiled function body.
+   *
+   * @return const std::shared_ptr<const bytecode::Chunk>& Compiled body, null
+   * if the function was defined by the tree walker.
+   */
+  [[nodiscard]] TCALC_INLINE auto& chunk() const noexcept { return _chunk; }
+
+  /**
+   * @brief Get how deep the tree walker nests in the function body.
+   *
+   * @return std::size_t Native nesting, charged to the frame of each call.
+   */
+  [[nodiscard]] TCALC_INLINE auto depth() const noexcept { return _depth; }
+
+  /**
+   * @brief Evaluate the function.
+   *
+   * @param args Function arguments.
+   * @param ctx Evaluation context.
+   * @return error::Result<double> Evaluation result.
+   */
+  error::Result<double> operator()(std::span<const double> args,
+                                   EvalContext& ctx) const;
+};
+
+/**
+ * @brief Wrapper for User-defined functions of a flat tree.
+ *
+ */
+class TCALC_PUBLIC FlatFunctionWrapper
+{
+private:
+  std::shared_ptr<const ast::FlatTree> _tree;
+
+public:
+  /**
+   * @brief Construct a new Flat Function Wrapper object.
+   *
+   * @param tree Tree whose root is the function definition.
+   */
+  explicit FlatFunctionWrapper(std::shared_ptr<const ast::FlatTree> tree)
+    : _tree{ std::move(tree) }
   {
   }
 
-  ~FunctionWrapper() = default;
+  ~FlatFunctionWrapper() = default;
+
+  /**
+   * @brief Get the tree of the function definition.
+   *
+   * @return const std::shared_ptr<const ast::FlatTree>& Tree whose root is the
+   * function definition.
+   */
+  [[nodiscard]] TCALC_INLINE auto& tree() const noexcept { return _tree; }
 
   /**
    * @brief Evaluate the function.
@@ -66,8 +302,8 @@ public:
    * @param ctx Evaluation context.
    * @return error::Result<double> Evaluation result.
    */
-  error::Result<double> operator()(const std::vector<double>& args,
-                                   const EvalContext& ctx) const;
+  error::Result<double> operator()(std::span<const double> args,
+                                   EvalContext& ctx) const;
 };
 
 /**
@@ -77,7 +313,7 @@ public:
 class TCALC_PUBLIC ImportWrapper
 {
 private:
-  ast::NodePtr<ast::ProgramImportNode> _node;
+  std::string _path;
 
 public:
   /**
@@ -86,7 +322,17 @@ public:
    * @param node ProgramImportNode.
    */
   explicit ImportWrapper(ast::NodePtr<ast::ProgramImportNode> node)
-    : _node{ std::move(node) }
+    : _path{ node->path() }
+  {
+  }
+
+  /**
+   * @brief Construct a new Import Wrapper object.
+   *
+   * @param path Path of the imported program.
+   */
+  explicit ImportWrapper(std::string path)
+    : _path{ std::move(path) }
   {
   }
 
@@ -101,113 +347,64 @@ public:
   error::Result<void> import(EvalContext& ctx) const;
 };
 
-/**
- * @brief Built-in sqrt function.
- *
- * @param args Function arguments.
- * @return error::Result<double> Result.
- */
-TCALC_PUBLIC error::Result<double>
-sqrt(const std::vector<double>& args, const EvalContext& ctx);
-
-/**
- * @brief Built-in pow function.
- *
- * @param args Function arguments.
- * @return error::Result<double> Result.
- */
-TCALC_PUBLIC error::Result<double>
-pow(const std::vector<double>& args, const EvalContext& ctx);
-
-/**
- * @brief Built-in log function.
- *
- * @param args Function arguments.
- * @param ctx Evaluation context.
- * @return error::Result<double> Result.
- */
-TCALC_PUBLIC error::Result<double>
-log(const std::vector<double>& args, const EvalContext& ctx);
-
-/**
- * @brief Built-in sin function.
- *
- * @param args Function arguments.
- * @param ctx Evaluation context.
- * @return error::Result<double> Result.
- */
-TCALC_PUBLIC error::Result<double>
-sin(const std::vector<double>& args, const EvalContext& ctx);
-
-/**
- * @brief Built-in cos function.
- *
- * @param args Function arguments.
- * @param ctx Evaluation context.
- * @return error::Result<double> Result.
- */
-TCALC_PUBLIC error::Result<double>
-cos(const std::vector<double>& args, const EvalContext& ctx);
+inline const VariableMap BUILTIN_VARIABLES = {
+  { "pi", M_PI },
+  { "e", M_E },
+}; /**< Built-in variables. */
 
 /**
- * @brief Built-in tan function.
+ * @brief Logarithm with an explicit base, the built-in `log`.
  *
- * @param args Function arguments.
- * @param ctx Evaluation context.
- * @return error::Result<double> Result.
+ * @param base Logarithm base.
+ * @param x Argument.
+ * @return double Logarithm of x in base.
  */
-TCALC_PUBLIC error::Result<double>
-tan(const std::vector<double>& args, const EvalContext& ctx);
+TCALC_PUBLIC double
+log_base(double base, double x);
 
 /**
- * @brief Built-in acos function.
+ * @brief Built-in math functions. Standard library functions may not have
+ * their address taken, each one is wrapped in a lambda whose closure type
+ * lets passes recognize it, see NativeThunk::native.
  *
- * @param args Function arguments.
- * @param ctx Evaluation context.
- * @return error::Result<double> Result.
  */
-TCALC_PUBLIC error::Result<double>
-acos(const std::vector<double>& args, const EvalContext& ctx);
+inline constexpr auto SQRT = [](double x) { return std::sqrt(x); };
+inline constexpr auto POW = [](double x, double y) { return std::pow(x, y); };
+inline constexpr auto LOG = [](double base, double x) {
+  return log_base(base, x);
+};
+inline constexpr auto SIN = [](double x) { return std::sin(x); };
+inline constexpr auto COS = [](double x) { return std::cos(x); };
+inline constexpr auto TAN = [](double x) { return std::tan(x); };
+inline constexpr auto ACOS = [](double x) { return std::acos(x); };
+inline constexpr auto ASIN = [](double x) { return std::asin(x); };
+inline constexpr auto ATAN = [](double x) { return std::atan(x); };
+inline constexpr auto EXP = [](double x) { return std::exp(x); };
 
 /**
- * @brief Built-in asin function.
+ * @brief Built-in functions with the generic calling convention, each one
+ * checks its argument count on every call.
  *
- * @param args Function arguments.
- * @param ctx Evaluation context.
- * @return error::Result<double> Result.
+ * @deprecated Functions passed through a FunctionMap are neither pure nor of
+ * a known arity, so calls to them are not optimized. Use register_builtins or
+ * make_context instead.
  */
-TCALC_PUBLIC error::Result<double>
-asin(const std::vector<double>& args, const EvalContext& ctx);
+extern TCALC_PUBLIC const FunctionMap BUILTIN_FUNCTIONS;
 
 /**
- * @brief Built-in atan function.
+ * @brief Register the built-in functions.
  *
- * @param args Function arguments.
  * @param ctx Evaluation context.
- * @return error::Result<double> Result.
  */
-TCALC_PUBLIC error::Result<double>
-atan(const std::vector<double>& args, const EvalContext& ctx);
+TCALC_PUBLIC void
+register_builtins(EvalContext& ctx);
 
 /**
- * @brief Built-in exp function.
+ * @brief Create a context with the built-in variables and functions.
  *
- * @param args Function arguments.
- * @param ctx Evaluation context.
- * @return error::Result<double> Result.
+ * @return EvalContext Evaluation context.
  */
-TCALC_PUBLIC error::Result<double>
-exp(const std::vector<double>& args, const EvalContext& ctx);
-
-inline const std::unordered_map<std::string, double> BUILTIN_VARIABLES = {
-  { "pi", M_PI },
-  { "e", M_E },
-}; /**< Built-in variables. */
-
-inline const std::unordered_map<std::string, Function> BUILTIN_FUNCTIONS = {
-  { "sqrt", sqrt }, { "pow", pow }, { "log", log },   { "sin", sin },
-  { "cos", cos },   { "tan", tan }, { "acos", acos }, { "asin", asin },
-  { "atan", atan }, { "exp", exp }
-}; /**< Built-in functions. */
+TCALC_PUBLIC EvalContext
+make_context();
 
 }
@@ -0,0 +1,330 @@
+/**
+ * @file bytecode.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Bytecode definition for the tcalc virtual machine.
+ * @version 0.2.0
+ * @date 2025-06-20
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/function.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/symbol.hpp"
+
+namespace tcalc::bytecode {
+
+/**
+ * @brief Operation code.
+ *
+ */
+enum class OpCode : uint8_t
+{
+  CONST,         /**< Push constant `arg`. */
+  LOAD,          /**< Push global in slot `arg`. */
+  LOAD_ARG,      /**< Push function argument in slot `arg`. */
+  STORE,         /**< Store top of stack into global in slot `arg`. */
+  ADD,           /**< Binary plus. */
+  SUB,           /**< Binary minus. */
+  MUL,           /**< Binary multiply. */
+  DIV,           /**< Binary divide. */
+  EQ,            /**< Binary equal. */
+  NE,            /**< Binary not equal. */
+  GT,            /**< Binary greater. */
+  GE,            /**< Binary greater equal. */
+  LT,            /**< Binary less. */
+  LE,            /**< Binary less equal. */
+  POS,           /**< Unary plus. */
+  NEG,           /**< Unary minus. */
+  NOT,           /**< Unary not. */
+  FMA,           /**< Pop c and x, replace top r with `fma(r, x, c)`. */
+  JUMP,          /**< Jump to `arg`. */
+  JUMP_IF_FALSE, /**< Pop condition, jump to `arg` if it is false. */
+  AND_JUMP,      /**< Jump to `arg` leaving 0 if top is 0, else pop it. */
+  OR_JUMP,       /**< Jump to `arg` leaving 1 if top is not 0, else pop it. */
+  TRUTH,         /**< Replace top of stack with 1 if it is not 0, else 0. */
+  CALL,          /**< Call the function of call site `arg`. */
+  TAIL_CALL,     /**< Call site `arg` in tail position, reuses the frame. */
+  DEF,           /**< Define function prototype `arg`. */
+  IMPORT,        /**< Import the program of import `arg`. */
+  YIELD,         /**< Pop a statement result into the program results. */
+  RETURN,        /**< Return top of stack. */
+};
+
+inline const std::unordered_map<OpCode, std::string> OPCODE_NAMES = {
+  { OpCode::CONST, "CONST" },
+  { OpCode::LOAD, "LOAD" },
+  { OpCode::LOAD_ARG, "LOAD_ARG" },
+  { OpCode::STORE, "STORE" },
+  { OpCode::ADD, "ADD" },
+  { OpCode::SUB, "SUB" },
+  { OpCode::MUL, "MUL" },
+  { OpCode::DIV, "DIV" },
+  { OpCode::EQ, "EQ" },
+  { OpCode::NE, "NE" },
+  { OpCode::GT, "GT" },
+  { OpCode::GE, "GE" },
+  { OpCode::LT, "LT" },
+  { OpCode::LE, "LE" },
+  { OpCode::POS, "POS" },
+  { OpCode::NEG, "NEG" },
+  { OpCode::NOT, "NOT" },
+  { OpCode::FMA, "FMA" },
+  { OpCode::JUMP, "JUMP" },
+  { OpCode::JUMP_IF_FALSE, "JUMP_IF_FALSE" },
+  { OpCode::AND_JUMP, "AND_JUMP" },
+  { OpCode::OR_JUMP, "OR_JUMP" },
+  { OpCode::TRUTH, "TRUTH" },
+  { OpCode::CALL, "CALL" },
+  { OpCode::TAIL_CALL, "TAIL_CALL" },
+  { OpCode::DEF, "DEF" },
+  { OpCode::IMPORT, "IMPORT" },
+  { OpCode::YIELD, "YIELD" },
+  { OpCode::RETURN, "RETURN" },
+}; /**< Operation code names. */
+
+/**
+ * @brief Single VM instruction.
+ *
+ */
+struct Instruction
+{
+  OpCode op;
+  uint32_t arg;
+};
+
+/**
+ * @brief Function call site.
+ *
+ */
+struct CallSite
+{
+  SymbolId symbol;
+  uint32_t argc;
+  mutable ast::CallCache cache{}; /**< Callee cache, chunks are shared. */
+};
+
+class Chunk;
+
+/**
+ * @brief Compiled user-defined function.
+ *
+ */
+struct FunctionProto
+{
+  std::shared_ptr<ast::Arena> arena; /**< Arena owning the definition. */
+  ast::NodePtr<ast::FdefNode> node;
+  std::shared_ptr<const Chunk> chunk;
+};
+
+/**
+ * @brief Linear bytecode with its constant and symbol tables.
+ *
+ */
+class TCALC_PUBLIC Chunk
+{
+private:
+  std::vector<Instruction> _code;
+  std::vector<double> _consts;
+  std::vector<CallSite> _calls;
+  std::vector<FunctionProto> _protos;
+  std::vector<std::string> _imports;
+  std::vector<FunctionProto> _inlined;
+
+public:
+  Chunk() = default;
+  ~Chunk() = default;
+
+  /**
+   * @brief Get instructions.
+   *
+   * @return const std::vector<Instruction>& Instructions.
+   */
+  [[nodiscard]] TCALC_INLINE auto& code() const noexcept { return _code; }
+
+  /**
+   * @brief Get constant table.
+   *
+   * @return const std::vector<double>& Constants.
+   */
+  [[nodiscard]] TCALC_INLINE auto& consts() const noexcept { return _consts; }
+
+  /**
+   * @brief Get call site table.
+   *
+   * @return const std::vector<CallSite>& Call sites.
+   */
+  [[nodiscard]] TCALC_INLINE auto& calls() const noexcept { return _calls; }
+
+  /**
+   * @brief Get function prototypes.
+   *
+   * @return const std::vector<FunctionProto>& Function prototypes.
+   */
+  [[nodiscard]] TCALC_INLINE auto& protos() const noexcept { return _protos; }
+
+  /**
+   * @brief Get import table.
+   *
+   * @return const std::vector<std::string>& Import paths.
+   */
+  [[nodiscard]] TCALC_INLINE auto& imports() const noexcept
+  {
+    return _imports;
+  }
+
+  /**
+   * @brief Get the context functions inlined into the chunk.
+   *
+   * @return const std::vector<FunctionProto>& Inlined functions, the chunk is
+   * stale once one of them is no longer defined under its name.
+   */
+  [[nodiscard]] TCALC_INLINE auto& inlined() const noexcept
+  {
+    return _inlined;
+  }
+
+  /**
+   * @brief Get current code size, used as a jump target.
+   *
+   * @return std::size_t Code size.
+   */
+  [[nodiscard]] TCALC_INLINE auto size() const noexcept { return _code.size(); }
+
+  /**
+   * @brief Emit an instruction.
+   *
+   * @param op Operation code.
+   * @param arg Instruction argument.
+   * @return std::size_t Index of the emitted instruction.
+   */
+  TCALC_INLINE auto emit(OpCode op, uint32_t arg = 0)
+  {
+    _code.push_back({ op, arg });
+    return _code.size() - 1;
+  }
+
+  /**
+   * @brief Patch the argument of an emitted instruction.
+   *
+   * @param index Instruction index.
+   * @param arg New argument.
+   */
+  TCALC_INLINE void patch(std::size_t index, uint32_t arg) noexcept
+  {
+    _code[index].arg = arg;
+  }
+
+  /**
+   * @brief Add a constant.
+   *
+   * @param value Constant value.
+   * @return uint32_t Constant index.
+   */
+  uint32_t add_const(double value);
+
+  /**
+   * @brief Add a call site.
+   *
+   * @param symbol Callee symbol.
+   * @param argc Argument count.
+   * @return uint32_t Call site index.
+   */
+  uint32_t add_call(SymbolId symbol, uint32_t argc);
+
+  /**
+   * @brief Add a function prototype.
+   *
+   * @param proto Function prototype.
+   * @return uint32_t Prototype index.
+   */
+  uint32_t add_proto(FunctionProto proto);
+
+  /**
+   * @brief Add an import.
+   *
+   * @param path Import path.
+   * @return uint32_t Import index.
+   */
+  uint32_t add_import(std::string path);
+
+  /**
+   * @brief Record a context function inlined into the chunk, its definition
+   * is kept alive with the chunk.
+   *
+   * @param proto Inlined function.
+   */
+  void add_inlined(FunctionProto proto);
+};
+
+/**
+ * @brief Bounded cache of compiled chunks keyed by their source text.
+ *
+ */
+class TCALC_PUBLIC ChunkCache
+{
+public:
+  constexpr static std::size_t DEFAULT_CAPACITY = 128; /**< Default size. */
+
+private:
+  std::size_t _capacity;
+  std::unordered_map<std::string,
+                     std::shared_ptr<const Chunk>,
+                     StringHash,
+                     std::equal_to<>>
+    _chunks;
+
+public:
+  /**
+   * @brief Construct a new Chunk Cache object.
+   *
+   * @param capacity Maximum number of cached chunks.
+   */
+  explicit ChunkCache(std::size_t capacity = DEFAULT_CAPACITY)
+    : _capacity{ capacity }
+  {
+  }
+
+  ~ChunkCache() = default;
+
+  /**
+   * @brief Find a cached chunk.
+   *
+   * @param source Source text.
+   * @return std::shared_ptr<const Chunk> Cached chunk, null if missing.
+   */
+  [[nodiscard]] std::shared_ptr<const Chunk> find(
+    std::string_view source) const;
+
+  /**
+   * @brief Cache a chunk, replacing a stale chunk of the same source, the
+   * cache is flushed when it is full.
+   *
+   * @param source Source text.
+   * @param chunk Compiled chunk.
+   */
+  void insert(std::string_view source, std::shared_ptr<const Chunk> chunk);
+
+  /**
+   * @brief Drop every cached chunk.
+   *
+   */
+  TCALC_INLINE void clear() noexcept { _chunks.clear(); }
+};
+
+}
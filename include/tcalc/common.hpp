@@ -11,6 +11,10 @@
 
 #pragma once
 
+#include <cstddef>
+#include <functional>
+#include <string_view>
+
 #if defined _WIN32 || defined __CYGWIN__
 #ifdef BUILDING_TCALC
 #define TCALC_PUBLIC __declspec(dllexport)
@@ -37,3 +41,21 @@
 #define TCALC_PRINTF_FORMAT(fmt_idx, arg_idx)                                  \
   __attribute__((format(printf, fmt_idx, arg_idx)))
 #endif
+
+namespace tcalc {
+
+/**
+ * @brief Transparent string hash, allows lookup with std::string_view.
+ *
+ */
+struct StringHash
+{
+  using is_transparent = void;
+
+  std::size_t operator()(std::string_view str) const noexcept
+  {
+    return std::hash<std::string_view>{}(str);
+  }
+};
+
+}
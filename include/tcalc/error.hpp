@@ -18,6 +18,7 @@
 #include <exception>
 #include <string>
 #include <unordered_map>
+#include <utility>
 
 #ifdef TCALC_USE_TL_EXPECTED
 #include <tl/expected.hpp>
@@ -40,7 +41,7 @@
     if (!_ret.has_value()) {                                                   \
       return _TCALC_EXPECTED_NS::unexpected(_ret.error());                     \
     }                                                                          \
-    _ret.value();                                                              \
+    std::move(_ret).value();                                                   \
   })
 
 #define log_err(expr)                                                          \
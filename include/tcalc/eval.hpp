@@ -12,128 +12,610 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/flat.hpp"
+#include "tcalc/ast/function.hpp"
 #include "tcalc/builtins.hpp"
+#include "tcalc/bytecode.hpp"
 #include "tcalc/common.hpp"
 #include "tcalc/error.hpp"
+#include "tcalc/memo.hpp"
 #include "tcalc/parser.hpp"
+#include "tcalc/pipeline.hpp"
+#include "tcalc/symbol.hpp"
+#include "tcalc/visitor/purity.hpp"
+#include "tcalc/vm.hpp"
 
 namespace tcalc {
 
+/**
+ * @brief Activation record of a user-defined function call.
+ *
+ */
+struct CallFrame
+{
+  std::span<const SymbolId> params; /**< Parameter symbols. */
+  std::size_t base; /**< Offset of the arguments in the argument stack. */
+  std::size_t depth; /**< Native nesting charged for the body. */
+};
+
 /**
  * @brief Evaluation context which stores variables and built-in functions.
  *
+ * @note User-defined function calls push a frame holding their arguments,
+ * names are looked up lexically, first in the parameters of the innermost
+ * frame then in the global variables. Globals and functions live in slots
+ * indexed by their symbol id, so resolved code never hashes a name. Only
+ * setting a name creates its slot, so a context grows with the largest id it
+ * sets rather than with the symbol table. Memo tables are only kept for the
+ * functions which are memoized.
+ *
+ * The tree walker recurses on the native stack through every body it enters,
+ * so each frame is charged how deep its body nests and a call fails with
+ * `RECURSION_LIMIT` once the frames together exceed MAX_NESTING.
+ *
+ * Every change to the functions moves the context to a new generation, call
+ * sites cache their callee until the generation changes. Generations are
+ * unique across all contexts and copies, so a cache filled by one context
+ * never matches another.
+ *
+ * Constants, see constant, may be folded into compiled code. Assigning one
+ * or replacing a pure host function moves the context to a new constant
+ * generation, code folded in an older one must be compiled again.
+ *
+ * Memoization is opt-in, see memoize. Pure user-defined functions then keep a
+ * bounded memo table which is dropped when the generation changes or a
+ * global the function reads is set to a different value.
  */
 class TCALC_PUBLIC EvalContext
 {
 public:
   constexpr static std::size_t MAX_CALL_DEPTH = 1000;
+  constexpr static std::size_t MAX_NESTING =
+    2 * ast::Parser::MAX_DEPTH; /**< Nesting of all frames' bodies. */
 
 private:
-  std::unordered_map<std::string, double> _vars;
-  std::unordered_map<std::string, builtins::Function> _funcs;
+  /**
+   * @brief Global variable slot.
+   *
+   */
+  struct Global
+  {
+    double value;
+    bool defined;
+    bool constant;
+  };
+
+  /**
+   * @brief Function slot.
+   *
+   */
+  struct FunctionSlot
+  {
+    builtins::Function fn;
+    builtins::FunctionInfo info;
+  };
+
+  /**
+   * @brief Function table generation, a copy starts a new generation because
+   * it owns a new table.
+   *
+   */
+  class Generation
+  {
+  private:
+    uint64_t _value{ _next() };
 
-  std::size_t _call_depth{ 0 };
+  public:
+    Generation() = default;
+    ~Generation() = default;
+
+    Generation(const Generation& /*other*/) noexcept {}
+    Generation& operator=(const Generation& /*other*/) noexcept
+    {
+      bump();
+      return *this;
+    }
+
+    [[nodiscard]] TCALC_INLINE auto value() const noexcept { return _value; }
+
+    TCALC_INLINE void bump() noexcept { _value = _next(); }
+
+  private:
+    static uint64_t _next() noexcept;
+  };
+
+  std::vector<Global> _globals;
+  std::vector<FunctionSlot> _funcs;
+  Generation _generation;
+  uint64_t _constant_generation{ 0 };
+
+  std::vector<CallFrame> _frames;
+  std::size_t _nesting{ 0 }; /**< Nesting charged for the frames. */
+  std::vector<double> _args;
+  std::vector<double> _call_args;
+
+  std::unordered_map<SymbolId, MemoTable> _memos;
+  std::size_t _memo_capacity{ 0 };
+  MemoStats _memo_stats;
 
 public:
   /**
    * @brief Construct a new Eval Context object.
    *
-   * @param vars Variables map.
+   * @param vars Constants map, see constant.
    * @param funcs Built-in functions map.
    */
-  EvalContext(std::unordered_map<std::string, double> vars,
-              std::unordered_map<std::string, builtins::Function> funcs,
-              std::size_t call_depth = 0)
-    : _vars{ std::move(vars) }
-    , _funcs{ std::move(funcs) }
-    , _call_depth{ call_depth }
-  {
-  }
+  EvalContext(const builtins::VariableMap& vars,
+              const builtins::FunctionMap& funcs);
 
   EvalContext() = default;
   ~EvalContext() = default;
 
   /**
-   * @brief Get variables.
+   * @brief Get a variable, parameters of the innermost call shadow globals.
    *
-   * @return std::unordered_map<std::string, double>& Variables map.
+   * @param name Variable name.
+   * @return error::Result<double> Variable value result.
    */
-  [[nodiscard]] TCALC_INLINE auto& vars() noexcept { return _vars; }
+  error::Result<double> var(std::string_view name) const;
 
   /**
-   * @brief Get built-in functions.
+   * @brief Get a variable by symbol, parameters of the innermost call shadow
+   * globals.
    *
-   * @return std::unordered_map<std::string, BuiltinFunc>& Built-in functions
-   * map.
+   * @param id Symbol id.
+   * @return error::Result<double> Variable value result.
    */
-  [[nodiscard]] TCALC_INLINE auto& funcs() noexcept { return _funcs; }
+  error::Result<double> var(SymbolId id) const;
 
   /**
-   * @brief Get a variable.
+   * @brief Set a global variable.
    *
    * @param name Variable name.
+   * @param value Variable value.
+   */
+  void var(std::string_view name, double value);
+
+  /**
+   * @brief Set a constant, a global which may be folded into compiled code
+   * until it is assigned again.
+   *
+   * @param name Constant name.
+   * @param value Constant value.
+   */
+  void constant(std::string_view name, double value);
+
+  /**
+   * @brief Check if a global variable is a constant.
+   *
+   * @param id Symbol id.
+   * @return true if the global was set as a constant and never assigned since
+   * @return false if it is a variable or undefined
+   */
+  [[nodiscard]] TCALC_INLINE bool constant(SymbolId id) const noexcept
+  {
+    return id < _globals.size() && _globals[id].constant;
+  }
+
+  /**
+   * @brief Get the constant generation.
+   *
+   * @return uint64_t Generation, changes whenever a constant is assigned or a
+   * pure host function is replaced.
+   */
+  [[nodiscard]] TCALC_INLINE auto constant_generation() const noexcept
+  {
+    return _constant_generation;
+  }
+
+  /**
+   * @brief Check if a global variable is defined.
+   *
+   * @param id Symbol id.
+   * @return true if the global has a value
+   * @return false if the global was never assigned
+   */
+  [[nodiscard]] TCALC_INLINE bool defined(SymbolId id) const noexcept
+  {
+    return id < _globals.size() && _globals[id].defined;
+  }
+
+  /**
+   * @brief Get a global variable by slot.
+   *
+   * @param id Symbol id.
    * @return error::Result<double> Variable value result.
    */
-  error::Result<double> var(const std::string& name) const;
+  [[nodiscard]] TCALC_INLINE error::Result<double> global(SymbolId id) const
+  {
+    if (defined(id)) {
+      return _globals[id].value;
+    }
+
+    return _undefined(id);
+  }
 
   /**
-   * @brief Set a variable.
+   * @brief Set a global variable by slot.
    *
-   * @param name Variable name.
+   * @param id Symbol id.
    * @param value Variable value.
    */
-  TCALC_INLINE void var(const std::string& name, double value) noexcept
+  TCALC_INLINE void global(SymbolId id, double value)
   {
-    _vars[name] = value;
+    if (id >= _globals.size()) {
+      _globals.resize(id + 1, { 0, false, false });
+    }
+
+    auto& slot = _globals[id];
+    if (slot.constant) {
+      ++_constant_generation;
+    }
+    slot = { value, true, false };
+  }
+
+  /**
+   * @brief Remove a global variable by slot.
+   *
+   * @param id Symbol id.
+   */
+  TCALC_INLINE void erase(SymbolId id) noexcept
+  {
+    if (id >= _globals.size()) {
+      return;
+    }
+
+    auto& slot = _globals[id];
+    if (slot.constant) {
+      ++_constant_generation;
+    }
+    slot = { 0, false, false };
+  }
+
+  /**
+   * @brief Get an argument of the innermost call.
+   *
+   * @param index Parameter index.
+   * @return double Argument value.
+   */
+  [[nodiscard]] TCALC_INLINE double arg(std::size_t index) const noexcept
+  {
+    return _args[_frames.back().base + index];
+  }
+
+  /**
+   * @brief Get the start of the arguments of a call being set up.
+   *
+   * @return std::size_t Offset to pass to call_args and pop_call_args.
+   */
+  [[nodiscard]] TCALC_INLINE auto call_base() const noexcept
+  {
+    return _call_args.size();
+  }
+
+  /**
+   * @brief Push an argument of a call being set up, the storage is kept
+   * between calls so arguments are passed without allocating.
+   *
+   * @param value Argument value.
+   */
+  TCALC_INLINE void push_call_arg(double value) { _call_args.push_back(value); }
+
+  /**
+   * @brief Get the arguments pushed since a call base.
+   *
+   * @param base Call base.
+   * @return std::span<const double> Arguments, valid until the next push.
+   */
+  [[nodiscard]] TCALC_INLINE std::span<const double> call_args(
+    std::size_t base) const noexcept
+  {
+    return std::span<const double>{ _call_args }.subspan(base);
+  }
+
+  /**
+   * @brief Drop the arguments pushed since a call base.
+   *
+   * @param base Call base.
+   */
+  TCALC_INLINE void pop_call_args(std::size_t base) noexcept
+  {
+    _call_args.resize(base);
+  }
+
+  /**
+   * @brief Find a function by slot.
+   *
+   * @param id Symbol id.
+   * @return const builtins::Function* Function, null if it is not defined.
+   */
+  [[nodiscard]] TCALC_INLINE const builtins::Function* find_func(
+    SymbolId id) const noexcept
+  {
+    return id < _funcs.size() && _funcs[id].fn ? &_funcs[id].fn : nullptr;
+  }
+
+  /**
+   * @brief Get the metadata of a function.
+   *
+   * @param id Symbol id.
+   * @return const builtins::FunctionInfo* Function metadata, null if it is not
+   * defined.
+   */
+  [[nodiscard]] TCALC_INLINE const builtins::FunctionInfo* func_info(
+    SymbolId id) const noexcept
+  {
+    return id < _funcs.size() && _funcs[id].fn ? &_funcs[id].info : nullptr;
+  }
+
+  /**
+   * @brief Get the metadata of a function by name.
+   *
+   * @param name Function name.
+   * @return const builtins::FunctionInfo* Function metadata, null if it is not
+   * defined.
+   */
+  [[nodiscard]] const builtins::FunctionInfo* func_info(
+    std::string_view name) const;
+
+  /**
+   * @brief Check the argument count of a call against a function.
+   *
+   * @param id Symbol id.
+   * @param argc Argument count of the call.
+   * @return error::Result<void> Result, fails only if the function is defined
+   * with a different arity.
+   */
+  error::Result<void> check_args(SymbolId id, std::size_t argc) const;
+
+  /**
+   * @brief Get the function table generation.
+   *
+   * @return uint64_t Generation, changes whenever a function is set.
+   */
+  [[nodiscard]] TCALC_INLINE auto generation() const noexcept
+  {
+    return _generation.value();
   }
 
   /**
    * @brief Get a built-in function.
    *
    * @param name Function name.
-   * @return error::Result<BuiltinFunc> Function pointer result.
+   * @return error::Result<std::reference_wrapper<const builtins::Function>>
+   * Function result, the reference stays valid until the function is
+   * redefined.
    */
-  error::Result<builtins::Function> func(const std::string& name) const;
+  error::Result<std::reference_wrapper<const builtins::Function>> func(
+    std::string_view name) const;
+
+  /**
+   * @brief Get a built-in function by symbol.
+   *
+   * @param id Symbol id.
+   * @return error::Result<std::reference_wrapper<const builtins::Function>>
+   * Function result, the reference stays valid until the function is
+   * redefined.
+   */
+  error::Result<std::reference_wrapper<const builtins::Function>> func(
+    SymbolId id) const;
+
+  /**
+   * @brief Get a built-in function through a call site cache, the table is
+   * only consulted and the arguments only checked when the functions changed
+   * since the cache was filled.
+   *
+   * @param id Symbol id.
+   * @param argc Argument count of the call site.
+   * @param cache Call site cache.
+   * @return error::Result<std::reference_wrapper<const builtins::Function>>
+   * Function result, fails on undefined functions and mismatched arguments.
+   */
+  TCALC_INLINE error::Result<std::reference_wrapper<const builtins::Function>>
+  func(SymbolId id, std::size_t argc, ast::CallCache& cache) const
+  {
+    if (cache.generation == _generation.value()) {
+      return std::cref(*static_cast<const builtins::Function*>(cache.callee));
+    }
+    return _fill(id, argc, cache);
+  }
 
   /**
    * @brief Set a built-in function.
    *
    * @param name Function name.
    * @param func Function pointer.
+   * @param info Function metadata.
+   */
+  void func(std::string_view name,
+            builtins::Function func,
+            builtins::FunctionInfo info = {});
+
+  /**
+   * @brief Set a built-in function by symbol.
+   *
+   * @param id Symbol id.
+   * @param func Function pointer.
+   * @param info Function metadata.
+   */
+  void func(SymbolId id,
+            builtins::Function func,
+            builtins::FunctionInfo info = {});
+
+  /**
+   * @brief Register a native function, its arguments are unpacked from the
+   * argument span and its arity is recorded from the signature.
+   *
+   * @tparam Sig Native signature, e.g. `double(double, double)`.
+   * @tparam F Callable type.
+   * @param name Function name.
+   * @param fn Native callable.
+   * @param pure Whether the result only depends on the arguments.
+   */
+  template<typename Sig, typename F>
+  void register_fn(std::string_view name, F fn, bool pure = true)
+  {
+    using Thunk = builtins::NativeThunk<Sig, F>;
+    func(name, Thunk{ std::move(fn) }, { Thunk::ARITY, pure });
+  }
+
+  /**
+   * @brief Register a native function pointer, selects the overload matching
+   * the signature.
+   *
+   * @tparam Sig Native signature, e.g. `double(double, double)`.
+   * @param name Function name.
+   * @param fn Native function.
+   * @param pure Whether the result only depends on the arguments.
+   */
+  template<typename Sig>
+  void register_fn(std::string_view name, Sig* fn, bool pure = true)
+  {
+    register_fn<Sig, Sig*>(name, fn, pure);
+  }
+
+  /**
+   * @brief Collect the dependencies of a function, following user-defined
+   * callees transitively.
+   *
+   * @param id Symbol id.
+   * @return ast::Dependencies Every reachable function and read global, the
+   * function is pure if its body and all of its callees are. Host functions
+   * are as pure as their metadata says, undefined callees are impure.
+   */
+  [[nodiscard]] ast::Dependencies dependencies(SymbolId id) const;
+
+  /**
+   * @brief Enable memoization of pure user-defined functions.
+   *
+   * @param capacity Entries per function, rounded up to a power of two, 0
+   * disables memoization.
+   */
+  void memoize(std::size_t capacity);
+
+  /**
+   * @brief Get the memo table capacity.
+   *
+   * @return std::size_t Entries per function, 0 if memoization is disabled.
+   */
+  [[nodiscard]] TCALC_INLINE auto memo_capacity() const noexcept
+  {
+    return _memo_capacity;
+  }
+
+  /**
+   * @brief Get the memoization counters.
+   *
+   * @return const MemoStats& Counters.
+   */
+  [[nodiscard]] TCALC_INLINE auto& memo_stats() const noexcept
+  {
+    return _memo_stats;
+  }
+
+  /**
+   * @brief Look up a call of a user-defined function in its memo table.
+   *
+   * @param id Function symbol.
+   * @param owner Function body, the definition node or flat tree.
+   * @param args Call arguments.
+   * @return const double* Memoized result, null on a miss or if the function
+   * is not memoized.
+   */
+  [[nodiscard]] TCALC_INLINE const double* memo_find(
+    SymbolId id,
+    const void* owner,
+    std::span<const double> args)
+  {
+    return _memo_capacity == 0 ? nullptr : _memo_find(id, owner, args);
+  }
+
+  /**
+   * @brief Store the result of a call of a user-defined function.
+   *
+   * @param id Function symbol.
+   * @param owner Function body, the definition node or flat tree.
+   * @param args Call arguments.
+   * @param value Call result.
    */
-  TCALC_INLINE void func(const std::string& name,
-                         builtins::Function func) noexcept
+  TCALC_INLINE void memo_store(SymbolId id,
+                               const void* owner,
+                               std::span<const double> args,
+                               double value)
   {
-    _funcs[name] = std::move(func);
+    if (_memo_capacity != 0) {
+      _memo_store(id, owner, args, value);
+    }
   }
 
   /**
    * @brief Get the call depth.
    *
-   * @return std::size_t Call depth.
+   * @return std::size_t Number of active user-defined function calls.
    */
   [[nodiscard]] TCALC_INLINE auto call_depth() const noexcept
   {
-    return _call_depth;
+    return _frames.size();
   }
 
   /**
-   * @brief Set the call depth.
+   * @brief Enter a user-defined function, the arguments are copied into the
+   * argument stack.
    *
-   * @param depth Call depth.
+   * @param name Function symbol, for error messages.
+   * @param params Parameter symbols, must outlive the frame.
+   * @param args Argument values.
+   * @param depth Native nesting of the body, 0 if it is not walked
+   * recursively.
+   * @return error::Result<void> Result, fails if the arguments do not match
+   * the parameters or the call is too deep.
    */
-  TCALC_INLINE void call_depth(std::size_t depth) { _call_depth = depth; }
+  error::Result<void> push_frame(SymbolId name,
+                                 std::span<const SymbolId> params,
+                                 std::span<const double> args,
+                                 std::size_t depth = 0);
 
   /**
-   * @brief Increment the call depth.
+   * @brief Get the arguments of the innermost frame.
    *
+   * @return std::span<const double> Arguments.
    */
-  TCALC_INLINE void increment_call_depth() noexcept { ++_call_depth; }
+  [[nodiscard]] TCALC_INLINE auto frame_args() const noexcept
+  {
+    return std::span<const double>{ _args }.subspan(_frames.back().base);
+  }
+
+  /**
+   * @brief Replace the innermost frame for a call in tail position, the
+   * call depth does not change.
+   *
+   * @param params Parameter symbols, must outlive the frame.
+   * @param args Argument values, must not alias the argument stack.
+   * @param depth Native nesting of the body, 0 if it is not walked
+   * recursively.
+   * @return error::Result<void> Result, fails if the arguments do not match
+   * the parameters or the body nests too deep.
+   */
+  error::Result<void> replace_frame(std::span<const SymbolId> params,
+                                    std::span<const double> args,
+                                    std::size_t depth = 0);
+
+  /**
+   * @brief Leave the innermost user-defined function.
+   *
+   */
+  void pop_frame() noexcept;
 
   /**
    * @brief Update the context with another context.
@@ -141,6 +623,85 @@ public:
    * @param ctx Other context.
    */
   void update_with(const EvalContext& ctx);
+
+private:
+  /**
+   * @brief Build the error of an undefined global.
+   *
+   * @param id Symbol id.
+   * @return error::Result<double> Error result.
+   */
+  [[nodiscard]] static error::Result<double> _undefined(SymbolId id);
+
+  /**
+   * @brief Resolve a call site and fill its cache, the cache is left alone if
+   * the call fails to resolve.
+   *
+   * @param id Symbol id.
+   * @param argc Argument count of the call site.
+   * @param cache Call site cache.
+   * @return error::Result<std::reference_wrapper<const builtins::Function>>
+   * Function result.
+   */
+  error::Result<std::reference_wrapper<const builtins::Function>>
+  _fill(SymbolId id, std::size_t argc, ast::CallCache& cache) const;
+
+  /**
+   * @brief Get the memo table of a function, analysing the function again if
+   * the table belongs to another generation or body.
+   *
+   * @param id Function symbol.
+   * @param owner Function body.
+   * @param argc Argument count.
+   * @return MemoTable& Memo table, synchronized with the globals.
+   */
+  MemoTable& _memo(SymbolId id, const void* owner, std::size_t argc);
+
+  /**
+   * @brief Get the body of a user-defined function.
+   *
+   * @param func Function.
+   * @return const void* Definition node or flat tree, null for host
+   * functions.
+   */
+  [[nodiscard]] static const void* _body(
+    const builtins::Function& func) noexcept;
+
+  /**
+   * @brief Look up a call in a memo table.
+   *
+   * @param id Function symbol.
+   * @param owner Function body.
+   * @param args Call arguments.
+   * @return const double* Memoized result, null if there is none.
+   */
+  const double* _memo_find(SymbolId id,
+                           const void* owner,
+                           std::span<const double> args);
+
+  /**
+   * @brief Store a call in a memo table if the function is pure.
+   *
+   * @param id Function symbol.
+   * @param owner Function body.
+   * @param args Call arguments.
+   * @param value Call result.
+   */
+  void _memo_store(SymbolId id,
+                   const void* owner,
+                   std::span<const double> args,
+                   double value);
+};
+
+/**
+ * @brief Evaluation engine.
+ *
+ */
+enum class Engine : uint8_t
+{
+  TREE, /**< Tree-walking visitor, the reference engine. */
+  VM,   /**< Bytecode compiler and stack virtual machine. */
+  FLAT, /**< Tree-walking over the flat, index based AST. */
 };
 
 /**
@@ -152,6 +713,16 @@ class TCALC_PUBLIC Evaluator
 private:
   EvalContext _ctx;
   ast::Parser _parser{};
+  ast::Arena _arena{};
+  ast::FlatParser _flat_parser{};
+  ast::FlatTree _flat{};
+  Engine _engine{ Engine::VM };
+  PassManager _passes{};
+  uint64_t _constant_generation{ 0 };
+  bytecode::ChunkCache _expr_chunks{};
+  bytecode::ChunkCache _prog_chunks{};
+  bytecode::VM _vm{};
+  SymbolId _ans{ symbols().intern("ans") };
 
 public:
   /**
@@ -166,13 +737,17 @@ public:
    *
    */
   Evaluator()
-    : Evaluator{ EvalContext{ builtins::BUILTIN_VARIABLES,
-                              builtins::BUILTIN_FUNCTIONS } }
+    : Evaluator{ builtins::make_context() }
   {
   }
 
   ~Evaluator() = default;
 
+  Evaluator(const Evaluator&) = delete;
+  Evaluator& operator=(const Evaluator&) = delete;
+  Evaluator(Evaluator&&) noexcept = default;
+  Evaluator& operator=(Evaluator&&) noexcept = default;
+
   /**
    * @brief Get the evaluation context.
    *
@@ -180,6 +755,247 @@ public:
    */
   [[nodiscard]] TCALC_INLINE auto& ctx() const noexcept { return _ctx; }
 
+  /**
+   * @brief Get the evaluation engine.
+   *
+   * @return Engine Evaluation engine.
+   */
+  [[nodiscard]] TCALC_INLINE auto engine() const noexcept { return _engine; }
+
+  /**
+   * @brief Set the evaluation engine.
+   *
+   * @param engine Evaluation engine.
+   */
+  TCALC_INLINE void engine(Engine engine) noexcept { _engine = engine; }
+
+  /**
+   * @brief Get the expression nesting limit of the tree parser.
+   *
+   * @return std::size_t Maximum expression depth.
+   */
+  [[nodiscard]] TCALC_INLINE auto max_depth() const noexcept
+  {
+    return _parser.max_depth();
+  }
+
+  /**
+   * @brief Set the expression nesting limit of the parsers, deeper input is
+   * rejected with `RECURSION_LIMIT` instead of being evaluated. Chains such as
+   * `1 + 1 + 1` do not nest. The tree and VM engines clamp the limit to
+   * ast::Parser::MAX_DEPTH, the flat engine takes any limit.
+   *
+   * @param depth Maximum expression depth.
+   */
+  TCALC_INLINE void max_depth(std::size_t depth) noexcept
+  {
+    _parser.max_depth(depth);
+    _flat_parser.max_depth(depth);
+  }
+
+  /**
+   * @brief Check if constant folding is enabled.
+   *
+   * @return true if inputs are folded before they run
+   * @return false if they run as written
+   */
+  [[nodiscard]] TCALC_INLINE auto fold() const noexcept
+  {
+    return _passes.enabled(Pass::FOLD);
+  }
+
+  /**
+   * @brief Enable or disable constant folding, see ast::FoldVisitor. It is
+   * enabled by default.
+   *
+   * @param fold Whether inputs are folded before they run.
+   */
+  TCALC_INLINE void fold(bool fold) noexcept
+  {
+    _passes.enable(Pass::FOLD, fold);
+    _expr_chunks.clear();
+    _prog_chunks.clear();
+  }
+
+  /**
+   * @brief Check if algebraic simplification is enabled.
+   *
+   * @return true if inputs are rewritten into cheaper forms before they run
+   * @return false if they run as written
+   */
+  [[nodiscard]] TCALC_INLINE auto simplify() const noexcept
+  {
+    return _passes.enabled(Pass::SIMPLIFY);
+  }
+
+  /**
+   * @brief Enable or disable algebraic simplification, see
+   * ast::SimplifyVisitor. It is enabled by default and does not apply to the
+   * flat engine.
+   *
+   * @param simplify Whether inputs are rewritten into cheaper forms.
+   */
+  TCALC_INLINE void simplify(bool simplify) noexcept
+  {
+    _passes.enable(Pass::SIMPLIFY, simplify);
+    _expr_chunks.clear();
+    _prog_chunks.clear();
+  }
+
+  /**
+   * @brief Check if fast math is enabled.
+   *
+   * @return true if simplification may change rounding
+   * @return false if simplified inputs give bit-identical results
+   */
+  [[nodiscard]] TCALC_INLINE auto fast_math() const noexcept
+  {
+    return _passes.fast_math();
+  }
+
+  /**
+   * @brief Enable or disable fast math, letting simplification reassociate
+   * and make rewrites which are not IEEE-exact, and evaluating polynomials
+   * with Horner's scheme and `fma`, see ast::PolyVisitor. It is disabled by
+   * default.
+   *
+   * @param fast_math Whether simplification may change rounding.
+   */
+  TCALC_INLINE void fast_math(bool fast_math) noexcept
+  {
+    _passes.fast_math(fast_math);
+    _expr_chunks.clear();
+    _prog_chunks.clear();
+  }
+
+  /**
+   * @brief Check if common subexpression elimination is enabled.
+   *
+   * @return true if repeated pure subexpressions are computed once
+   * @return false if they run as written
+   */
+  [[nodiscard]] TCALC_INLINE auto cse() const noexcept
+  {
+    return _passes.enabled(Pass::CSE);
+  }
+
+  /**
+   * @brief Enable or disable common subexpression elimination, see
+   * ast::CsePass. It is enabled by default and does not apply to the flat
+   * engine.
+   *
+   * @param cse Whether repeated pure subexpressions are computed once.
+   */
+  TCALC_INLINE void cse(bool cse) noexcept
+  {
+    _passes.enable(Pass::CSE, cse);
+    _expr_chunks.clear();
+    _prog_chunks.clear();
+  }
+
+  /**
+   * @brief Get the inlining budget.
+   *
+   * @return std::size_t Largest inlined function body in nodes, 0 if
+   * inlining is disabled.
+   */
+  [[nodiscard]] TCALC_INLINE auto inline_budget() const noexcept
+  {
+    return _passes.enabled(Pass::INLINE) ? _passes.inline_budget() : 0;
+  }
+
+  /**
+   * @brief Set the inlining budget, calls of user-defined functions whose
+   * body has at most this many nodes are replaced by the body, see
+   * ast::InlinePass. It is ast::InlinePass::DEFAULT_BUDGET by default and
+   * does not apply to the flat engine.
+   *
+   * @param budget Largest inlined function body in nodes, 0 disables
+   * inlining.
+   */
+  TCALC_INLINE void inline_budget(std::size_t budget) noexcept
+  {
+    _passes.inline_budget(budget);
+    _passes.enable(Pass::INLINE, budget > 0);
+    _expr_chunks.clear();
+    _prog_chunks.clear();
+  }
+
+  /**
+   * @brief Get the optimization level.
+   *
+   * @return OptLevel Level last set, passes may have been switched since.
+   */
+  [[nodiscard]] TCALC_INLINE auto opt_level() const noexcept
+  {
+    return _passes.level();
+  }
+
+  /**
+   * @brief Set the optimization level, enabling exactly its passes, see
+   * OptLevel. It is OptLevel::O2 by default.
+   *
+   * @param level Optimization level.
+   */
+  TCALC_INLINE void opt_level(OptLevel level) noexcept
+  {
+    _passes.level(level);
+    _expr_chunks.clear();
+    _prog_chunks.clear();
+  }
+
+  /**
+   * @brief Check if a pass is enabled.
+   *
+   * @param pass Pass.
+   * @return true if the pass runs before inputs are evaluated
+   * @return false if it is skipped
+   */
+  [[nodiscard]] TCALC_INLINE auto pass(Pass pass) const noexcept
+  {
+    return _passes.enabled(pass);
+  }
+
+  /**
+   * @brief Enable or disable a single pass, overriding the level.
+   *
+   * @param pass Pass.
+   * @param enabled Whether the pass runs.
+   */
+  TCALC_INLINE void pass(Pass pass, bool enabled) noexcept
+  {
+    _passes.enable(pass, enabled);
+    _expr_chunks.clear();
+    _prog_chunks.clear();
+  }
+
+  /**
+   * @brief Enable or disable per-pass statistics, see PassManager::stats.
+   * They are disabled by default, cached chunks are not optimized again and
+   * do not count.
+   *
+   * @param collect Whether passes are timed and their trees counted.
+   */
+  TCALC_INLINE void collect_stats(bool collect) noexcept
+  {
+    _passes.collect_stats(collect);
+  }
+
+  /**
+   * @brief Get the pass manager, for its statistics.
+   *
+   * @return const PassManager& Pass manager.
+   */
+  [[nodiscard]] TCALC_INLINE auto& passes() const noexcept { return _passes; }
+
+  /**
+   * @brief Enable memoization of pure user-defined functions, see
+   * EvalContext::memoize.
+   *
+   * @param capacity Entries per function, 0 disables memoization.
+   */
+  TCALC_INLINE void memoize(std::size_t capacity) { _ctx.memoize(capacity); }
+
   /**
    * @brief Evaluate an expression.
    *
@@ -195,6 +1011,57 @@ public:
    * @return error::Result<std::vector<double>> Evaluation result.
    */
   error::Result<std::vector<double>> eval_prog(std::string_view input);
+
+private:
+  /**
+   * @brief Evaluate an expression with the selected engine.
+   *
+   * @param input Expression string.
+   * @return error::Result<double> Evaluation result.
+   */
+  error::Result<double> _eval(std::string_view input);
+
+  /**
+   * @brief Evaluate a program with the selected engine.
+   *
+   * @param input Program string.
+   * @return error::Result<std::vector<double>> Evaluation result.
+   */
+  error::Result<std::vector<double>> _eval_prog(std::string_view input);
+
+  /**
+   * @brief Remove the temporaries of the optimized code from the context.
+   *
+   */
+  void _erase_temps();
+
+  /**
+   * @brief Run the enabled optimization passes over a resolved tree.
+   *
+   * @param node Expression or program node, replaced if it is rewritten.
+   * @return error::Result<void> Result.
+   */
+  error::Result<void> _optimize(ast::NodePtr<>& node);
+
+  /**
+   * @brief Compile an input with the VM engine, reusing cached chunks.
+   *
+   * @param input Input string.
+   * @param prog Compile as a program rather than an expression.
+   * @return error::Result<std::shared_ptr<const bytecode::Chunk>> Chunk.
+   */
+  error::Result<std::shared_ptr<const bytecode::Chunk>> _compile(
+    std::string_view input,
+    bool prog);
+
+  /**
+   * @brief Check if the functions inlined into a chunk are still defined.
+   *
+   * @param chunk Compiled chunk.
+   * @return true if every inlined function is the one called by name
+   * @return false if one was redefined and the chunk must be compiled again
+   */
+  [[nodiscard]] bool _current(const bytecode::Chunk& chunk) const;
 };
 
 }
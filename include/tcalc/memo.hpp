@@ -0,0 +1,158 @@
+/**
+ * @file memo.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Memo tables for pure user-defined functions.
+ * @version 0.2.0
+ * @date 2025-06-27
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "tcalc/common.hpp"
+#include "tcalc/symbol.hpp"
+
+namespace tcalc {
+
+/**
+ * @brief Memoization counters.
+ *
+ */
+struct MemoStats
+{
+  uint64_t hits{ 0 };   /**< Calls answered from a memo table. */
+  uint64_t misses{ 0 }; /**< Calls of pure functions which were evaluated. */
+};
+
+/**
+ * @brief Bounded memo table of a function, direct mapped on the bits of the
+ * arguments, a colliding entry replaces the previous one.
+ *
+ * @note The table remembers the context generation and the body it was
+ * analysed for, and the values of the globals the function reads. Entries are
+ * dropped as soon as one of the globals changes, see sync.
+ */
+class TCALC_PUBLIC MemoTable
+{
+private:
+  uint64_t _generation{ 0 };
+  const void* _owner{ nullptr };
+  bool _pure{ false };
+
+  std::vector<SymbolId> _globals;
+  std::vector<double> _snapshot;
+
+  std::size_t _argc{ 0 };
+  std::vector<double> _keys;
+  std::vector<double> _values;
+  std::vector<uint8_t> _used;
+
+public:
+  MemoTable() = default;
+  ~MemoTable() = default;
+
+  /**
+   * @brief Check if the table was analysed for a function body.
+   *
+   * @param generation Function table generation.
+   * @param owner Function body.
+   * @return true if the table belongs to the body
+   * @return false if it must be reset
+   */
+  [[nodiscard]] TCALC_INLINE bool matches(uint64_t generation,
+                                          const void* owner) const noexcept
+  {
+    return _generation == generation && _owner == owner;
+  }
+
+  /**
+   * @brief Check if the function may be memoized.
+   *
+   * @return true if the function is pure
+   * @return false if it is not
+   */
+  [[nodiscard]] TCALC_INLINE auto pure() const noexcept { return _pure; }
+
+  /**
+   * @brief Reset the table for a function body.
+   *
+   * @param generation Function table generation.
+   * @param owner Function body.
+   * @param pure Whether the function may be memoized.
+   * @param globals Globals the function reads, transitively.
+   * @param argc Argument count of the function.
+   * @param capacity Entry count, a power of two.
+   */
+  void reset(uint64_t generation,
+             const void* owner,
+             bool pure,
+             std::vector<SymbolId> globals,
+             std::size_t argc,
+             std::size_t capacity);
+
+  /**
+   * @brief Compare the globals with the values the entries were computed
+   * with, the entries are dropped if any of them changed.
+   *
+   * @tparam F Callable returning the value of a global.
+   * @param value_of Global value lookup.
+   */
+  template<typename F>
+  void sync(F&& value_of)
+  {
+    auto changed = false;
+    for (std::size_t i = 0; i < _globals.size(); ++i) {
+      auto value = value_of(_globals[i]);
+      if (std::bit_cast<uint64_t>(value) !=
+          std::bit_cast<uint64_t>(_snapshot[i])) {
+        _snapshot[i] = value;
+        changed = true;
+      }
+    }
+
+    if (changed) {
+      clear();
+    }
+  }
+
+  /**
+   * @brief Find the result of a call.
+   *
+   * @param args Call arguments.
+   * @return const double* Result, null if it is not in the table.
+   */
+  [[nodiscard]] const double* find(std::span<const double> args) const noexcept;
+
+  /**
+   * @brief Insert the result of a call.
+   *
+   * @param args Call arguments.
+   * @param value Call result.
+   */
+  void insert(std::span<const double> args, double value) noexcept;
+
+  /**
+   * @brief Drop every entry.
+   *
+   */
+  void clear() noexcept;
+
+private:
+  /**
+   * @brief Get the entry index of a call.
+   *
+   * @param args Call arguments.
+   * @return std::size_t Entry index.
+   */
+  [[nodiscard]] std::size_t _index(std::span<const double> args) const noexcept;
+};
+
+}
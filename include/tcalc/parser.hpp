@@ -11,10 +11,17 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <string_view>
+#include <utility>
+#include <vector>
 
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/flat.hpp"
 #include "tcalc/ast/node.hpp"
+#include "tcalc/ast/tree.hpp"
 #include "tcalc/common.hpp"
 #include "tcalc/error.hpp"
 #include "tcalc/token.hpp"
@@ -31,18 +38,35 @@ class TCALC_PUBLIC ParserContext
 private:
   token::Tokenizer _tokenizer;
   token::Token _current;
+  Arena* _arena;
 
 public:
   /**
    * @brief Create a new parser context.
    *
    * @param input The input string to parse.
+   * @param arena The arena to allocate nodes from.
+   * @return error::Result<ParserContext> The parser context result.
+   */
+  static error::Result<ParserContext> create(std::string_view input,
+                                             Arena& arena);
+
+  /**
+   * @brief Create a new parser context without an arena, used by parsers
+   * which do not allocate nodes.
+   *
+   * @param input The input string to parse.
    * @return error::Result<ParserContext> The parser context result.
    */
   static error::Result<ParserContext> create(std::string_view input);
 
   ~ParserContext() = default;
 
+  ParserContext(const ParserContext&) = delete;
+  ParserContext& operator=(const ParserContext&) = delete;
+  ParserContext(ParserContext&&) noexcept = default;
+  ParserContext& operator=(ParserContext&&) noexcept = default;
+
   /**
    * @brief Get tokenizer.
    *
@@ -60,6 +84,13 @@ public:
    */
   [[nodiscard]] TCALC_INLINE auto& current() const noexcept { return _current; }
 
+  /**
+   * @brief Get the arena nodes are allocated from.
+   *
+   * @return Arena& The arena.
+   */
+  [[nodiscard]] TCALC_INLINE auto& arena() const noexcept { return *_arena; }
+
   /**
    * @brief Eat the current token and get the next one.
    *
@@ -81,31 +112,125 @@ private:
    *
    * @param tokenizer The tokenizer to use.
    * @param current First token.
+   * @param arena The arena to allocate nodes from.
    */
-  ParserContext(token::Tokenizer tokenizer, token::Token current)
-    : _tokenizer{ tokenizer }
+  ParserContext(token::Tokenizer tokenizer, token::Token current, Arena* arena)
+    : _tokenizer{ std::move(tokenizer) }
     , _current{ std::move(current) }
+    , _arena{ arena }
   {
   }
 };
 
+/**
+ * @brief Kind of a construct left open while parsing an expression.
+ *
+ */
+enum class ExprFrameKind : uint8_t
+{
+  BINARY,  /**< Binary operator waiting for its right operand. */
+  UNARY,   /**< Unary operator waiting for its operand. */
+  PAREN,   /**< Parenthesized expression. */
+  CALL,    /**< Function call collecting its arguments. */
+  IF_COND, /**< If expression parsing its condition. */
+  IF_THEN, /**< If expression parsing its then branch. */
+  IF_ELSE, /**< If expression parsing its else branch. */
+};
+
+/**
+ * @brief Construct left open while parsing an expression, expressions are
+ * parsed with explicit stacks so nesting does not consume native stack.
+ *
+ */
+struct ExprFrame
+{
+  ExprFrameKind kind;
+  NodeType type{};    /**< Node type of operators. */
+  uint8_t prio{};     /**< Priority of binary operators. */
+  SymbolId symbol{};  /**< Function symbol of calls. */
+  std::size_t base{}; /**< First operand of the frame. */
+};
+
+/**
+ * @brief Finished subtree waiting on the operand stack.
+ *
+ * @tparam Node Node handle type.
+ */
+template<typename Node>
+struct ExprOperand
+{
+  Node node;
+  std::size_t depth; /**< Nesting of the subtree, left operands of binary
+                        operators do not nest. */
+};
+
 /**
  * @brief AST parser.
  *
  */
 class TCALC_PUBLIC Parser
 {
+public:
+  constexpr static std::size_t MAX_DEPTH =
+    4096; /**< Deepest nesting the recursive passes and engines are tested
+             with. */
+  constexpr static std::size_t DEFAULT_MAX_DEPTH =
+    MAX_DEPTH; /**< Default expression nesting limit. */
+
+private:
+  std::size_t _max_depth{ DEFAULT_MAX_DEPTH };
+  std::vector<ExprFrame> _frames{};
+  std::vector<ExprOperand<NodePtr<>>> _operands{};
+  std::vector<NodePtr<>> _args{};
+  std::vector<NodePtr<>> _statements{};
+
 public:
   Parser() = default;
   ~Parser() = default;
 
   /**
-   * @brief Parse the input string.
+   * @brief Get the expression nesting limit.
+   *
+   * @return std::size_t Maximum nesting of expressions and open frames.
+   */
+  [[nodiscard]] TCALC_INLINE auto max_depth() const noexcept
+  {
+    return _max_depth;
+  }
+
+  /**
+   * @brief Set the expression nesting limit, deeper input is rejected with
+   * `RECURSION_LIMIT`. Chains of binary operators such as `1 + 1 + 1` do not
+   * nest, parentheses, operands of unary operators, call arguments and `if`
+   * do.
+   *
+   * @note The tree is walked recursively by the passes and engines, so the
+   * limit is clamped to MAX_DEPTH.
+   *
+   * @param depth Maximum nesting of expressions and open frames.
+   */
+  TCALC_INLINE void max_depth(std::size_t depth) noexcept
+  {
+    _max_depth = std::min(depth, MAX_DEPTH);
+  }
+
+  /**
+   * @brief Parse the input string into a tree owning its own arena.
    *
    * @param input The input string to parse.
+   * @return error::Result<Tree> The parsed AST.
+   */
+  error::Result<Tree> parse(std::string_view input);
+
+  /**
+   * @brief Parse the input string, allocating nodes from the given arena.
+   *
+   * @param input The input string to parse.
+   * @param arena The arena to allocate nodes from, the caller may reset and
+   * reuse it once the AST is no longer needed.
    * @return error::Result<NodePtr<>> The root node of the AST.
    */
-  error::Result<NodePtr<>> parse(std::string_view input);
+  error::Result<NodePtr<>> parse(std::string_view input, Arena& arena);
 
   /**
    * @brief Get the next program node.
@@ -132,61 +257,180 @@ public:
   error::Result<NodePtr<>> next_expr(ParserContext& ctx);
 
   /**
-   * @brief Get the next term node with the given priority.
+   * @brief Get the next assignment node.
    *
    * @param ctx The parser context.
-   * @param prio The priority of the term.
-   * @return error::Result<NodePtr<>> The term node result.
+   * @return error::Result<NodePtr<>> The assignment node result.
    */
-  error::Result<NodePtr<>> next_prio_term(ParserContext& ctx, std::size_t prio);
+  error::Result<NodePtr<>> next_assign(ParserContext& ctx);
 
   /**
-   * @brief Get the next if node.
+   * @brief Get the next function definition node.
    *
    * @param ctx The parser context.
-   * @return error::Result<NodePtr<>> The if node result.
+   * @return error::Result<NodePtr<>> The function definition node result.
    */
-  error::Result<NodePtr<>> next_if(ParserContext& ctx);
+  error::Result<NodePtr<>> next_fdef(ParserContext& ctx);
 
   /**
-   * @brief Get the next assignment node.
+   * @brief Get the next import node.
    *
    * @param ctx The parser context.
-   * @return error::Result<NodePtr<>> The assignment node result.
+   * @return error::Result<NodePtr<>> The import node result.
    */
-  error::Result<NodePtr<>> next_assign(ParserContext& ctx);
+  error::Result<NodePtr<>> next_import(ParserContext& ctx);
 
+private:
   /**
-   * @brief Get the next factor node.
+   * @brief Open an expression frame.
+   *
+   * @param frame The frame, its base is set from the operand stack.
+   * @return true if the frame is opened
+   * @return false if the frame stack would exceed the depth limit
+   */
+  [[nodiscard]] bool _open(ExprFrame frame);
+
+  /**
+   * @brief Close the top frame, replacing its operands with the node built
+   * from them.
    *
    * @param ctx The parser context.
-   * @return error::Result<NodePtr<>> The factor node result.
+   * @return true if the frame is closed
+   * @return false if the built node would exceed the depth limit
    */
-  error::Result<NodePtr<>> next_factor(ParserContext& ctx);
+  [[nodiscard]] bool _close(ParserContext& ctx);
+};
+
+/**
+ * @brief AST parser emitting a flat tree, the grammar is the same as Parser.
+ *
+ */
+class TCALC_PUBLIC FlatParser
+{
+private:
+  std::size_t _max_depth{ Parser::DEFAULT_MAX_DEPTH };
+  std::vector<ExprFrame> _frames{};
+  std::vector<ExprOperand<FlatIndex>> _operands{};
+  std::vector<FlatIndex> _args{};
+  std::vector<FlatIndex> _statements{};
+
+public:
+  FlatParser() = default;
+  ~FlatParser() = default;
+
+  /**
+   * @brief Get the expression nesting limit.
+   *
+   * @return std::size_t Maximum nesting of expressions and open frames.
+   */
+  [[nodiscard]] TCALC_INLINE auto max_depth() const noexcept
+  {
+    return _max_depth;
+  }
 
   /**
-   * @brief Get the next identifier reference node (function or variable).
+   * @brief Set the expression nesting limit, deeper input is rejected with
+   * `RECURSION_LIMIT`. Flat trees are walked with explicit stacks, so the
+   * limit is not clamped.
+   *
+   * @param depth Maximum nesting of expressions and open frames.
+   */
+  TCALC_INLINE void max_depth(std::size_t depth) noexcept
+  {
+    _max_depth = depth;
+  }
+
+  /**
+   * @brief Parse the input string into a new flat tree.
+   *
+   * @param input The input string to parse.
+   * @return error::Result<FlatTree> The parsed AST.
+   */
+  error::Result<FlatTree> parse(std::string_view input);
+
+  /**
+   * @brief Parse the input string into the given flat tree.
+   *
+   * @param input The input string to parse.
+   * @param tree The tree to emit nodes into, it is cleared first so the
+   * caller may reuse its memory.
+   * @return error::Result<FlatIndex> The root node index.
+   */
+  error::Result<FlatIndex> parse(std::string_view input, FlatTree& tree);
+
+  /**
+   * @brief Get the next program node.
+   *
+   * @param ctx The parser context.
+   * @param tree The tree to emit nodes into.
+   * @return error::Result<FlatIndex> The program node result.
+   */
+  error::Result<FlatIndex> next_program(ParserContext& ctx, FlatTree& tree);
+
+  /**
+   * @brief Get the next statement node.
+   *
+   * @param ctx The parser context.
+   * @param tree The tree to emit nodes into.
+   * @return error::Result<FlatIndex> The statement node result.
+   */
+  error::Result<FlatIndex> next_statement(ParserContext& ctx, FlatTree& tree);
+
+  /**
+   * @brief Get the next expression node.
+   *
+   * @param ctx The parser context.
+   * @param tree The tree to emit nodes into.
+   * @return error::Result<FlatIndex> The expression node result.
+   */
+  error::Result<FlatIndex> next_expr(ParserContext& ctx, FlatTree& tree);
+
+  /**
+   * @brief Get the next assignment node.
    *
    * @param ctx The parser context.
-   * @return error::Result<NodePtr<>> The identifier reference node result.
+   * @param tree The tree to emit nodes into.
+   * @return error::Result<FlatIndex> The assignment node result.
    */
-  error::Result<NodePtr<>> next_idref(ParserContext& ctx);
+  error::Result<FlatIndex> next_assign(ParserContext& ctx, FlatTree& tree);
 
   /**
    * @brief Get the next function definition node.
    *
    * @param ctx The parser context.
-   * @return error::Result<NodePtr<>> The function definition node result.
+   * @param tree The tree to emit nodes into.
+   * @return error::Result<FlatIndex> The function definition node result.
    */
-  error::Result<NodePtr<>> next_fdef(ParserContext& ctx);
+  error::Result<FlatIndex> next_fdef(ParserContext& ctx, FlatTree& tree);
 
   /**
    * @brief Get the next import node.
    *
    * @param ctx The parser context.
-   * @return error::Result<NodePtr<>> The import node result.
+   * @param tree The tree to emit nodes into.
+   * @return error::Result<FlatIndex> The import node result.
    */
-  error::Result<NodePtr<>> next_import(ParserContext& ctx);
+  error::Result<FlatIndex> next_import(ParserContext& ctx, FlatTree& tree);
+
+private:
+  /**
+   * @brief Open an expression frame.
+   *
+   * @param frame The frame, its base is set from the operand stack.
+   * @return true if the frame is opened
+   * @return false if the frame stack would exceed the depth limit
+   */
+  [[nodiscard]] bool _open(ExprFrame frame);
+
+  /**
+   * @brief Close the top frame, replacing its operands with the node built
+   * from them.
+   *
+   * @param tree The tree to emit nodes into.
+   * @return true if the frame is closed
+   * @return false if the built node would exceed the depth limit
+   */
+  [[nodiscard]] bool _close(FlatTree& tree);
 };
 
 }
@@ -0,0 +1,302 @@
+/**
+ * @file pipeline.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Optimization pipeline of the evaluator.
+ * @version 0.2.0
+ * @date 2025-06-27
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/parser.hpp"
+#include "tcalc/visitor/cse.hpp"
+#include "tcalc/visitor/inline.hpp"
+
+namespace tcalc {
+
+class EvalContext;
+
+/**
+ * @brief Optimization pass over resolved trees, in the order they run.
+ *
+ */
+enum class Pass : uint8_t
+{
+  INLINE,   /**< Inlining of small functions, see ast::InlinePass. */
+  FOLD,     /**< Constant folding, see ast::FoldVisitor. */
+  SIMPLIFY, /**< Algebraic simplification, see ast::SimplifyVisitor. */
+  POLY,     /**< Polynomial recognition, see ast::PolyVisitor. */
+  CSE,      /**< Common subexpression elimination, see ast::CsePass. */
+};
+
+constexpr std::size_t PASS_COUNT = 5; /**< Number of passes. */
+
+constexpr std::array<std::string_view, PASS_COUNT> PASS_NAMES = {
+  "inline", "fold", "simplify", "poly", "cse"
+}; /**< Pass names, indexed by Pass. */
+
+/**
+ * @brief Get the name of a pass.
+ *
+ * @param pass Pass.
+ * @return std::string_view Name, as used by the `--<pass>` REPL options.
+ */
+constexpr std::string_view
+pass_name(Pass pass) noexcept
+{
+  return PASS_NAMES[static_cast<std::size_t>(pass)];
+}
+
+/**
+ * @brief Optimization level, selects the enabled passes.
+ *
+ */
+enum class OptLevel : uint8_t
+{
+  O0, /**< No pass, inputs run as written. */
+  O1, /**< Folding and simplification, cheap enough for one-shot inputs. */
+  O2, /**< Every pass, for inputs which run many times. */
+};
+
+/**
+ * @brief Statistics of a pass, summed over its runs.
+ *
+ */
+struct PassStats
+{
+  std::size_t runs{ 0 };
+  std::chrono::nanoseconds time{ 0 };
+  std::size_t nodes_before{ 0 }; /**< Nodes of the trees it was given. */
+  std::size_t nodes_after{ 0 };  /**< Nodes of the trees it returned. */
+};
+
+/**
+ * @brief Pass manager running the enabled passes over a resolved tree.
+ *
+ * @note The level sets every switch at once, single passes can be switched
+ * afterwards. Polynomial recognition only runs with fast math, as it changes
+ * rounding. Statistics are only collected when asked for, counting nodes
+ * walks the tree before and after every pass. Function bodies are not
+ * counted.
+ *
+ * The passes recurse on every operand, trees deeper than MAX_DEPTH such as
+ * long chains of `+` run as written.
+ */
+class TCALC_PUBLIC PassManager
+{
+public:
+  constexpr static std::size_t MAX_DEPTH =
+    ast::Parser::MAX_DEPTH; /**< Deepest tree the passes run on. */
+
+private:
+  OptLevel _level{ OptLevel::O2 };
+  std::array<bool, PASS_COUNT> _enabled{};
+  bool _fast_math{ false };
+  bool _deep{ false }; /**< Whether the last tree was too deep to optimize. */
+  std::size_t _inline_budget{ ast::InlinePass::DEFAULT_BUDGET };
+
+  bool _collect{ false };
+  std::array<PassStats, PASS_COUNT> _stats{};
+  std::chrono::steady_clock::time_point _start{};
+
+  ast::InlinePass _inline{};
+  ast::CsePass _cse{};
+
+public:
+  /**
+   * @brief Construct a new Pass Manager object at OptLevel::O2.
+   *
+   */
+  PassManager();
+
+  ~PassManager() = default;
+
+  /**
+   * @brief Get the optimization level.
+   *
+   * @return OptLevel Level last set, passes may have been switched since.
+   */
+  [[nodiscard]] TCALC_INLINE auto level() const noexcept { return _level; }
+
+  /**
+   * @brief Set the optimization level, enabling exactly its passes.
+   *
+   * @param level Optimization level.
+   */
+  void level(OptLevel level) noexcept;
+
+  /**
+   * @brief Check if a pass is enabled.
+   *
+   * @param pass Pass.
+   * @return true if the pass runs
+   * @return false if it is skipped
+   */
+  [[nodiscard]] TCALC_INLINE bool enabled(Pass pass) const noexcept
+  {
+    return _enabled[static_cast<std::size_t>(pass)];
+  }
+
+  /**
+   * @brief Enable or disable a pass.
+   *
+   * @param pass Pass.
+   * @param enabled Whether the pass runs.
+   */
+  TCALC_INLINE void enable(Pass pass, bool enabled) noexcept
+  {
+    _enabled[static_cast<std::size_t>(pass)] = enabled;
+  }
+
+  /**
+   * @brief Check if fast math is enabled.
+   *
+   * @return true if passes may change rounding
+   * @return false if optimized inputs give bit-identical results
+   */
+  [[nodiscard]] TCALC_INLINE auto fast_math() const noexcept
+  {
+    return _fast_math;
+  }
+
+  /**
+   * @brief Enable or disable fast math.
+   *
+   * @param fast_math Whether passes may change rounding.
+   */
+  TCALC_INLINE void fast_math(bool fast_math) noexcept
+  {
+    _fast_math = fast_math;
+  }
+
+  /**
+   * @brief Get the inlining budget.
+   *
+   * @return std::size_t Largest inlined function body in nodes.
+   */
+  [[nodiscard]] TCALC_INLINE auto inline_budget() const noexcept
+  {
+    return _inline_budget;
+  }
+
+  /**
+   * @brief Set the inlining budget.
+   *
+   * @param budget Largest inlined function body in nodes, 0 inlines nothing.
+   */
+  TCALC_INLINE void inline_budget(std::size_t budget) noexcept
+  {
+    _inline_budget = budget;
+  }
+
+  /**
+   * @brief Check if statistics are collected.
+   *
+   * @return true if passes are timed and their trees counted
+   * @return false if they only run
+   */
+  [[nodiscard]] TCALC_INLINE auto collect_stats() const noexcept
+  {
+    return _collect;
+  }
+
+  /**
+   * @brief Enable or disable statistics.
+   *
+   * @param collect Whether passes are timed and their trees counted.
+   */
+  TCALC_INLINE void collect_stats(bool collect) noexcept
+  {
+    _collect = collect;
+  }
+
+  /**
+   * @brief Get the statistics of a pass.
+   *
+   * @param pass Pass.
+   * @return const PassStats& Statistics since the last reset.
+   */
+  [[nodiscard]] TCALC_INLINE auto& stats(Pass pass) const noexcept
+  {
+    return _stats[static_cast<std::size_t>(pass)];
+  }
+
+  /**
+   * @brief Reset the statistics of every pass.
+   *
+   */
+  TCALC_INLINE void reset_stats() noexcept { _stats = {}; }
+
+  /**
+   * @brief Get the context functions inlined by the last run.
+   *
+   * @return std::span<const builtins::FunctionWrapper* const> Functions, the
+   * code is stale once one of them is no longer defined under its name.
+   */
+  [[nodiscard]] TCALC_INLINE std::span<const builtins::FunctionWrapper* const>
+  inlined() const noexcept
+  {
+    if (_deep || !enabled(Pass::INLINE)) {
+      return {};
+    }
+    return _inline.inlined();
+  }
+
+  /**
+   * @brief Get the temporaries of common subexpression elimination.
+   *
+   * @return std::span<const SymbolId> Globals the optimized code may store
+   * into, they must be removed from the context after each run.
+   */
+  [[nodiscard]] TCALC_INLINE std::span<const SymbolId> temps() const noexcept
+  {
+    return _cse.temps();
+  }
+
+  /**
+   * @brief Run the enabled passes.
+   *
+   * @param node Expression or program node, replaced if it is rewritten.
+   * @param arena Arena owning the tree.
+   * @param ctx Evaluation context.
+   * @return error::Result<void> Result.
+   */
+  error::Result<void> run(ast::NodePtr<>& node,
+                          ast::Arena& arena,
+                          EvalContext& ctx);
+
+private:
+  /**
+   * @brief Start a pass.
+   *
+   * @param pass Pass.
+   * @param node Tree the pass is given.
+   * @return true if the pass is enabled and must run
+   * @return false if it is skipped
+   */
+  bool _begin(Pass pass, ast::NodePtr<> node);
+
+  /**
+   * @brief Finish a pass, recording its statistics.
+   *
+   * @param pass Pass.
+   * @param node Tree the pass returned.
+   */
+  void _end(Pass pass, ast::NodePtr<> node);
+};
+
+}
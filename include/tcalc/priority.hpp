@@ -11,48 +11,80 @@
 
 #pragma once
 
-#include <unordered_map>
-#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 
 #include "tcalc/ast/node.hpp"
+#include "tcalc/common.hpp"
 #include "tcalc/token.hpp"
 
 namespace tcalc::ast {
 
 /**
- * @brief Operator priority table type.
+ * @brief Operator table entry.
  *
  */
-using PriorityTable =
-  std::vector<std::unordered_map<token::TokenType, NodeType>>;
-
-inline const PriorityTable BINOP_PRIORITY = {
-  {
-    { token::TokenType::AND, NodeType::BINARY_AND },
-    { token::TokenType::OR, NodeType::BINARY_OR },
-  },
-  {
-    { token::TokenType::EQUAL, NodeType::BINARY_EQUAL },
-    { token::TokenType::NOTEQUAL, NodeType::BINARY_NOT_EQUAL },
-    { token::TokenType::GREATER, NodeType::BINARY_GREATER },
-    { token::TokenType::GREATEREQUAL, NodeType::BINARY_GREATER_EQUAL },
-    { token::TokenType::LESS, NodeType::BINARY_LESS },
-    { token::TokenType::LESSEQUAL, NodeType::BINARY_LESS_EQUAL },
-  },
-  {
-    { token::TokenType::PLUS, NodeType::BINARY_PLUS },
-    { token::TokenType::MINUS, NodeType::BINARY_MINUS },
-  },
-  {
-    { token::TokenType::MULTIPLY, NodeType::BINARY_MULTIPLY },
-    { token::TokenType::DIVIDE, NodeType::BINARY_DIVIDE },
-  }
-}; /**< Binary operator priority table. */
-
-inline const PriorityTable UNARYOP_PRIORITY = { {
-  { token::TokenType::PLUS, NodeType::UNARY_PLUS },
-  { token::TokenType::MINUS, NodeType::UNARY_MINUS },
-  { token::TokenType::NOT, NodeType::UNARY_NOT },
-} }; /**< Unary operator priority table. */
+struct OperatorInfo
+{
+  bool valid;    /**< Whether the token is an operator. */
+  uint8_t prio;  /**< Priority, higher binds tighter. */
+  NodeType type; /**< Node type built for the operator. */
+};
+
+/**
+ * @brief Operator table type, indexed by token type.
+ *
+ */
+using OperatorTable = std::array<OperatorInfo, token::TOKEN_TYPE_COUNT>;
+
+inline constexpr auto BINOP_PRIORITY = [] {
+  auto table = OperatorTable{};
+  auto set = [&](token::TokenType token, uint8_t prio, NodeType type) {
+    table[static_cast<std::size_t>(token)] = { true, prio, type };
+  };
+
+  set(token::TokenType::AND, 0, NodeType::BINARY_AND);
+  set(token::TokenType::OR, 0, NodeType::BINARY_OR);
+  set(token::TokenType::EQUAL, 1, NodeType::BINARY_EQUAL);
+  set(token::TokenType::NOTEQUAL, 1, NodeType::BINARY_NOT_EQUAL);
+  set(token::TokenType::GREATER, 1, NodeType::BINARY_GREATER);
+  set(token::TokenType::GREATEREQUAL, 1, NodeType::BINARY_GREATER_EQUAL);
+  set(token::TokenType::LESS, 1, NodeType::BINARY_LESS);
+  set(token::TokenType::LESSEQUAL, 1, NodeType::BINARY_LESS_EQUAL);
+  set(token::TokenType::PLUS, 2, NodeType::BINARY_PLUS);
+  set(token::TokenType::MINUS, 2, NodeType::BINARY_MINUS);
+  set(token::TokenType::MULTIPLY, 3, NodeType::BINARY_MULTIPLY);
+  set(token::TokenType::DIVIDE, 3, NodeType::BINARY_DIVIDE);
+
+  return table;
+}(); /**< Binary operator priority table. */
+
+inline constexpr auto UNARYOP_PRIORITY = [] {
+  auto table = OperatorTable{};
+  auto set = [&](token::TokenType token, NodeType type) {
+    table[static_cast<std::size_t>(token)] = { true, 0, type };
+  };
+
+  set(token::TokenType::PLUS, NodeType::UNARY_PLUS);
+  set(token::TokenType::MINUS, NodeType::UNARY_MINUS);
+  set(token::TokenType::NOT, NodeType::UNARY_NOT);
+
+  return table;
+}(); /**< Unary operator table, unary operators bind tighter than any binary
+        operator. */
+
+/**
+ * @brief Look up an operator.
+ *
+ * @param table Operator table.
+ * @param type Token type.
+ * @return const OperatorInfo& Operator entry.
+ */
+TCALC_INLINE constexpr const OperatorInfo&
+find_operator(const OperatorTable& table, token::TokenType type) noexcept
+{
+  return table[static_cast<std::size_t>(type)];
+}
 
 }
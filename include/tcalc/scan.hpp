@@ -0,0 +1,125 @@
+/**
+ * @file scan.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Character classification and scanning kernels for the tokenizer.
+ * @version 0.2.0
+ * @date 2025-06-23
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "tcalc/common.hpp"
+
+namespace tcalc::token {
+
+/**
+ * @brief Character class flags.
+ *
+ */
+enum CharClass : uint8_t
+{
+  CHAR_SPACE = 1 << 0, /**< Skippable whitespace. */
+  CHAR_DIGIT = 1 << 1, /**< Decimal digit. */
+  CHAR_ALPHA = 1 << 2, /**< ASCII letter or underscore. */
+  CHAR_IDENT = CHAR_DIGIT | CHAR_ALPHA, /**< Identifier character. */
+  CHAR_XDIGIT = 1 << 3,                /**< Hexadecimal digit. */
+};
+
+inline constexpr auto CHAR_CLASS = [] {
+  auto table = std::array<uint8_t, 256>{};
+  for (auto c : std::string_view{ " \t\n\v\f\r" }) {
+    table[static_cast<unsigned char>(c)] = CHAR_SPACE;
+  }
+  for (auto c = '0'; c <= '9'; ++c) {
+    table[static_cast<unsigned char>(c)] = CHAR_DIGIT;
+  }
+  for (auto c = 'a'; c <= 'z'; ++c) {
+    table[static_cast<unsigned char>(c)] = CHAR_ALPHA;
+    table[static_cast<unsigned char>(c - 'a' + 'A')] = CHAR_ALPHA;
+  }
+  table['_'] = CHAR_ALPHA;
+  for (auto c : std::string_view{ "0123456789abcdefABCDEF" }) {
+    table[static_cast<unsigned char>(c)] |= CHAR_XDIGIT;
+  }
+  return table;
+}(); /**< Locale independent character classes. */
+
+/**
+ * @brief Check if a character belongs to any of the given classes.
+ *
+ * @param c Character.
+ * @param cls Class flags.
+ * @return true if the character matches
+ * @return false if the character does not match
+ */
+TCALC_INLINE constexpr bool
+is_class(char c, uint8_t cls) noexcept
+{
+  return (CHAR_CLASS[static_cast<unsigned char>(c)] & cls) != 0;
+}
+
+/**
+ * @brief Instruction set used by the scanning kernels.
+ *
+ */
+enum class ScanLevel : uint8_t
+{
+  SCALAR, /**< One byte per step. */
+  SSE2,   /**< 16 bytes per step. */
+  AVX2,   /**< 32 bytes per step. */
+};
+
+inline const std::unordered_map<ScanLevel, std::string> SCAN_LEVEL_NAMES = {
+  { ScanLevel::SCALAR, "SCALAR" },
+  { ScanLevel::SSE2, "SSE2" },
+  { ScanLevel::AVX2, "AVX2" },
+}; /**< Scan level names. */
+
+/**
+ * @brief Scanning kernels, each one returns the first position in
+ * `[begin, end)` which is not of its class, or `end`.
+ *
+ */
+struct ScanKernels
+{
+  const char* (*skip_space)(const char* begin, const char* end);
+  const char* (*skip_digit)(const char* begin, const char* end);
+  const char* (*skip_ident)(const char* begin, const char* end);
+};
+
+/**
+ * @brief Get the best scan level supported by the running CPU, detected once.
+ *
+ * @return ScanLevel Scan level.
+ */
+TCALC_PUBLIC ScanLevel
+scan_level() noexcept;
+
+/**
+ * @brief Get the kernels of a scan level, levels unavailable in this build or
+ * on the running CPU fall back to the best available one.
+ *
+ * @param level Scan level.
+ * @return const ScanKernels& Scanning kernels.
+ */
+TCALC_PUBLIC const ScanKernels&
+scan_kernels(ScanLevel level) noexcept;
+
+/**
+ * @brief Get the kernels of the best scan level.
+ *
+ * @return const ScanKernels& Scanning kernels.
+ */
+TCALC_PUBLIC const ScanKernels&
+scan_kernels() noexcept;
+
+}
@@ -0,0 +1,118 @@
+/**
+ * @file symbol.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Process wide symbol table.
+ * @version 0.2.0
+ * @date 2025-06-25
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "tcalc/common.hpp"
+
+namespace tcalc {
+
+/**
+ * @brief Small integer id of an interned name.
+ *
+ */
+using SymbolId = uint32_t;
+
+constexpr SymbolId NO_SYMBOL = 0; /**< Id reserved for unresolved names. */
+
+constexpr SymbolId TEMP_COUNT = 64; /**< Ids reserved for temporaries. */
+
+/**
+ * @brief Get the symbol of a temporary.
+ *
+ * @param index Temporary index, below TEMP_COUNT.
+ * @return SymbolId Symbol id, no name is interned to it.
+ */
+constexpr SymbolId
+temp_symbol(std::size_t index) noexcept
+{
+  return static_cast<SymbolId>(index + 1);
+}
+
+/**
+ * @brief Symbol table mapping every distinct name to a stable id, shared by
+ * all contexts so that resolved code can move between them.
+ *
+ * @note Interning is thread safe, ids and names are never released, so the
+ * table grows with every distinct name the process ever sees, once per name
+ * however often it is used. Passes never intern names of their own. Contexts
+ * store globals and functions in slots indexed by id, a name must be set in a
+ * context before its slot exists there.
+ *
+ * Ids 1 to TEMP_COUNT belong to temporaries of the optimization passes, see
+ * temp_symbol. They have names for messages, but interning that name, even
+ * from a quoted identifier, gives another id, so user code cannot read or
+ * assign a temporary.
+ */
+class TCALC_PUBLIC SymbolTable
+{
+private:
+  mutable std::mutex _mutex;
+  std::deque<std::string> _names;
+  std::unordered_map<std::string_view, SymbolId> _ids;
+
+public:
+  SymbolTable();
+  ~SymbolTable() = default;
+
+  SymbolTable(const SymbolTable&) = delete;
+  SymbolTable& operator=(const SymbolTable&) = delete;
+
+  /**
+   * @brief Get the id of a name, adding it if needed.
+   *
+   * @param name Name.
+   * @return SymbolId Symbol id.
+   */
+  SymbolId intern(std::string_view name);
+
+  /**
+   * @brief Get the id of a name without adding it.
+   *
+   * @param name Name.
+   * @return SymbolId Symbol id, `NO_SYMBOL` if the name was never interned.
+   */
+  [[nodiscard]] SymbolId find(std::string_view name) const;
+
+  /**
+   * @brief Get the name of a symbol.
+   *
+   * @param id Symbol id.
+   * @return std::string_view Name, valid for the lifetime of the process.
+   */
+  [[nodiscard]] std::string_view name(SymbolId id) const;
+
+  /**
+   * @brief Get the number of ids handed out, the reserved ones included.
+   *
+   * @return std::size_t Symbol count, lets long running hosts watch the
+   * table grow.
+   */
+  [[nodiscard]] std::size_t size() const;
+};
+
+/**
+ * @brief Get the process wide symbol table.
+ *
+ * @return SymbolTable& Symbol table.
+ */
+TCALC_PUBLIC SymbolTable&
+symbols() noexcept;
+
+}
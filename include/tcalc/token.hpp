@@ -11,10 +11,14 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
+#include "tcalc/symbol.hpp"
+
 namespace tcalc::token {
 
 /**
@@ -52,14 +56,23 @@ enum class TokenType : uint8_t
   EOI,          /**< End of input. */
 };
 
+inline constexpr std::size_t TOKEN_TYPE_COUNT =
+  static_cast<std::size_t>(TokenType::EOI) + 1; /**< Number of token types. */
+
 /**
  * @brief Token structure.
  *
+ * @note `text` refers to the input string, or to the escape buffer of the
+ * tokenizer for quoted identifiers with escapes, it is only valid while both
+ * are alive. `value` is the converted literal of NUMBER tokens and `symbol`
+ * the interned name of IDENTIFIER tokens.
  */
 struct Token
 {
   TokenType type;
-  std::string text;
+  std::string_view text;
+  double value{ 0.0 };
+  SymbolId symbol{ NO_SYMBOL };
 };
 
 inline const std::unordered_map<TokenType, std::string> TOKEN_TYPE_NAMES = {
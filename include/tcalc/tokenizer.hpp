@@ -11,17 +11,98 @@
 
 #pragma once
 
-#include <functional>
-#include <map>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <forward_list>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #include "tcalc/common.hpp"
 #include "tcalc/error.hpp"
+#include "tcalc/scan.hpp"
 #include "tcalc/token.hpp"
 
 namespace tcalc::token {
 
+/**
+ * @brief Lexeme class selected by the first byte of a token.
+ *
+ */
+enum class Lead : uint8_t
+{
+  INVALID,    /**< Not the start of any token. */
+  SPACE,      /**< Skippable whitespace. */
+  OPERATOR,   /**< Operator or punctuation. */
+  DIGIT,      /**< Number literal. */
+  IDENTIFIER, /**< Identifier or keyword. */
+  QUOTE,      /**< Quoted identifier. */
+};
+
+/**
+ * @brief Operator rule of a first byte, the two byte operator is preferred
+ * (maximal munch).
+ *
+ */
+struct OperatorRule
+{
+  bool has_single;  /**< Whether the byte alone is an operator. */
+  TokenType single; /**< Operator of the byte alone. */
+  char second;      /**< Second byte of the two byte operator, 0 if none. */
+  TokenType pair;   /**< Operator of both bytes. */
+};
+
+inline constexpr auto LEAD_TABLE = [] {
+  auto table = std::array<Lead, 256>{};
+  for (std::size_t c = 0; c < table.size(); ++c) {
+    if ((CHAR_CLASS[c] & CHAR_SPACE) != 0) {
+      table[c] = Lead::SPACE;
+    } else if ((CHAR_CLASS[c] & CHAR_DIGIT) != 0) {
+      table[c] = Lead::DIGIT;
+    } else if ((CHAR_CLASS[c] & CHAR_ALPHA) != 0) {
+      table[c] = Lead::IDENTIFIER;
+    }
+  }
+  for (auto c : std::string_view{ "+-*/(),;=><!&|" }) {
+    table[static_cast<unsigned char>(c)] = Lead::OPERATOR;
+  }
+  table['\''] = Lead::QUOTE;
+  return table;
+}(); /**< Lexeme class of every first byte. */
+
+inline constexpr auto OPERATOR_TABLE = [] {
+  auto table = std::array<OperatorRule, 256>{};
+  auto single = [&](char c, TokenType type) {
+    table[static_cast<unsigned char>(c)].has_single = true;
+    table[static_cast<unsigned char>(c)].single = type;
+  };
+  auto pair = [&](char c, char second, TokenType type) {
+    table[static_cast<unsigned char>(c)].second = second;
+    table[static_cast<unsigned char>(c)].pair = type;
+  };
+
+  single('+', TokenType::PLUS);
+  single('-', TokenType::MINUS);
+  single('*', TokenType::MULTIPLY);
+  single('/', TokenType::DIVIDE);
+  single('(', TokenType::LPAREN);
+  single(')', TokenType::RPAREN);
+  single(',', TokenType::COMMA);
+  single(';', TokenType::SEMICOLON);
+  single('=', TokenType::ASSIGN);
+  single('>', TokenType::GREATER);
+  single('<', TokenType::LESS);
+  single('!', TokenType::NOT);
+  pair('=', '=', TokenType::EQUAL);
+  pair('!', '=', TokenType::NOTEQUAL);
+  pair('>', '=', TokenType::GREATEREQUAL);
+  pair('<', '=', TokenType::LESSEQUAL);
+  pair('&', '&', TokenType::AND);
+  pair('|', '|', TokenType::OR);
+  return table;
+}(); /**< Operator rule of every first byte. */
+
 /**
  * @brief Tokenize the input string into tokens.
  *
@@ -29,30 +110,23 @@ namespace tcalc::token {
 class TCALC_PUBLIC Tokenizer
 {
 public:
-  using KeywordComp =
-    std::greater<std::string_view>; /**< Comparator for keywords. */
-
-  inline static const std::map<std::string_view, TokenType, KeywordComp>
-    KEYWORDS = {
-      { "def", TokenType::DEF },         { "let", TokenType::LET },
-      { "if", TokenType::IF },           { "then", TokenType::THEN },
-      { "else", TokenType::ELSE },       { "import", TokenType::IMPORT },
-      { "==", TokenType::EQUAL },        { "!=", TokenType::NOTEQUAL },
-      { ">=", TokenType::GREATEREQUAL }, { "<=", TokenType::LESSEQUAL },
-      { "&&", TokenType::AND },          { "||", TokenType::OR },
-      { "+", TokenType::PLUS },          { "-", TokenType::MINUS },
-      { "*", TokenType::MULTIPLY },      { "/", TokenType::DIVIDE },
-      { "(", TokenType::LPAREN },        { ")", TokenType::RPAREN },
-      { ",", TokenType::COMMA },         { ";", TokenType::SEMICOLON },
-      { "=", TokenType::ASSIGN },        { ">", TokenType::GREATER },
-      { "<", TokenType::LESS },          { "!", TokenType::NOT },
-    }; /**< Tcalc keywords, must be ordered by length. */
+  constexpr static std::array<std::pair<std::string_view, TokenType>, 6>
+    KEYWORDS = { {
+      { "def", TokenType::DEF },
+      { "let", TokenType::LET },
+      { "if", TokenType::IF },
+      { "then", TokenType::THEN },
+      { "else", TokenType::ELSE },
+      { "import", TokenType::IMPORT },
+    } }; /**< Tcalc keywords, matched against whole identifiers. */
 
   constexpr static char QUOTE = '\''; /**< The quote character. */
 
 private:
   std::string_view _input;
   std::string_view::const_iterator _pos;
+  std::forward_list<std::string> _escapes;
+  const ScanKernels* _scan;
 
 public:
   /**
@@ -61,11 +135,30 @@ public:
    * @param input The input string.
    */
   explicit Tokenizer(std::string_view input)
+    : Tokenizer{ input, scan_kernels() }
+  {
+  }
+
+  /**
+   * @brief Construct a new Tokenizer object with specific scanning kernels.
+   *
+   * @param input The input string.
+   * @param scan The scanning kernels.
+   */
+  Tokenizer(std::string_view input, const ScanKernels& scan)
     : _input{ input }
     , _pos{ _input.begin() }
+    , _scan{ &scan }
   {
   }
 
+  ~Tokenizer() = default;
+
+  Tokenizer(const Tokenizer&) = delete;
+  Tokenizer& operator=(const Tokenizer&) = delete;
+  Tokenizer(Tokenizer&&) noexcept = default;
+  Tokenizer& operator=(Tokenizer&&) noexcept = default;
+
   /**
    * @brief Get the next token.
    *
@@ -92,83 +185,47 @@ public:
 
 private:
   /**
-   * @brief Get the next token with the given type and predicate.
+   * @brief Parse the next operator.
    *
-   * @param type The type of the token.
-   * @param pred The predicate to check if the current character is valid.
-   * @return Token The token.
+   * @return error::Result<Token> The parsed token.
    */
-  template<typename Pred>
-  auto _next_with(TokenType type, const Pred& pred)
-  {
-    const auto* start = _pos;
-    while (_pos != _input.end() && pred(*_pos)) {
-      ++_pos;
-    }
-    return Token{ type, std::string{ start, _pos } };
-  }
+  error::Result<Token> _parse_operator();
 
   /**
-   * @brief Skip the characters with the given predicate.
+   * @brief Parse the next identifier or keyword.
    *
-   * @param pred The predicate to check if the current character is valid.
+   * @return Token The parsed token.
    */
-  template<typename Pred>
-  void _skip_with(const Pred& pred)
-  {
-    while (_pos != _input.end() && pred(*_pos)) {
-      ++_pos;
-    }
-  }
+  Token _parse_identifier();
 
   /**
-   * @brief Parse the next number.
-   *
-   */
-  error::Result<Token> _parse_number();
-
-  /**
-   * @brief Parse the next quoted identifier.
+   * @brief Parse the next decimal or hex-float number, the value is converted
+   * in place.
    *
    * @return error::Result<Token> The parsed token.
    */
-  error::Result<Token> _parse_quoted_identifier();
-
-  /**
-   * @brief Check if the string is a keyword.
-   *
-   * @param keyword The keyword to check.
-   * @return true If the string is a keyword.
-   * @return false If the string is not a keyword.
-   */
-  bool _is_keyword(std::string_view keyword);
+  error::Result<Token> _parse_number();
 
   /**
-   * @brief Check if the character is a valid variable character.
+   * @brief Skip a run of digits.
    *
-   * @param c The character to check.
-   * @return true If the character is a valid variable character.
-   * @return false If the character is not a valid variable character.
+   * @param cls Digit class, `CHAR_DIGIT` or `CHAR_XDIGIT`.
    */
-  static bool _is_identifier_char(char c);
+  void _skip_digits(uint8_t cls) noexcept;
 
   /**
-   * @brief Check if the character is a valid first variable character.
+   * @brief Build the error for the character at the current position.
    *
-   * @param c The character to check.
-   * @return true If the character is a valid first variable character.
-   * @return false If the character is not a valid first variable character.
+   * @return error::Result<Token> Syntax error.
    */
-  static bool _is_first_identifier_char(char c);
+  [[nodiscard]] error::Result<Token> _unexpected_char() const;
 
   /**
-   * @brief Check if the character is a valid skippable character.
+   * @brief Parse the next quoted identifier.
    *
-   * @param c The character to check.
-   * @return true If the character is a valid skippable character.
-   * @return false If the character is not a valid skippable character.
+   * @return error::Result<Token> The parsed token.
    */
-  static bool _is_skippable_char(char c);
+  error::Result<Token> _parse_quoted_identifier();
 };
 
 }
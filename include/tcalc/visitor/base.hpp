@@ -11,21 +11,21 @@
 
 #pragma once
 
-#include <memory>
-
 #include "tcalc/ast/binaryop.hpp"
 #include "tcalc/ast/control_flow.hpp"
 #include "tcalc/ast/function.hpp"
 #include "tcalc/ast/node.hpp"
 #include "tcalc/ast/number.hpp"
+#include "tcalc/ast/poly.hpp"
 #include "tcalc/ast/program.hpp"
 #include "tcalc/ast/unaryop.hpp"
 #include "tcalc/ast/variable.hpp"
 #include "tcalc/error.hpp"
 
-#define __check_node_type(node, type, entry)                                   \
-  if (auto node_type = std::dynamic_pointer_cast<type>(node)) {                \
-    return entry(node_type);                                                   \
+#define __visit_node_as(node, type, entry)                                     \
+  {                                                                            \
+    auto node_type = static_cast<type*>(node);                                 \
+    return static_cast<Derived*>(this)->entry(node_type);                      \
   }
 
 #define VISIT_DEFAULT(node)                                                    \
@@ -37,15 +37,86 @@
 namespace tcalc::ast {
 
 /**
- * @brief Base visitor class with default return type.
+ * @brief Statically dispatched visitor base (CRTP), handlers of `Derived` are
+ * called directly and can be inlined.
  *
+ * @tparam Derived Derived visitor class.
  * @tparam RT Return type of the visitor.
  */
-template<typename RT>
-class BaseVisitor
+template<typename Derived, typename RT>
+class StaticVisitor
 {
 public:
-  virtual ~BaseVisitor() = default;
+  /**
+   * @brief Visit a node, dispatching on its node type.
+   *
+   * @param node Node to visit.
+   * @return error::Result<RT> Result of the visit.
+   */
+  error::Result<RT> visit(NodePtr<>& node)
+  {
+    if (node == nullptr) {
+      return error::ok<RT>();
+    }
+
+    switch (node->type()) {
+      case NodeType::BINARY_PLUS:
+      case NodeType::BINARY_MINUS:
+      case NodeType::BINARY_MULTIPLY:
+      case NodeType::BINARY_DIVIDE:
+      case NodeType::BINARY_EQUAL:
+      case NodeType::BINARY_NOT_EQUAL:
+      case NodeType::BINARY_GREATER:
+      case NodeType::BINARY_GREATER_EQUAL:
+      case NodeType::BINARY_LESS:
+      case NodeType::BINARY_LESS_EQUAL:
+      case NodeType::BINARY_AND:
+      case NodeType::BINARY_OR:
+        __visit_node_as(node, BinaryOpNode, visit_bin_op);
+      case NodeType::UNARY_PLUS:
+      case NodeType::UNARY_MINUS:
+      case NodeType::UNARY_NOT:
+        __visit_node_as(node, UnaryOpNode, visit_unary_op);
+      case NodeType::NUMBER:
+        __visit_node_as(node, NumberNode, visit_number);
+      case NodeType::VARREF:
+        __visit_node_as(node, VarRefNode, visit_varref);
+      case NodeType::VARASSIGN:
+        __visit_node_as(node, VarAssignNode, visit_varassign);
+      case NodeType::FCALL:
+        __visit_node_as(node, FcallNode, visit_fcall);
+      case NodeType::FDEF:
+        __visit_node_as(node, FdefNode, visit_fdef);
+      case NodeType::IF:
+        __visit_node_as(node, IfNode, visit_if);
+      case NodeType::PROGRAM:
+        __visit_node_as(node, ProgramNode, visit_program);
+      case NodeType::IMPORT:
+        __visit_node_as(node, ProgramImportNode, visit_import);
+      case NodeType::POLY:
+        __visit_node_as(node, PolyNode, visit_poly);
+    }
+
+    return error::ok<RT>();
+  }
+
+  /**
+   * @brief Visit a binary operation node.
+   *
+   * @param node Binary operation node.
+   * @return error::Result<RT> Result of the visit.
+   */
+  error::Result<RT> visit_bin_op(NodePtr<BinaryOpNode>& node)
+    VISIT_DEFAULT(node);
+
+  /**
+   * @brief Visit a unary operation node.
+   *
+   * @param node Unary operation node.
+   * @return error::Result<RT> Result of the visit.
+   */
+  error::Result<RT> visit_unary_op(NodePtr<UnaryOpNode>& node)
+    VISIT_DEFAULT(node);
 
   /**
    * @brief Visit a number node.
@@ -53,20 +124,97 @@ public:
    * @param node Number node.
    * @return error::Result<RT> Result of the visit.
    */
+  error::Result<RT> visit_number(NodePtr<NumberNode>& node) VISIT_DEFAULT(node);
+
+  /**
+   * @brief Visit a variable reference node.
+   *
+   * @param node Variable reference node.
+   * @return error::Result<RT> Result of the visit.
+   */
+  error::Result<RT> visit_varref(NodePtr<VarRefNode>& node) VISIT_DEFAULT(node);
+
+  /**
+   * @brief Visit a variable assignment node.
+   *
+   * @param node Variable assignment node.
+   * @return error::Result<RT> Result of the visit.
+   */
+  error::Result<RT> visit_varassign(NodePtr<VarAssignNode>& node)
+    VISIT_DEFAULT(node);
+
+  /**
+   * @brief Visit a function call node.
+   *
+   * @param node Function call node.
+   * @return error::Result<RT> Result of the visit.
+   */
+  error::Result<RT> visit_fcall(NodePtr<FcallNode>& node) VISIT_DEFAULT(node);
+
+  /**
+   * @brief Visit a function definition node.
+   *
+   * @param node Function definition node.
+   * @return error::Result<RT> Result of the visit.
+   */
+  error::Result<RT> visit_fdef(NodePtr<FdefNode>& node) VISIT_DEFAULT(node);
+
+  /**
+   * @brief Visit an if node.
+   *
+   * @param node If node.
+   * @return error::Result<RT> Result of the visit.
+   */
+  error::Result<RT> visit_if(NodePtr<IfNode>& node) VISIT_DEFAULT(node);
+
+  /**
+   * @brief Visit a program node.
+   *
+   * @param node Program node.
+   * @return error::Result<RT> Result of the visit.
+   */
+  error::Result<RT> visit_program(NodePtr<ProgramNode>& node)
+    VISIT_DEFAULT(node);
+
+  /**
+   * @brief Visit a program import node.
+   *
+   * @param node Program import node.
+   * @return error::Result<RT> Result of the visit.
+   */
+  error::Result<RT> visit_import(NodePtr<ProgramImportNode>& node)
+    VISIT_DEFAULT(node);
+
+  /**
+   * @brief Visit a polynomial node.
+   *
+   * @param node Polynomial node.
+   * @return error::Result<RT> Result of the visit.
+   */
+  error::Result<RT> visit_poly(NodePtr<PolyNode>& node) VISIT_DEFAULT(node);
+};
+
+/**
+ * @brief Base visitor class with default return type, handlers are virtual so
+ * visitors can be used polymorphically.
+ *
+ * @tparam RT Return type of the visitor.
+ */
+template<typename RT>
+class BaseVisitor : public StaticVisitor<BaseVisitor<RT>, RT>
+{
+public:
+  virtual ~BaseVisitor() = default;
+
+  /**
+   * @brief Visit a node, dispatching on its node type.
+   *
+   * @param node Node to visit.
+   * @return error::Result<RT> Result of the visit.
+   */
   virtual error::Result<RT> visit(NodePtr<>& node)
   {
-    __check_node_type(node, BinaryOpNode, visit_bin_op);
-    __check_node_type(node, UnaryOpNode, visit_unary_op);
-    __check_node_type(node, NumberNode, visit_number);
-    __check_node_type(node, VarRefNode, visit_varref);
-    __check_node_type(node, VarAssignNode, visit_varassign);
-    __check_node_type(node, FcallNode, visit_fcall);
-    __check_node_type(node, FdefNode, visit_fdef);
-    __check_node_type(node, IfNode, visit_if);
-    __check_node_type(node, ProgramNode, visit_program);
-    __check_node_type(node, ProgramImportNode, visit_import);
-
-    return error::ok<RT>();
+    return StaticVisitor<BaseVisitor<RT>, RT>::visit(node);
   }
 
   /**
@@ -157,6 +305,15 @@ public:
    */
   virtual error::Result<RT> visit_import(NodePtr<ProgramImportNode>& node)
     VISIT_DEFAULT(node);
+
+  /**
+   * @brief Visit a polynomial node.
+   *
+   * @param node Polynomial node.
+   * @return error::Result<RT> Result of the visit.
+   */
+  virtual error::Result<RT> visit_poly(NodePtr<PolyNode>& node)
+    VISIT_DEFAULT(node);
 };
 
 }
@@ -0,0 +1,254 @@
+/**
+ * @file children.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Child iteration for passes over the AST.
+ * @version 0.2.0
+ * @date 2025-06-27
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "tcalc/ast/binaryop.hpp"
+#include "tcalc/ast/control_flow.hpp"
+#include "tcalc/ast/function.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/ast/poly.hpp"
+#include "tcalc/ast/program.hpp"
+#include "tcalc/ast/unaryop.hpp"
+#include "tcalc/ast/variable.hpp"
+#include "tcalc/common.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Call a function on each child of a node in evaluation order, with
+ * whether the child may be skipped at runtime.
+ *
+ * @note Right operands of `&&` and `||` and the branches of an `if` may be
+ * skipped. Function bodies are never entered, definitions and imports have
+ * no children.
+ *
+ * @tparam F Callable taking `(NodePtr<>&, bool)`.
+ * @param node Parent node.
+ * @param cond Whether the parent may be skipped.
+ * @param fn Callback.
+ */
+template<typename F>
+void
+for_children(NodePtr<> node, bool cond, F&& fn)
+{
+  switch (node->type()) {
+    case NodeType::BINARY_AND:
+    case NodeType::BINARY_OR: {
+      auto* bin = static_cast<NodePtr<BinaryOpNode>>(node);
+      fn(bin->left(), cond);
+      fn(bin->right(), true);
+      break;
+    }
+    case NodeType::BINARY_PLUS:
+    case NodeType::BINARY_MINUS:
+    case NodeType::BINARY_MULTIPLY:
+    case NodeType::BINARY_DIVIDE:
+    case NodeType::BINARY_EQUAL:
+    case NodeType::BINARY_NOT_EQUAL:
+    case NodeType::BINARY_GREATER:
+    case NodeType::BINARY_GREATER_EQUAL:
+    case NodeType::BINARY_LESS:
+    case NodeType::BINARY_LESS_EQUAL: {
+      auto* bin = static_cast<NodePtr<BinaryOpNode>>(node);
+      fn(bin->left(), cond);
+      fn(bin->right(), cond);
+      break;
+    }
+    case NodeType::UNARY_PLUS:
+    case NodeType::UNARY_MINUS:
+    case NodeType::UNARY_NOT:
+      fn(static_cast<NodePtr<UnaryOpNode>>(node)->operand(), cond);
+      break;
+    case NodeType::VARASSIGN:
+      fn(static_cast<NodePtr<VarAssignNode>>(node)->body(), cond);
+      break;
+    case NodeType::FCALL:
+      for (auto& arg : static_cast<NodePtr<FcallNode>>(node)->args()) {
+        fn(arg, cond);
+      }
+      break;
+    case NodeType::POLY: {
+      // Horner's scheme starts from the highest coefficient
+      auto* poly = static_cast<NodePtr<PolyNode>>(node);
+      fn(poly->var(), cond);
+      auto coeffs = poly->coeffs();
+      for (auto coeff = coeffs.rbegin(); coeff != coeffs.rend(); ++coeff) {
+        fn(*coeff, cond);
+      }
+      break;
+    }
+    case NodeType::IF: {
+      auto* branch = static_cast<NodePtr<IfNode>>(node);
+      fn(branch->cond(), cond);
+      fn(branch->then(), true);
+      fn(branch->else_(), true);
+      break;
+    }
+    case NodeType::PROGRAM:
+      for (auto& stmt : static_cast<NodePtr<ProgramNode>>(node)->statements()) {
+        fn(stmt, cond);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Left spine of a chain of binary operators such as `a + b - c`,
+ * innermost operator first.
+ *
+ * @note Chains of left-associative operators grow on their left operand, so
+ * visitors walk the spine in a loop instead of recursing once per operator.
+ * Short spines are kept inline and do not allocate.
+ */
+class Spine
+{
+public:
+  constexpr static std::size_t INLINE_SIZE = 8; /**< Operators kept inline. */
+
+private:
+  std::array<NodePtr<BinaryOpNode>, INLINE_SIZE> _inline{};
+  std::vector<NodePtr<BinaryOpNode>> _heap{};
+  std::size_t _size{ 0 };
+
+public:
+  /**
+   * @brief Collect the spine below an operator.
+   *
+   * @param top Outermost operator of the chain.
+   */
+  explicit Spine(NodePtr<BinaryOpNode> top)
+  {
+    for (NodePtr<> node = top; binary(node);
+         node = static_cast<NodePtr<BinaryOpNode>>(node)->left()) {
+      ++_size;
+    }
+
+    if (_size > INLINE_SIZE) {
+      _heap.resize(_size);
+    }
+
+    auto* ops = _size > INLINE_SIZE ? _heap.data() : _inline.data();
+    ops[_size - 1] = top;
+    for (auto i = _size - 1; i-- > 0;) {
+      ops[i] = static_cast<NodePtr<BinaryOpNode>>(ops[i + 1]->left());
+    }
+  }
+
+  ~Spine() = default;
+
+  Spine(const Spine&) = delete;
+  Spine& operator=(const Spine&) = delete;
+  Spine(Spine&&) = delete;
+  Spine& operator=(Spine&&) = delete;
+
+  /**
+   * @brief Get the number of operators.
+   *
+   * @return std::size_t Number of operators.
+   */
+  [[nodiscard]] TCALC_INLINE auto size() const noexcept { return _size; }
+
+  /**
+   * @brief Get an operator.
+   *
+   * @param index Position from the innermost operator.
+   * @return NodePtr<BinaryOpNode> Operator.
+   */
+  [[nodiscard]] TCALC_INLINE auto operator[](std::size_t index) const noexcept
+  {
+    return _size > INLINE_SIZE ? _heap[index] : _inline[index];
+  }
+
+  /**
+   * @brief Get the left operand of the innermost operator.
+   *
+   * @return NodePtr<>& Operand, it is not a binary operator.
+   */
+  [[nodiscard]] TCALC_INLINE auto& leaf() const noexcept
+  {
+    return (*this)[0]->left();
+  }
+
+  /**
+   * @brief Check if a node is a binary operator.
+   *
+   * @param node Node.
+   * @return true if the node is a BinaryOpNode
+   * @return false otherwise
+   */
+  [[nodiscard]] TCALC_INLINE static bool binary(NodePtr<> node) noexcept
+  {
+    return node->type() <= NodeType::BINARY_OR;
+  }
+};
+
+/**
+ * @brief Count the nodes of a subtree, function bodies are not entered.
+ *
+ * @note Counting stops once there are more than `limit` nodes, so the walk
+ * recurses at most `limit` times.
+ *
+ * @param node Subtree root.
+ * @param limit Largest count of interest.
+ * @return std::size_t Number of nodes, above `limit` if counting stopped.
+ */
+inline std::size_t
+tree_size(NodePtr<> node,
+          std::size_t limit = std::numeric_limits<std::size_t>::max())
+{
+  auto size = std::size_t{ 1 };
+  for_children(node, false, [&size, limit](NodePtr<>& child, bool /*cond*/) {
+    if (size <= limit) {
+      size += tree_size(child, limit - size);
+    }
+  });
+
+  return size;
+}
+
+/**
+ * @brief Check if a tree is deeper than a limit, function bodies included.
+ *
+ * @note The walk stops at the limit, so it recurses at most `depth` times.
+ *
+ * @param node Tree root.
+ * @param depth Largest accepted depth in nodes.
+ * @return true if a path from the root has more than `depth` nodes
+ * @return false otherwise
+ */
+inline bool
+deeper_than(NodePtr<> node, std::size_t depth)
+{
+  if (depth == 0) {
+    return true;
+  }
+
+  if (node->type() == NodeType::FDEF) {
+    return deeper_than(static_cast<NodePtr<FdefNode>>(node)->body(), depth - 1);
+  }
+
+  auto deeper = false;
+  for_children(node, false, [&deeper, depth](NodePtr<>& child, bool) {
+    deeper = deeper || deeper_than(child, depth - 1);
+  });
+
+  return deeper;
+}
+
+}
@@ -0,0 +1,58 @@
+/**
+ * @file clone.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Visitor for copying AST between arenas.
+ * @version 0.2.0
+ * @date 2025-06-21
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/visitor/base.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Visitor for deep copying an AST into another arena, used when a node
+ * must outlive the arena it was parsed into.
+ *
+ */
+class TCALC_PUBLIC CloneVisitor : public StaticVisitor<CloneVisitor, NodePtr<>>
+{
+private:
+  Arena* _arena;
+
+public:
+  /**
+   * @brief Construct a new Clone Visitor object.
+   *
+   * @param arena Target arena.
+   */
+  explicit CloneVisitor(Arena& arena)
+    : _arena{ &arena }
+  {
+  }
+
+  ~CloneVisitor() = default;
+
+  error::Result<NodePtr<>> visit_bin_op(NodePtr<BinaryOpNode>& node);
+  error::Result<NodePtr<>> visit_unary_op(NodePtr<UnaryOpNode>& node);
+  error::Result<NodePtr<>> visit_number(NodePtr<NumberNode>& node);
+  error::Result<NodePtr<>> visit_varref(NodePtr<VarRefNode>& node);
+  error::Result<NodePtr<>> visit_varassign(NodePtr<VarAssignNode>& node);
+  error::Result<NodePtr<>> visit_fcall(NodePtr<FcallNode>& node);
+  error::Result<NodePtr<>> visit_fdef(NodePtr<FdefNode>& node);
+  error::Result<NodePtr<>> visit_if(NodePtr<IfNode>& node);
+  error::Result<NodePtr<>> visit_program(NodePtr<ProgramNode>& node);
+  error::Result<NodePtr<>> visit_import(NodePtr<ProgramImportNode>& node);
+  error::Result<NodePtr<>> visit_poly(NodePtr<PolyNode>& node);
+};
+
+}
@@ -0,0 +1,136 @@
+/**
+ * @file compile.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Visitor for compiling AST into bytecode.
+ * @version 0.2.0
+ * @date 2025-06-20
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <span>
+#include <string_view>
+#include <unordered_map>
+
+#include "tcalc/ast/node.hpp"
+#include "tcalc/bytecode.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/symbol.hpp"
+#include "tcalc/visitor/base.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Visitor for compiling an expression AST, the result is left on the
+ * top of the VM stack.
+ *
+ * @note `&&` and `||` jump over their right operand when the left one
+ * decides the result. Calls in tail position of a function body, the body
+ * itself or a branch of an `if` in tail position, compile to `TAIL_CALL`.
+ */
+class TCALC_PUBLIC CompileVisitor : public StaticVisitor<CompileVisitor, void>
+{
+public:
+  inline static const std::unordered_map<NodeType, bytecode::OpCode> BINOP_MAP =
+    {
+      { NodeType::BINARY_PLUS, bytecode::OpCode::ADD },
+      { NodeType::BINARY_MINUS, bytecode::OpCode::SUB },
+      { NodeType::BINARY_MULTIPLY, bytecode::OpCode::MUL },
+      { NodeType::BINARY_DIVIDE, bytecode::OpCode::DIV },
+      { NodeType::BINARY_EQUAL, bytecode::OpCode::EQ },
+      { NodeType::BINARY_NOT_EQUAL, bytecode::OpCode::NE },
+      { NodeType::BINARY_GREATER, bytecode::OpCode::GT },
+      { NodeType::BINARY_GREATER_EQUAL, bytecode::OpCode::GE },
+      { NodeType::BINARY_LESS, bytecode::OpCode::LT },
+      { NodeType::BINARY_LESS_EQUAL, bytecode::OpCode::LE },
+    }; /**< Map of binary operator to operation code, logical operators
+          compile to jumps. */
+
+  inline static const std::unordered_map<NodeType, bytecode::OpCode>
+    UNARYOP_MAP = {
+      { NodeType::UNARY_PLUS, bytecode::OpCode::POS },
+      { NodeType::UNARY_MINUS, bytecode::OpCode::NEG },
+      { NodeType::UNARY_NOT, bytecode::OpCode::NOT },
+    }; /**< Map of unary operator to operation code. */
+
+private:
+  bytecode::Chunk* _chunk;
+  std::span<const SymbolId> _params;
+  bool _tail{ false }; /**< Next node is in tail position of a function. */
+
+public:
+  /**
+   * @brief Construct a new Compile Visitor object.
+   *
+   * @param chunk Target chunk.
+   * @param params Parameters of the enclosing function, if any.
+   */
+  CompileVisitor(bytecode::Chunk& chunk,
+                 std::span<const SymbolId> params = {})
+    : _chunk{ &chunk }
+    , _params{ params }
+  {
+  }
+
+  ~CompileVisitor() = default;
+
+  /**
+   * @brief Compile an expression node into a standalone chunk.
+   *
+   * @param node Expression node.
+   * @return error::Result<bytecode::Chunk> Compiled chunk.
+   */
+  static error::Result<bytecode::Chunk> compile(NodePtr<>& node);
+
+  error::Result<void> visit_bin_op(NodePtr<BinaryOpNode>& node);
+  error::Result<void> visit_unary_op(NodePtr<UnaryOpNode>& node);
+  error::Result<void> visit_number(NodePtr<NumberNode>& node);
+  error::Result<void> visit_varref(NodePtr<VarRefNode>& node);
+  error::Result<void> visit_varassign(NodePtr<VarAssignNode>& node);
+  error::Result<void> visit_fcall(NodePtr<FcallNode>& node);
+  error::Result<void> visit_fdef(NodePtr<FdefNode>& node);
+  error::Result<void> visit_if(NodePtr<IfNode>& node);
+  error::Result<void> visit_import(NodePtr<ProgramImportNode>& node);
+  error::Result<void> visit_poly(NodePtr<PolyNode>& node);
+  error::Result<void> visit_program(NodePtr<ProgramNode>& node);
+};
+
+/**
+ * @brief Visitor for compiling a Program AST, every statement yields its
+ * result.
+ *
+ */
+class TCALC_PUBLIC ProgramCompileVisitor
+  : public StaticVisitor<ProgramCompileVisitor, void>
+{
+private:
+  bytecode::Chunk* _chunk;
+
+public:
+  /**
+   * @brief Construct a new Program Compile Visitor object.
+   *
+   * @param chunk Target chunk.
+   */
+  ProgramCompileVisitor(bytecode::Chunk& chunk)
+    : _chunk{ &chunk }
+  {
+  }
+
+  ~ProgramCompileVisitor() = default;
+
+  /**
+   * @brief Compile a program node into a standalone chunk.
+   *
+   * @param node Program node.
+   * @return error::Result<bytecode::Chunk> Compiled chunk.
+   */
+  static error::Result<bytecode::Chunk> compile(NodePtr<>& node);
+
+  error::Result<void> visit_program(NodePtr<ProgramNode>& node);
+};
+
+}
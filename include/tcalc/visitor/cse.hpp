@@ -0,0 +1,221 @@
+/**
+ * @file cse.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Common subexpression elimination.
+ * @version 0.2.0
+ * @date 2025-06-27
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/symbol.hpp"
+
+namespace tcalc {
+
+class EvalContext;
+
+}
+
+namespace tcalc::ast {
+
+/**
+ * @brief Pass computing repeated pure subexpressions of a resolved AST once,
+ * within an expression and across the statements of a program.
+ *
+ * @note Subtrees are hashed structurally, a subexpression is pure if it only
+ * reads globals and calls pure host functions. The first occurrence which
+ * always runs stores its value into a temporary global, see temp_symbol, and
+ * the occurrences after it load the temporary. Past TEMP_COUNT temporaries
+ * in one run, further subexpressions are computed again. A `let` retires the
+ * subexpressions reading the variable it assigns. Functions defined by the
+ * program, everything after an import and function bodies, which may be
+ * entered recursively, are left alone.
+ *
+ * Temporaries only live for one run, the evaluator removes them from the
+ * context once the code finished, see temps.
+ *
+ * The pass keeps its buffers between runs, so a warm pass does not allocate.
+ */
+class TCALC_PUBLIC CsePass
+{
+private:
+  constexpr static uint32_t NO_ENTRY = UINT32_MAX;
+
+  /**
+   * @brief Analysis of a node, stored in pre-order.
+   *
+   */
+  struct Info
+  {
+    NodePtr<> node;
+    uint64_t hash;
+    uint32_t size;  /**< Nodes in the subtree. */
+    uint32_t entry; /**< Subexpression class, NO_ENTRY if not a candidate. */
+    bool pure;
+    bool first; /**< First occurrence of its class, children were scanned. */
+  };
+
+  /**
+   * @brief Class of structurally equal subexpressions.
+   *
+   */
+  struct Entry
+  {
+    std::size_t index; /**< Pre-order index of the first occurrence. */
+    uint64_t hash;
+    uint32_t uses{ 0 }; /**< Occurrences after the anchor. */
+    SymbolId temp{ NO_SYMBOL };
+    bool anchored{ false }; /**< An occurrence which always runs was seen. */
+    bool live{ true };      /**< No `let` changed what it reads. */
+  };
+
+  const EvalContext* _ctx{ nullptr };
+  Arena* _arena{ nullptr };
+  bool _late{ false };
+  std::size_t _removed{ 0 };
+  std::size_t _temp_count{ 0 };
+
+  std::vector<Info> _info;
+  std::vector<Entry> _entries;
+  std::vector<uint32_t> _table;
+  std::vector<SymbolId> _defined;
+  std::vector<SymbolId> _temps;
+
+public:
+  CsePass() = default;
+  ~CsePass() = default;
+
+  /**
+   * @brief Eliminate common subexpressions.
+   *
+   * @param node Expression or program node, replaced if it is rewritten.
+   * @param arena Arena owning the tree.
+   * @param ctx Evaluation context to check function purity against.
+   * @return std::size_t Number of nodes removed.
+   */
+  std::size_t run(NodePtr<>& node, Arena& arena, const EvalContext& ctx);
+
+  /**
+   * @brief Get the number of nodes removed by the last run.
+   *
+   * @return std::size_t Nodes which no longer run, net of the temporaries.
+   */
+  [[nodiscard]] TCALC_INLINE auto removed() const noexcept { return _removed; }
+
+  /**
+   * @brief Get every temporary the pass has handed out.
+   *
+   * @return std::span<const SymbolId> Temporaries, code compiled by any
+   * earlier run stores into a subset of them.
+   */
+  [[nodiscard]] TCALC_INLINE std::span<const SymbolId> temps() const noexcept
+  {
+    return _temps;
+  }
+
+private:
+  /**
+   * @brief Hash a subtree and check its purity, filling the analysis in
+   * pre-order.
+   *
+   * @param node Subtree root.
+   */
+  void _analyse(NodePtr<>& node);
+
+  /**
+   * @brief Assign subexpressions to classes and count their occurrences.
+   *
+   * @param node Subtree root.
+   * @param index Pre-order index of the root.
+   * @param cond Whether the subtree may be skipped at runtime.
+   */
+  void _count(NodePtr<>& node, std::size_t index, bool cond);
+
+  /**
+   * @brief Store the anchors into temporaries and load them at later
+   * occurrences.
+   *
+   * @param node Subtree root, replaced if it is rewritten.
+   * @param index Pre-order index of the root.
+   * @param cond Whether the subtree may be skipped at runtime.
+   */
+  void _rewrite(NodePtr<>& node, std::size_t index, bool cond);
+
+  /**
+   * @brief Call a function on each child with its pre-order index and
+   * whether it may be skipped.
+   *
+   * @tparam F Callable taking `(NodePtr<>&, std::size_t, bool)`.
+   * @param node Parent node.
+   * @param index Pre-order index of the parent.
+   * @param cond Whether the parent may be skipped.
+   * @param fn Callback.
+   */
+  template<typename F>
+  void _each_child(NodePtr<> node, std::size_t index, bool cond, F&& fn);
+
+  /**
+   * @brief Find the live class of a subexpression or create it.
+   *
+   * @param index Pre-order index of the subexpression.
+   * @return uint32_t Class index.
+   */
+  uint32_t _classify(std::size_t index);
+
+  /**
+   * @brief Retire the classes reading a global.
+   *
+   * @param id Symbol id of the global.
+   */
+  void _kill(SymbolId id);
+
+  /**
+   * @brief Get a temporary global.
+   *
+   * @return SymbolId Symbol id of the next unused temporary, NO_SYMBOL once
+   * all of them are in use.
+   */
+  SymbolId _temp();
+
+  /**
+   * @brief Store the value of an occurrence into a new temporary of its
+   * class.
+   *
+   * @param node Occurrence, wrapped in the store.
+   * @param entry Class of the occurrence.
+   */
+  void _store(NodePtr<>& node, Entry& entry);
+
+  /**
+   * @brief Check if two analysed subtrees are structurally equal.
+   *
+   * @param lhs Pre-order index of the left subtree.
+   * @param rhs Pre-order index of the right subtree.
+   * @return true if they compute the same value
+   * @return false if they may not
+   */
+  [[nodiscard]] bool _equal(std::size_t lhs, std::size_t rhs) const;
+
+  /**
+   * @brief Check if an analysed subtree reads a global.
+   *
+   * @param index Pre-order index of the subtree.
+   * @param id Symbol id of the global.
+   * @return true if the global is read
+   * @return false if it is not
+   */
+  [[nodiscard]] bool _reads(std::size_t index, SymbolId id) const;
+};
+
+}
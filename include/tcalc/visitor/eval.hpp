@@ -11,6 +11,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <functional>
 #include <unordered_map>
 #include <vector>
@@ -28,7 +29,7 @@ namespace tcalc::ast {
  * @brief Visitor for evaluating AST.
  *
  */
-class TCALC_PUBLIC EvalVisitor : public BaseVisitor<double>
+class TCALC_PUBLIC EvalVisitor : public StaticVisitor<EvalVisitor, double>
 {
 private:
   /**
@@ -117,25 +118,59 @@ public:
   {
   }
 
-  ~EvalVisitor() override = default;
-
-  error::Result<double> visit_bin_op(NodePtr<BinaryOpNode>& node) override;
-  error::Result<double> visit_unary_op(NodePtr<UnaryOpNode>& node) override;
-  error::Result<double> visit_number(NodePtr<NumberNode>& node) override;
-  error::Result<double> visit_varref(NodePtr<VarRefNode>& node) override;
-  error::Result<double> visit_varassign(NodePtr<VarAssignNode>& node) override;
-  error::Result<double> visit_fcall(NodePtr<FcallNode>& node) override;
-  error::Result<double> visit_fdef(NodePtr<FdefNode>& node) override;
-  error::Result<double> visit_if(NodePtr<IfNode>& node) override;
-  error::Result<double> visit_import(NodePtr<ProgramImportNode>& node) override;
-  error::Result<double> visit_program(NodePtr<ProgramNode>& node) override;
+  ~EvalVisitor() = default;
+
+  error::Result<double> visit_bin_op(NodePtr<BinaryOpNode>& node);
+  error::Result<double> visit_unary_op(NodePtr<UnaryOpNode>& node);
+  error::Result<double> visit_number(NodePtr<NumberNode>& node);
+  error::Result<double> visit_varref(NodePtr<VarRefNode>& node);
+  error::Result<double> visit_varassign(NodePtr<VarAssignNode>& node);
+  error::Result<double> visit_fcall(NodePtr<FcallNode>& node);
+  error::Result<double> visit_fdef(NodePtr<FdefNode>& node);
+  error::Result<double> visit_if(NodePtr<IfNode>& node);
+  error::Result<double> visit_import(NodePtr<ProgramImportNode>& node);
+  error::Result<double> visit_poly(NodePtr<PolyNode>& node);
+  error::Result<double> visit_program(NodePtr<ProgramNode>& node);
+
+  /**
+   * @brief Evaluate the body of a user-defined function whose frame is
+   * already pushed.
+   *
+   * @param func Function wrapper.
+   * @return error::Result<double> Result of the visit.
+   *
+   * @note Calls to user-defined functions in tail position, the body itself
+   * or a branch of an `if` in tail position, replace the frame and loop
+   * instead of nesting, so tail recursion runs in constant stack space.
+   */
+  error::Result<double> visit_body(const builtins::FunctionWrapper& func);
+
+  /**
+   * @brief Get how deep visiting a subtree nests on the native stack.
+   *
+   * @param node Subtree root.
+   * @return std::size_t Nested visits, chains of left-associative operators
+   * count once.
+   */
+  static std::size_t nesting(NodePtr<> node);
+
+private:
+  /**
+   * @brief Evaluate the arguments of a call onto the context's call stack.
+   *
+   * @param node Function call node.
+   * @return error::Result<std::size_t> Base of the arguments, nothing is left
+   * on the call stack on failure.
+   */
+  error::Result<std::size_t> _push_args(NodePtr<FcallNode>& node);
 };
 
 /**
  * @brief Visitor for evaluating Program AST.
  *
  */
-class TCALC_PUBLIC ProgramEvalVisitor : public BaseVisitor<std::vector<double>>
+class TCALC_PUBLIC ProgramEvalVisitor
+  : public StaticVisitor<ProgramEvalVisitor, std::vector<double>>
 {
 private:
   EvalContext* _ctx;
@@ -151,10 +186,10 @@ public:
   {
   }
 
-  ~ProgramEvalVisitor() override = default;
+  ~ProgramEvalVisitor() = default;
 
   error::Result<std::vector<double>> visit_program(
-    NodePtr<ProgramNode>& node) override;
+    NodePtr<ProgramNode>& node);
 };
 
 }
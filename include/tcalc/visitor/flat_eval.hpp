@@ -0,0 +1,158 @@
+/**
+ * @file flat_eval.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Visitor for evaluating flat AST.
+ * @version 0.2.0
+ * @date 2025-06-22
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "tcalc/ast/flat.hpp"
+#include "tcalc/builtins.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/eval.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Visitor for evaluating flat AST, the semantics are the same as
+ * EvalVisitor.
+ *
+ * @note Nodes are evaluated with explicit stacks, deeply nested input does
+ * not consume native stack. Calls to user defined functions still nest, they
+ * are bounded by the call depth limit, except for calls in tail position of
+ * a function body which replace the frame, see visit_body.
+ */
+class TCALC_PUBLIC FlatEvalVisitor
+{
+private:
+  /**
+   * @brief Pending node evaluation.
+   *
+   */
+  struct Task
+  {
+    FlatIndex index;
+    uint32_t stage;
+  };
+
+  const FlatTree* _tree;
+  EvalContext* _ctx;
+
+  std::vector<Task> _tasks;
+  std::vector<double> _values;
+  std::vector<std::reference_wrapper<const builtins::Function>> _funcs;
+
+public:
+  /**
+   * @brief Construct a new Flat Eval Visitor object.
+   *
+   * @param tree Flat tree.
+   * @param ctx Evaluation context.
+   */
+  FlatEvalVisitor(const FlatTree& tree, EvalContext& ctx)
+    : _tree{ &tree }
+    , _ctx{ &ctx }
+  {
+  }
+
+  ~FlatEvalVisitor() = default;
+
+  /**
+   * @brief Visit a node.
+   *
+   * @param index Node index.
+   * @return error::Result<double> Result of the visit.
+   */
+  error::Result<double> visit(FlatIndex index);
+
+  /**
+   * @brief Evaluate the body of a user-defined function whose frame is
+   * already pushed.
+   *
+   * @param func Function wrapper.
+   * @return error::Result<double> Result of the visit.
+   *
+   * @note Calls to user-defined functions in tail position replace the frame
+   * and loop instead of nesting, the stacks of the visitor are reused for
+   * every iteration.
+   */
+  error::Result<double> visit_body(const builtins::FlatFunctionWrapper& func);
+
+private:
+  /**
+   * @brief Apply a binary operator, logical operators are evaluated lazily
+   * by the visitor instead.
+   *
+   * @param type Binary operator node type.
+   * @param lval Left hand side.
+   * @param rval Right hand side.
+   * @return double Operation result.
+   */
+  static double _bin_op(NodeType type, double lval, double rval);
+
+  /**
+   * @brief Evaluate equality between two double.
+   *
+   * @param a Left hand side.
+   * @param b Right hand side.
+   * @return true if equal
+   * @return false if not equal
+   */
+  static bool _double_eq(double a, double b);
+
+  /**
+   * @brief Evaluate inequality between two double.
+   *
+   * @param a Left hand side.
+   * @param b Right hand side.
+   * @return true if not equal
+   * @return false if equal
+   */
+  static bool _double_noeq(double a, double b);
+};
+
+/**
+ * @brief Visitor for evaluating flat Program AST.
+ *
+ */
+class TCALC_PUBLIC FlatProgramEvalVisitor
+{
+private:
+  const FlatTree* _tree;
+  EvalContext* _ctx;
+
+public:
+  /**
+   * @brief Construct a new Flat Program Eval Visitor object.
+   *
+   * @param tree Flat tree.
+   * @param ctx Evaluation context.
+   */
+  FlatProgramEvalVisitor(const FlatTree& tree, EvalContext& ctx)
+    : _tree{ &tree }
+    , _ctx{ &ctx }
+  {
+  }
+
+  ~FlatProgramEvalVisitor() = default;
+
+  /**
+   * @brief Visit a program node, evaluating every statement.
+   *
+   * @param index Node index.
+   * @return error::Result<std::vector<double>> Result of every statement.
+   */
+  error::Result<std::vector<double>> visit(FlatIndex index);
+};
+
+}
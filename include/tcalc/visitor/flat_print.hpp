@@ -0,0 +1,92 @@
+/**
+ * @file flat_print.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Visitor for printing flat AST.
+ * @version 0.2.0
+ * @date 2025-06-22
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <ostream>
+#include <string>
+
+#include "tcalc/ast/flat.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/error.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Visitor for printing flat AST, the output is the same as
+ * PrintVisitor.
+ *
+ */
+class TCALC_PUBLIC FlatPrintVisitor
+{
+public:
+  constexpr static std::size_t INDENT_STEP = 2; /**< Default indent step. */
+
+private:
+  const FlatTree* _tree;
+  std::ostream* _os;
+  std::size_t _indent{ 0 };
+  std::size_t _step;
+
+public:
+  /**
+   * @brief Construct a new Flat Print Visitor object.
+   *
+   * @param tree Flat tree.
+   * @param os Output stream.
+   * @param step Indent step.
+   */
+  FlatPrintVisitor(const FlatTree& tree,
+                   std::ostream& os = std::cout,
+                   std::size_t step = INDENT_STEP)
+    : _tree{ &tree }
+    , _os{ &os }
+    , _step{ step }
+  {
+  }
+
+  ~FlatPrintVisitor() = default;
+
+  /**
+   * @brief Visit a node.
+   *
+   * @param index Node index.
+   * @return error::Result<void> Result of the visit.
+   */
+  error::Result<void> visit(FlatIndex index);
+
+private:
+  /**
+   * @brief Generate indent string.
+   *
+   * @return std::string Indent string.
+   */
+  [[nodiscard]] TCALC_INLINE auto _gen_indent() const
+  {
+    return std::string(_indent, ' ');
+  }
+
+  /**
+   * @brief Step indent.
+   *
+   */
+  TCALC_INLINE void _step_indent() { _indent += _step; }
+
+  /**
+   * @brief Unstep indent.
+   *
+   */
+  TCALC_INLINE void _unstep_indent() { _indent -= _step; }
+};
+
+}
@@ -0,0 +1,124 @@
+/**
+ * @file fold.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Visitors for folding constant subtrees.
+ * @version 0.2.0
+ * @date 2025-06-27
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/flat.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/eval.hpp"
+#include "tcalc/symbol.hpp"
+#include "tcalc/visitor/base.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Visitor for folding constant subtrees of a resolved AST, returns the
+ * node replacing the visited one.
+ *
+ * @note Operators over numbers, constants of the context and calls of pure
+ * host functions with constant arguments are replaced by numbers, an `if`
+ * with a constant condition by its live branch. Names a statement may change
+ * before they are reached are left alone: constants assigned and functions
+ * defined by the program, and every name after an import. Function bodies
+ * outlive the input and bind late, only their operators and `if`s are folded.
+ */
+class TCALC_PUBLIC FoldVisitor : public StaticVisitor<FoldVisitor, NodePtr<>>
+{
+private:
+  Arena* _arena;
+  EvalContext* _ctx;
+  std::vector<SymbolId> _assigned;
+  std::vector<SymbolId> _defined;
+  bool _late{ false };
+
+public:
+  /**
+   * @brief Construct a new Fold Visitor object.
+   *
+   * @param arena Arena to allocate folded numbers in.
+   * @param ctx Evaluation context to fold names with, null to only fold
+   * operators and `if`s.
+   */
+  FoldVisitor(Arena& arena, EvalContext* ctx)
+    : _arena{ &arena }
+    , _ctx{ ctx }
+    , _late{ ctx == nullptr }
+  {
+  }
+
+  ~FoldVisitor() = default;
+
+  error::Result<NodePtr<>> visit_bin_op(NodePtr<BinaryOpNode>& node);
+  error::Result<NodePtr<>> visit_unary_op(NodePtr<UnaryOpNode>& node);
+  error::Result<NodePtr<>> visit_number(NodePtr<NumberNode>& node);
+  error::Result<NodePtr<>> visit_varref(NodePtr<VarRefNode>& node);
+  error::Result<NodePtr<>> visit_varassign(NodePtr<VarAssignNode>& node);
+  error::Result<NodePtr<>> visit_fcall(NodePtr<FcallNode>& node);
+  error::Result<NodePtr<>> visit_fdef(NodePtr<FdefNode>& node);
+  error::Result<NodePtr<>> visit_if(NodePtr<IfNode>& node);
+  error::Result<NodePtr<>> visit_import(NodePtr<ProgramImportNode>& node);
+  error::Result<NodePtr<>> visit_poly(NodePtr<PolyNode>& node);
+  error::Result<NodePtr<>> visit_program(NodePtr<ProgramNode>& node);
+
+private:
+  /**
+   * @brief Allocate a folded number.
+   *
+   * @param value Number value.
+   * @return NodePtr<> Number node.
+   */
+  NodePtr<> _number(double value);
+};
+
+/**
+ * @brief Folder for flat trees, rewrites records in place with the same rules
+ * as FoldVisitor.
+ *
+ * @note The tree is scanned linearly, children are folded before their
+ * parent. Folded records keep their index, the children they no longer refer
+ * to stay in the tree unreachable.
+ */
+class TCALC_PUBLIC FlatFoldVisitor
+{
+private:
+  FlatTree* _tree;
+  EvalContext* _ctx;
+
+public:
+  /**
+   * @brief Construct a new Flat Fold Visitor object.
+   *
+   * @param tree Resolved flat tree.
+   * @param ctx Evaluation context to fold names with, null to only fold
+   * operators and `if`s.
+   */
+  FlatFoldVisitor(FlatTree& tree, EvalContext* ctx)
+    : _tree{ &tree }
+    , _ctx{ ctx }
+  {
+  }
+
+  ~FlatFoldVisitor() = default;
+
+  /**
+   * @brief Fold a subtree.
+   *
+   * @param index Subtree root, it keeps its index.
+   */
+  void visit(FlatIndex index);
+};
+
+}
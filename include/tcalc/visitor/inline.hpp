@@ -0,0 +1,171 @@
+/**
+ * @file inline.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Inlining of user-defined functions.
+ * @version 0.2.0
+ * @date 2025-06-27
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/symbol.hpp"
+
+namespace tcalc {
+
+class EvalContext;
+
+}
+
+namespace tcalc::builtins {
+
+class FunctionWrapper;
+
+}
+
+namespace tcalc::ast {
+
+/**
+ * @brief Pass replacing calls of small user-defined functions of a resolved
+ * AST with a copy of their body.
+ *
+ * @note A call is inlined if it reaches a function defined earlier in the
+ * program or in the context, its body has at most `budget` nodes and the
+ * function never calls itself, directly or through other functions. The
+ * parameters are replaced by the arguments, so the arguments must not change
+ * meaning when they move into the body: numbers and names are copied freely,
+ * any other argument must be pure and used at most once. Unless every
+ * argument is a number, the body must be pure as well once the calls inside
+ * it are inlined. Everything after an import is left alone, the functions
+ * called there are only known at runtime.
+ *
+ * Calls inside function bodies are never inlined, not even calls of small
+ * helpers from other functions. A body is stored when its definition runs
+ * and called long after, when its callees may have been redefined, and a
+ * stored copy of an old callee would never be noticed as stale. Only the
+ * code of the run itself is rewritten, calls made from bodies keep their
+ * per-call overhead.
+ *
+ * Code inlining a context function is stale once the function is redefined,
+ * see inlined. The pass keeps its buffers between runs, so a warm pass does
+ * not allocate.
+ */
+class TCALC_PUBLIC InlinePass
+{
+public:
+  constexpr static std::size_t DEFAULT_BUDGET = 16; /**< Default body size. */
+  constexpr static std::size_t MAX_DEPTH = 8; /**< Deepest nested inlining. */
+
+private:
+  const EvalContext* _ctx{ nullptr };
+  Arena* _arena{ nullptr };
+  std::size_t _budget{ 0 };
+  bool _late{ false };
+  std::size_t _count{ 0 };
+
+  std::vector<NodePtr<FdefNode>> _defined; /**< Definitions seen so far. */
+  std::vector<SymbolId> _active;           /**< Functions being inlined. */
+  std::vector<const builtins::FunctionWrapper*> _inlined;
+  std::vector<NodePtr<>> _pending;
+  std::vector<SymbolId> _seen;
+  std::vector<uint32_t> _uses;
+  std::vector<NodePtr<>> _stack;
+
+public:
+  InlinePass() = default;
+  ~InlinePass() = default;
+
+  /**
+   * @brief Inline calls of small user-defined functions.
+   *
+   * @param node Expression or program node, replaced if it is rewritten.
+   * @param arena Arena owning the tree.
+   * @param ctx Evaluation context to find functions in.
+   * @param budget Largest inlined body in nodes, 0 inlines nothing.
+   * @return std::size_t Number of calls inlined.
+   */
+  std::size_t run(NodePtr<>& node,
+                  Arena& arena,
+                  const EvalContext& ctx,
+                  std::size_t budget);
+
+  /**
+   * @brief Get the context functions inlined by the last run.
+   *
+   * @return const std::vector<const builtins::FunctionWrapper*>& Functions,
+   * the code is stale once one of them is no longer defined under its name.
+   */
+  [[nodiscard]] TCALC_INLINE auto& inlined() const noexcept
+  {
+    return _inlined;
+  }
+
+private:
+  /**
+   * @brief Inline the calls of a subtree.
+   *
+   * @param node Subtree root, replaced if it is inlined.
+   */
+  void _visit(NodePtr<>& node);
+
+  /**
+   * @brief Inline a call whose arguments are inlined.
+   *
+   * @param call Function call node.
+   * @return NodePtr<> Copy of the body, null if the call is kept.
+   */
+  NodePtr<> _inline(NodePtr<FcallNode> call);
+
+  /**
+   * @brief Find the definition a call reaches.
+   *
+   * @param id Function symbol.
+   * @param argc Argument count of the call.
+   * @param wrapper Receives the context function, null if the definition is
+   * part of the program.
+   * @return NodePtr<FdefNode> Definition, null if the function is not
+   * user-defined or takes another argument count.
+   */
+  NodePtr<FdefNode> _lookup(SymbolId id,
+                            std::size_t argc,
+                            const builtins::FunctionWrapper*& wrapper) const;
+
+  /**
+   * @brief Check if a function may call itself.
+   *
+   * @param def Function definition.
+   * @return true if a call of the function is reachable from its body
+   * @return false if every call chain from the body ends
+   */
+  bool _recursive(NodePtr<FdefNode> def);
+
+  /**
+   * @brief Check if a subtree only computes a value.
+   *
+   * @param node Subtree root.
+   * @return true if it assigns nothing and only calls pure host functions
+   * @return false if it may have effects
+   */
+  [[nodiscard]] bool _pure(NodePtr<> node) const;
+
+  /**
+   * @brief Copy a function body with its parameters replaced.
+   *
+   * @param node Body subtree.
+   * @param args Call arguments.
+   * @return NodePtr<> Copy.
+   */
+  NodePtr<> _substitute(NodePtr<> node, std::span<NodePtr<>> args);
+};
+
+}
@@ -0,0 +1,267 @@
+/**
+ * @file poly.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Visitor for recognizing polynomials.
+ * @version 0.2.0
+ * @date 2025-06-27
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/ast/variable.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/symbol.hpp"
+#include "tcalc/visitor/base.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Visitor for replacing polynomial subtrees of a resolved AST with
+ * PolyNode, returns the node replacing the visited one.
+ *
+ * @note A subtree of sums, differences, products and negations is a
+ * polynomial in a variable if the other operands do not read it, the
+ * variable of highest degree is picked. The other operands are numbers,
+ * names and operators over them, so evaluating them once per coefficient
+ * instead of once per term changes nothing but rounding. Coefficients are
+ * searched again, so a polynomial in several variables becomes nested
+ * polynomials. A subtree is only replaced if Horner's scheme needs fewer
+ * operations than the subtree, `x * x` stays as it is, and if expanding it,
+ * together with the polynomials in its coefficients, makes at most
+ * MAX_GROWTH times as many nodes as the subtree has. Products of two
+ * polynomials with several terms each are only distributed if their
+ * coefficients are numbers, `(x + a) * (x + b)` is kept. Once a chain of
+ * these operators is kept, the chains below it are not tried again, only
+ * the operands of other nodes are, so a long chain is not scanned once per
+ * operator.
+ *
+ * Collecting terms and evaluating with `fma` round differently from the
+ * written expression, the evaluator only runs this pass with fast math.
+ */
+class TCALC_PUBLIC PolyVisitor : public StaticVisitor<PolyVisitor, NodePtr<>>
+{
+public:
+  constexpr static int MAX_DEGREE = 16; /**< Largest recognized degree. */
+  constexpr static std::size_t MAX_GROWTH = 4; /**< Largest size factor. */
+
+private:
+  /**
+   * @brief Coefficients of a subtree, a range of the coefficient stack.
+   *
+   */
+  struct Coeffs
+  {
+    std::size_t offset;
+    std::size_t count; /**< 0 if the expansion was given up. */
+  };
+
+  /**
+   * @brief Degree of a subtree in one variable.
+   *
+   */
+  struct Degree
+  {
+    int degree;              /**< -1 if the subtree is not polynomial. */
+    std::size_t order;       /**< Position of the first reference. */
+    NodePtr<VarRefNode> var; /**< First reference. */
+  };
+
+  /**
+   * @brief Variable, its symbol and binding.
+   *
+   */
+  struct VarKey
+  {
+    SymbolId symbol;
+    BindingKind kind;
+    uint32_t index;
+
+    bool operator==(const VarKey&) const = default;
+  };
+
+  /**
+   * @brief Hash of a variable.
+   *
+   */
+  struct VarHash
+  {
+    std::size_t operator()(const VarKey& key) const noexcept
+    {
+      return (static_cast<std::size_t>(key.symbol) << 32U) ^
+             (static_cast<std::size_t>(key.kind) << 24U) ^ key.index;
+    }
+  };
+
+  using Degrees = std::unordered_map<VarKey, Degree, VarHash>;
+
+  Arena* _arena;
+  std::vector<NodePtr<>> _stack; /**< Coefficients, null for zero. */
+  std::size_t _ops{ 0 };         /**< Operators of the scanned subtree. */
+  std::size_t _refs{ 0 };        /**< References seen by the scan. */
+  bool _opaque{ false };         /**< An operand is not an atom. */
+  std::size_t _room{ 0 };        /**< Nodes the expansion may still make. */
+  bool _nested{ false };         /**< Searching coefficients. */
+
+public:
+  /**
+   * @brief Construct a new Poly Visitor object.
+   *
+   * @param arena Arena to allocate polynomials in.
+   */
+  explicit PolyVisitor(Arena& arena)
+    : _arena{ &arena }
+  {
+  }
+
+  ~PolyVisitor() = default;
+
+  error::Result<NodePtr<>> visit_bin_op(NodePtr<BinaryOpNode>& node);
+  error::Result<NodePtr<>> visit_unary_op(NodePtr<UnaryOpNode>& node);
+  error::Result<NodePtr<>> visit_number(NodePtr<NumberNode>& node);
+  error::Result<NodePtr<>> visit_varref(NodePtr<VarRefNode>& node);
+  error::Result<NodePtr<>> visit_varassign(NodePtr<VarAssignNode>& node);
+  error::Result<NodePtr<>> visit_fcall(NodePtr<FcallNode>& node);
+  error::Result<NodePtr<>> visit_fdef(NodePtr<FdefNode>& node);
+  error::Result<NodePtr<>> visit_if(NodePtr<IfNode>& node);
+  error::Result<NodePtr<>> visit_import(NodePtr<ProgramImportNode>& node);
+  error::Result<NodePtr<>> visit_program(NodePtr<ProgramNode>& node);
+  error::Result<NodePtr<>> visit_poly(NodePtr<PolyNode>& node);
+
+private:
+  /**
+   * @brief Replace a subtree with a polynomial if it pays off.
+   *
+   * @param node Subtree root, a sum, difference, product or negation.
+   * @return error::Result<NodePtr<>> Polynomial node, null if the subtree is
+   * kept.
+   */
+  error::Result<NodePtr<>> _recognize(NodePtr<> node);
+
+  /**
+   * @brief Visit the operands of an operator which is kept, without trying
+   * the sums, differences, products and negations it is chained with again.
+   *
+   * @param node Unary or binary operator.
+   * @return error::Result<NodePtr<>> The operator.
+   */
+  error::Result<NodePtr<>> _operands(NodePtr<> node);
+
+  /**
+   * @brief Get the degree of a subtree in every variable it reads, count its
+   * operators and check its operands, in one post-order walk.
+   *
+   * @param node Subtree root.
+   * @return Degrees Degree by variable, above MAX_DEGREE counts as -1.
+   */
+  Degrees _degrees(NodePtr<> node);
+
+  /**
+   * @brief Mark every variable read by an atom as not polynomial.
+   *
+   * @param node Atom operand.
+   * @param degrees Degrees of the operand.
+   */
+  void _block(NodePtr<> node, Degrees& degrees);
+
+  /**
+   * @brief Push the coefficients of a polynomial subtree.
+   *
+   * @param node Subtree root, its degree must be known.
+   * @param var Variable.
+   * @return Coeffs Coefficients, from the constant term up, none if the
+   * expansion ran out of room or would distribute a product of coefficients
+   * which are not numbers.
+   */
+  Coeffs _expand(NodePtr<> node, NodePtr<VarRefNode> var);
+
+  /**
+   * @brief Check if coefficients are numbers or zero.
+   *
+   * @param coeffs Coefficients.
+   * @return true if they are
+   * @return false otherwise
+   */
+  [[nodiscard]] bool _numbers(Coeffs coeffs) const;
+
+  /**
+   * @brief Count the coefficients which are not zero.
+   *
+   * @param coeffs Coefficients.
+   * @return std::size_t Number of terms.
+   */
+  [[nodiscard]] std::size_t _terms(Coeffs coeffs) const;
+
+  /**
+   * @brief Take room for nodes made by the expansion.
+   *
+   * @param nodes Number of nodes.
+   * @return true if there was room
+   * @return false if the expansion must be given up
+   */
+  bool _take(std::size_t nodes);
+
+  /**
+   * @brief Replace the coefficient stack from an offset with the coefficients
+   * pushed after it.
+   *
+   * @param offset Start of the operands.
+   * @param result Coefficients computed from the operands.
+   * @return Coeffs Coefficients at the offset.
+   */
+  Coeffs _collapse(std::size_t offset, Coeffs result);
+
+  /**
+   * @brief Add two coefficients, numbers are added directly.
+   *
+   * @param lhs Left coefficient, null for zero.
+   * @param rhs Right coefficient, null for zero.
+   * @return NodePtr<> Sum, null for zero.
+   */
+  NodePtr<> _add(NodePtr<> lhs, NodePtr<> rhs);
+
+  /**
+   * @brief Multiply two coefficients, numbers are multiplied directly.
+   *
+   * @param lhs Left coefficient, null for zero.
+   * @param rhs Right coefficient, null for zero.
+   * @return NodePtr<> Product, null for zero.
+   */
+  NodePtr<> _mul(NodePtr<> lhs, NodePtr<> rhs);
+
+  /**
+   * @brief Negate a coefficient.
+   *
+   * @param node Coefficient, null for zero.
+   * @return NodePtr<> Negation, null for zero.
+   */
+  NodePtr<> _neg(NodePtr<> node);
+
+  /**
+   * @brief Copy a coefficient used by more than one term.
+   *
+   * @param node Coefficient, null for zero.
+   * @return NodePtr<> Copy, null for zero.
+   */
+  NodePtr<> _clone(NodePtr<> node);
+
+  /**
+   * @brief Allocate a number.
+   *
+   * @param value Number value.
+   * @return NodePtr<> Number node.
+   */
+  NodePtr<> _number(double value);
+};
+
+}
@@ -31,7 +31,7 @@ namespace tcalc::ast {
  * @brief Visitor for printing AST.
  *
  */
-class TCALC_PUBLIC PrintVisitor : public BaseVisitor<void>
+class TCALC_PUBLIC PrintVisitor : public StaticVisitor<PrintVisitor, void>
 {
 public:
   constexpr static std::size_t INDENT_STEP = 2; /**< Default indent step. */
@@ -54,18 +54,19 @@ public:
   {
   }
 
-  ~PrintVisitor() override = default;
+  ~PrintVisitor() = default;
 
-  error::Result<void> visit_bin_op(NodePtr<BinaryOpNode>& node) override;
-  error::Result<void> visit_unary_op(NodePtr<UnaryOpNode>& node) override;
-  error::Result<void> visit_number(NodePtr<NumberNode>& node) override;
-  error::Result<void> visit_varref(NodePtr<VarRefNode>& node) override;
-  error::Result<void> visit_varassign(NodePtr<VarAssignNode>& node) override;
-  error::Result<void> visit_fcall(NodePtr<FcallNode>& node) override;
-  error::Result<void> visit_fdef(NodePtr<FdefNode>& node) override;
-  error::Result<void> visit_if(NodePtr<IfNode>& node) override;
-  error::Result<void> visit_program(NodePtr<ProgramNode>& node) override;
-  error::Result<void> visit_import(NodePtr<ProgramImportNode>& node) override;
+  error::Result<void> visit_bin_op(NodePtr<BinaryOpNode>& node);
+  error::Result<void> visit_unary_op(NodePtr<UnaryOpNode>& node);
+  error::Result<void> visit_number(NodePtr<NumberNode>& node);
+  error::Result<void> visit_varref(NodePtr<VarRefNode>& node);
+  error::Result<void> visit_varassign(NodePtr<VarAssignNode>& node);
+  error::Result<void> visit_fcall(NodePtr<FcallNode>& node);
+  error::Result<void> visit_fdef(NodePtr<FdefNode>& node);
+  error::Result<void> visit_if(NodePtr<IfNode>& node);
+  error::Result<void> visit_program(NodePtr<ProgramNode>& node);
+  error::Result<void> visit_import(NodePtr<ProgramImportNode>& node);
+  error::Result<void> visit_poly(NodePtr<PolyNode>& node);
 
 private:
   /**
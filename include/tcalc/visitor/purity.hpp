@@ -0,0 +1,111 @@
+/**
+ * @file purity.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Visitors for collecting what a function body depends on.
+ * @version 0.2.0
+ * @date 2025-06-27
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "tcalc/ast/flat.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/symbol.hpp"
+#include "tcalc/visitor/base.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Direct dependencies of a function body.
+ *
+ */
+struct Dependencies
+{
+  std::vector<SymbolId> calls;   /**< Called functions. */
+  std::vector<SymbolId> globals; /**< Read global variables. */
+  bool pure{ true }; /**< False if the body assigns, defines or imports. */
+};
+
+/**
+ * @brief Visitor for collecting the functions and globals a function body
+ * uses, callees are not followed.
+ *
+ */
+class TCALC_PUBLIC DependencyVisitor
+  : public StaticVisitor<DependencyVisitor, void>
+{
+private:
+  std::span<const SymbolId> _params;
+  Dependencies* _deps;
+
+public:
+  /**
+   * @brief Construct a new Dependency Visitor object.
+   *
+   * @param params Parameters of the function.
+   * @param deps Dependencies to add to.
+   */
+  DependencyVisitor(std::span<const SymbolId> params, Dependencies& deps)
+    : _params{ params }
+    , _deps{ &deps }
+  {
+  }
+
+  ~DependencyVisitor() = default;
+
+  error::Result<void> visit_bin_op(NodePtr<BinaryOpNode>& node);
+  error::Result<void> visit_unary_op(NodePtr<UnaryOpNode>& node);
+  error::Result<void> visit_varref(NodePtr<VarRefNode>& node);
+  error::Result<void> visit_varassign(NodePtr<VarAssignNode>& node);
+  error::Result<void> visit_fcall(NodePtr<FcallNode>& node);
+  error::Result<void> visit_fdef(NodePtr<FdefNode>& node);
+  error::Result<void> visit_if(NodePtr<IfNode>& node);
+  error::Result<void> visit_import(NodePtr<ProgramImportNode>& node);
+  error::Result<void> visit_poly(NodePtr<PolyNode>& node);
+  error::Result<void> visit_program(NodePtr<ProgramNode>& node);
+};
+
+/**
+ * @brief Collector for the dependencies of a flat function, same as
+ * DependencyVisitor.
+ *
+ * @note The tree must only hold the function, as the trees of flat function
+ * wrappers do, so every record is scanned once.
+ */
+class TCALC_PUBLIC FlatDependencyVisitor
+{
+private:
+  const FlatTree* _tree;
+  Dependencies* _deps;
+
+public:
+  /**
+   * @brief Construct a new Flat Dependency Visitor object.
+   *
+   * @param tree Tree whose root is the function definition.
+   * @param deps Dependencies to add to.
+   */
+  FlatDependencyVisitor(const FlatTree& tree, Dependencies& deps)
+    : _tree{ &tree }
+    , _deps{ &deps }
+  {
+  }
+
+  ~FlatDependencyVisitor() = default;
+
+  /**
+   * @brief Collect the dependencies of the function body.
+   *
+   */
+  void visit();
+};
+
+}
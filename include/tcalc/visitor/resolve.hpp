@@ -0,0 +1,123 @@
+/**
+ * @file resolve.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Visitors for binding variable references to slots.
+ * @version 0.2.0
+ * @date 2025-06-25
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "tcalc/ast/flat.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/eval.hpp"
+#include "tcalc/symbol.hpp"
+#include "tcalc/visitor/base.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Visitor for binding every variable reference to a parameter or global
+ * slot before evaluation.
+ *
+ * @note References outside function bodies must name a global which is
+ * defined in the context or assigned by an earlier statement, anything else is
+ * reported as `UNDEFINED_VAR`. Calls outside function bodies are checked
+ * against the arity of context functions and reported as `MISMATCHED_ARGS`.
+ * Function bodies bind late because globals may be defined after the
+ * function, and so does everything after an import.
+ */
+class TCALC_PUBLIC ResolveVisitor : public StaticVisitor<ResolveVisitor, void>
+{
+private:
+  const EvalContext* _ctx;
+  std::span<const SymbolId> _params;
+  std::vector<SymbolId> _assigned;
+  std::vector<SymbolId> _defined;
+  bool _late{ false };
+
+public:
+  /**
+   * @brief Construct a new Resolve Visitor object.
+   *
+   * @param ctx Evaluation context to check globals against, null to bind
+   * without checking.
+   * @param params Parameters of the enclosing function, if any.
+   */
+  explicit ResolveVisitor(const EvalContext* ctx,
+                          std::span<const SymbolId> params = {})
+    : _ctx{ ctx }
+    , _params{ params }
+  {
+  }
+
+  ~ResolveVisitor() = default;
+
+  error::Result<void> visit_bin_op(NodePtr<BinaryOpNode>& node);
+  error::Result<void> visit_unary_op(NodePtr<UnaryOpNode>& node);
+  error::Result<void> visit_varref(NodePtr<VarRefNode>& node);
+  error::Result<void> visit_varassign(NodePtr<VarAssignNode>& node);
+  error::Result<void> visit_fcall(NodePtr<FcallNode>& node);
+  error::Result<void> visit_fdef(NodePtr<FdefNode>& node);
+  error::Result<void> visit_if(NodePtr<IfNode>& node);
+  error::Result<void> visit_import(NodePtr<ProgramImportNode>& node);
+  error::Result<void> visit_poly(NodePtr<PolyNode>& node);
+  error::Result<void> visit_program(NodePtr<ProgramNode>& node);
+
+private:
+  /**
+   * @brief Bind a symbol outside of the parameters.
+   *
+   * @param id Symbol id.
+   * @return error::Result<SymbolId> Symbol id of the global.
+   */
+  error::Result<SymbolId> _bind_global(SymbolId id);
+};
+
+/**
+ * @brief Resolver for flat trees, binds `VARREF` and `VARASSIGN` records in
+ * place with the same rules as ResolveVisitor.
+ *
+ * @note The tree is scanned linearly, it never recurses.
+ */
+class TCALC_PUBLIC FlatResolveVisitor
+{
+private:
+  FlatTree* _tree;
+  const EvalContext* _ctx;
+
+public:
+  /**
+   * @brief Construct a new Flat Resolve Visitor object.
+   *
+   * @param tree Flat tree.
+   * @param ctx Evaluation context to check globals against, null to bind
+   * without checking.
+   */
+  FlatResolveVisitor(FlatTree& tree, const EvalContext* ctx)
+    : _tree{ &tree }
+    , _ctx{ ctx }
+  {
+  }
+
+  ~FlatResolveVisitor() = default;
+
+  /**
+   * @brief Resolve a subtree.
+   *
+   * @param index Subtree root.
+   * @return error::Result<void> Result, fails on undefined variables and
+   * mismatched arguments.
+   */
+  error::Result<void> visit(FlatIndex index);
+};
+
+}
@@ -0,0 +1,174 @@
+/**
+ * @file simplify.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Visitor for algebraic simplification.
+ * @version 0.2.0
+ * @date 2025-06-27
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/eval.hpp"
+#include "tcalc/symbol.hpp"
+#include "tcalc/visitor/base.hpp"
+
+namespace tcalc::ast {
+
+/**
+ * @brief Visitor for rewriting a resolved AST into cheaper equivalent forms,
+ * returns the node replacing the visited one.
+ *
+ * @note By default only rewrites giving bit-identical results are made:
+ * `x * 1`, `x / 1`, `x - 0`, `- -x` and `+x` become `x`, `x * -1` becomes
+ * `-x`, division by a power of two becomes multiplication by its reciprocal,
+ * and `pow(x, 1)` of the built-in `pow` becomes `x`. Fast math adds rewrites
+ * which may round differently or assume finite arguments: `x + 0`,
+ * reassociation of constant sums and products, division by any constant,
+ * integer powers up to MAX_POWER such as `pow(x, 2)` to `x * x` and
+ * `pow(x, -1)` to `1 / x`, `pow(x, 0.5)` to `sqrt(x)`, and cancelling `exp`,
+ * `pow` and `log` pairs. Calls are only rewritten when they reach the
+ * built-in function, so the same names are left alone as FoldVisitor leaves
+ * them.
+ */
+class TCALC_PUBLIC SimplifyVisitor
+  : public StaticVisitor<SimplifyVisitor, NodePtr<>>
+{
+public:
+  constexpr static double MAX_POWER = 4; /**< Largest expanded exponent. */
+
+private:
+  Arena* _arena;
+  const EvalContext* _ctx;
+  bool _fast_math;
+  std::vector<SymbolId> _defined;
+  bool _late{ false };
+
+public:
+  /**
+   * @brief Construct a new Simplify Visitor object.
+   *
+   * @param arena Arena to allocate rewritten nodes in.
+   * @param ctx Evaluation context to recognize built-in functions with, null
+   * to only rewrite operators.
+   * @param fast_math Whether rewrites which are not IEEE-exact are allowed.
+   */
+  SimplifyVisitor(Arena& arena, const EvalContext* ctx, bool fast_math)
+    : _arena{ &arena }
+    , _ctx{ ctx }
+    , _fast_math{ fast_math }
+    , _late{ ctx == nullptr }
+  {
+  }
+
+  ~SimplifyVisitor() = default;
+
+  error::Result<NodePtr<>> visit_bin_op(NodePtr<BinaryOpNode>& node);
+  error::Result<NodePtr<>> visit_unary_op(NodePtr<UnaryOpNode>& node);
+  error::Result<NodePtr<>> visit_number(NodePtr<NumberNode>& node);
+  error::Result<NodePtr<>> visit_varref(NodePtr<VarRefNode>& node);
+  error::Result<NodePtr<>> visit_varassign(NodePtr<VarAssignNode>& node);
+  error::Result<NodePtr<>> visit_fcall(NodePtr<FcallNode>& node);
+  error::Result<NodePtr<>> visit_fdef(NodePtr<FdefNode>& node);
+  error::Result<NodePtr<>> visit_if(NodePtr<IfNode>& node);
+  error::Result<NodePtr<>> visit_import(NodePtr<ProgramImportNode>& node);
+  error::Result<NodePtr<>> visit_poly(NodePtr<PolyNode>& node);
+  error::Result<NodePtr<>> visit_program(NodePtr<ProgramNode>& node);
+
+private:
+  /**
+   * @brief Rewrite a binary operation whose operands are simplified.
+   *
+   * @param node Binary operation node.
+   * @return NodePtr<> Node replacing it.
+   */
+  NodePtr<> _bin_op(NodePtr<BinaryOpNode> node);
+
+  /**
+   * @brief Rewrite a call of the built-in `pow`.
+   *
+   * @param node Function call node with simplified arguments.
+   * @return NodePtr<> Node replacing it.
+   */
+  NodePtr<> _pow(NodePtr<FcallNode> node);
+
+  /**
+   * @brief Rewrite a call undoing the function called in its argument.
+   *
+   * @param node Function call node with simplified arguments.
+   * @return NodePtr<> Node replacing it, null if the call is kept.
+   */
+  NodePtr<> _inverse(NodePtr<FcallNode> node);
+
+  /**
+   * @brief Check if a call reaches a native built-in function.
+   *
+   * @tparam F Built-in closure type, see builtins::SQRT.
+   * @param node Function call node.
+   * @param fn Built-in function.
+   * @return true if the call runs the function
+   * @return false if the name may be bound to anything else
+   */
+  template<typename F>
+  [[nodiscard]] bool _calls(NodePtr<> node, const F& fn) const;
+
+  /**
+   * @brief Check if a function name is bound to a native built-in function.
+   *
+   * @tparam F Built-in closure type, see builtins::SQRT.
+   * @param id Function symbol.
+   * @param argc Argument count of the call.
+   * @param fn Built-in function.
+   * @return true if a call with argc arguments runs the function
+   * @return false if the name may be bound to anything else
+   */
+  template<typename F>
+  [[nodiscard]] bool _reaches(SymbolId id,
+                              std::size_t argc,
+                              const F& fn) const;
+
+  /**
+   * @brief Copy a number or variable reference, which may be evaluated twice.
+   *
+   * @param node Node to copy.
+   * @return NodePtr<> Copy, null if the node is not a leaf.
+   */
+  NodePtr<> _copy(NodePtr<> node);
+
+  /**
+   * @brief Simplify a negation whose operand is simplified.
+   *
+   * @param node Unary minus node.
+   * @return NodePtr<> Node replacing it.
+   */
+  NodePtr<> _negate(NodePtr<UnaryOpNode> node);
+
+  /**
+   * @brief Allocate a number.
+   *
+   * @param value Number value.
+   * @return NodePtr<> Number node.
+   */
+  NodePtr<> _number(double value);
+
+  /**
+   * @brief Allocate a binary operation and simplify it.
+   *
+   * @param type Operator type.
+   * @param left Simplified left operand.
+   * @param right Simplified right operand.
+   * @return NodePtr<> Simplified node.
+   */
+  NodePtr<> _binary(NodeType type, NodePtr<> left, NodePtr<> right);
+};
+
+}
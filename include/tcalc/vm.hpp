@@ -0,0 +1,123 @@
+/**
+ * @file vm.hpp
+ * @author Dessera (dessera@qq.com)
+ * @brief Stack based virtual machine for tcalc bytecode.
+ * @version 0.2.0
+ * @date 2025-06-20
+ *
+ * @copyright Copyright (c) 2025 Dessera
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "tcalc/builtins.hpp"
+#include "tcalc/bytecode.hpp"
+#include "tcalc/common.hpp"
+#include "tcalc/error.hpp"
+
+namespace tcalc {
+
+class EvalContext;
+
+}
+
+namespace tcalc::bytecode {
+
+/**
+ * @brief Stack based virtual machine.
+ *
+ * @note The stacks are kept between runs, a VM owned by an evaluator runs
+ * calls without allocating once they have grown to the deepest call.
+ */
+class TCALC_PUBLIC VM
+{
+public:
+  constexpr static std::size_t INIT_STACK_SIZE = 256; /**< Initial stack. */
+
+private:
+  /**
+   * @brief Call frame.
+   *
+   */
+  struct Frame
+  {
+    const Chunk* chunk;
+    const Instruction* pc;
+    std::size_t base;
+    const builtins::FunctionWrapper* func;
+  };
+
+  EvalContext* _ctx{ nullptr };
+  std::vector<double> _stack;
+  std::vector<Frame> _frames;
+
+public:
+  VM();
+
+  ~VM() = default;
+
+  /**
+   * @brief Run an expression chunk.
+   *
+   * @param chunk Compiled chunk.
+   * @param ctx Evaluation context.
+   * @return error::Result<double> Evaluation result.
+   */
+  error::Result<double> run(const Chunk& chunk, EvalContext& ctx);
+
+  /**
+   * @brief Run a program chunk.
+   *
+   * @param chunk Compiled chunk.
+   * @param ctx Evaluation context.
+   * @return error::Result<std::vector<double>> Result of every statement.
+   */
+  error::Result<std::vector<double>> run_prog(const Chunk& chunk,
+                                              EvalContext& ctx);
+
+private:
+  /**
+   * @brief Dispatch loop.
+   *
+   * @param chunk Entry chunk.
+   * @param results Program results, receives YIELDed values if not null.
+   * @return error::Result<double> Value returned by the entry chunk.
+   */
+  error::Result<double> _exec(const Chunk& chunk, std::vector<double>* results);
+
+  /**
+   * @brief Call a function through its generic interface.
+   *
+   * @param func Function.
+   * @param argc Argument count, arguments are on the top of the stack.
+   * @return error::Result<double> Function result.
+   */
+  error::Result<double> _call_generic(const builtins::Function& func,
+                                      std::size_t argc);
+
+  /**
+   * @brief Evaluate equality between two double.
+   *
+   * @param a Left hand side.
+   * @param b Right hand side.
+   * @return true if equal
+   * @return false if not equal
+   */
+  static bool _double_eq(double a, double b);
+
+  /**
+   * @brief Evaluate inequality between two double.
+   *
+   * @param a Left hand side.
+   * @param b Right hand side.
+   * @return true if not equal
+   * @return false if equal
+   */
+  static bool _double_noeq(double a, double b);
+};
+
+}
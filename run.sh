@@ -0,0 +1,2 @@
+input=$(cat)
+for e in tree vm flat; do for l in 0 2; do echo "--- $e O$l $1"; echo "$input" | timeout 20 /tmp/q/probe $e $l $1 2>&1; echo "rc=$?"; done; done
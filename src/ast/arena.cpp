@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+#include "tcalc/ast/arena.hpp"
+
+namespace tcalc::ast {
+
+void*
+Arena::allocate(std::size_t size, std::size_t align)
+{
+  while (_block < _blocks.size()) {
+    auto& block = _blocks[_block];
+    auto offset = (_offset + align - 1) & ~(align - 1);
+    if (offset + size <= block.size) {
+      _offset = offset + size;
+      return block.data.get() + offset;
+    }
+
+    ++_block;
+    _offset = 0;
+  }
+
+  auto block_size =
+    _blocks.empty() ? BLOCK_SIZE : std::min(_blocks.back().size * 2, MAX_BLOCK);
+  block_size = std::max(block_size, size + align);
+
+  // operator new[] aligns to __STDCPP_DEFAULT_NEW_ALIGNMENT__, which is enough
+  // for every node type.
+  _blocks.push_back(
+    { std::make_unique_for_overwrite<std::byte[]>(block_size), block_size });
+  _block = _blocks.size() - 1;
+  _offset = size;
+
+  return _blocks.back().data.get();
+}
+
+std::string_view
+Arena::str(std::string_view str)
+{
+  if (str.empty()) {
+    return {};
+  }
+
+  auto* data = static_cast<char*>(allocate(str.size(), alignof(char)));
+  std::memcpy(data, str.data(), str.size());
+
+  return { data, str.size() };
+}
+
+std::size_t
+Arena::capacity() const noexcept
+{
+  auto size = std::size_t{ 0 };
+  for (const auto& block : _blocks) {
+    size += block.size;
+  }
+
+  return size;
+}
+
+}
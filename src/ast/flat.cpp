@@ -0,0 +1,183 @@
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "tcalc/ast/flat.hpp"
+
+namespace tcalc::ast {
+
+FlatIndex
+FlatTree::add_const(double value)
+{
+  _consts.push_back(value);
+  return static_cast<FlatIndex>(_consts.size() - 1);
+}
+
+FlatIndex
+FlatTree::add_cache()
+{
+  _caches.emplace_back();
+  return static_cast<FlatIndex>(_caches.size() - 1);
+}
+
+FlatIndex
+FlatTree::add_list(std::span<const FlatIndex> items)
+{
+  auto offset = static_cast<FlatIndex>(_lists.size());
+  _lists.push_back(static_cast<FlatIndex>(items.size()));
+  _lists.insert(_lists.end(), items.begin(), items.end());
+
+  return offset;
+}
+
+FlatIndex
+FlatTree::first(FlatIndex index) const
+{
+  // the first child is always emitted first, follow it down to a leaf
+  while (true) {
+    const auto& record = _nodes[index];
+
+    switch (record.type) {
+      case NodeType::BINARY_PLUS:
+      case NodeType::BINARY_MINUS:
+      case NodeType::BINARY_MULTIPLY:
+      case NodeType::BINARY_DIVIDE:
+      case NodeType::BINARY_EQUAL:
+      case NodeType::BINARY_NOT_EQUAL:
+      case NodeType::BINARY_GREATER:
+      case NodeType::BINARY_GREATER_EQUAL:
+      case NodeType::BINARY_LESS:
+      case NodeType::BINARY_LESS_EQUAL:
+      case NodeType::BINARY_AND:
+      case NodeType::BINARY_OR:
+      case NodeType::UNARY_PLUS:
+      case NodeType::UNARY_MINUS:
+      case NodeType::UNARY_NOT:
+      case NodeType::IF:
+        index = record.a;
+        break;
+      case NodeType::VARASSIGN:
+        index = record.b;
+        break;
+      case NodeType::FDEF:
+        index = record.c;
+        break;
+      case NodeType::FCALL:
+      case NodeType::PROGRAM: {
+        auto children =
+          list(record.type == NodeType::FCALL ? record.b : record.a);
+        if (children.empty()) {
+          return index;
+        }
+        index = children.front();
+        break;
+      }
+      default:
+        return index;
+    }
+  }
+}
+
+FlatTree
+FlatTree::subtree(FlatIndex root) const
+{
+  auto tree = FlatTree{};
+  tree._copy(*this, root);
+
+  return tree;
+}
+
+void
+FlatTree::clear() noexcept
+{
+  _nodes.clear();
+  _consts.clear();
+  _lists.clear();
+  _caches.clear();
+}
+
+std::size_t
+FlatTree::footprint() const noexcept
+{
+  return _nodes.size() * sizeof(FlatNode) + _consts.size() * sizeof(double) +
+         _lists.size() * sizeof(FlatIndex) +
+         _caches.size() * sizeof(CallCache);
+}
+
+FlatIndex
+FlatTree::_copy(const FlatTree& tree, FlatIndex index)
+{
+  // the subtree is a contiguous range, copy it in order and shift the child
+  // indices, so the native stack does not grow with the depth of the tree
+  auto begin = tree.first(index);
+  auto shift = [base = static_cast<FlatIndex>(_nodes.size()),
+                begin](FlatIndex child) { return child - begin + base; };
+
+  for (auto i = begin; i <= index; ++i) {
+    auto node = tree.node(i);
+
+    switch (node.type) {
+      case NodeType::BINARY_PLUS:
+      case NodeType::BINARY_MINUS:
+      case NodeType::BINARY_MULTIPLY:
+      case NodeType::BINARY_DIVIDE:
+      case NodeType::BINARY_EQUAL:
+      case NodeType::BINARY_NOT_EQUAL:
+      case NodeType::BINARY_GREATER:
+      case NodeType::BINARY_GREATER_EQUAL:
+      case NodeType::BINARY_LESS:
+      case NodeType::BINARY_LESS_EQUAL:
+      case NodeType::BINARY_AND:
+      case NodeType::BINARY_OR:
+        node.a = shift(node.a);
+        node.b = shift(node.b);
+        break;
+      case NodeType::UNARY_PLUS:
+      case NodeType::UNARY_MINUS:
+      case NodeType::UNARY_NOT:
+        node.a = shift(node.a);
+        break;
+      case NodeType::NUMBER:
+        node.a = add_const(tree.value(node.a));
+        break;
+      case NodeType::VARREF:
+      case NodeType::IMPORT:
+        break;
+      case NodeType::VARASSIGN:
+        node.b = shift(node.b);
+        break;
+      case NodeType::FCALL:
+      case NodeType::PROGRAM: {
+        auto& list = node.type == NodeType::FCALL ? node.b : node.a;
+        auto items = std::vector<FlatIndex>{};
+        for (auto item : tree.list(list)) {
+          items.push_back(shift(item));
+        }
+        list = add_list(items);
+        if (node.type == NodeType::FCALL) {
+          node.c = add_cache();
+        }
+        break;
+      }
+      case NodeType::FDEF:
+        node.b = add_list(tree.list(node.b));
+        node.c = shift(node.c);
+        break;
+      case NodeType::IF:
+        node.a = shift(node.a);
+        node.b = shift(node.b);
+        node.c = shift(node.c);
+        break;
+      case NodeType::POLY:
+        // only built by passes over pointer trees, never flattened
+        std::unreachable();
+    }
+
+    emit(node);
+  }
+
+  return root();
+}
+
+}
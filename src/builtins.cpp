@@ -1,181 +1,162 @@
 #include <cmath>
 #include <fstream>
+#include <memory>
+#include <span>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 #include "tcalc/builtins.hpp"
 #include "tcalc/error.hpp"
 #include "tcalc/eval.hpp"
+#include "tcalc/visitor/clone.hpp"
 #include "tcalc/visitor/eval.hpp"
+#include "tcalc/visitor/flat_eval.hpp"
 
 namespace tcalc::builtins {
 
-error::Result<double>
-FunctionWrapper::operator()(const std::vector<double>& args,
-                            const EvalContext& ctx) const
+FunctionWrapper::FunctionWrapper(ast::NodePtr<ast::FdefNode> node)
+  : _arena{ std::make_shared<ast::Arena>() }
 {
-  auto local_ctx = ctx;
-  local_ctx.increment_call_depth();
-
-  if (local_ctx.call_depth() >= EvalContext::MAX_CALL_DEPTH) {
-    return error::err(error::Code::RECURSION_LIMIT,
-                      "Function call `%s' exceeded maximum recursion depth",
-                      _node->name().c_str());
-  }
-
-  if (args.size() != _node->args().size()) {
-    return error::err(error::Code::MISMATCHED_ARGS,
-                      "Wrong number of arguments, expected %zu, got %zu",
-                      _node->args().size(),
-                      args.size());
-  }
-  for (std::size_t i = 0; i < args.size(); ++i) {
-    local_ctx.var(_node->args()[i], args[i]);
-  }
+  auto visitor = ast::CloneVisitor{ *_arena };
+  auto root = ast::NodePtr<>{ node };
 
-  auto local_visitor = ast::EvalVisitor{ local_ctx };
-  return local_visitor.visit(_node->body());
+  // cloning never fails, the result is only for the visitor interface
+  _node = static_cast<ast::NodePtr<ast::FdefNode>>(visitor.visit(root).value());
+  _depth = ast::EvalVisitor::nesting(_node->body());
 }
 
-error::Result<void>
-ImportWrapper::import(EvalContext& ctx) const
+FunctionWrapper::FunctionWrapper(std::shared_ptr<ast::Arena> arena,
+                                 ast::NodePtr<ast::FdefNode> node,
+                                 std::shared_ptr<const bytecode::Chunk> chunk)
+  : _arena{ std::move(arena) }
+  , _node{ node }
+  , _chunk{ std::move(chunk) }
+  , _depth{ ast::EvalVisitor::nesting(node->body()) }
 {
-  auto file = std::ifstream{ _node->path() };
-  if (!file.is_open()) {
-    return error::err(error::Code::FILE_NOT_FOUND,
-                      "File `%s` not found",
-                      _node->path().c_str());
-  }
-
-  auto iss = std::stringstream{};
-  iss << file.rdbuf();
-
-  auto evaluator = Evaluator{};
-  ret_err(evaluator.eval_prog(iss.str()));
-
-  ctx.update_with(evaluator.ctx());
-
-  return error::ok<void>();
 }
 
 error::Result<double>
-sqrt(const std::vector<double>& args, const EvalContext& /*ctx*/)
+FunctionWrapper::operator()(std::span<const double> args,
+                            EvalContext& ctx) const
 {
-  if (args.size() != 1) {
-    return error::err(error::Code::MISMATCHED_ARGS,
-                      "Mismatched arguments in sqrt, expected 1, got %zu",
-                      args.size());
+  if (const auto* hit = ctx.memo_find(_node->symbol(), _node, args)) {
+    return error::ok<double>(*hit);
   }
 
-  return error::ok<double>(std::sqrt(args[0]));
-}
+  ret_err(ctx.push_frame(_node->symbol(), _node->args(), args, _depth));
 
-error::Result<double>
-pow(const std::vector<double>& args, const EvalContext& /*ctx*/)
-{
-  if (args.size() != 2) {
-    return error::err(error::Code::MISMATCHED_ARGS,
-                      "Mismatched arguments in pow, expected 2, got %zu",
-                      args.size());
-  }
+  auto visitor = ast::EvalVisitor{ ctx };
+  auto res = visitor.visit_body(*this);
+  ctx.pop_frame();
 
-  return error::ok<double>(std::pow(args[0], args[1]));
+  return res;
 }
 
 error::Result<double>
-log(const std::vector<double>& args, const EvalContext& /*ctx*/)
+FlatFunctionWrapper::operator()(std::span<const double> args,
+                                EvalContext& ctx) const
 {
-  if (args.size() != 2) {
-    return error::err(error::Code::MISMATCHED_ARGS,
-                      "Mismatched arguments in log, expected 2, got %zu",
-                      args.size());
+  const auto& def = _tree->node(_tree->root());
+  if (const auto* hit = ctx.memo_find(def.a, _tree.get(), args)) {
+    return error::ok<double>(*hit);
   }
 
-  return error::ok<double>(std::log(args[1]) / std::log(args[0]));
-}
+  ret_err(ctx.push_frame(def.a, _tree->list(def.b), args));
 
-error::Result<double>
-sin(const std::vector<double>& args, const EvalContext& /*ctx*/)
-{
-  if (args.size() != 1) {
-    return error::err(error::Code::MISMATCHED_ARGS,
-                      "Mismatched arguments in sin, expected 1, got %zu",
-                      args.size());
-  }
+  auto visitor = ast::FlatEvalVisitor{ *_tree, ctx };
+  auto res = visitor.visit_body(*this);
+  ctx.pop_frame();
 
-  return error::ok<double>(std::sin(args[0]));
+  return res;
 }
 
-error::Result<double>
-cos(const std::vector<double>& args, const EvalContext& /*ctx*/)
+error::Result<void>
+ImportWrapper::import(EvalContext& ctx) const
 {
-  if (args.size() != 1) {
-    return error::err(error::Code::MISMATCHED_ARGS,
-                      "Mismatched arguments in cos, expected 1, got %zu",
-                      args.size());
+  auto file = std::ifstream{ _path };
+  if (!file.is_open()) {
+    return error::err(error::Code::FILE_NOT_FOUND,
+                      "File `%s` not found",
+                      _path.c_str());
   }
 
-  return error::ok<double>(std::cos(args[0]));
-}
+  auto iss = std::stringstream{};
+  iss << file.rdbuf();
 
-error::Result<double>
-tan(const std::vector<double>& args, const EvalContext& /*ctx*/)
-{
-  if (args.size() != 1) {
-    return error::err(error::Code::MISMATCHED_ARGS,
-                      "Mismatched arguments in tan, expected 1, got %zu",
-                      args.size());
-  }
+  auto evaluator = Evaluator{};
+  ret_err(evaluator.eval_prog(iss.str()));
 
-  return error::ok<double>(std::tan(args[0]));
+  ctx.update_with(evaluator.ctx());
+
+  return error::ok<void>();
 }
 
-error::Result<double>
-acos(const std::vector<double>& args, const EvalContext& /*ctx*/)
+double
+log_base(double base, double x)
 {
-  if (args.size() != 1) {
-    return error::err(error::Code::MISMATCHED_ARGS,
-                      "Mismatched arguments in acos, expected 1, got %zu",
-                      args.size());
-  }
-
-  return error::ok<double>(std::acos(args[0]));
+  return std::log(x) / std::log(base);
 }
 
-error::Result<double>
-asin(const std::vector<double>& args, const EvalContext& /*ctx*/)
+void
+register_builtins(EvalContext& ctx)
 {
-  if (args.size() != 1) {
-    return error::err(error::Code::MISMATCHED_ARGS,
-                      "Mismatched arguments in asin, expected 1, got %zu",
-                      args.size());
-  }
-
-  return error::ok<double>(std::asin(args[0]));
+  ctx.register_fn<double(double)>("sqrt", SQRT);
+  ctx.register_fn<double(double, double)>("pow", POW);
+  ctx.register_fn<double(double, double)>("log", LOG);
+  ctx.register_fn<double(double)>("sin", SIN);
+  ctx.register_fn<double(double)>("cos", COS);
+  ctx.register_fn<double(double)>("tan", TAN);
+  ctx.register_fn<double(double)>("acos", ACOS);
+  ctx.register_fn<double(double)>("asin", ASIN);
+  ctx.register_fn<double(double)>("atan", ATAN);
+  ctx.register_fn<double(double)>("exp", EXP);
 }
 
-error::Result<double>
-atan(const std::vector<double>& args, const EvalContext& /*ctx*/)
+namespace {
+
+template<typename Sig, typename F>
+Function
+checked(const char* name, F fn)
 {
-  if (args.size() != 1) {
-    return error::err(error::Code::MISMATCHED_ARGS,
-                      "Mismatched arguments in atan, expected 1, got %zu",
-                      args.size());
-  }
+  using Thunk = NativeThunk<Sig, F>;
+  return [name, thunk = Thunk{ fn }](
+           std::span<const double> args,
+           EvalContext& ctx) -> error::Result<double> {
+    if (args.size() != Thunk::ARITY) {
+      return error::err(error::Code::MISMATCHED_ARGS,
+                        "Mismatched arguments in %s, expected %zu, got %zu",
+                        name,
+                        Thunk::ARITY,
+                        args.size());
+    }
+
+    return thunk(args, ctx);
+  };
+}
 
-  return error::ok<double>(std::atan(args[0]));
 }
 
-error::Result<double>
-exp(const std::vector<double>& args, const EvalContext& /*ctx*/)
+const FunctionMap BUILTIN_FUNCTIONS = {
+  { "sqrt", checked<double(double)>("sqrt", SQRT) },
+  { "pow", checked<double(double, double)>("pow", POW) },
+  { "log", checked<double(double, double)>("log", LOG) },
+  { "sin", checked<double(double)>("sin", SIN) },
+  { "cos", checked<double(double)>("cos", COS) },
+  { "tan", checked<double(double)>("tan", TAN) },
+  { "acos", checked<double(double)>("acos", ACOS) },
+  { "asin", checked<double(double)>("asin", ASIN) },
+  { "atan", checked<double(double)>("atan", ATAN) },
+  { "exp", checked<double(double)>("exp", EXP) },
+};
+
+EvalContext
+make_context()
 {
-  if (args.size() != 1) {
-    return error::err(error::Code::MISMATCHED_ARGS,
-                      "Mismatched arguments in exp, expected 1, got %zu",
-                      args.size());
-  }
+  auto ctx = EvalContext{ BUILTIN_VARIABLES, {} };
+  register_builtins(ctx);
 
-  return error::ok<double>(std::exp(args[0]));
+  return ctx;
 }
 
 }
@@ -0,0 +1,71 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "tcalc/bytecode.hpp"
+
+namespace tcalc::bytecode {
+
+uint32_t
+Chunk::add_const(double value)
+{
+  _consts.push_back(value);
+  return static_cast<uint32_t>(_consts.size() - 1);
+}
+
+uint32_t
+Chunk::add_call(SymbolId symbol, uint32_t argc)
+{
+  _calls.push_back({ symbol, argc });
+  return static_cast<uint32_t>(_calls.size() - 1);
+}
+
+uint32_t
+Chunk::add_proto(FunctionProto proto)
+{
+  _protos.push_back(std::move(proto));
+  return static_cast<uint32_t>(_protos.size() - 1);
+}
+
+uint32_t
+Chunk::add_import(std::string path)
+{
+  _imports.push_back(std::move(path));
+  return static_cast<uint32_t>(_imports.size() - 1);
+}
+
+void
+Chunk::add_inlined(FunctionProto proto)
+{
+  _inlined.push_back(std::move(proto));
+}
+
+std::shared_ptr<const Chunk>
+ChunkCache::find(std::string_view source) const
+{
+  auto it = _chunks.find(source);
+  if (it == _chunks.end()) {
+    return nullptr;
+  }
+
+  return it->second;
+}
+
+void
+ChunkCache::insert(std::string_view source, std::shared_ptr<const Chunk> chunk)
+{
+  if (auto it = _chunks.find(source); it != _chunks.end()) {
+    it->second = std::move(chunk);
+    return;
+  }
+
+  if (_chunks.size() >= _capacity) {
+    _chunks.clear();
+  }
+
+  _chunks.emplace(source, std::move(chunk));
+}
+
+}
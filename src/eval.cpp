@@ -1,54 +1,408 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
 #include "tcalc/eval.hpp"
 #include "tcalc/builtins.hpp"
 #include "tcalc/error.hpp"
+#include "tcalc/memo.hpp"
+#include "tcalc/visitor/compile.hpp"
 #include "tcalc/visitor/eval.hpp"
+#include "tcalc/visitor/flat_eval.hpp"
+#include "tcalc/visitor/fold.hpp"
+#include "tcalc/visitor/purity.hpp"
+#include "tcalc/visitor/resolve.hpp"
+#include "tcalc/vm.hpp"
 
 namespace tcalc {
 
+EvalContext::EvalContext(const builtins::VariableMap& vars,
+                         const builtins::FunctionMap& funcs)
+{
+  for (const auto& [name, value] : vars) {
+    constant(name, value);
+  }
+  for (const auto& [name, fn] : funcs) {
+    func(name, fn);
+  }
+}
+
+error::Result<double>
+EvalContext::var(std::string_view name) const
+{
+  if (auto id = symbols().find(name); id != NO_SYMBOL) {
+    return var(id);
+  }
+
+  return error::err(error::Code::UNDEFINED_VAR,
+                    "Undefined variable: %.*s",
+                    static_cast<int>(name.size()),
+                    name.data());
+}
+
 error::Result<double>
-EvalContext::var(const std::string& name) const
+EvalContext::var(SymbolId id) const
 {
-  if (_vars.find(name) != _vars.end()) {
-    return _vars.at(name);
+  if (!_frames.empty()) {
+    const auto& frame = _frames.back();
+    for (std::size_t i = 0; i < frame.params.size(); ++i) {
+      if (frame.params[i] == id) {
+        return _args[frame.base + i];
+      }
+    }
   }
 
-  return error::err(
-    error::Code::UNDEFINED_VAR, "Undefined variable: %s", name.c_str());
+  return global(id);
+}
+
+void
+EvalContext::var(std::string_view name, double value)
+{
+  global(symbols().intern(name), value);
+}
+
+void
+EvalContext::constant(std::string_view name, double value)
+{
+  auto id = symbols().intern(name);
+  global(id, value);
+  _globals[id].constant = true;
 }
 
-error::Result<builtins::Function>
-EvalContext::func(const std::string& name) const
+error::Result<std::reference_wrapper<const builtins::Function>>
+EvalContext::func(std::string_view name) const
 {
-  if (_funcs.find(name) != _funcs.end()) {
-    return _funcs.at(name);
+  if (auto id = symbols().find(name); id != NO_SYMBOL) {
+    return func(id);
   }
 
-  return error::err(
-    error::Code::UNDEFINED_FUNC, "Undefined function: %s", name.c_str());
+  return error::err(error::Code::UNDEFINED_FUNC,
+                    "Undefined function: %.*s",
+                    static_cast<int>(name.size()),
+                    name.data());
+}
+
+error::Result<std::reference_wrapper<const builtins::Function>>
+EvalContext::func(SymbolId id) const
+{
+  if (const auto* fn = find_func(id); fn != nullptr) {
+    return std::cref(*fn);
+  }
+
+  auto name = symbols().name(id);
+  return error::err(error::Code::UNDEFINED_FUNC,
+                    "Undefined function: %.*s",
+                    static_cast<int>(name.size()),
+                    name.data());
+}
+
+const builtins::FunctionInfo*
+EvalContext::func_info(std::string_view name) const
+{
+  if (auto id = symbols().find(name); id != NO_SYMBOL) {
+    return func_info(id);
+  }
+
+  return nullptr;
+}
+
+error::Result<void>
+EvalContext::check_args(SymbolId id, std::size_t argc) const
+{
+  const auto* info = func_info(id);
+  if (info == nullptr || info->arity == builtins::FunctionInfo::VARIADIC ||
+      info->arity == argc) {
+    return error::ok<void>();
+  }
+
+  auto name = symbols().name(id);
+  return error::err(error::Code::MISMATCHED_ARGS,
+                    "Wrong number of arguments in %.*s, expected %zu, got %zu",
+                    static_cast<int>(name.size()),
+                    name.data(),
+                    info->arity,
+                    argc);
+}
+
+void
+EvalContext::func(std::string_view name,
+                  builtins::Function func,
+                  builtins::FunctionInfo info)
+{
+  this->func(symbols().intern(name), std::move(func), info);
+}
+
+void
+EvalContext::func(SymbolId id,
+                  builtins::Function func,
+                  builtins::FunctionInfo info)
+{
+  if (id >= _funcs.size()) {
+    _funcs.resize(id + 1);
+  }
+
+  // calls of pure host functions may have been folded
+  if (_funcs[id].info.pure) {
+    ++_constant_generation;
+  }
+  _funcs[id] = { std::move(func), info };
+  _generation.bump();
+}
+
+error::Result<void>
+EvalContext::push_frame(SymbolId name,
+                        std::span<const SymbolId> params,
+                        std::span<const double> args,
+                        std::size_t depth)
+{
+  if (_frames.size() + 1 >= MAX_CALL_DEPTH ||
+      _nesting + depth > MAX_NESTING) {
+    auto text = symbols().name(name);
+    return error::err(error::Code::RECURSION_LIMIT,
+                      "Function call `%.*s' exceeded maximum recursion depth",
+                      static_cast<int>(text.size()),
+                      text.data());
+  }
+
+  if (args.size() != params.size()) {
+    return error::err(error::Code::MISMATCHED_ARGS,
+                      "Wrong number of arguments, expected %zu, got %zu",
+                      params.size(),
+                      args.size());
+  }
+
+  _frames.push_back({ params, _args.size(), depth });
+  _nesting += depth;
+  _args.insert(_args.end(), args.begin(), args.end());
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+EvalContext::replace_frame(std::span<const SymbolId> params,
+                           std::span<const double> args,
+                           std::size_t depth)
+{
+  if (args.size() != params.size()) {
+    return error::err(error::Code::MISMATCHED_ARGS,
+                      "Wrong number of arguments, expected %zu, got %zu",
+                      params.size(),
+                      args.size());
+  }
+
+  auto& frame = _frames.back();
+  if (_nesting - frame.depth + depth > MAX_NESTING) {
+    return error::err(error::Code::RECURSION_LIMIT,
+                      "Function call exceeded maximum recursion depth");
+  }
+
+  _nesting = _nesting - frame.depth + depth;
+  frame.params = params;
+  frame.depth = depth;
+  _args.resize(frame.base);
+  _args.insert(_args.end(), args.begin(), args.end());
+
+  return error::ok<void>();
+}
+
+void
+EvalContext::pop_frame() noexcept
+{
+  _args.resize(_frames.back().base);
+  _nesting -= _frames.back().depth;
+  _frames.pop_back();
 }
 
 void
 EvalContext::update_with(const EvalContext& ctx)
 {
-  _vars.insert(ctx._vars.begin(), ctx._vars.end());
-  _funcs.insert(ctx._funcs.begin(), ctx._funcs.end());
+  for (SymbolId id = 0; id < ctx._globals.size(); ++id) {
+    if (ctx.defined(id) && !defined(id)) {
+      global(id, ctx._globals[id].value);
+    }
+  }
+  for (SymbolId id = 0; id < ctx._funcs.size(); ++id) {
+    if (ctx._funcs[id].fn && find_func(id) == nullptr) {
+      func(id, ctx._funcs[id].fn, ctx._funcs[id].info);
+    }
+  }
+}
+
+uint64_t
+EvalContext::Generation::_next() noexcept
+{
+  // 0 is never handed out so that empty caches never match
+  static auto counter = std::atomic<uint64_t>{ 1 };
+  return counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+error::Result<double>
+EvalContext::_undefined(SymbolId id)
+{
+  auto name = symbols().name(id);
+  return error::err(error::Code::UNDEFINED_VAR,
+                    "Undefined variable: %.*s",
+                    static_cast<int>(name.size()),
+                    name.data());
+}
+
+error::Result<std::reference_wrapper<const builtins::Function>>
+EvalContext::_fill(SymbolId id, std::size_t argc, ast::CallCache& cache) const
+{
+  auto func = unwrap_err(this->func(id));
+  ret_err(check_args(id, argc));
+
+  cache = { _generation.value(), &func.get() };
+
+  return func;
+}
+
+ast::Dependencies
+EvalContext::dependencies(SymbolId id) const
+{
+  auto result = ast::Dependencies{};
+  auto pending = std::vector<SymbolId>{ id };
+  result.calls.push_back(id);
+
+  while (!pending.empty()) {
+    auto current = pending.back();
+    pending.pop_back();
+
+    const auto* func = find_func(current);
+    if (func == nullptr) {
+      result.pure = false;
+      continue;
+    }
+
+    auto deps = ast::Dependencies{};
+    if (const auto* wrapper = func->target<builtins::FunctionWrapper>()) {
+      auto body = wrapper->node()->body();
+      auto visitor = ast::DependencyVisitor{ wrapper->node()->args(), deps };
+      // collecting never fails, the result is only for the visitor interface
+      static_cast<void>(visitor.visit(body));
+    } else if (const auto* flat =
+                 func->target<builtins::FlatFunctionWrapper>()) {
+      auto visitor = ast::FlatDependencyVisitor{ *flat->tree(), deps };
+      visitor.visit();
+    } else {
+      result.pure = result.pure && func_info(current)->pure;
+      continue;
+    }
+
+    result.pure = result.pure && deps.pure;
+    for (auto global : deps.globals) {
+      if (std::find(result.globals.begin(), result.globals.end(), global) ==
+          result.globals.end()) {
+        result.globals.push_back(global);
+      }
+    }
+    for (auto call : deps.calls) {
+      if (std::find(result.calls.begin(), result.calls.end(), call) ==
+          result.calls.end()) {
+        result.calls.push_back(call);
+        pending.push_back(call);
+      }
+    }
+  }
+
+  return result;
+}
+
+void
+EvalContext::memoize(std::size_t capacity)
+{
+  _memo_capacity = capacity == 0 ? 0 : std::bit_ceil(capacity);
+  _memos.clear();
+}
+
+MemoTable&
+EvalContext::_memo(SymbolId id, const void* owner, std::size_t argc)
+{
+  auto& table = _memos[id];
+  if (!table.matches(_generation.value(), owner)) {
+    // a body which is not the one defined under the symbol is never memoized
+    const auto* func = find_func(id);
+    const auto* defined = func != nullptr ? _body(*func) : nullptr;
+
+    auto deps = defined == owner ? dependencies(id) : ast::Dependencies{};
+    table.reset(_generation.value(),
+                owner,
+                defined == owner && deps.pure,
+                std::move(deps.globals),
+                argc,
+                _memo_capacity);
+  }
+
+  table.sync([this](SymbolId global) {
+    return global < _globals.size() ? _globals[global].value : 0;
+  });
+
+  return table;
+}
+
+const void*
+EvalContext::_body(const builtins::Function& func) noexcept
+{
+  if (const auto* wrapper = func.target<builtins::FunctionWrapper>()) {
+    return wrapper->node();
+  }
+  if (const auto* flat = func.target<builtins::FlatFunctionWrapper>()) {
+    return flat->tree().get();
+  }
+
+  return nullptr;
+}
+
+const double*
+EvalContext::_memo_find(SymbolId id,
+                        const void* owner,
+                        std::span<const double> args)
+{
+  auto& table = _memo(id, owner, args.size());
+  if (!table.pure()) {
+    return nullptr;
+  }
+
+  const auto* hit = table.find(args);
+  ++(hit != nullptr ? _memo_stats.hits : _memo_stats.misses);
+
+  return hit;
+}
+
+void
+EvalContext::_memo_store(SymbolId id,
+                         const void* owner,
+                         std::span<const double> args,
+                         double value)
+{
+  auto& table = _memo(id, owner, args.size());
+  if (table.pure()) {
+    table.insert(args, value);
+  }
 }
 
 Evaluator::Evaluator(const EvalContext& ctx)
   : _ctx{ ctx }
 {
-  _ctx.var("ans", 1);
+  _ctx.global(_ans, 1);
 }
 
 error::Result<double>
 Evaluator::eval(std::string_view input)
 {
-  auto node = unwrap_err(_parser.parse(input));
-
-  auto visitor = ast::EvalVisitor{ _ctx };
-  auto res = unwrap_err(visitor.visit(node));
-
-  _ctx.var("ans", res);
+  auto res = _eval(input);
+  _erase_temps();
+  if (res.has_value()) {
+    _ctx.global(_ans, res.value());
+  }
 
   return res;
 }
@@ -56,16 +410,135 @@ Evaluator::eval(std::string_view input)
 error::Result<std::vector<double>>
 Evaluator::eval_prog(std::string_view input)
 {
-  auto nodes = unwrap_err(_parser.parse(input));
-  auto visitor = ast::ProgramEvalVisitor{ _ctx };
+  auto res = _eval_prog(input);
+  _erase_temps();
+  if (res.has_value() && res.value().size() > 0) {
+    _ctx.global(_ans, res.value().back());
+  }
 
-  auto res = unwrap_err(visitor.visit(nodes));
+  return res;
+}
 
-  if (res.size() > 0) {
-    _ctx.var("ans", res.back());
+error::Result<double>
+Evaluator::_eval(std::string_view input)
+{
+  double res = 0;
+  if (_engine == Engine::VM) {
+    auto chunk = unwrap_err(_compile(input, false));
+    res = unwrap_err(_vm.run(*chunk, _ctx));
+  } else if (_engine == Engine::FLAT) {
+    auto root = unwrap_err(_flat_parser.parse(input, _flat));
+    auto resolver = ast::FlatResolveVisitor{ _flat, &_ctx };
+    ret_err(resolver.visit(root));
+    if (_passes.enabled(Pass::FOLD)) {
+      ast::FlatFoldVisitor{ _flat, &_ctx }.visit(root);
+    }
+    auto visitor = ast::FlatEvalVisitor{ _flat, _ctx };
+    res = unwrap_err(visitor.visit(root));
+  } else {
+    _arena.reset();
+    auto node = unwrap_err(_parser.parse(input, _arena));
+    auto resolver = ast::ResolveVisitor{ &_ctx };
+    ret_err(resolver.visit(node));
+    ret_err(_optimize(node));
+    auto visitor = ast::EvalVisitor{ _ctx };
+    res = unwrap_err(visitor.visit(node));
   }
 
   return res;
 }
 
+error::Result<std::vector<double>>
+Evaluator::_eval_prog(std::string_view input)
+{
+  auto res = std::vector<double>{};
+  if (_engine == Engine::VM) {
+    auto chunk = unwrap_err(_compile(input, true));
+    res = unwrap_err(_vm.run_prog(*chunk, _ctx));
+  } else if (_engine == Engine::FLAT) {
+    auto root = unwrap_err(_flat_parser.parse(input, _flat));
+    auto resolver = ast::FlatResolveVisitor{ _flat, &_ctx };
+    ret_err(resolver.visit(root));
+    if (_passes.enabled(Pass::FOLD)) {
+      ast::FlatFoldVisitor{ _flat, &_ctx }.visit(root);
+    }
+    auto visitor = ast::FlatProgramEvalVisitor{ _flat, _ctx };
+    res = unwrap_err(visitor.visit(root));
+  } else {
+    _arena.reset();
+    auto nodes = unwrap_err(_parser.parse(input, _arena));
+    auto resolver = ast::ResolveVisitor{ &_ctx };
+    ret_err(resolver.visit(nodes));
+    ret_err(_optimize(nodes));
+    auto visitor = ast::ProgramEvalVisitor{ _ctx };
+    res = unwrap_err(visitor.visit(nodes));
+  }
+
+  return res;
+}
+
+void
+Evaluator::_erase_temps()
+{
+  // temporaries hold values of one run only, never let the user see them
+  for (auto id : _passes.temps()) {
+    _ctx.erase(id);
+  }
+}
+
+error::Result<void>
+Evaluator::_optimize(ast::NodePtr<>& node)
+{
+  return _passes.run(node, _arena, _ctx);
+}
+
+error::Result<std::shared_ptr<const bytecode::Chunk>>
+Evaluator::_compile(std::string_view input, bool prog)
+{
+  // chunks hold folded constants, drop them once a constant changed
+  if (_constant_generation != _ctx.constant_generation()) {
+    _expr_chunks.clear();
+    _prog_chunks.clear();
+    _constant_generation = _ctx.constant_generation();
+  }
+
+  auto& cache = prog ? _prog_chunks : _expr_chunks;
+  if (auto chunk = cache.find(input); chunk != nullptr && _current(*chunk)) {
+    return chunk;
+  }
+
+  _arena.reset();
+  auto node = unwrap_err(_parser.parse(input, _arena));
+  auto resolver = ast::ResolveVisitor{ &_ctx };
+  ret_err(resolver.visit(node));
+  ret_err(_optimize(node));
+  auto compiled = unwrap_err(prog ? ast::ProgramCompileVisitor::compile(node)
+                                  : ast::CompileVisitor::compile(node));
+  for (const auto* func : _passes.inlined()) {
+    compiled.add_inlined({ func->arena(), func->node(), func->chunk() });
+  }
+  auto chunk = std::make_shared<const bytecode::Chunk>(std::move(compiled));
+
+  cache.insert(input, chunk);
+
+  return chunk;
+}
+
+bool
+Evaluator::_current(const bytecode::Chunk& chunk) const
+{
+  const auto& inlined = chunk.inlined();
+  return std::all_of(inlined.begin(),
+                     inlined.end(),
+                     [this](const bytecode::FunctionProto& proto) {
+                       const auto* func = _ctx.find_func(proto.node->symbol());
+                       const auto* wrapper =
+                         func != nullptr
+                           ? func->target<builtins::FunctionWrapper>()
+                           : nullptr;
+                       return wrapper != nullptr &&
+                              wrapper->node() == proto.node;
+                     });
+}
+
 }
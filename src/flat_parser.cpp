@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "tcalc/ast/flat.hpp"
+#include "tcalc/ast/node.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/parser.hpp"
+#include "tcalc/priority.hpp"
+#include "tcalc/token.hpp"
+
+namespace tcalc::ast {
+
+namespace {
+
+auto
+depth_error(std::size_t max_depth)
+{
+  return error::err(error::Code::RECURSION_LIMIT,
+                    "Expression exceeded maximum nesting depth %zu",
+                    max_depth);
+}
+
+}
+
+error::Result<FlatTree>
+FlatParser::parse(std::string_view input)
+{
+  auto tree = FlatTree{};
+  ret_err(parse(input, tree));
+
+  return error::ok<FlatTree>(std::move(tree));
+}
+
+error::Result<FlatIndex>
+FlatParser::parse(std::string_view input, FlatTree& tree)
+{
+  tree.clear();
+  auto ctx = unwrap_err(ParserContext::create(input));
+
+  return error::ok<FlatIndex>(unwrap_err(next_program(ctx, tree)));
+}
+
+// program : (statement)*
+error::Result<FlatIndex>
+FlatParser::next_program(ParserContext& ctx, FlatTree& tree)
+{
+  _statements.clear();
+
+  while (ctx.current().type != token::TokenType::EOI) {
+    auto stmt = unwrap_err(next_statement(ctx, tree));
+    _statements.push_back(stmt);
+  }
+
+  return error::ok<FlatIndex>(
+    tree.emit({ NodeType::PROGRAM, tree.add_list(_statements), 0, 0 }));
+}
+
+// statement : (expr | fdef | assign | import) SEMICOLON?
+error::Result<FlatIndex>
+FlatParser::next_statement(ParserContext& ctx, FlatTree& tree)
+{
+  FlatIndex node = 0;
+
+  if (ctx.current().type == token::TokenType::DEF) {
+    node = unwrap_err(next_fdef(ctx, tree));
+  } else if (ctx.current().type == token::TokenType::LET) {
+    node = unwrap_err(next_assign(ctx, tree));
+  } else if (ctx.current().type == token::TokenType::IMPORT) {
+    node = unwrap_err(next_import(ctx, tree));
+  } else {
+    node = unwrap_err(next_expr(ctx, tree));
+  }
+
+  if (ctx.current().type == token::TokenType::SEMICOLON) {
+    ret_err(ctx.eat(token::TokenType::SEMICOLON));
+  }
+
+  return error::ok<FlatIndex>(node);
+}
+
+TCALC_INLINE bool
+FlatParser::_open(ExprFrame frame)
+{
+  if (_frames.size() >= _max_depth) {
+    return false;
+  }
+
+  // binary operators already have their left operand
+  frame.base = _operands.size() - (frame.kind == ExprFrameKind::BINARY ? 1 : 0);
+  _frames.push_back(frame);
+
+  return true;
+}
+
+TCALC_INLINE bool
+FlatParser::_close(FlatTree& tree)
+{
+  auto frame = _frames.back();
+  _frames.pop_back();
+
+  switch (frame.kind) {
+    case ExprFrameKind::BINARY: {
+      auto right = _operands.back();
+      _operands.pop_back();
+      auto& left = _operands.back();
+      // chains such as `1 + 1 + 1` grow on the left and do not nest
+      left = { tree.emit({ frame.type, left.node, right.node, 0 }),
+               std::max(left.depth, right.depth + 1) };
+      break;
+    }
+    case ExprFrameKind::UNARY: {
+      auto& operand = _operands.back();
+      operand = { tree.emit({ frame.type, operand.node, 0, 0 }),
+                  operand.depth + 1 };
+      break;
+    }
+    case ExprFrameKind::CALL: {
+      auto depth = std::size_t{ 0 };
+      _args.clear();
+      for (auto i = frame.base; i < _operands.size(); ++i) {
+        _args.push_back(_operands[i].node);
+        depth = std::max(depth, _operands[i].depth);
+      }
+
+      auto node = tree.emit({ NodeType::FCALL,
+                              frame.symbol,
+                              tree.add_list(_args),
+                              tree.add_cache() });
+      _operands.resize(frame.base);
+      _operands.push_back({ node, depth + 1 });
+      break;
+    }
+    case ExprFrameKind::IF_ELSE: {
+      const auto* operands = _operands.data() + frame.base;
+      auto depth = std::max(
+        { operands[0].depth, operands[1].depth, operands[2].depth });
+
+      auto node = tree.emit({ NodeType::IF,
+                              operands[0].node,
+                              operands[1].node,
+                              operands[2].node });
+      _operands.resize(frame.base);
+      _operands.push_back({ node, depth + 1 });
+      break;
+    }
+    default:
+      return true;
+  }
+
+  return _operands.back().depth <= _max_depth;
+}
+
+// expr : if | prio_term
+// if : IF expr THEN expr ELSE expr
+// prio_term : factor (BINOP factor)*, climbing by operator priority
+// factor : NUMBER | idref | LPAREN expr RPAREN | UNARYOP factor
+// idref : IDENTIFIER | IDENTIFIER LPAREN (expr (COMMA expr)*)? RPAREN
+//
+// parsed with explicit stacks like Parser::next_expr
+error::Result<FlatIndex>
+FlatParser::next_expr(ParserContext& ctx, FlatTree& tree) // NOLINT
+{
+  _frames.clear();
+  _operands.clear();
+
+  // `if` may only start an expr, not a factor
+  auto expr_start = true;
+
+  while (true) {
+    auto current = ctx.current();
+
+    if (expr_start && current.type == token::TokenType::IF) {
+      ret_err(ctx.eat());
+      if (!_open({ ExprFrameKind::IF_COND })) {
+        return depth_error(_max_depth);
+      }
+      continue;
+    }
+    expr_start = false;
+
+    if (current.type == token::TokenType::NUMBER) {
+      // is number
+      auto value = tree.add_const(current.value);
+      _operands.push_back({ tree.emit({ NodeType::NUMBER, value, 0, 0 }), 1 });
+      ret_err(ctx.eat());
+    } else if (current.type == token::TokenType::IDENTIFIER) {
+      // is idref
+      ret_err(ctx.eat());
+      if (ctx.current().type != token::TokenType::LPAREN) {
+        _operands.push_back(
+          { tree.emit({ NodeType::VARREF, current.symbol, 0, 0 }), 1 });
+      } else {
+        ret_err(ctx.eat());
+        if (!_open({ ExprFrameKind::CALL, {}, 0, current.symbol })) {
+          return depth_error(_max_depth);
+        }
+        if (ctx.current().type != token::TokenType::RPAREN) {
+          expr_start = true;
+          continue;
+        }
+        ret_err(ctx.eat());
+        if (!_close(tree)) {
+          return depth_error(_max_depth);
+        }
+      }
+    } else if (current.type == token::TokenType::LPAREN) {
+      // is parenthesized expr
+      ret_err(ctx.eat());
+      if (!_open({ ExprFrameKind::PAREN })) {
+        return depth_error(_max_depth);
+      }
+      expr_start = true;
+      continue;
+    } else if (find_operator(UNARYOP_PRIORITY, current.type).valid) {
+      // is unary operator
+      ret_err(ctx.eat());
+      if (!_open({ ExprFrameKind::UNARY,
+                   find_operator(UNARYOP_PRIORITY, current.type).type })) {
+        return depth_error(_max_depth);
+      }
+      continue;
+    } else {
+      // syntax error
+      return error::err(error::Code::SYNTAX_ERROR,
+                        "Unexpected token %s at position %zu",
+                        token::TOKEN_TYPE_NAMES.at(current.type).c_str(),
+                        ctx.tokenizer().spos() - 1);
+    }
+
+    // an operand is finished, close every frame it completes
+    while (!expr_start) {
+      const auto& op = find_operator(BINOP_PRIORITY, ctx.current().type);
+      while (!_frames.empty() &&
+             (_frames.back().kind == ExprFrameKind::UNARY ||
+              (_frames.back().kind == ExprFrameKind::BINARY &&
+               (!op.valid || _frames.back().prio >= op.prio)))) {
+        if (!_close(tree)) {
+          return depth_error(_max_depth);
+        }
+      }
+
+      if (op.valid) {
+        ret_err(ctx.eat());
+        if (!_open({ ExprFrameKind::BINARY, op.type, op.prio })) {
+          return depth_error(_max_depth);
+        }
+        break;
+      }
+
+      if (_frames.empty()) {
+        return error::ok<FlatIndex>(_operands.back().node);
+      }
+
+      auto& frame = _frames.back();
+      switch (frame.kind) {
+        case ExprFrameKind::PAREN:
+          ret_err(ctx.eat(token::TokenType::RPAREN));
+          _frames.pop_back();
+          break;
+        case ExprFrameKind::CALL:
+          if (ctx.current().type != token::TokenType::RPAREN) {
+            ret_err(ctx.eat(token::TokenType::COMMA));
+            if (ctx.current().type != token::TokenType::RPAREN) {
+              expr_start = true;
+              break;
+            }
+          }
+          ret_err(ctx.eat(token::TokenType::RPAREN));
+          if (!_close(tree)) {
+            return depth_error(_max_depth);
+          }
+          break;
+        case ExprFrameKind::IF_COND:
+          ret_err(ctx.eat(token::TokenType::THEN));
+          frame.kind = ExprFrameKind::IF_THEN;
+          expr_start = true;
+          break;
+        case ExprFrameKind::IF_THEN:
+          ret_err(ctx.eat(token::TokenType::ELSE));
+          frame.kind = ExprFrameKind::IF_ELSE;
+          expr_start = true;
+          break;
+        default:
+          if (!_close(tree)) {
+            return depth_error(_max_depth);
+          }
+          break;
+      }
+    }
+  }
+}
+
+// assign : LET IDENTIFIER ASSIGN expr
+error::Result<FlatIndex>
+FlatParser::next_assign(ParserContext& ctx, FlatTree& tree)
+{
+  ret_err(ctx.eat(token::TokenType::LET));
+
+  auto name = ctx.current().symbol;
+
+  ret_err(ctx.eat(token::TokenType::IDENTIFIER));
+  ret_err(ctx.eat(token::TokenType::ASSIGN));
+  auto body = unwrap_err(next_expr(ctx, tree));
+
+  return error::ok<FlatIndex>(
+    tree.emit({ NodeType::VARASSIGN, name, body, 0 }));
+}
+
+// fdef : DEF IDENTIFIER LPAREN (IDENTIFIER (COMMA IDENTIFIER)*)? RPAREN expr
+error::Result<FlatIndex>
+FlatParser::next_fdef(ParserContext& ctx, FlatTree& tree)
+{
+  ret_err(ctx.eat(token::TokenType::DEF));
+
+  auto name = ctx.current().symbol;
+  ret_err(ctx.eat(token::TokenType::IDENTIFIER));
+
+  ret_err(ctx.eat(token::TokenType::LPAREN));
+
+  auto params = std::vector<FlatIndex>{};
+  while (ctx.current().type != token::TokenType::RPAREN) {
+    params.push_back(ctx.current().symbol);
+    ret_err(ctx.eat(token::TokenType::IDENTIFIER));
+    if (ctx.current().type != token::TokenType::RPAREN) {
+      ret_err(ctx.eat(token::TokenType::COMMA));
+    }
+  }
+
+  ret_err(ctx.eat(token::TokenType::RPAREN));
+
+  auto list = tree.add_list(params);
+  auto body = unwrap_err(next_expr(ctx, tree));
+
+  return error::ok<FlatIndex>(
+    tree.emit({ NodeType::FDEF, name, list, body }));
+}
+
+error::Result<FlatIndex>
+FlatParser::next_import(ParserContext& ctx, FlatTree& tree)
+{
+  ret_err(ctx.eat(token::TokenType::IMPORT));
+
+  auto path = ctx.current().symbol;
+  ret_err(ctx.eat(token::TokenType::IDENTIFIER));
+
+  return error::ok<FlatIndex>(tree.emit({ NodeType::IMPORT, path, 0, 0 }));
+}
+
+}
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "tcalc/memo.hpp"
+
+namespace tcalc {
+
+void
+MemoTable::reset(uint64_t generation,
+                 const void* owner,
+                 bool pure,
+                 std::vector<SymbolId> globals,
+                 std::size_t argc,
+                 std::size_t capacity)
+{
+  _generation = generation;
+  _owner = owner;
+  _pure = pure;
+  _globals = std::move(globals);
+  _snapshot.assign(_globals.size(), 0);
+  _argc = argc;
+
+  // impure functions never store anything
+  capacity = pure ? capacity : 0;
+  _keys.assign(capacity * argc, 0);
+  _values.assign(capacity, 0);
+  _used.assign(capacity, 0);
+}
+
+const double*
+MemoTable::find(std::span<const double> args) const noexcept
+{
+  if (_values.empty() || args.size() != _argc) {
+    return nullptr;
+  }
+
+  auto index = _index(args);
+  if (_used[index] == 0) {
+    return nullptr;
+  }
+
+  const auto* key = _keys.data() + (index * _argc);
+  for (std::size_t i = 0; i < _argc; ++i) {
+    if (std::bit_cast<uint64_t>(key[i]) != std::bit_cast<uint64_t>(args[i])) {
+      return nullptr;
+    }
+  }
+
+  return &_values[index];
+}
+
+void
+MemoTable::insert(std::span<const double> args, double value) noexcept
+{
+  if (_values.empty() || args.size() != _argc) {
+    return;
+  }
+
+  auto index = _index(args);
+  std::copy(args.begin(), args.end(), _keys.begin() + (index * _argc));
+  _values[index] = value;
+  _used[index] = 1;
+}
+
+void
+MemoTable::clear() noexcept
+{
+  std::fill(_used.begin(), _used.end(), 0);
+}
+
+std::size_t
+MemoTable::_index(std::span<const double> args) const noexcept
+{
+  // the bits of small integers differ only at the top, mix them down
+  auto hash = uint64_t{ 0x9e3779b97f4a7c15 };
+  for (auto arg : args) {
+    hash ^= std::bit_cast<uint64_t>(arg);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccd;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53;
+    hash ^= hash >> 33;
+  }
+
+  return hash & (_values.size() - 1);
+}
+
+}
@@ -1,13 +1,18 @@
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
-#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+#include "tcalc/ast/arena.hpp"
 #include "tcalc/ast/binaryop.hpp"
 #include "tcalc/ast/control_flow.hpp"
 #include "tcalc/ast/function.hpp"
 #include "tcalc/ast/node.hpp"
 #include "tcalc/ast/number.hpp"
 #include "tcalc/ast/program.hpp"
+#include "tcalc/ast/tree.hpp"
 #include "tcalc/ast/unaryop.hpp"
 #include "tcalc/ast/variable.hpp"
 #include "tcalc/error.hpp"
@@ -18,13 +23,34 @@
 
 namespace tcalc::ast {
 
+namespace {
+
+auto
+depth_error(std::size_t max_depth)
+{
+  return error::err(error::Code::RECURSION_LIMIT,
+                    "Expression exceeded maximum nesting depth %zu",
+                    max_depth);
+}
+
+}
+
+error::Result<ParserContext>
+ParserContext::create(std::string_view input, Arena& arena)
+{
+  auto tokenizer = token::Tokenizer{ input };
+  auto init_token = unwrap_err(tokenizer.next());
+
+  return ParserContext{ std::move(tokenizer), init_token, &arena };
+}
+
 error::Result<ParserContext>
 ParserContext::create(std::string_view input)
 {
   auto tokenizer = token::Tokenizer{ input };
   auto init_token = unwrap_err(tokenizer.next());
 
-  return ParserContext{ tokenizer, init_token };
+  return ParserContext{ std::move(tokenizer), init_token, nullptr };
 }
 
 error::Result<void>
@@ -51,10 +77,19 @@ ParserContext::eat()
   return error::ok<void>();
 }
 
-error::Result<NodePtr<>>
+error::Result<Tree>
 Parser::parse(std::string_view input)
 {
-  auto ctx = unwrap_err(ParserContext::create(input));
+  auto arena = Arena{};
+  auto root = unwrap_err(parse(input, arena));
+
+  return error::ok<Tree>(std::move(arena), root);
+}
+
+error::Result<NodePtr<>>
+Parser::parse(std::string_view input, Arena& arena)
+{
+  auto ctx = unwrap_err(ParserContext::create(input, arena));
 
   return error::ok<NodePtr<>>(unwrap_err(next_program(ctx)));
 }
@@ -63,96 +98,247 @@ Parser::parse(std::string_view input)
 error::Result<NodePtr<>>
 Parser::next_program(ParserContext& ctx)
 {
-  auto node = std::make_shared<ProgramNode>();
+  _statements.clear();
 
   while (ctx.current().type != token::TokenType::EOI) {
-    node->statements().push_back(unwrap_err(next_statement(ctx)));
+    auto stmt = unwrap_err(next_statement(ctx));
+    _statements.push_back(stmt);
   }
 
-  return error::ok<NodePtr<>>(node);
+  return error::ok<NodePtr<>>(
+    ctx.arena().make<ProgramNode>(ctx.arena().array(_statements)));
 }
 
-// program : expr | fdef | assign
+// statement : (expr | fdef | assign | import) SEMICOLON?
 error::Result<NodePtr<>>
 Parser::next_statement(ParserContext& ctx)
 {
-  if (ctx.current().type == token::TokenType::DEF) {
-    return next_fdef(ctx);
-  }
+  NodePtr<> node;
 
-  if (ctx.current().type == token::TokenType::LET) {
-    return next_assign(ctx);
+  if (ctx.current().type == token::TokenType::DEF) {
+    node = unwrap_err(next_fdef(ctx));
+  } else if (ctx.current().type == token::TokenType::LET) {
+    node = unwrap_err(next_assign(ctx));
+  } else if (ctx.current().type == token::TokenType::IMPORT) {
+    node = unwrap_err(next_import(ctx));
+  } else {
+    node = unwrap_err(next_expr(ctx));
   }
 
-  if (ctx.current().type == token::TokenType::IMPORT) {
-    return next_import(ctx);
+  if (ctx.current().type == token::TokenType::SEMICOLON) {
+    ret_err(ctx.eat(token::TokenType::SEMICOLON));
   }
 
-  return next_expr(ctx);
+  return error::ok<NodePtr<>>(node);
 }
 
-// expr : if | prio_term
-error::Result<NodePtr<>>
-Parser::next_expr(ParserContext& ctx)
+TCALC_INLINE bool
+Parser::_open(ExprFrame frame)
 {
-  if (ctx.current().type == token::TokenType::IF) {
-    return next_if(ctx);
+  if (_frames.size() >= _max_depth) {
+    return false;
   }
 
-  return next_prio_term(ctx, 0);
+  // binary operators already have their left operand
+  frame.base = _operands.size() - (frame.kind == ExprFrameKind::BINARY ? 1 : 0);
+  _frames.push_back(frame);
+
+  return true;
 }
 
-error::Result<NodePtr<>>
-Parser::next_prio_term(ParserContext& ctx, std::size_t prio)
+TCALC_INLINE bool
+Parser::_close(ParserContext& ctx)
 {
-  if (prio >= BINOP_PRIORITY.size()) {
-    return next_factor(ctx);
-  }
-
-  auto node = unwrap_err(next_prio_term(ctx, prio + 1));
-
-  while (BINOP_PRIORITY[prio].find(ctx.current().type) !=
-         BINOP_PRIORITY[prio].end()) {
-    auto type = ctx.current().type;
-    ret_err(ctx.eat());
-
-    node =
-      std::make_shared<BinaryOpNode>(BINOP_PRIORITY[prio].at(type),
-                                     node,
-                                     unwrap_err(next_prio_term(ctx, prio + 1)));
-
-    if (ctx.current().type == token::TokenType::SEMICOLON) {
-      if (prio == 0) {
-        ret_err(ctx.eat(token::TokenType::SEMICOLON));
-      }
-      return error::ok<NodePtr<>>(node);
+  auto frame = _frames.back();
+  _frames.pop_back();
+
+  switch (frame.kind) {
+    case ExprFrameKind::BINARY: {
+      auto right = _operands.back();
+      _operands.pop_back();
+      auto& left = _operands.back();
+      auto* node =
+        ctx.arena().make<BinaryOpNode>(frame.type, left.node, right.node);
+      // chains such as `1 + 1 + 1` grow on the left and are walked in a loop
+      left = { node, std::max(left.depth, right.depth + 1) };
+      break;
     }
-  }
+    case ExprFrameKind::UNARY: {
+      auto& operand = _operands.back();
+      auto* node = ctx.arena().make<UnaryOpNode>(frame.type, operand.node);
+      operand = { node, operand.depth + 1 };
+      break;
+    }
+    case ExprFrameKind::CALL: {
+      auto depth = std::size_t{ 0 };
+      _args.clear();
+      for (auto i = frame.base; i < _operands.size(); ++i) {
+        _args.push_back(_operands[i].node);
+        depth = std::max(depth, _operands[i].depth);
+      }
 
-  if (ctx.current().type == token::TokenType::SEMICOLON && prio == 0) {
-    ret_err(ctx.eat(token::TokenType::SEMICOLON));
+      auto* node =
+        ctx.arena().make<FcallNode>(frame.symbol, ctx.arena().array(_args));
+      _operands.resize(frame.base);
+      _operands.push_back({ node, depth + 1 });
+      break;
+    }
+    case ExprFrameKind::IF_ELSE: {
+      const auto* operands = _operands.data() + frame.base;
+      auto depth = std::max(
+        { operands[0].depth, operands[1].depth, operands[2].depth });
+
+      auto* node = ctx.arena().make<IfNode>(
+        operands[0].node, operands[1].node, operands[2].node);
+      _operands.resize(frame.base);
+      _operands.push_back({ node, depth + 1 });
+      break;
+    }
+    default:
+      return true;
   }
 
-  return error::ok<NodePtr<>>(node);
+  return _operands.back().depth <= _max_depth;
 }
 
+// expr : if | prio_term
 // if : IF expr THEN expr ELSE expr
+// prio_term : factor (BINOP factor)*, climbing by operator priority
+// factor : NUMBER | idref | LPAREN expr RPAREN | UNARYOP factor
+// idref : IDENTIFIER | IDENTIFIER LPAREN (expr (COMMA expr)*)? RPAREN
+//
+// open constructs are kept on `_frames` and finished subtrees on `_operands`,
+// so the native stack does not grow with the nesting of the input
 error::Result<NodePtr<>>
-Parser::next_if(ParserContext& ctx)
+Parser::next_expr(ParserContext& ctx) // NOLINT
 {
-  ret_err(ctx.eat(token::TokenType::IF));
+  _frames.clear();
+  _operands.clear();
 
-  auto node = std::make_shared<IfNode>();
+  // `if` may only start an expr, not a factor
+  auto expr_start = true;
 
-  node->cond(unwrap_err(next_expr(ctx)));
-  ret_err(ctx.eat(token::TokenType::THEN));
+  while (true) {
+    auto current = ctx.current();
 
-  node->then(unwrap_err(next_expr(ctx)));
-  ret_err(ctx.eat(token::TokenType::ELSE));
+    if (expr_start && current.type == token::TokenType::IF) {
+      ret_err(ctx.eat());
+      if (!_open({ ExprFrameKind::IF_COND })) {
+        return depth_error(_max_depth);
+      }
+      continue;
+    }
+    expr_start = false;
+
+    if (current.type == token::TokenType::NUMBER) {
+      // is number
+      _operands.push_back({ ctx.arena().make<NumberNode>(current.value), 1 });
+      ret_err(ctx.eat());
+    } else if (current.type == token::TokenType::IDENTIFIER) {
+      // is idref
+      ret_err(ctx.eat());
+      if (ctx.current().type != token::TokenType::LPAREN) {
+        _operands.push_back(
+          { ctx.arena().make<VarRefNode>(current.symbol), 1 });
+      } else {
+        ret_err(ctx.eat());
+        if (!_open({ ExprFrameKind::CALL, {}, 0, current.symbol })) {
+          return depth_error(_max_depth);
+        }
+        if (ctx.current().type != token::TokenType::RPAREN) {
+          expr_start = true;
+          continue;
+        }
+        ret_err(ctx.eat());
+        if (!_close(ctx)) {
+          return depth_error(_max_depth);
+        }
+      }
+    } else if (current.type == token::TokenType::LPAREN) {
+      // is parenthesized expr
+      ret_err(ctx.eat());
+      if (!_open({ ExprFrameKind::PAREN })) {
+        return depth_error(_max_depth);
+      }
+      expr_start = true;
+      continue;
+    } else if (find_operator(UNARYOP_PRIORITY, current.type).valid) {
+      // is unary operator
+      ret_err(ctx.eat());
+      if (!_open({ ExprFrameKind::UNARY,
+                   find_operator(UNARYOP_PRIORITY, current.type).type })) {
+        return depth_error(_max_depth);
+      }
+      continue;
+    } else {
+      // syntax error
+      return error::err(error::Code::SYNTAX_ERROR,
+                        "Unexpected token %s at position %zu",
+                        token::TOKEN_TYPE_NAMES.at(current.type).c_str(),
+                        ctx.tokenizer().spos() - 1);
+    }
+
+    // an operand is finished, close every frame it completes
+    while (!expr_start) {
+      const auto& op = find_operator(BINOP_PRIORITY, ctx.current().type);
+      while (!_frames.empty() &&
+             (_frames.back().kind == ExprFrameKind::UNARY ||
+              (_frames.back().kind == ExprFrameKind::BINARY &&
+               (!op.valid || _frames.back().prio >= op.prio)))) {
+        if (!_close(ctx)) {
+          return depth_error(_max_depth);
+        }
+      }
 
-  node->else_(unwrap_err(next_expr(ctx)));
+      if (op.valid) {
+        ret_err(ctx.eat());
+        if (!_open({ ExprFrameKind::BINARY, op.type, op.prio })) {
+          return depth_error(_max_depth);
+        }
+        break;
+      }
 
-  return error::ok<NodePtr<>>(node);
+      if (_frames.empty()) {
+        return error::ok<NodePtr<>>(_operands.back().node);
+      }
+
+      auto& frame = _frames.back();
+      switch (frame.kind) {
+        case ExprFrameKind::PAREN:
+          ret_err(ctx.eat(token::TokenType::RPAREN));
+          _frames.pop_back();
+          break;
+        case ExprFrameKind::CALL:
+          if (ctx.current().type != token::TokenType::RPAREN) {
+            ret_err(ctx.eat(token::TokenType::COMMA));
+            if (ctx.current().type != token::TokenType::RPAREN) {
+              expr_start = true;
+              break;
+            }
+          }
+          ret_err(ctx.eat(token::TokenType::RPAREN));
+          if (!_close(ctx)) {
+            return depth_error(_max_depth);
+          }
+          break;
+        case ExprFrameKind::IF_COND:
+          ret_err(ctx.eat(token::TokenType::THEN));
+          frame.kind = ExprFrameKind::IF_THEN;
+          expr_start = true;
+          break;
+        case ExprFrameKind::IF_THEN:
+          ret_err(ctx.eat(token::TokenType::ELSE));
+          frame.kind = ExprFrameKind::IF_ELSE;
+          expr_start = true;
+          break;
+        default:
+          if (!_close(ctx)) {
+            return depth_error(_max_depth);
+          }
+          break;
+      }
+    }
+  }
 }
 
 // assign : LET IDENTIFIER ASSIGN expr
@@ -161,7 +347,7 @@ Parser::next_assign(ParserContext& ctx)
 {
   ret_err(ctx.eat(token::TokenType::LET));
 
-  auto node = std::make_shared<VarAssignNode>(ctx.current().text);
+  auto* node = ctx.arena().make<VarAssignNode>(ctx.current().symbol);
 
   ret_err(ctx.eat(token::TokenType::IDENTIFIER));
   ret_err(ctx.eat(token::TokenType::ASSIGN));
@@ -170,87 +356,20 @@ Parser::next_assign(ParserContext& ctx)
   return error::ok<NodePtr<>>(node);
 }
 
-// factor : NUMBER |
-//          idref |
-//          LPAREN expr RPAREN |
-//          MINUS factor |
-//          PLUS factor
-error::Result<NodePtr<>>
-Parser::next_factor(ParserContext& ctx) // NOLINT
-{
-  auto current = ctx.current();
-  NodePtr<> node;
-
-  if (current.type == token::TokenType::NUMBER) {
-    // is number
-    node = std::make_shared<NumberNode>(std::stod(current.text));
-    ret_err(ctx.eat(token::TokenType::NUMBER));
-  } else if (current.type == token::TokenType::IDENTIFIER) {
-    // is idref
-    node = unwrap_err(next_idref(ctx));
-  } else if (current.type == token::TokenType::LPAREN) {
-    // is parenthesized expr
-    ret_err(ctx.eat(token::TokenType::LPAREN));
-    node = unwrap_err(next_expr(ctx));
-    ret_err(ctx.eat(token::TokenType::RPAREN));
-  } else if (UNARYOP_PRIORITY[0].find(current.type) !=
-             UNARYOP_PRIORITY[0].end()) {
-    auto type = current.type;
-    ret_err(ctx.eat(type));
-    node = std::make_shared<UnaryOpNode>(UNARYOP_PRIORITY[0].at(type),
-                                         unwrap_err(next_factor(ctx)));
-  } else {
-    // syntax error
-    return error::err(error::Code::SYNTAX_ERROR,
-                      "Unexpected token %s at position %zu",
-                      token::TOKEN_TYPE_NAMES.at(current.type).c_str(),
-                      ctx.tokenizer().spos() - 1);
-  }
-
-  return error::ok<NodePtr<>>(node);
-}
-
-// idref : VARREF | FCALL
-error::Result<NodePtr<>>
-Parser::next_idref(ParserContext& ctx)
-{
-  auto id = ctx.current().text;
-
-  ret_err(ctx.eat(token::TokenType::IDENTIFIER));
-
-  if (ctx.current().type != token::TokenType::LPAREN) {
-    return error::ok<NodePtr<>>(std::make_shared<VarRefNode>(id));
-  }
-
-  ret_err(ctx.eat(token::TokenType::LPAREN));
-
-  auto fnode = std::make_shared<FcallNode>(id);
-  while (ctx.current().type != token::TokenType::RPAREN) {
-    fnode->push_arg(unwrap_err(next_expr(ctx)));
-    if (ctx.current().type != token::TokenType::RPAREN) {
-      ret_err(ctx.eat(token::TokenType::COMMA));
-    }
-  }
-
-  ret_err(ctx.eat(token::TokenType::RPAREN));
-
-  return error::ok<NodePtr<>>(fnode);
-}
-
 // fdef : DEF IDENTIFIER LPAREN (IDENTIFIER (COMMA IDENTIFIER)*)? RPAREN expr
 error::Result<NodePtr<>>
 Parser::next_fdef(ParserContext& ctx)
 {
   ret_err(ctx.eat(token::TokenType::DEF));
 
-  auto id = ctx.current().text;
+  auto id = ctx.current().symbol;
   ret_err(ctx.eat(token::TokenType::IDENTIFIER));
 
   ret_err(ctx.eat(token::TokenType::LPAREN));
 
-  auto fnode = std::make_shared<FdefNode>(id);
+  auto args = std::vector<SymbolId>{};
   while (ctx.current().type != token::TokenType::RPAREN) {
-    fnode->push_arg(ctx.current().text);
+    args.push_back(ctx.current().symbol);
     ret_err(ctx.eat(token::TokenType::IDENTIFIER));
     if (ctx.current().type != token::TokenType::RPAREN) {
       ret_err(ctx.eat(token::TokenType::COMMA));
@@ -259,6 +378,8 @@ Parser::next_fdef(ParserContext& ctx)
 
   ret_err(ctx.eat(token::TokenType::RPAREN));
 
+  auto* fnode =
+    ctx.arena().make<FdefNode>(id, ctx.arena().array(args), nullptr);
   fnode->body(unwrap_err(next_expr(ctx)));
 
   return error::ok<NodePtr<>>(fnode);
@@ -269,7 +390,8 @@ Parser::next_import(ParserContext& ctx)
 {
   ret_err(ctx.eat(token::TokenType::IMPORT));
 
-  auto node = std::make_shared<ProgramImportNode>(ctx.current().text);
+  auto* node =
+    ctx.arena().make<ProgramImportNode>(ctx.arena().str(ctx.current().text));
   ret_err(ctx.eat(token::TokenType::IDENTIFIER));
 
   return error::ok<NodePtr<>>(node);
@@ -0,0 +1,101 @@
+#include <chrono>
+
+#include "tcalc/error.hpp"
+#include "tcalc/eval.hpp"
+#include "tcalc/pipeline.hpp"
+#include "tcalc/visitor/children.hpp"
+#include "tcalc/visitor/fold.hpp"
+#include "tcalc/visitor/poly.hpp"
+#include "tcalc/visitor/simplify.hpp"
+
+namespace tcalc {
+
+PassManager::PassManager()
+{
+  level(OptLevel::O2);
+}
+
+void
+PassManager::level(OptLevel level) noexcept
+{
+  _level = level;
+  _enabled.fill(level == OptLevel::O2);
+
+  // local rewrites pay off even for inputs which run once
+  if (level == OptLevel::O1) {
+    enable(Pass::FOLD, true);
+    enable(Pass::SIMPLIFY, true);
+  }
+}
+
+error::Result<void>
+PassManager::run(ast::NodePtr<>& node,
+                 ast::Arena& arena,
+                 EvalContext& ctx)
+{
+  _deep = ast::deeper_than(node, MAX_DEPTH);
+  if (_deep) {
+    return error::ok<void>();
+  }
+
+  if (_begin(Pass::INLINE, node)) {
+    _inline.run(node, arena, ctx, _inline_budget);
+    _end(Pass::INLINE, node);
+  }
+
+  if (_begin(Pass::FOLD, node)) {
+    auto folder = ast::FoldVisitor{ arena, &ctx };
+    node = unwrap_err(folder.visit(node));
+    _end(Pass::FOLD, node);
+  }
+
+  if (_begin(Pass::SIMPLIFY, node)) {
+    auto simplifier = ast::SimplifyVisitor{ arena, &ctx, _fast_math };
+    node = unwrap_err(simplifier.visit(node));
+    _end(Pass::SIMPLIFY, node);
+  }
+
+  if (_fast_math && _begin(Pass::POLY, node)) {
+    auto poly = ast::PolyVisitor{ arena };
+    node = unwrap_err(poly.visit(node));
+    _end(Pass::POLY, node);
+  }
+
+  if (_begin(Pass::CSE, node)) {
+    _cse.run(node, arena, ctx);
+    _end(Pass::CSE, node);
+  }
+
+  return error::ok<void>();
+}
+
+bool
+PassManager::_begin(Pass pass, ast::NodePtr<> node)
+{
+  if (!enabled(pass)) {
+    return false;
+  }
+
+  if (_collect) {
+    _stats[static_cast<std::size_t>(pass)].nodes_before +=
+      ast::tree_size(node);
+    _start = std::chrono::steady_clock::now();
+  }
+
+  return true;
+}
+
+void
+PassManager::_end(Pass pass, ast::NodePtr<> node)
+{
+  if (!_collect) {
+    return;
+  }
+
+  auto& stats = _stats[static_cast<std::size_t>(pass)];
+  stats.time += std::chrono::steady_clock::now() - _start;
+  stats.nodes_after += ast::tree_size(node);
+  ++stats.runs;
+}
+
+}
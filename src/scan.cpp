@@ -0,0 +1,195 @@
+#include <bit>
+#include <cstdint>
+
+#include "tcalc/scan.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TCALC_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace tcalc::token {
+
+namespace {
+
+template<uint8_t Class>
+const char*
+skip_scalar(const char* begin, const char* end)
+{
+  while (begin != end && is_class(*begin, Class)) {
+    ++begin;
+  }
+  return begin;
+}
+
+#ifdef TCALC_SCAN_X86
+
+/**
+ * @brief Byte wise `lo <= v <= hi` for unsigned bytes, SSE2 only has signed
+ * compares so the range is shifted to start at INT8_MIN.
+ */
+__m128i
+in_range_sse2(__m128i v, char lo, char hi)
+{
+  auto shifted = _mm_add_epi8(_mm_sub_epi8(v, _mm_set1_epi8(lo)),
+                              _mm_set1_epi8(static_cast<char>(0x80)));
+  return _mm_cmplt_epi8(
+    shifted, _mm_set1_epi8(static_cast<char>(0x80 + (hi - lo) + 1)));
+}
+
+template<uint8_t Class>
+__m128i
+match_sse2(__m128i v)
+{
+  auto res = _mm_setzero_si128();
+  if constexpr ((Class & CHAR_SPACE) != 0) {
+    res = _mm_or_si128(res, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    res = _mm_or_si128(res, in_range_sse2(v, '\t', '\r'));
+  }
+  if constexpr ((Class & CHAR_DIGIT) != 0) {
+    res = _mm_or_si128(res, in_range_sse2(v, '0', '9'));
+  }
+  if constexpr ((Class & CHAR_ALPHA) != 0) {
+    auto lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    res = _mm_or_si128(res, in_range_sse2(lower, 'a', 'z'));
+    res = _mm_or_si128(res, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+  }
+  return res;
+}
+
+template<uint8_t Class>
+const char*
+skip_sse2(const char* begin, const char* end)
+{
+  while (end - begin >= 16) {
+    auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    auto mask =
+      static_cast<uint32_t>(_mm_movemask_epi8(match_sse2<Class>(v))) ^ 0xFFFF;
+    if (mask != 0) {
+      return begin + std::countr_zero(mask);
+    }
+    begin += 16;
+  }
+  return skip_scalar<Class>(begin, end);
+}
+
+__attribute__((target("avx2"))) __m256i
+in_range_avx2(__m256i v, char lo, char hi)
+{
+  auto shifted = _mm256_add_epi8(_mm256_sub_epi8(v, _mm256_set1_epi8(lo)),
+                                 _mm256_set1_epi8(static_cast<char>(0x80)));
+  return _mm256_cmpgt_epi8(
+    _mm256_set1_epi8(static_cast<char>(0x80 + (hi - lo) + 1)), shifted);
+}
+
+template<uint8_t Class>
+__attribute__((target("avx2"))) __m256i
+match_avx2(__m256i v)
+{
+  auto res = _mm256_setzero_si256();
+  if constexpr ((Class & CHAR_SPACE) != 0) {
+    res = _mm256_or_si256(res, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+    res = _mm256_or_si256(res, in_range_avx2(v, '\t', '\r'));
+  }
+  if constexpr ((Class & CHAR_DIGIT) != 0) {
+    res = _mm256_or_si256(res, in_range_avx2(v, '0', '9'));
+  }
+  if constexpr ((Class & CHAR_ALPHA) != 0) {
+    auto lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    res = _mm256_or_si256(res, in_range_avx2(lower, 'a', 'z'));
+    res = _mm256_or_si256(res, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+  }
+  return res;
+}
+
+template<uint8_t Class>
+__attribute__((target("avx2"))) const char*
+skip_avx2(const char* begin, const char* end)
+{
+  while (end - begin >= 32) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    auto mask = ~static_cast<uint32_t>(
+      _mm256_movemask_epi8(match_avx2<Class>(v)));
+    if (mask != 0) {
+      return begin + std::countr_zero(mask);
+    }
+    begin += 32;
+  }
+  return skip_sse2<Class>(begin, end);
+}
+
+#endif
+
+constexpr ScanKernels SCALAR_KERNELS = {
+  skip_scalar<CHAR_SPACE>,
+  skip_scalar<CHAR_DIGIT>,
+  skip_scalar<CHAR_IDENT>,
+}; /**< Scalar kernels. */
+
+#ifdef TCALC_SCAN_X86
+
+constexpr ScanKernels SSE2_KERNELS = {
+  skip_sse2<CHAR_SPACE>,
+  skip_sse2<CHAR_DIGIT>,
+  skip_sse2<CHAR_IDENT>,
+}; /**< SSE2 kernels. */
+
+constexpr ScanKernels AVX2_KERNELS = {
+  skip_avx2<CHAR_SPACE>,
+  skip_avx2<CHAR_DIGIT>,
+  skip_avx2<CHAR_IDENT>,
+}; /**< AVX2 kernels. */
+
+#endif
+
+ScanLevel
+detect_scan_level() noexcept
+{
+#ifdef TCALC_SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return ScanLevel::AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return ScanLevel::SSE2;
+  }
+#endif
+  return ScanLevel::SCALAR;
+}
+
+}
+
+ScanLevel
+scan_level() noexcept
+{
+  static const auto level = detect_scan_level();
+  return level;
+}
+
+const ScanKernels&
+scan_kernels(ScanLevel level) noexcept
+{
+  if (level > scan_level()) {
+    level = scan_level();
+  }
+
+  switch (level) {
+#ifdef TCALC_SCAN_X86
+    case ScanLevel::AVX2:
+      return AVX2_KERNELS;
+    case ScanLevel::SSE2:
+      return SSE2_KERNELS;
+#endif
+    default:
+      return SCALAR_KERNELS;
+  }
+}
+
+const ScanKernels&
+scan_kernels() noexcept
+{
+  static const auto& kernels = scan_kernels(scan_level());
+  return kernels;
+}
+
+}
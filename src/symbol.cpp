@@ -0,0 +1,68 @@
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "tcalc/symbol.hpp"
+
+namespace tcalc {
+
+SymbolTable::SymbolTable()
+{
+  // id 0 is never handed out so it can mark unresolved names
+  _names.emplace_back();
+
+  // temporaries are named but never looked up by name
+  for (SymbolId i = 0; i < TEMP_COUNT; ++i) {
+    _names.emplace_back("$t" + std::to_string(i));
+  }
+}
+
+SymbolId
+SymbolTable::intern(std::string_view name)
+{
+  auto lock = std::lock_guard{ _mutex };
+  if (auto it = _ids.find(name); it != _ids.end()) {
+    return it->second;
+  }
+
+  auto id = static_cast<SymbolId>(_names.size());
+  const auto& stored = _names.emplace_back(name);
+  _ids.emplace(stored, id);
+
+  return id;
+}
+
+SymbolId
+SymbolTable::find(std::string_view name) const
+{
+  auto lock = std::lock_guard{ _mutex };
+  if (auto it = _ids.find(name); it != _ids.end()) {
+    return it->second;
+  }
+
+  return NO_SYMBOL;
+}
+
+std::string_view
+SymbolTable::name(SymbolId id) const
+{
+  auto lock = std::lock_guard{ _mutex };
+  return _names[id];
+}
+
+std::size_t
+SymbolTable::size() const
+{
+  auto lock = std::lock_guard{ _mutex };
+  return _names.size();
+}
+
+SymbolTable&
+symbols() noexcept
+{
+  static auto table = SymbolTable{};
+  return table;
+}
+
+}
@@ -1,6 +1,11 @@
-#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
 
 #include "tcalc/error.hpp"
+#include "tcalc/scan.hpp"
+#include "tcalc/symbol.hpp"
 #include "tcalc/token.hpp"
 #include "tcalc/tokenizer.hpp"
 
@@ -9,36 +14,52 @@ namespace tcalc::token {
 error::Result<Token>
 Tokenizer::next()
 {
-  _skip_with(_is_skippable_char);
+  _pos = _scan->skip_space(_pos, _input.end());
 
   if (_pos >= _input.end()) {
     return Token{ TokenType::EOI, "" };
   }
 
-  if (std::iscntrl(*_pos)) {
+  switch (LEAD_TABLE[static_cast<unsigned char>(*_pos)]) {
+    case Lead::OPERATOR:
+      return _parse_operator();
+    case Lead::DIGIT:
+      return _parse_number();
+    case Lead::IDENTIFIER:
+      return _parse_identifier();
+    case Lead::QUOTE:
+      return _parse_quoted_identifier();
+    default:
+      break;
+  }
+
+  if (static_cast<unsigned char>(*_pos) < 0x20 || *_pos == 0x7f) {
     return error::err(error::Code::SYNTAX_ERROR,
                       "Unexpected control character '%c', index: %zu",
                       *_pos,
                       std::distance(_input.cbegin(), _pos));
   }
 
-  for (const auto& [key, value] : KEYWORDS) {
-    if (_is_keyword(key)) {
-      _pos += key.size();
-      return Token{ value, std::string{ key } };
-    }
-  }
+  return error::err(error::Code::SYNTAX_ERROR,
+                    "Unexpected character '%c', index: %zu",
+                    *_pos,
+                    std::distance(_input.cbegin(), _pos));
+}
 
-  if (std::isdigit(*_pos)) {
-    return _parse_number();
-  }
+error::Result<Token>
+Tokenizer::_parse_operator()
+{
+  const auto& rule = OPERATOR_TABLE[static_cast<unsigned char>(*_pos)];
+  const auto* start = _pos;
 
-  if (*_pos == QUOTE) {
-    return _parse_quoted_identifier();
+  if (rule.second != 0 && _pos + 1 < _input.end() && _pos[1] == rule.second) {
+    _pos += 2;
+    return Token{ rule.pair, std::string_view{ start, _pos } };
   }
 
-  if (_is_first_identifier_char(*_pos)) {
-    return _next_with(TokenType::IDENTIFIER, _is_identifier_char);
+  if (rule.has_single) {
+    ++_pos;
+    return Token{ rule.single, std::string_view{ start, _pos } };
   }
 
   return error::err(error::Code::SYNTAX_ERROR,
@@ -47,35 +68,128 @@ Tokenizer::next()
                     std::distance(_input.cbegin(), _pos));
 }
 
+Token
+Tokenizer::_parse_identifier()
+{
+  const auto* start = _pos;
+  _pos = _scan->skip_ident(_pos, _input.end());
+  auto token = Token{ TokenType::IDENTIFIER, std::string_view{ start, _pos } };
+
+  for (const auto& [key, value] : KEYWORDS) {
+    if (token.text == key) {
+      token.type = value;
+      return token;
+    }
+  }
+
+  token.symbol = symbols().intern(token.text);
+
+  return token;
+}
+
 error::Result<Token>
 Tokenizer::_parse_number()
 {
-  // accept number with dot
   const auto* start = _pos;
-  _skip_with(isdigit);
+  auto format = std::chars_format::general;
+  auto digit = CHAR_DIGIT;
+  auto exponent = 'e';
+
+  // hex-float: 0x mantissa with an optional binary exponent
+  if (*_pos == '0' && _pos + 1 < _input.end() &&
+      (_pos[1] == 'x' || _pos[1] == 'X')) {
+    _pos += 2;
+    format = std::chars_format::hex;
+    digit = CHAR_XDIGIT;
+    exponent = 'p';
+  }
+
+  const auto* mantissa = _pos;
+  _skip_digits(digit);
   if (_pos != _input.end() && *_pos == '.') {
     ++_pos;
 
-    if (_pos != _input.end() && isdigit(*_pos)) {
-      _skip_with(isdigit);
-    } else {
-      return error::err(error::Code::SYNTAX_ERROR,
-                        "Unexpected character '%c', index: %zu",
-                        *_pos,
-                        std::distance(_input.cbegin(), _pos));
+    if (_pos == _input.end() || !is_class(*_pos, digit)) {
+      return _unexpected_char();
     }
+    _skip_digits(digit);
   }
 
-  return Token{ TokenType::NUMBER, std::string{ start, _pos } };
+  if (_pos == mantissa) {
+    return _unexpected_char();
+  }
+
+  // the exponent is only taken if digits follow, `2e` stays NUMBER IDENTIFIER
+  if (_pos != _input.end() && (*_pos | 0x20) == exponent) {
+    const auto* sign = _pos + 1;
+    if (sign != _input.end() && (*sign == '+' || *sign == '-')) {
+      ++sign;
+    }
+
+    if (sign != _input.end() && is_class(*sign, CHAR_DIGIT)) {
+      _pos = sign;
+      _skip_digits(CHAR_DIGIT);
+    }
+  }
+
+  auto value = 0.0;
+  auto [ptr, ec] = std::from_chars(mantissa, _pos, value, format);
+  if (ec != std::errc{} || ptr != _pos) {
+    return error::err(error::Code::SYNTAX_ERROR,
+                      "Number out of range, index: %zu",
+                      std::distance(_input.cbegin(), start));
+  }
+
+  return Token{ TokenType::NUMBER, std::string_view{ start, _pos }, value };
+}
+
+void
+Tokenizer::_skip_digits(uint8_t cls) noexcept
+{
+  if (cls == CHAR_DIGIT) {
+    _pos = _scan->skip_digit(_pos, _input.end());
+    return;
+  }
+
+  while (_pos != _input.end() && is_class(*_pos, cls)) {
+    ++_pos;
+  }
 }
 
 error::Result<Token>
-Tokenizer::_parse_quoted_identifier()
+Tokenizer::_unexpected_char() const
 {
-  auto text = std::string{};
+  if (_pos == _input.end()) {
+    return error::err(error::Code::SYNTAX_ERROR,
+                      "Unexpected end of input, index: %zu",
+                      std::distance(_input.cbegin(), _pos));
+  }
 
+  return error::err(error::Code::SYNTAX_ERROR,
+                    "Unexpected character '%c', index: %zu",
+                    *_pos,
+                    std::distance(_input.cbegin(), _pos));
+}
+
+error::Result<Token>
+Tokenizer::_parse_quoted_identifier()
+{
   ++_pos;
 
+  // unescaped identifiers are referenced in place
+  const auto* start = _pos;
+  while (_pos < _input.end() && *_pos != QUOTE && *_pos != '\\') {
+    ++_pos;
+  }
+
+  if (_pos < _input.end() && *_pos == QUOTE) {
+    auto text = std::string_view{ start, _pos };
+    ++_pos;
+    return Token{ TokenType::IDENTIFIER, text, 0, symbols().intern(text) };
+  }
+
+  auto& text = _escapes.emplace_front(start, _pos);
+
   while (_pos < _input.end() && *_pos != QUOTE) {
     if (*_pos == '\\') {
       ++_pos;
@@ -97,39 +211,7 @@ Tokenizer::_parse_quoted_identifier()
 
   ++_pos;
 
-  return Token{ TokenType::IDENTIFIER, text };
-}
-
-bool
-Tokenizer::_is_keyword(std::string_view keyword)
-{
-  if (_pos + keyword.size() > _input.end()) {
-    return false;
-  }
-
-  if (std::string_view{ _pos, keyword.size() } == keyword) {
-    return true;
-  }
-
-  return false;
-}
-
-bool
-Tokenizer::_is_identifier_char(char c)
-{
-  return std::isalnum(c) || c == '_';
-}
-
-bool
-Tokenizer::_is_first_identifier_char(char c)
-{
-  return std::isalpha(c) || c == '_';
-}
-
-bool
-Tokenizer::_is_skippable_char(char c)
-{
-  return std::isspace(c) || c == '\n' || c == '\t';
+  return Token{ TokenType::IDENTIFIER, text, 0, symbols().intern(text) };
 }
 
 }
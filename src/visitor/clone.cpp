@@ -0,0 +1,123 @@
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "tcalc/error.hpp"
+#include "tcalc/visitor/children.hpp"
+#include "tcalc/visitor/clone.hpp"
+
+namespace tcalc::ast {
+
+error::Result<NodePtr<>>
+CloneVisitor::visit_bin_op(NodePtr<BinaryOpNode>& node)
+{
+  auto spine = Spine{ node };
+  auto clone = unwrap_err(visit(spine.leaf()));
+  for (std::size_t i = 0; i < spine.size(); ++i) {
+    auto right = unwrap_err(visit(spine[i]->right()));
+    clone = _arena->make<BinaryOpNode>(spine[i]->type(), clone, right);
+  }
+
+  return error::ok<NodePtr<>>(clone);
+}
+
+error::Result<NodePtr<>>
+CloneVisitor::visit_unary_op(NodePtr<UnaryOpNode>& node)
+{
+  auto operand = unwrap_err(visit(node->operand()));
+
+  return error::ok<NodePtr<>>(
+    _arena->make<UnaryOpNode>(node->type(), operand));
+}
+
+error::Result<NodePtr<>>
+CloneVisitor::visit_number(NodePtr<NumberNode>& node)
+{
+  return error::ok<NodePtr<>>(_arena->make<NumberNode>(node->value()));
+}
+
+error::Result<NodePtr<>>
+CloneVisitor::visit_varref(NodePtr<VarRefNode>& node)
+{
+  auto* clone = _arena->make<VarRefNode>(node->symbol());
+  clone->binding(node->binding());
+
+  return error::ok<NodePtr<>>(clone);
+}
+
+error::Result<NodePtr<>>
+CloneVisitor::visit_varassign(NodePtr<VarAssignNode>& node)
+{
+  auto body = unwrap_err(visit(node->body()));
+
+  return error::ok<NodePtr<>>(
+    _arena->make<VarAssignNode>(node->symbol(), body));
+}
+
+error::Result<NodePtr<>>
+CloneVisitor::visit_fcall(NodePtr<FcallNode>& node)
+{
+  auto args = std::vector<NodePtr<>>{};
+  args.reserve(node->args().size());
+  for (auto& arg : node->args()) {
+    args.push_back(unwrap_err(visit(arg)));
+  }
+
+  return error::ok<NodePtr<>>(
+    _arena->make<FcallNode>(node->symbol(), _arena->array(args)));
+}
+
+error::Result<NodePtr<>>
+CloneVisitor::visit_fdef(NodePtr<FdefNode>& node)
+{
+  auto body = unwrap_err(visit(node->body()));
+  auto args = _arena->array<SymbolId>(node->args());
+
+  return error::ok<NodePtr<>>(
+    _arena->make<FdefNode>(node->symbol(), args, body));
+}
+
+error::Result<NodePtr<>>
+CloneVisitor::visit_if(NodePtr<IfNode>& node)
+{
+  auto cond = unwrap_err(visit(node->cond()));
+  auto then = unwrap_err(visit(node->then()));
+  auto else_ = unwrap_err(visit(node->else_()));
+
+  return error::ok<NodePtr<>>(_arena->make<IfNode>(cond, then, else_));
+}
+
+error::Result<NodePtr<>>
+CloneVisitor::visit_program(NodePtr<ProgramNode>& node)
+{
+  auto stmts = std::vector<NodePtr<>>{};
+  stmts.reserve(node->statements().size());
+  for (auto& stmt : node->statements()) {
+    stmts.push_back(unwrap_err(visit(stmt)));
+  }
+
+  return error::ok<NodePtr<>>(_arena->make<ProgramNode>(_arena->array(stmts)));
+}
+
+error::Result<NodePtr<>>
+CloneVisitor::visit_import(NodePtr<ProgramImportNode>& node)
+{
+  return error::ok<NodePtr<>>(
+    _arena->make<ProgramImportNode>(_arena->str(node->path())));
+}
+
+error::Result<NodePtr<>>
+CloneVisitor::visit_poly(NodePtr<PolyNode>& node)
+{
+  auto var = unwrap_err(visit(node->var()));
+  auto coeffs = std::vector<NodePtr<>>{};
+  coeffs.reserve(node->coeffs().size());
+  for (auto& coeff : node->coeffs()) {
+    coeffs.push_back(unwrap_err(visit(coeff)));
+  }
+
+  return error::ok<NodePtr<>>(
+    _arena->make<PolyNode>(var, _arena->array(coeffs)));
+}
+
+}
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "tcalc/ast/arena.hpp"
+#include "tcalc/ast/variable.hpp"
+#include "tcalc/bytecode.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/visitor/children.hpp"
+#include "tcalc/visitor/clone.hpp"
+#include "tcalc/visitor/compile.hpp"
+
+namespace tcalc::ast {
+
+error::Result<bytecode::Chunk>
+CompileVisitor::compile(NodePtr<>& node)
+{
+  auto chunk = bytecode::Chunk{};
+  auto visitor = CompileVisitor{ chunk };
+
+  ret_err(visitor.visit(node));
+  chunk.emit(bytecode::OpCode::RETURN);
+
+  return error::ok<bytecode::Chunk>(std::move(chunk));
+}
+
+error::Result<void>
+CompileVisitor::visit_bin_op(NodePtr<BinaryOpNode>& node)
+{
+  _tail = false;
+  auto spine = Spine{ node };
+  ret_err(visit(spine.leaf()));
+
+  for (std::size_t i = 0; i < spine.size(); ++i) {
+    auto* op = spine[i];
+    if (op->type() == NodeType::BINARY_AND ||
+        op->type() == NodeType::BINARY_OR) {
+      auto to_end = _chunk->emit(op->type() == NodeType::BINARY_AND
+                                   ? bytecode::OpCode::AND_JUMP
+                                   : bytecode::OpCode::OR_JUMP);
+      ret_err(visit(op->right()));
+      _chunk->emit(bytecode::OpCode::TRUTH);
+      _chunk->patch(to_end, static_cast<uint32_t>(_chunk->size()));
+      continue;
+    }
+
+    ret_err(visit(op->right()));
+    _chunk->emit(BINOP_MAP.at(op->type()));
+  }
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+CompileVisitor::visit_unary_op(NodePtr<UnaryOpNode>& node)
+{
+  _tail = false;
+  ret_err(visit(node->operand()));
+  _chunk->emit(UNARYOP_MAP.at(node->type()));
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+CompileVisitor::visit_number(NodePtr<NumberNode>& node)
+{
+  _chunk->emit(bytecode::OpCode::CONST, _chunk->add_const(node->value()));
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+CompileVisitor::visit_varref(NodePtr<VarRefNode>& node)
+{
+  auto binding = node->binding();
+  if (binding.kind == BindingKind::UNRESOLVED) {
+    // not resolved ahead of time, bind it the same way here
+    auto it = std::find(_params.begin(), _params.end(), node->symbol());
+    binding = it != _params.end()
+                ? Binding{ BindingKind::PARAM,
+                           static_cast<uint32_t>(it - _params.begin()) }
+                : Binding{ BindingKind::GLOBAL, node->symbol() };
+  }
+
+  _chunk->emit(binding.kind == BindingKind::PARAM ? bytecode::OpCode::LOAD_ARG
+                                                  : bytecode::OpCode::LOAD,
+               binding.index);
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+CompileVisitor::visit_varassign(NodePtr<VarAssignNode>& node)
+{
+  ret_err(visit(node->body()));
+
+  _chunk->emit(bytecode::OpCode::STORE, node->symbol());
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+CompileVisitor::visit_fcall(NodePtr<FcallNode>& node)
+{
+  auto tail = std::exchange(_tail, false);
+  for (auto& arg : node->args()) {
+    ret_err(visit(arg));
+  }
+
+  _chunk->emit(tail ? bytecode::OpCode::TAIL_CALL : bytecode::OpCode::CALL,
+               _chunk->add_call(node->symbol(),
+                                static_cast<uint32_t>(node->args().size())));
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+CompileVisitor::visit_fdef(NodePtr<FdefNode>& node)
+{
+  // the definition outlives the parsed tree, move it to its own arena
+  auto arena = std::make_shared<Arena>();
+  auto cloner = CloneVisitor{ *arena };
+  auto root = NodePtr<>{ node };
+  auto def = static_cast<NodePtr<FdefNode>>(unwrap_err(cloner.visit(root)));
+
+  auto body = std::make_shared<bytecode::Chunk>();
+  auto visitor = CompileVisitor{ *body, def->args() };
+  visitor._tail = true;
+
+  ret_err(visitor.visit(def->body()));
+  body->emit(bytecode::OpCode::RETURN);
+
+  _chunk->emit(
+    bytecode::OpCode::DEF,
+    _chunk->add_proto({ std::move(arena), def, std::move(body) }));
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+CompileVisitor::visit_if(NodePtr<IfNode>& node)
+{
+  // only the branches inherit the tail position
+  auto tail = std::exchange(_tail, false);
+  ret_err(visit(node->cond()));
+  auto to_else = _chunk->emit(bytecode::OpCode::JUMP_IF_FALSE);
+
+  _tail = tail;
+  ret_err(visit(node->then()));
+  auto to_end = _chunk->emit(bytecode::OpCode::JUMP);
+
+  _chunk->patch(to_else, static_cast<uint32_t>(_chunk->size()));
+  _tail = tail;
+  ret_err(visit(node->else_()));
+  _tail = false;
+
+  _chunk->patch(to_end, static_cast<uint32_t>(_chunk->size()));
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+CompileVisitor::visit_import(NodePtr<ProgramImportNode>& node)
+{
+  _chunk->emit(bytecode::OpCode::IMPORT,
+               _chunk->add_import(std::string{ node->path() }));
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+CompileVisitor::visit_poly(NodePtr<PolyNode>& node)
+{
+  _tail = false;
+  auto coeffs = node->coeffs();
+
+  // Horner's scheme, the variable is reloaded for every degree
+  ret_err(visit(coeffs.back()));
+  for (auto i = coeffs.size() - 1; i-- > 0;) {
+    ret_err(visit(node->var()));
+    ret_err(visit(coeffs[i]));
+    _chunk->emit(bytecode::OpCode::FMA);
+  }
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+CompileVisitor::visit_program(NodePtr<ProgramNode>& node)
+{
+  if (node->statements().empty()) {
+    _chunk->emit(bytecode::OpCode::CONST, _chunk->add_const(0));
+    return error::ok<void>();
+  }
+
+  return visit(node->statements().back());
+}
+
+error::Result<bytecode::Chunk>
+ProgramCompileVisitor::compile(NodePtr<>& node)
+{
+  auto chunk = bytecode::Chunk{};
+  auto visitor = ProgramCompileVisitor{ chunk };
+
+  ret_err(visitor.visit(node));
+  chunk.emit(bytecode::OpCode::CONST, chunk.add_const(0));
+  chunk.emit(bytecode::OpCode::RETURN);
+
+  return error::ok<bytecode::Chunk>(std::move(chunk));
+}
+
+error::Result<void>
+ProgramCompileVisitor::visit_program(NodePtr<ProgramNode>& node)
+{
+  for (auto& stmt : node->statements()) {
+    auto visitor = CompileVisitor{ *_chunk };
+    ret_err(visitor.visit(stmt));
+    _chunk->emit(bytecode::OpCode::YIELD);
+  }
+
+  return error::ok<void>();
+}
+
+}
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tcalc/ast/binaryop.hpp"
+#include "tcalc/ast/control_flow.hpp"
+#include "tcalc/ast/function.hpp"
+#include "tcalc/ast/number.hpp"
+#include "tcalc/ast/poly.hpp"
+#include "tcalc/ast/program.hpp"
+#include "tcalc/ast/unaryop.hpp"
+#include "tcalc/ast/variable.hpp"
+#include "tcalc/builtins.hpp"
+#include "tcalc/eval.hpp"
+#include "tcalc/visitor/children.hpp"
+#include "tcalc/visitor/cse.hpp"
+
+namespace tcalc::ast {
+
+namespace {
+
+auto
+mix(uint64_t hash, uint64_t value)
+{
+  hash ^= value;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccd;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+uint64_t
+payload(NodePtr<> node)
+{
+  switch (node->type()) {
+    case NodeType::NUMBER:
+      return std::bit_cast<uint64_t>(
+        static_cast<NodePtr<NumberNode>>(node)->value());
+    case NodeType::VARREF:
+      return static_cast<NodePtr<VarRefNode>>(node)->symbol();
+    case NodeType::FCALL: {
+      auto* call = static_cast<NodePtr<FcallNode>>(node);
+      return (static_cast<uint64_t>(call->args().size()) << 32) |
+             call->symbol();
+    }
+    case NodeType::POLY:
+      return static_cast<NodePtr<PolyNode>>(node)->coeffs().size();
+    default:
+      return 0;
+  }
+}
+
+}
+
+template<typename F>
+void
+CsePass::_each_child(NodePtr<> node, std::size_t index, bool cond, F&& fn)
+{
+  // children follow their parent in pre-order, one subtree after another
+  auto at = index + 1;
+  for_children(node, cond, [this, &at, &fn](NodePtr<>& child, bool skip) {
+    fn(child, at, skip);
+    at += _info[at].size;
+  });
+}
+
+std::size_t
+CsePass::run(NodePtr<>& node, Arena& arena, const EvalContext& ctx)
+{
+  _ctx = &ctx;
+  _arena = &arena;
+  _late = false;
+  _removed = 0;
+  _temp_count = 0;
+  _info.clear();
+  _entries.clear();
+  _defined.clear();
+
+  // functions defined by the program are not known to be pure
+  if (node->type() == NodeType::PROGRAM) {
+    for (auto* stmt : static_cast<NodePtr<ProgramNode>>(node)->statements()) {
+      if (stmt->type() == NodeType::FDEF) {
+        _defined.push_back(static_cast<NodePtr<FdefNode>>(stmt)->symbol());
+      }
+    }
+  }
+
+  _analyse(node);
+
+  // at most one class per node, the table stays at most half full
+  _table.assign(std::bit_ceil(_info.size() * 2), 0);
+
+  _count(node, 0, false);
+  _rewrite(node, 0, false);
+
+  // every temporary adds the node storing it
+  _removed -= _temp_count;
+
+  return _removed;
+}
+
+void
+CsePass::_analyse(NodePtr<>& node)
+{
+  auto index = _info.size();
+  _info.push_back({ node, 0, 1, NO_ENTRY, false, false });
+
+  auto hash = mix(static_cast<uint64_t>(node->type()) + 1, payload(node));
+  auto pure = !_late;
+
+  switch (node->type()) {
+    case NodeType::FCALL: {
+      auto* call = static_cast<NodePtr<FcallNode>>(node);
+      const auto* info = _ctx->func_info(call->symbol());
+      pure = pure && info != nullptr && info->pure &&
+             (info->arity == builtins::FunctionInfo::VARIADIC ||
+              info->arity == call->args().size()) &&
+             std::find(_defined.begin(), _defined.end(), call->symbol()) ==
+               _defined.end();
+      break;
+    }
+    case NodeType::VARASSIGN:
+    case NodeType::FDEF:
+    case NodeType::PROGRAM:
+      pure = false;
+      break;
+    case NodeType::IMPORT:
+      pure = false;
+      _late = true;
+      break;
+    default:
+      break;
+  }
+
+  _each_child(node,
+              index,
+              false,
+              [this, &hash, &pure](NodePtr<>& child, std::size_t at, bool) {
+                _analyse(child);
+                hash = mix(hash, _info[at].hash);
+                pure = pure && _info[at].pure;
+              });
+
+  auto& info = _info[index];
+  info.hash = hash;
+  info.size = static_cast<uint32_t>(_info.size() - index);
+  info.pure = pure;
+}
+
+void
+CsePass::_count(NodePtr<>& node, std::size_t index, bool cond)
+{
+  // numbers and names are cheaper to load than a temporary
+  if (_info[index].pure && node->type() != NodeType::NUMBER &&
+      node->type() != NodeType::VARREF) {
+    auto& entry = _entries[_classify(index)];
+    if (entry.anchored) {
+      ++entry.uses;
+    } else if (!cond) {
+      entry.anchored = true;
+    }
+
+    // later occurrences are replaced as a whole
+    if (!_info[index].first) {
+      return;
+    }
+  }
+
+  _each_child(
+    node, index, cond, [this](NodePtr<>& child, std::size_t at, bool skip) {
+      _count(child, at, skip);
+    });
+
+  if (node->type() == NodeType::VARASSIGN) {
+    _kill(static_cast<NodePtr<VarAssignNode>>(node)->symbol());
+  }
+}
+
+void
+CsePass::_rewrite(NodePtr<>& node, std::size_t index, bool cond)
+{
+  const auto& info = _info[index];
+  auto* entry = info.entry == NO_ENTRY ? nullptr : &_entries[info.entry];
+
+  if (entry != nullptr && entry->temp != NO_SYMBOL) {
+    auto* ref = _arena->make<VarRefNode>(entry->temp);
+    ref->binding({ BindingKind::GLOBAL, entry->temp });
+    node = ref;
+    _removed += info.size - 1;
+    return;
+  }
+
+  if (entry != nullptr && !info.first) {
+    if (!cond && entry->uses > 0) {
+      _store(node, *entry);
+    }
+    return;
+  }
+
+  _each_child(
+    node, index, cond, [this](NodePtr<>& child, std::size_t at, bool skip) {
+      _rewrite(child, at, skip);
+    });
+
+  if (entry != nullptr && !cond && entry->uses > 0) {
+    _store(node, *entry);
+  }
+}
+
+void
+CsePass::_store(NodePtr<>& node, Entry& entry)
+{
+  // once the temporaries run out, later occurrences are computed again
+  entry.temp = _temp();
+  if (entry.temp != NO_SYMBOL) {
+    node = _arena->make<VarAssignNode>(entry.temp, node);
+  }
+}
+
+uint32_t
+CsePass::_classify(std::size_t index)
+{
+  auto& info = _info[index];
+  auto mask = _table.size() - 1;
+
+  for (auto slot = info.hash & mask;; slot = (slot + 1) & mask) {
+    auto item = _table[slot];
+    if (item == 0) {
+      _entries.push_back({ index, info.hash });
+      info.entry = static_cast<uint32_t>(_entries.size() - 1);
+      info.first = true;
+      _table[slot] = info.entry + 1;
+      return info.entry;
+    }
+
+    const auto& entry = _entries[item - 1];
+    if (entry.live && entry.hash == info.hash && _equal(entry.index, index)) {
+      info.entry = item - 1;
+      return item - 1;
+    }
+  }
+}
+
+void
+CsePass::_kill(SymbolId id)
+{
+  for (auto& entry : _entries) {
+    if (entry.live && _reads(entry.index, id)) {
+      entry.live = false;
+    }
+  }
+}
+
+SymbolId
+CsePass::_temp()
+{
+  if (_temp_count == TEMP_COUNT) {
+    return NO_SYMBOL;
+  }
+  if (_temp_count == _temps.size()) {
+    _temps.push_back(temp_symbol(_temp_count));
+  }
+
+  return _temps[_temp_count++];
+}
+
+bool
+CsePass::_equal(std::size_t lhs, std::size_t rhs) const
+{
+  // pre-order with arities fixes the shape, compare node by node
+  auto size = _info[lhs].size;
+  if (_info[rhs].size != size) {
+    return false;
+  }
+
+  for (std::size_t i = 0; i < size; ++i) {
+    auto* left = _info[lhs + i].node;
+    auto* right = _info[rhs + i].node;
+    if (left->type() != right->type() || payload(left) != payload(right)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool
+CsePass::_reads(std::size_t index, SymbolId id) const
+{
+  for (std::size_t i = index; i < index + _info[index].size; ++i) {
+    auto* node = _info[i].node;
+    if (node->type() == NodeType::VARREF &&
+        static_cast<NodePtr<VarRefNode>>(node)->symbol() == id) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+}
@@ -1,10 +1,15 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <limits>
 #include <vector>
 
 #include "tcalc/ast/program.hpp"
+#include "tcalc/ast/variable.hpp"
 #include "tcalc/builtins.hpp"
 #include "tcalc/error.hpp"
 #include "tcalc/eval.hpp"
+#include "tcalc/visitor/children.hpp"
 #include "tcalc/visitor/eval.hpp"
 
 namespace tcalc::ast {
@@ -12,10 +17,27 @@ namespace tcalc::ast {
 error::Result<double>
 EvalVisitor::visit_bin_op(NodePtr<BinaryOpNode>& node)
 {
-  auto lval = unwrap_err(visit(node->left()));
-  auto rval = unwrap_err(visit(node->right()));
+  auto spine = Spine{ node };
+  auto value = unwrap_err(visit(spine.leaf()));
 
-  return error::ok<double>(BINOP_MAP.at(node->type())(lval, rval));
+  for (std::size_t i = 0; i < spine.size(); ++i) {
+    auto* op = spine[i];
+
+    // logical operators skip the right operand once the left one decides
+    if (op->type() == NodeType::BINARY_AND && value == 0) {
+      value = 0;
+      continue;
+    }
+    if (op->type() == NodeType::BINARY_OR && value != 0) {
+      value = 1;
+      continue;
+    }
+
+    auto rval = unwrap_err(visit(op->right()));
+    value = BINOP_MAP.at(op->type())(value, rval);
+  }
+
+  return error::ok<double>(value);
 }
 
 error::Result<double>
@@ -35,34 +57,46 @@ EvalVisitor::visit_number(NodePtr<NumberNode>& node)
 error::Result<double>
 EvalVisitor::visit_varref(NodePtr<VarRefNode>& node)
 {
-  return error::ok<double>(unwrap_err(_ctx->var(node->name())));
+  const auto& binding = node->binding();
+
+  switch (binding.kind) {
+    case BindingKind::PARAM:
+      return error::ok<double>(_ctx->arg(binding.index));
+    case BindingKind::GLOBAL:
+      return _ctx->global(binding.index);
+    default:
+      return _ctx->var(node->symbol());
+  }
 }
 
 error::Result<double>
 EvalVisitor::visit_varassign(NodePtr<VarAssignNode>& node)
 {
-  _ctx->var(node->name(), unwrap_err(visit(node->body())));
+  auto value = unwrap_err(visit(node->body()));
+  _ctx->global(node->symbol(), value);
 
-  return error::ok<double>(unwrap_err(_ctx->var(node->name())));
+  return error::ok<double>(value);
 }
 
 error::Result<double>
 EvalVisitor::visit_fcall(NodePtr<FcallNode>& node)
 {
-  auto func = unwrap_err(_ctx->func(node->name()));
+  auto func = unwrap_err(
+    _ctx->func(node->symbol(), node->args().size(), node->cache()));
 
-  auto args = std::vector<double>{};
-  for (auto& arg : node->args()) {
-    args.push_back(unwrap_err(visit(arg)));
-  }
+  auto base = unwrap_err(_push_args(node));
+  auto res = func(_ctx->call_args(base), *_ctx);
+  _ctx->pop_call_args(base);
 
-  return error::ok<double>(unwrap_err(func(args, *_ctx)));
+  return res;
 }
 
 error::Result<double>
 EvalVisitor::visit_fdef(NodePtr<FdefNode>& node)
 {
-  _ctx->func(node->name(), builtins::FunctionWrapper(node));
+  _ctx->func(node->symbol(),
+             builtins::FunctionWrapper(node),
+             { node->args().size(), false });
 
   return error::ok<double>(0);
 }
@@ -87,6 +121,22 @@ EvalVisitor::visit_import(NodePtr<ProgramImportNode>& node)
   return error::ok<double>(0);
 }
 
+error::Result<double>
+EvalVisitor::visit_poly(NodePtr<PolyNode>& node)
+{
+  auto var = unwrap_err(visit(node->var()));
+  auto coeffs = node->coeffs();
+
+  // Horner's scheme, one rounding per degree
+  auto res = unwrap_err(visit(coeffs.back()));
+  for (auto i = coeffs.size() - 1; i-- > 0;) {
+    auto coeff = unwrap_err(visit(coeffs[i]));
+    res = std::fma(res, var, coeff);
+  }
+
+  return error::ok<double>(res);
+}
+
 error::Result<double>
 EvalVisitor::visit_program(NodePtr<ProgramNode>& node)
 {
@@ -140,4 +190,97 @@ ProgramEvalVisitor::visit_program(NodePtr<ProgramNode>& node)
   return error::ok<std::vector<double>>(results);
 }
 
+error::Result<double>
+EvalVisitor::visit_body(const builtins::FunctionWrapper& func)
+{
+  const auto* current = &func;
+  auto* node = &current->node()->body();
+
+  while (true) {
+    if ((*node)->type() == NodeType::IF) {
+      auto* if_node = static_cast<IfNode*>(*node);
+      auto cond = unwrap_err(visit(if_node->cond()));
+      node = _double_noeq_bool(cond, 0) ? &if_node->then() : &if_node->else_();
+      continue;
+    }
+
+    if ((*node)->type() != NodeType::FCALL) {
+      break;
+    }
+
+    auto call = static_cast<NodePtr<FcallNode>>(*node);
+    auto callee = unwrap_err(
+      _ctx->func(call->symbol(), call->args().size(), call->cache()));
+    const auto* next = callee.get().target<builtins::FunctionWrapper>();
+    if (next == nullptr) {
+      break;
+    }
+
+    // the callee takes over the frame, its arguments never alias the frame's
+    auto base = unwrap_err(_push_args(call));
+    const auto* hit = _ctx->memo_find(
+      next->node()->symbol(), next->node(), _ctx->call_args(base));
+    if (hit != nullptr) {
+      auto value = *hit;
+      _ctx->pop_call_args(base);
+      return error::ok<double>(value);
+    }
+
+    auto replaced = _ctx->replace_frame(
+      next->node()->args(), _ctx->call_args(base), next->depth());
+    _ctx->pop_call_args(base);
+    ret_err(replaced);
+
+    current = next;
+    node = &current->node()->body();
+  }
+
+  // the frame holds the arguments of the function which produced the result
+  auto res = visit(*node);
+  if (res.has_value()) {
+    _ctx->memo_store(
+      current->node()->symbol(), current->node(), _ctx->frame_args(), *res);
+  }
+
+  return res;
+}
+
+std::size_t
+EvalVisitor::nesting(NodePtr<> node)
+{
+  auto deepest = std::size_t{ 0 };
+  auto deeper = [&deepest](NodePtr<>& child, bool /*cond*/) {
+    deepest = std::max(deepest, nesting(child));
+  };
+
+  // the spine is walked in a loop, as visit_bin_op does
+  if (Spine::binary(node)) {
+    auto spine = Spine{ static_cast<NodePtr<BinaryOpNode>>(node) };
+    deeper(spine.leaf(), false);
+    for (std::size_t i = 0; i < spine.size(); ++i) {
+      deeper(spine[i]->right(), false);
+    }
+  } else {
+    for_children(node, false, deeper);
+  }
+
+  return deepest + 1;
+}
+
+error::Result<std::size_t>
+EvalVisitor::_push_args(NodePtr<FcallNode>& node)
+{
+  // arguments go to the context's call stack, nested calls push above them
+  auto base = _ctx->call_base();
+  for (auto& arg : node->args()) {
+    auto value = visit(arg);
+    if (!value.has_value()) {
+      _ctx->pop_call_args(base);
+    }
+    _ctx->push_call_arg(unwrap_err(std::move(value)));
+  }
+
+  return base;
+}
+
 }
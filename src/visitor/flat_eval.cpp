@@ -0,0 +1,300 @@
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tcalc/ast/variable.hpp"
+#include "tcalc/builtins.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/eval.hpp"
+#include "tcalc/symbol.hpp"
+#include "tcalc/visitor/flat_eval.hpp"
+
+namespace tcalc::ast {
+
+error::Result<double>
+FlatEvalVisitor::visit(FlatIndex index) // NOLINT
+{
+  // nodes are visited with explicit stacks, `stage` counts how many times a
+  // task has been resumed after its children
+  auto& tasks = _tasks;
+  auto& values = _values;
+  auto& funcs = _funcs;
+  tasks.assign(1, { index, 0 });
+  values.clear();
+  funcs.clear();
+
+  while (!tasks.empty()) {
+    auto& task = tasks.back();
+    const auto& node = _tree->node(task.index);
+
+    switch (node.type) {
+      case NodeType::BINARY_PLUS:
+      case NodeType::BINARY_MINUS:
+      case NodeType::BINARY_MULTIPLY:
+      case NodeType::BINARY_DIVIDE:
+      case NodeType::BINARY_EQUAL:
+      case NodeType::BINARY_NOT_EQUAL:
+      case NodeType::BINARY_GREATER:
+      case NodeType::BINARY_GREATER_EQUAL:
+      case NodeType::BINARY_LESS:
+      case NodeType::BINARY_LESS_EQUAL: {
+        if (task.stage++ == 0) {
+          // left is on top so it is evaluated first
+          tasks.push_back({ node.b, 0 });
+          tasks.push_back({ node.a, 0 });
+          continue;
+        }
+        auto rval = values.back();
+        values.pop_back();
+        values.back() = _bin_op(node.type, values.back(), rval);
+        break;
+      }
+      case NodeType::BINARY_AND:
+      case NodeType::BINARY_OR: {
+        auto stage = task.stage++;
+        if (stage == 0) {
+          tasks.push_back({ node.a, 0 });
+          continue;
+        }
+        if (stage == 1) {
+          // the right operand is only evaluated if the left one does not
+          // decide the result
+          auto decided = node.type == NodeType::BINARY_AND
+                           ? values.back() == 0
+                           : values.back() != 0;
+          if (!decided) {
+            values.pop_back();
+            tasks.push_back({ node.b, 0 });
+            continue;
+          }
+        }
+        values.back() = values.back() != 0 ? 1 : 0;
+        break;
+      }
+      case NodeType::UNARY_PLUS:
+      case NodeType::UNARY_MINUS:
+      case NodeType::UNARY_NOT:
+        if (task.stage++ == 0) {
+          tasks.push_back({ node.a, 0 });
+          continue;
+        }
+        if (node.type == NodeType::UNARY_MINUS) {
+          values.back() = -values.back();
+        } else if (node.type == NodeType::UNARY_NOT) {
+          values.back() = !values.back();
+        }
+        break;
+      case NodeType::NUMBER:
+        values.push_back(_tree->value(node.a));
+        break;
+      case NodeType::VARREF:
+        switch (static_cast<BindingKind>(node.b)) {
+          case BindingKind::PARAM:
+            values.push_back(_ctx->arg(node.c));
+            break;
+          case BindingKind::GLOBAL:
+            values.push_back(unwrap_err(_ctx->global(node.c)));
+            break;
+          default:
+            values.push_back(unwrap_err(_ctx->var(node.a)));
+            break;
+        }
+        break;
+      case NodeType::VARASSIGN:
+        if (task.stage++ == 0) {
+          tasks.push_back({ node.b, 0 });
+          continue;
+        }
+        _ctx->global(node.a, values.back());
+        break;
+      case NodeType::FCALL: {
+        auto args = _tree->list(node.b);
+        if (task.stage++ == 0) {
+          auto& cache = _tree->cache(node.c);
+          funcs.push_back(unwrap_err(_ctx->func(node.a, args.size(), cache)));
+          for (auto it = args.rbegin(); it != args.rend(); ++it) {
+            tasks.push_back({ *it, 0 });
+          }
+          continue;
+        }
+
+        // the arguments are passed in place, the callee has its own stacks
+        auto argv = std::span<const double>{ values }.last(args.size());
+        auto func = funcs.back();
+        funcs.pop_back();
+        auto res = unwrap_err(func(argv, *_ctx));
+
+        values.resize(values.size() - args.size());
+        values.push_back(res);
+        break;
+      }
+      case NodeType::FDEF:
+        // the definition outlives the tree, copy it out
+        _ctx->func(
+          node.a,
+          builtins::FlatFunctionWrapper{ std::make_shared<const FlatTree>(
+            _tree->subtree(task.index)) },
+          { _tree->list(node.b).size(), false });
+        values.push_back(0);
+        break;
+      case NodeType::IF:
+        if (task.stage++ == 0) {
+          tasks.push_back({ node.a, 0 });
+          continue;
+        }
+        // the taken branch replaces the if
+        task = { _double_noeq(values.back(), 0) ? node.b : node.c, 0 };
+        values.pop_back();
+        continue;
+      case NodeType::PROGRAM: {
+        auto stmts = _tree->list(node.a);
+        if (!stmts.empty()) {
+          task = { stmts.back(), 0 };
+          continue;
+        }
+        values.push_back(0);
+        break;
+      }
+      case NodeType::IMPORT: {
+        auto wrapper = builtins::ImportWrapper{ std::string{
+          _tree->name(node.a) } };
+        ret_err(wrapper.import(*_ctx));
+        values.push_back(0);
+        break;
+      }
+      case NodeType::POLY:
+        // only built by passes over pointer trees, never flattened
+        std::unreachable();
+    }
+
+    tasks.pop_back();
+  }
+
+  return values.back();
+}
+
+error::Result<double>
+FlatEvalVisitor::visit_body(const builtins::FlatFunctionWrapper& func)
+{
+  _tree = func.tree().get();
+  auto index = _tree->node(_tree->root()).c;
+
+  while (true) {
+    const auto& node = _tree->node(index);
+    if (node.type == NodeType::IF) {
+      auto cond = unwrap_err(visit(node.a));
+      index = _double_noeq(cond, 0) ? node.b : node.c;
+      continue;
+    }
+
+    if (node.type != NodeType::FCALL) {
+      break;
+    }
+
+    auto args = _tree->list(node.b);
+    auto callee =
+      unwrap_err(_ctx->func(node.a, args.size(), _tree->cache(node.c)));
+    const auto* next = callee.get().target<builtins::FlatFunctionWrapper>();
+    if (next == nullptr) {
+      break;
+    }
+
+    // the callee takes over the frame, its arguments never alias the frame's
+    auto base = _ctx->call_base();
+    for (auto arg : args) {
+      auto value = visit(arg);
+      if (!value.has_value()) {
+        _ctx->pop_call_args(base);
+      }
+      _ctx->push_call_arg(unwrap_err(std::move(value)));
+    }
+
+    const auto& tree = *next->tree();
+    const auto& def = tree.node(tree.root());
+    const auto* hit = _ctx->memo_find(def.a, &tree, _ctx->call_args(base));
+    if (hit != nullptr) {
+      auto value = *hit;
+      _ctx->pop_call_args(base);
+      return error::ok<double>(value);
+    }
+
+    auto replaced =
+      _ctx->replace_frame(tree.list(def.b), _ctx->call_args(base));
+    _ctx->pop_call_args(base);
+    ret_err(replaced);
+
+    _tree = &tree;
+    index = def.c;
+  }
+
+  // the frame holds the arguments of the function which produced the result
+  auto res = visit(index);
+  if (res.has_value()) {
+    _ctx->memo_store(
+      _tree->node(_tree->root()).a, _tree, _ctx->frame_args(), *res);
+  }
+
+  return res;
+}
+
+double
+FlatEvalVisitor::_bin_op(NodeType type, double lval, double rval)
+{
+  switch (type) {
+    case NodeType::BINARY_PLUS:
+      return lval + rval;
+    case NodeType::BINARY_MINUS:
+      return lval - rval;
+    case NodeType::BINARY_MULTIPLY:
+      return lval * rval;
+    case NodeType::BINARY_DIVIDE:
+      return lval / rval;
+    case NodeType::BINARY_EQUAL:
+      return _double_eq(lval, rval);
+    case NodeType::BINARY_NOT_EQUAL:
+      return _double_noeq(lval, rval);
+    case NodeType::BINARY_GREATER:
+      return lval > rval;
+    case NodeType::BINARY_GREATER_EQUAL:
+      return lval >= rval;
+    case NodeType::BINARY_LESS:
+      return lval < rval;
+    case NodeType::BINARY_LESS_EQUAL:
+      return lval <= rval;
+    default:
+      return 0;
+  }
+}
+
+bool
+FlatEvalVisitor::_double_eq(double a, double b)
+{
+  return std::abs(a - b) < std::numeric_limits<double>::epsilon();
+}
+
+bool
+FlatEvalVisitor::_double_noeq(double a, double b)
+{
+  return std::abs(a - b) > std::numeric_limits<double>::epsilon();
+}
+
+error::Result<std::vector<double>>
+FlatProgramEvalVisitor::visit(FlatIndex index)
+{
+  std::vector<double> results{};
+
+  for (auto stmt : _tree->list(_tree->node(index).a)) {
+    auto visitor = FlatEvalVisitor{ *_tree, *_ctx };
+    results.push_back(unwrap_err(visitor.visit(stmt)));
+  }
+
+  return error::ok<std::vector<double>>(results);
+}
+
+}
@@ -0,0 +1,105 @@
+#include <ostream>
+#include <utility>
+
+#include "tcalc/ast/node.hpp"
+#include "tcalc/visitor/flat_print.hpp"
+
+namespace tcalc::ast {
+
+error::Result<void>
+FlatPrintVisitor::visit(FlatIndex index) // NOLINT
+{
+  const auto& node = _tree->node(index);
+
+  switch (node.type) {
+    case NodeType::BINARY_PLUS:
+    case NodeType::BINARY_MINUS:
+    case NodeType::BINARY_MULTIPLY:
+    case NodeType::BINARY_DIVIDE:
+    case NodeType::BINARY_EQUAL:
+    case NodeType::BINARY_NOT_EQUAL:
+    case NodeType::BINARY_GREATER:
+    case NodeType::BINARY_GREATER_EQUAL:
+    case NodeType::BINARY_LESS:
+    case NodeType::BINARY_LESS_EQUAL:
+    case NodeType::BINARY_AND:
+    case NodeType::BINARY_OR:
+      *_os << _gen_indent() << NODE_TYPE_NAMES.at(node.type) << ":\n";
+
+      _step_indent();
+      ret_err(visit(node.a));
+      ret_err(visit(node.b));
+      _unstep_indent();
+      break;
+    case NodeType::UNARY_PLUS:
+    case NodeType::UNARY_MINUS:
+    case NodeType::UNARY_NOT:
+      *_os << _gen_indent() << NODE_TYPE_NAMES.at(node.type) << ":\n";
+
+      _step_indent();
+      ret_err(visit(node.a));
+      _unstep_indent();
+      break;
+    case NodeType::NUMBER:
+      *_os << _gen_indent() << "NUMBER: " << _tree->value(node.a) << ":\n";
+      break;
+    case NodeType::VARREF:
+      *_os << _gen_indent() << "VARREF: " << _tree->name(node.a) << ":";
+      break;
+    case NodeType::VARASSIGN:
+      *_os << _gen_indent() << "VARASSIGN: " << _tree->name(node.a) << ":\n";
+
+      _step_indent();
+      ret_err(visit(node.b));
+      _unstep_indent();
+      break;
+    case NodeType::FCALL:
+      *_os << _gen_indent() << "FCALL: " << _tree->name(node.a) << ":\n";
+      _step_indent();
+      for (auto arg : _tree->list(node.b)) {
+        ret_err(visit(arg));
+      }
+      _unstep_indent();
+      break;
+    case NodeType::FDEF:
+      *_os << _gen_indent() << "FDEF: " << _tree->name(node.a) << ":";
+      for (auto param : _tree->list(node.b)) {
+        *_os << " " << _tree->name(param);
+      }
+
+      *_os << "\n";
+
+      _step_indent();
+      ret_err(visit(node.c));
+      _unstep_indent();
+      break;
+    case NodeType::IF:
+      *_os << _gen_indent() << "IF:\n";
+
+      _step_indent();
+      ret_err(visit(node.a));
+      ret_err(visit(node.b));
+      ret_err(visit(node.c));
+      _unstep_indent();
+      break;
+    case NodeType::PROGRAM:
+      *_os << _gen_indent() << "PROGRAM:\n";
+
+      _step_indent();
+      for (auto stmt : _tree->list(node.a)) {
+        ret_err(visit(stmt));
+      }
+      _unstep_indent();
+      break;
+    case NodeType::IMPORT:
+      *_os << _gen_indent() << "IMPORT: " << _tree->name(node.a) << ":\n";
+      break;
+    case NodeType::POLY:
+      // only built by passes over pointer trees, never flattened
+      std::unreachable();
+  }
+
+  return error::ok<void>();
+}
+
+}
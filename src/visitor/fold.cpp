@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "tcalc/ast/variable.hpp"
+#include "tcalc/builtins.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/symbol.hpp"
+#include "tcalc/visitor/eval.hpp"
+#include "tcalc/visitor/fold.hpp"
+
+namespace tcalc::ast {
+
+namespace {
+
+auto
+truthy(double value)
+{
+  return EvalVisitor::BINOP_MAP.at(NodeType::BINARY_NOT_EQUAL)(value, 0) != 0;
+}
+
+std::optional<double>
+decided(NodeType type, double lhs)
+{
+  // logical operators whose left operand decides the result
+  if (type == NodeType::BINARY_AND && lhs == 0) {
+    return 0;
+  }
+  if (type == NodeType::BINARY_OR && lhs != 0) {
+    return 1;
+  }
+
+  return std::nullopt;
+}
+
+const builtins::Function*
+pure_func(const EvalContext& ctx, SymbolId id, std::size_t argc)
+{
+  const auto* info = ctx.func_info(id);
+  if (info == nullptr || !info->pure ||
+      (info->arity != builtins::FunctionInfo::VARIADIC &&
+       info->arity != argc)) {
+    return nullptr;
+  }
+
+  return ctx.find_func(id);
+}
+
+template<typename T>
+auto
+contains(const std::vector<T>& items, const T& item)
+{
+  return std::find(items.begin(), items.end(), item) != items.end();
+}
+
+}
+
+error::Result<NodePtr<>>
+FoldVisitor::visit_bin_op(NodePtr<BinaryOpNode>& node)
+{
+  auto left = unwrap_err(visit(node->left()));
+  auto right = unwrap_err(visit(node->right()));
+  node->left(left);
+  node->right(right);
+
+  if (left->type() != NodeType::NUMBER) {
+    return error::ok<NodePtr<>>(node);
+  }
+
+  auto lval = static_cast<NodePtr<NumberNode>>(left)->value();
+  if (auto value = decided(node->type(), lval)) {
+    return error::ok<NodePtr<>>(_number(*value));
+  }
+
+  if (right->type() != NodeType::NUMBER) {
+    return error::ok<NodePtr<>>(node);
+  }
+
+  auto rval = static_cast<NodePtr<NumberNode>>(right)->value();
+
+  return error::ok<NodePtr<>>(
+    _number(EvalVisitor::BINOP_MAP.at(node->type())(lval, rval)));
+}
+
+error::Result<NodePtr<>>
+FoldVisitor::visit_unary_op(NodePtr<UnaryOpNode>& node)
+{
+  auto operand = unwrap_err(visit(node->operand()));
+  node->operand(operand);
+
+  if (operand->type() != NodeType::NUMBER) {
+    return error::ok<NodePtr<>>(node);
+  }
+
+  auto val = static_cast<NodePtr<NumberNode>>(operand)->value();
+
+  return error::ok<NodePtr<>>(
+    _number(EvalVisitor::UNARYOP_MAP.at(node->type())(val)));
+}
+
+error::Result<NodePtr<>>
+FoldVisitor::visit_number(NodePtr<NumberNode>& node)
+{
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+FoldVisitor::visit_varref(NodePtr<VarRefNode>& node)
+{
+  if (_late || node->binding().kind != BindingKind::GLOBAL ||
+      !_ctx->constant(node->symbol()) || contains(_assigned, node->symbol())) {
+    return error::ok<NodePtr<>>(node);
+  }
+
+  return error::ok<NodePtr<>>(_number(_ctx->global(node->symbol()).value()));
+}
+
+error::Result<NodePtr<>>
+FoldVisitor::visit_varassign(NodePtr<VarAssignNode>& node)
+{
+  auto body = unwrap_err(visit(node->body()));
+  node->body(body);
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+FoldVisitor::visit_fcall(NodePtr<FcallNode>& node)
+{
+  auto constant = true;
+  for (auto& arg : node->args()) {
+    arg = unwrap_err(visit(arg));
+    constant = constant && arg->type() == NodeType::NUMBER;
+  }
+
+  if (_late || !constant || contains(_defined, node->symbol())) {
+    return error::ok<NodePtr<>>(node);
+  }
+
+  const auto* func = pure_func(*_ctx, node->symbol(), node->args().size());
+  if (func == nullptr) {
+    return error::ok<NodePtr<>>(node);
+  }
+
+  auto base = _ctx->call_base();
+  for (auto* arg : node->args()) {
+    _ctx->push_call_arg(static_cast<NodePtr<NumberNode>>(arg)->value());
+  }
+  auto value = (*func)(_ctx->call_args(base), *_ctx);
+  _ctx->pop_call_args(base);
+
+  // failing calls are kept to report their error when they run
+  return error::ok<NodePtr<>>(value.has_value() ? _number(*value) : node);
+}
+
+error::Result<NodePtr<>>
+FoldVisitor::visit_fdef(NodePtr<FdefNode>& node)
+{
+  auto visitor = FoldVisitor{ *_arena, nullptr };
+  auto body = unwrap_err(visitor.visit(node->body()));
+  node->body(body);
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+FoldVisitor::visit_if(NodePtr<IfNode>& node)
+{
+  auto cond = unwrap_err(visit(node->cond()));
+  if (cond->type() == NodeType::NUMBER) {
+    auto val = static_cast<NodePtr<NumberNode>>(cond)->value();
+    return visit(truthy(val) ? node->then() : node->else_());
+  }
+
+  auto then = unwrap_err(visit(node->then()));
+  auto else_ = unwrap_err(visit(node->else_()));
+  node->cond(cond);
+  node->then(then);
+  node->else_(else_);
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+FoldVisitor::visit_import(NodePtr<ProgramImportNode>& node)
+{
+  _late = true;
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+FoldVisitor::visit_poly(NodePtr<PolyNode>& node)
+{
+  auto var = unwrap_err(visit(node->var()));
+  node->var(var);
+  for (auto& coeff : node->coeffs()) {
+    coeff = unwrap_err(visit(coeff));
+  }
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+FoldVisitor::visit_program(NodePtr<ProgramNode>& node)
+{
+  // statements run in order, names they change are never folded
+  for (auto* stmt : node->statements()) {
+    if (stmt->type() == NodeType::VARASSIGN) {
+      _assigned.push_back(static_cast<NodePtr<VarAssignNode>>(stmt)->symbol());
+    } else if (stmt->type() == NodeType::FDEF) {
+      _defined.push_back(static_cast<NodePtr<FdefNode>>(stmt)->symbol());
+    }
+  }
+
+  for (auto& stmt : node->statements()) {
+    stmt = unwrap_err(visit(stmt));
+  }
+
+  return error::ok<NodePtr<>>(node);
+}
+
+NodePtr<>
+FoldVisitor::_number(double value)
+{
+  return _arena->make<NumberNode>(value);
+}
+
+void
+FlatFoldVisitor::visit(FlatIndex index)
+{
+  // function body, the node range ending at the body root
+  struct Scope
+  {
+    FlatIndex first;
+    FlatIndex last;
+  };
+
+  auto begin = _tree->first(index);
+
+  // statements run in order, names they change are never folded
+  auto scopes = std::vector<Scope>{};
+  auto assigned = std::vector<SymbolId>{};
+  auto defined = std::vector<SymbolId>{};
+  for (auto i = begin; i <= index; ++i) {
+    const auto& node = _tree->node(i);
+    if (node.type == NodeType::FDEF) {
+      scopes.push_back({ _tree->first(node.c), node.c });
+      defined.push_back(node.a);
+    } else if (node.type == NodeType::VARASSIGN) {
+      assigned.push_back(node.a);
+    }
+  }
+
+  auto number = [this](double value) {
+    return FlatNode{ NodeType::NUMBER, _tree->add_const(value), 0, 0 };
+  };
+  auto late = _ctx == nullptr;
+  auto scope = scopes.begin();
+
+  for (auto i = begin; i <= index; ++i) {
+    while (scope != scopes.end() && scope->last < i) {
+      ++scope;
+    }
+    auto in_body = scope != scopes.end() && scope->first <= i;
+    auto names = !late && !in_body;
+
+    auto& node = _tree->node(i);
+    switch (node.type) {
+      case NodeType::BINARY_PLUS:
+      case NodeType::BINARY_MINUS:
+      case NodeType::BINARY_MULTIPLY:
+      case NodeType::BINARY_DIVIDE:
+      case NodeType::BINARY_EQUAL:
+      case NodeType::BINARY_NOT_EQUAL:
+      case NodeType::BINARY_GREATER:
+      case NodeType::BINARY_GREATER_EQUAL:
+      case NodeType::BINARY_LESS:
+      case NodeType::BINARY_LESS_EQUAL:
+      case NodeType::BINARY_AND:
+      case NodeType::BINARY_OR: {
+        const auto& left = _tree->node(node.a);
+        const auto& right = _tree->node(node.b);
+        if (left.type != NodeType::NUMBER) {
+          break;
+        }
+
+        auto lval = _tree->value(left.a);
+        if (auto value = decided(node.type, lval)) {
+          node = number(*value);
+        } else if (right.type == NodeType::NUMBER) {
+          auto rval = _tree->value(right.a);
+          node = number(EvalVisitor::BINOP_MAP.at(node.type)(lval, rval));
+        }
+        break;
+      }
+      case NodeType::UNARY_PLUS:
+      case NodeType::UNARY_MINUS:
+      case NodeType::UNARY_NOT: {
+        const auto& operand = _tree->node(node.a);
+        if (operand.type == NodeType::NUMBER) {
+          auto val = _tree->value(operand.a);
+          node = number(EvalVisitor::UNARYOP_MAP.at(node.type)(val));
+        }
+        break;
+      }
+      case NodeType::VARREF:
+        if (names &&
+            static_cast<BindingKind>(node.b) == BindingKind::GLOBAL &&
+            _ctx->constant(node.a) && !contains(assigned, node.a)) {
+          node = number(_ctx->global(node.a).value());
+        }
+        break;
+      case NodeType::FCALL: {
+        auto args = _tree->list(node.b);
+        if (!names || contains(defined, node.a) ||
+            !std::all_of(args.begin(), args.end(), [this](auto arg) {
+              return _tree->node(arg).type == NodeType::NUMBER;
+            })) {
+          break;
+        }
+
+        const auto* func = pure_func(*_ctx, node.a, args.size());
+        if (func == nullptr) {
+          break;
+        }
+
+        auto base = _ctx->call_base();
+        for (auto arg : args) {
+          _ctx->push_call_arg(_tree->value(_tree->node(arg).a));
+        }
+        auto value = (*func)(_ctx->call_args(base), *_ctx);
+        _ctx->pop_call_args(base);
+
+        // failing calls are kept to report their error when they run
+        if (value.has_value()) {
+          node = number(*value);
+        }
+        break;
+      }
+      case NodeType::IF: {
+        const auto& cond = _tree->node(node.a);
+        if (cond.type == NodeType::NUMBER) {
+          node = _tree->node(truthy(_tree->value(cond.a)) ? node.b : node.c);
+        }
+        break;
+      }
+      case NodeType::IMPORT:
+        late = true;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+}
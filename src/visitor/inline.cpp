@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "tcalc/ast/binaryop.hpp"
+#include "tcalc/ast/control_flow.hpp"
+#include "tcalc/ast/function.hpp"
+#include "tcalc/ast/number.hpp"
+#include "tcalc/ast/poly.hpp"
+#include "tcalc/ast/program.hpp"
+#include "tcalc/ast/unaryop.hpp"
+#include "tcalc/ast/variable.hpp"
+#include "tcalc/builtins.hpp"
+#include "tcalc/eval.hpp"
+#include "tcalc/visitor/children.hpp"
+#include "tcalc/visitor/inline.hpp"
+
+namespace tcalc::ast {
+
+namespace {
+
+void
+count_uses(NodePtr<> node, std::vector<uint32_t>& uses)
+{
+  if (node->type() == NodeType::VARREF) {
+    const auto& binding = static_cast<NodePtr<VarRefNode>>(node)->binding();
+    if (binding.kind == BindingKind::PARAM) {
+      ++uses[binding.index];
+    }
+    return;
+  }
+
+  for_children(node, false, [&uses](NodePtr<>& child, bool) {
+    count_uses(child, uses);
+  });
+}
+
+auto
+leaf(NodePtr<> node)
+{
+  return node->type() == NodeType::NUMBER || node->type() == NodeType::VARREF;
+}
+
+}
+
+std::size_t
+InlinePass::run(NodePtr<>& node,
+                Arena& arena,
+                const EvalContext& ctx,
+                std::size_t budget)
+{
+  _ctx = &ctx;
+  _arena = &arena;
+  _budget = budget;
+  _late = false;
+  _count = 0;
+  _defined.clear();
+  _active.clear();
+  _inlined.clear();
+
+  if (_budget > 0) {
+    _visit(node);
+  }
+
+  return _count;
+}
+
+void
+InlinePass::_visit(NodePtr<>& node)
+{
+  switch (node->type()) {
+    case NodeType::FCALL:
+      for (auto& arg : static_cast<NodePtr<FcallNode>>(node)->args()) {
+        _visit(arg);
+      }
+      if (auto* body = _inline(static_cast<NodePtr<FcallNode>>(node))) {
+        node = body;
+      }
+      break;
+    case NodeType::FDEF:
+      // later statements call this definition
+      _defined.push_back(static_cast<NodePtr<FdefNode>>(node));
+      break;
+    case NodeType::IMPORT:
+      _late = true;
+      break;
+    default:
+      for_children(
+        node, false, [this](NodePtr<>& child, bool) { _visit(child); });
+      break;
+  }
+}
+
+NodePtr<>
+InlinePass::_inline(NodePtr<FcallNode> call)
+{
+  if (_late || _active.size() >= MAX_DEPTH) {
+    return nullptr;
+  }
+
+  const builtins::FunctionWrapper* wrapper = nullptr;
+  auto* def = _lookup(call->symbol(), call->args().size(), wrapper);
+  if (def == nullptr || tree_size(def->body(), _budget) > _budget ||
+      std::find(_active.begin(), _active.end(), def->symbol()) !=
+        _active.end() ||
+      _recursive(def)) {
+    return nullptr;
+  }
+
+  _uses.assign(def->args().size(), 0);
+  count_uses(def->body(), _uses);
+
+  auto args = call->args();
+  auto numbers = true;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    numbers = numbers && args[i]->type() == NodeType::NUMBER;
+    if (!leaf(args[i]) && (_uses[i] > 1 || !_pure(args[i]))) {
+      return nullptr;
+    }
+  }
+
+  auto count = _count;
+  auto inlined = _inlined.size();
+  auto* body = _substitute(def->body(), args);
+  _active.push_back(def->symbol());
+  _visit(body);
+  _active.pop_back();
+
+  // arguments only keep their order relative to the body if it has no effects
+  if (!numbers && !_pure(body)) {
+    _count = count;
+    _inlined.resize(inlined);
+    return nullptr;
+  }
+
+  if (wrapper != nullptr &&
+      std::find(_inlined.begin(), _inlined.end(), wrapper) == _inlined.end()) {
+    _inlined.push_back(wrapper);
+  }
+  ++_count;
+
+  return body;
+}
+
+NodePtr<FdefNode>
+InlinePass::_lookup(SymbolId id,
+                    std::size_t argc,
+                    const builtins::FunctionWrapper*& wrapper) const
+{
+  NodePtr<FdefNode> def = nullptr;
+  wrapper = nullptr;
+
+  auto it = std::find_if(_defined.rbegin(),
+                         _defined.rend(),
+                         [id](auto* node) { return node->symbol() == id; });
+  if (it != _defined.rend()) {
+    def = *it;
+  } else if (const auto* func = _ctx->find_func(id); func != nullptr) {
+    wrapper = func->target<builtins::FunctionWrapper>();
+    def = wrapper != nullptr ? wrapper->node() : nullptr;
+  }
+
+  // a mismatched call fails at runtime, as it did before
+  if (def == nullptr || def->args().size() != argc) {
+    wrapper = nullptr;
+    return nullptr;
+  }
+
+  return def;
+}
+
+bool
+InlinePass::_recursive(NodePtr<FdefNode> def)
+{
+  _pending.clear();
+  _seen.clear();
+  _pending.push_back(def->body());
+  _seen.push_back(def->symbol());
+
+  while (!_pending.empty()) {
+    auto* node = _pending.back();
+    _pending.pop_back();
+
+    if (node->type() == NodeType::FCALL) {
+      auto* call = static_cast<NodePtr<FcallNode>>(node);
+      if (call->symbol() == def->symbol()) {
+        return true;
+      }
+
+      if (std::find(_seen.begin(), _seen.end(), call->symbol()) ==
+          _seen.end()) {
+        _seen.push_back(call->symbol());
+        const builtins::FunctionWrapper* wrapper = nullptr;
+        if (auto* callee =
+              _lookup(call->symbol(), call->args().size(), wrapper)) {
+          _pending.push_back(callee->body());
+        }
+      }
+    }
+
+    for_children(node, false, [this](NodePtr<>& child, bool) {
+      _pending.push_back(child);
+    });
+  }
+
+  return false;
+}
+
+bool
+InlinePass::_pure(NodePtr<> node) const
+{
+  switch (node->type()) {
+    case NodeType::VARASSIGN:
+    case NodeType::FDEF:
+    case NodeType::IMPORT:
+    case NodeType::PROGRAM:
+      return false;
+    case NodeType::FCALL: {
+      auto* call = static_cast<NodePtr<FcallNode>>(node);
+      const auto* info = _ctx->func_info(call->symbol());
+      if (info == nullptr || !info->pure ||
+          (info->arity != builtins::FunctionInfo::VARIADIC &&
+           info->arity != call->args().size()) ||
+          std::any_of(_defined.begin(), _defined.end(), [call](auto* def) {
+            return def->symbol() == call->symbol();
+          })) {
+        return false;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+
+  auto pure = true;
+  for_children(node, false, [this, &pure](NodePtr<>& child, bool) {
+    pure = pure && _pure(child);
+  });
+
+  return pure;
+}
+
+NodePtr<>
+InlinePass::_substitute(NodePtr<> node, std::span<NodePtr<>> args)
+{
+  switch (node->type()) {
+    case NodeType::NUMBER:
+      return _arena->make<NumberNode>(
+        static_cast<NodePtr<NumberNode>>(node)->value());
+    case NodeType::VARREF: {
+      auto* ref = static_cast<NodePtr<VarRefNode>>(node);
+      if (ref->binding().kind == BindingKind::PARAM) {
+        // other arguments than numbers and names are used at most once
+        auto* arg = args[ref->binding().index];
+        return leaf(arg) ? _substitute(arg, {}) : arg;
+      }
+
+      auto* copy = _arena->make<VarRefNode>(ref->symbol());
+      copy->binding(ref->binding());
+      return copy;
+    }
+    case NodeType::BINARY_PLUS:
+    case NodeType::BINARY_MINUS:
+    case NodeType::BINARY_MULTIPLY:
+    case NodeType::BINARY_DIVIDE:
+    case NodeType::BINARY_EQUAL:
+    case NodeType::BINARY_NOT_EQUAL:
+    case NodeType::BINARY_GREATER:
+    case NodeType::BINARY_GREATER_EQUAL:
+    case NodeType::BINARY_LESS:
+    case NodeType::BINARY_LESS_EQUAL:
+    case NodeType::BINARY_AND:
+    case NodeType::BINARY_OR: {
+      auto* bin = static_cast<NodePtr<BinaryOpNode>>(node);
+      auto* left = _substitute(bin->left(), args);
+      auto* right = _substitute(bin->right(), args);
+      return _arena->make<BinaryOpNode>(node->type(), left, right);
+    }
+    case NodeType::UNARY_PLUS:
+    case NodeType::UNARY_MINUS:
+    case NodeType::UNARY_NOT: {
+      auto* operand =
+        _substitute(static_cast<NodePtr<UnaryOpNode>>(node)->operand(), args);
+      return _arena->make<UnaryOpNode>(node->type(), operand);
+    }
+    case NodeType::VARASSIGN: {
+      auto* assign = static_cast<NodePtr<VarAssignNode>>(node);
+      auto* body = _substitute(assign->body(), args);
+      return _arena->make<VarAssignNode>(assign->symbol(), body);
+    }
+    case NodeType::FCALL: {
+      auto* call = static_cast<NodePtr<FcallNode>>(node);
+      auto base = _stack.size();
+      for (auto* arg : call->args()) {
+        _stack.push_back(_substitute(arg, args));
+      }
+      auto copies =
+        _arena->array(std::span<const NodePtr<>>{ _stack }.subspan(base));
+      _stack.resize(base);
+      return _arena->make<FcallNode>(call->symbol(), copies);
+    }
+    case NodeType::IF: {
+      auto* branch = static_cast<NodePtr<IfNode>>(node);
+      auto* cond = _substitute(branch->cond(), args);
+      auto* then = _substitute(branch->then(), args);
+      auto* else_ = _substitute(branch->else_(), args);
+      return _arena->make<IfNode>(cond, then, else_);
+    }
+    case NodeType::POLY: {
+      auto* poly = static_cast<NodePtr<PolyNode>>(node);
+      auto* var = _substitute(poly->var(), args);
+      auto base = _stack.size();
+      for (auto* coeff : poly->coeffs()) {
+        _stack.push_back(_substitute(coeff, args));
+      }
+      auto copies =
+        _arena->array(std::span<const NodePtr<>>{ _stack }.subspan(base));
+      _stack.resize(base);
+      return _arena->make<PolyNode>(var, copies);
+    }
+    default:
+      // definitions, imports and programs never appear in a body
+      return node;
+  }
+}
+
+}
@@ -0,0 +1,603 @@
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "tcalc/ast/poly.hpp"
+#include "tcalc/ast/variable.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/visitor/children.hpp"
+#include "tcalc/visitor/clone.hpp"
+#include "tcalc/visitor/poly.hpp"
+
+namespace tcalc::ast {
+
+namespace {
+
+auto
+same_var(NodePtr<VarRefNode> var, NodePtr<> node)
+{
+  if (node->type() != NodeType::VARREF) {
+    return false;
+  }
+
+  auto* ref = static_cast<NodePtr<VarRefNode>>(node);
+  return var->symbol() == ref->symbol() &&
+         var->binding().kind == ref->binding().kind &&
+         var->binding().index == ref->binding().index;
+}
+
+// operands which may become coefficients, numbers, names and operators
+bool
+atom(NodePtr<> node)
+{
+  switch (node->type()) {
+    case NodeType::NUMBER:
+    case NodeType::VARREF:
+      return true;
+    case NodeType::BINARY_PLUS:
+    case NodeType::BINARY_MINUS:
+    case NodeType::BINARY_MULTIPLY:
+    case NodeType::BINARY_DIVIDE:
+    case NodeType::BINARY_EQUAL:
+    case NodeType::BINARY_NOT_EQUAL:
+    case NodeType::BINARY_GREATER:
+    case NodeType::BINARY_GREATER_EQUAL:
+    case NodeType::BINARY_LESS:
+    case NodeType::BINARY_LESS_EQUAL:
+    case NodeType::BINARY_AND:
+    case NodeType::BINARY_OR: {
+      auto* bin = static_cast<NodePtr<BinaryOpNode>>(node);
+      return atom(bin->left()) && atom(bin->right());
+    }
+    case NodeType::UNARY_PLUS:
+    case NodeType::UNARY_MINUS:
+    case NodeType::UNARY_NOT:
+      return atom(static_cast<NodePtr<UnaryOpNode>>(node)->operand());
+    default:
+      return false;
+  }
+}
+
+// operators a polynomial is built of, _degrees walks through them
+bool
+chain(NodePtr<> node)
+{
+  switch (node->type()) {
+    case NodeType::BINARY_PLUS:
+    case NodeType::BINARY_MINUS:
+    case NodeType::BINARY_MULTIPLY:
+    case NodeType::UNARY_PLUS:
+    case NodeType::UNARY_MINUS:
+      return true;
+    default:
+      return false;
+  }
+}
+
+NodePtr<NumberNode>
+number(NodePtr<> node)
+{
+  return node->type() == NodeType::NUMBER
+           ? static_cast<NodePtr<NumberNode>>(node)
+           : nullptr;
+}
+
+}
+
+error::Result<NodePtr<>>
+PolyVisitor::visit_bin_op(NodePtr<BinaryOpNode>& node)
+{
+  if (node->type() == NodeType::BINARY_PLUS ||
+      node->type() == NodeType::BINARY_MINUS ||
+      node->type() == NodeType::BINARY_MULTIPLY) {
+    if (auto* poly = unwrap_err(_recognize(node)); poly != nullptr) {
+      return error::ok<NodePtr<>>(poly);
+    }
+  }
+
+  return _operands(node);
+}
+
+error::Result<NodePtr<>>
+PolyVisitor::visit_unary_op(NodePtr<UnaryOpNode>& node)
+{
+  if (node->type() == NodeType::UNARY_MINUS) {
+    if (auto* poly = unwrap_err(_recognize(node)); poly != nullptr) {
+      return error::ok<NodePtr<>>(poly);
+    }
+  }
+
+  return _operands(node);
+}
+
+error::Result<NodePtr<>>
+PolyVisitor::visit_number(NodePtr<NumberNode>& node)
+{
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+PolyVisitor::visit_varref(NodePtr<VarRefNode>& node)
+{
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+PolyVisitor::visit_varassign(NodePtr<VarAssignNode>& node)
+{
+  auto body = unwrap_err(visit(node->body()));
+  node->body(body);
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+PolyVisitor::visit_fcall(NodePtr<FcallNode>& node)
+{
+  for (auto& arg : node->args()) {
+    arg = unwrap_err(visit(arg));
+  }
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+PolyVisitor::visit_fdef(NodePtr<FdefNode>& node)
+{
+  auto body = unwrap_err(visit(node->body()));
+  node->body(body);
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+PolyVisitor::visit_if(NodePtr<IfNode>& node)
+{
+  auto cond = unwrap_err(visit(node->cond()));
+  auto then = unwrap_err(visit(node->then()));
+  auto else_ = unwrap_err(visit(node->else_()));
+  node->cond(cond);
+  node->then(then);
+  node->else_(else_);
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+PolyVisitor::visit_import(NodePtr<ProgramImportNode>& node)
+{
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+PolyVisitor::visit_program(NodePtr<ProgramNode>& node)
+{
+  for (auto& stmt : node->statements()) {
+    stmt = unwrap_err(visit(stmt));
+  }
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+PolyVisitor::visit_poly(NodePtr<PolyNode>& node)
+{
+  for (auto& coeff : node->coeffs()) {
+    coeff = unwrap_err(visit(coeff));
+  }
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+PolyVisitor::_recognize(NodePtr<> node)
+{
+  _ops = 0;
+  _refs = 0;
+  _opaque = false;
+  auto degrees = _degrees(node);
+
+  // the highest degree wins, ties go to the variable read first
+  const Degree* best = nullptr;
+  for (const auto& [key, entry] : degrees) {
+    if (entry.degree > 1 &&
+        (best == nullptr || entry.degree > best->degree ||
+         (entry.degree == best->degree && entry.order < best->order))) {
+      best = &entry;
+    }
+  }
+
+  // Horner's scheme takes one fma per degree
+  if (_opaque || best == nullptr ||
+      static_cast<std::size_t>(best->degree) >= _ops) {
+    return error::ok<NodePtr<>>(nullptr);
+  }
+
+  // polynomials found in the coefficients share the room of this one
+  auto nested = _nested;
+  if (!nested) {
+    _room = MAX_GROWTH * tree_size(node);
+  }
+
+  auto base = _stack.size();
+  auto expanded = _expand(node, best->var);
+  auto zeros = std::count(
+    _stack.begin() + static_cast<std::ptrdiff_t>(base), _stack.end(), nullptr);
+  // the zeros, the variable and the polynomial node are made as well
+  if (expanded.count == 0 || !_take(static_cast<std::size_t>(zeros) + 2)) {
+    _stack.resize(base);
+    return error::ok<NodePtr<>>(nullptr);
+  }
+  for (auto i = expanded.offset; i < expanded.offset + expanded.count; ++i) {
+    if (_stack[i] == nullptr) {
+      _stack[i] = _number(0);
+    }
+  }
+  auto coeffs = _arena->array(std::span<const NodePtr<>>{ _stack }.subspan(
+    expanded.offset, expanded.count));
+  _stack.resize(base);
+
+  // coefficients may be polynomials in the other variables
+  _nested = true;
+  for (auto& coeff : coeffs) {
+    auto res = visit(coeff);
+    if (!res.has_value()) {
+      _nested = nested;
+      return _TCALC_EXPECTED_NS::unexpected(res.error());
+    }
+    coeff = res.value();
+  }
+  _nested = nested;
+
+  auto* var = _arena->make<VarRefNode>(best->var->symbol());
+  var->binding(best->var->binding());
+
+  return error::ok<NodePtr<>>(_arena->make<PolyNode>(var, coeffs));
+}
+
+error::Result<NodePtr<>>
+PolyVisitor::_operands(NodePtr<> node)
+{
+  // the chain was scanned as a whole, trying each of its operators again
+  // would scan it once per operator
+  auto operand = [this, node](NodePtr<>& child) -> error::Result<NodePtr<>> {
+    return chain(node) && chain(child) ? _operands(child) : visit(child);
+  };
+
+  if (node->type() == NodeType::UNARY_PLUS ||
+      node->type() == NodeType::UNARY_MINUS ||
+      node->type() == NodeType::UNARY_NOT) {
+    auto* unary = static_cast<NodePtr<UnaryOpNode>>(node);
+    auto child = unwrap_err(operand(unary->operand()));
+    unary->operand(child);
+    return error::ok<NodePtr<>>(node);
+  }
+
+  auto* bin = static_cast<NodePtr<BinaryOpNode>>(node);
+  auto left = unwrap_err(operand(bin->left()));
+  auto right = unwrap_err(operand(bin->right()));
+  bin->left(left);
+  bin->right(right);
+
+  return error::ok<NodePtr<>>(node);
+}
+
+PolyVisitor::Degrees
+PolyVisitor::_degrees(NodePtr<> node)
+{
+  switch (node->type()) {
+    case NodeType::BINARY_PLUS:
+    case NodeType::BINARY_MINUS:
+    case NodeType::BINARY_MULTIPLY: {
+      ++_ops;
+      auto* bin = static_cast<NodePtr<BinaryOpNode>>(node);
+      auto left = _degrees(bin->left());
+      auto right = _degrees(bin->right());
+      auto product = node->type() == NodeType::BINARY_MULTIPLY;
+
+      // merging the smaller side keeps a long chain linear, a variable
+      // missing on one side has degree 0 there
+      if (left.size() < right.size()) {
+        std::swap(left, right);
+      }
+      for (const auto& [key, entry] : right) {
+        auto [it, inserted] = left.try_emplace(key, entry);
+        if (inserted) {
+          continue;
+        }
+
+        auto& merged = it->second;
+        if (entry.order < merged.order) {
+          merged.order = entry.order;
+          merged.var = entry.var;
+        }
+        if (merged.degree < 0 || entry.degree < 0) {
+          merged.degree = -1;
+          continue;
+        }
+        auto degree = product ? merged.degree + entry.degree
+                              : std::max(merged.degree, entry.degree);
+        merged.degree = degree > MAX_DEGREE ? -1 : degree;
+      }
+      return left;
+    }
+    case NodeType::UNARY_PLUS:
+    case NodeType::UNARY_MINUS:
+      ++_ops;
+      return _degrees(static_cast<NodePtr<UnaryOpNode>>(node)->operand());
+    case NodeType::VARREF: {
+      auto* ref = static_cast<NodePtr<VarRefNode>>(node);
+      auto degrees = Degrees{};
+      degrees.emplace(
+        VarKey{ ref->symbol(), ref->binding().kind, ref->binding().index },
+        Degree{ 1, _refs++, ref });
+      return degrees;
+    }
+    case NodeType::NUMBER:
+      return {};
+    default: {
+      auto degrees = Degrees{};
+      if (atom(node)) {
+        _block(node, degrees);
+      } else {
+        _opaque = true;
+      }
+      return degrees;
+    }
+  }
+}
+
+void
+PolyVisitor::_block(NodePtr<> node, Degrees& degrees)
+{
+  switch (node->type()) {
+    case NodeType::VARREF: {
+      auto* ref = static_cast<NodePtr<VarRefNode>>(node);
+      auto [it, inserted] = degrees.try_emplace(
+        VarKey{ ref->symbol(), ref->binding().kind, ref->binding().index },
+        Degree{ -1, _refs, ref });
+      it->second.degree = -1;
+      _refs += inserted ? 1 : 0;
+      return;
+    }
+    case NodeType::NUMBER:
+      return;
+    case NodeType::UNARY_PLUS:
+    case NodeType::UNARY_MINUS:
+    case NodeType::UNARY_NOT:
+      _block(static_cast<NodePtr<UnaryOpNode>>(node)->operand(), degrees);
+      return;
+    default: {
+      // atoms only hold binary operators otherwise
+      auto* bin = static_cast<NodePtr<BinaryOpNode>>(node);
+      _block(bin->left(), degrees);
+      _block(bin->right(), degrees);
+      return;
+    }
+  }
+}
+
+PolyVisitor::Coeffs
+PolyVisitor::_expand(NodePtr<> node, NodePtr<VarRefNode> var)
+{
+  auto offset = _stack.size();
+
+  switch (node->type()) {
+    case NodeType::BINARY_PLUS:
+    case NodeType::BINARY_MINUS: {
+      auto* bin = static_cast<NodePtr<BinaryOpNode>>(node);
+      auto lhs = _expand(bin->left(), var);
+      if (lhs.count == 0) {
+        return { offset, 0 };
+      }
+      auto rhs = _expand(bin->right(), var);
+      if (rhs.count == 0) {
+        return { offset, 0 };
+      }
+      auto count = std::max(lhs.count, rhs.count);
+      auto out = _stack.size();
+      for (std::size_t i = 0; i < count; ++i) {
+        // a negation and a sum at most
+        if (!_take(2)) {
+          return { offset, 0 };
+        }
+        auto* left = i < lhs.count ? _stack[lhs.offset + i] : nullptr;
+        auto* right = i < rhs.count ? _stack[rhs.offset + i] : nullptr;
+        if (node->type() == NodeType::BINARY_MINUS) {
+          right = _neg(right);
+        }
+        _stack.push_back(_add(left, right));
+      }
+      return _collapse(offset, { out, count });
+    }
+    case NodeType::BINARY_MULTIPLY: {
+      auto* bin = static_cast<NodePtr<BinaryOpNode>>(node);
+      auto lhs = _expand(bin->left(), var);
+      if (lhs.count == 0) {
+        return { offset, 0 };
+      }
+      auto rhs = _expand(bin->right(), var);
+      if (rhs.count == 0) {
+        return { offset, 0 };
+      }
+      // distributing a product of sums multiplies their sizes unless the
+      // terms fold into numbers
+      if (_terms(lhs) > 1 && _terms(rhs) > 1 &&
+          (!_numbers(lhs) || !_numbers(rhs))) {
+        return { offset, 0 };
+      }
+      auto count = lhs.count + rhs.count - 1;
+      auto out = _stack.size();
+      _stack.resize(out + count, nullptr);
+      for (std::size_t i = 0; i < lhs.count; ++i) {
+        for (std::size_t j = 0; j < rhs.count; ++j) {
+          auto* left = _stack[lhs.offset + i];
+          auto* right = _stack[rhs.offset + j];
+          if (left == nullptr || right == nullptr) {
+            continue;
+          }
+          // operands used by several terms are copied, trees never share
+          auto copied = (j == 0 ? 0 : tree_size(left, _room)) +
+                        (i == 0 ? 0 : tree_size(right, _room));
+          if (!_take(2 + copied)) {
+            return { offset, 0 };
+          }
+          auto* term = _mul(j == 0 ? left : _clone(left),
+                            i == 0 ? right : _clone(right));
+          _stack[out + i + j] = _add(_stack[out + i + j], term);
+        }
+      }
+      return _collapse(offset, { out, count });
+    }
+    case NodeType::UNARY_PLUS:
+      return _expand(static_cast<NodePtr<UnaryOpNode>>(node)->operand(), var);
+    case NodeType::UNARY_MINUS: {
+      auto res =
+        _expand(static_cast<NodePtr<UnaryOpNode>>(node)->operand(), var);
+      if (!_take(res.count)) {
+        return { offset, 0 };
+      }
+      for (auto i = res.offset; i < res.offset + res.count; ++i) {
+        _stack[i] = _neg(_stack[i]);
+      }
+      return res;
+    }
+    case NodeType::VARREF:
+      if (same_var(var, node)) {
+        if (!_take(1)) {
+          return { offset, 0 };
+        }
+        _stack.push_back(nullptr);
+        _stack.push_back(_number(1));
+        return { offset, 2 };
+      }
+      break;
+    default:
+      break;
+  }
+
+  _stack.push_back(node);
+  return { offset, 1 };
+}
+
+bool
+PolyVisitor::_numbers(Coeffs coeffs) const
+{
+  auto begin = _stack.begin() + static_cast<std::ptrdiff_t>(coeffs.offset);
+  return std::all_of(begin,
+                     begin + static_cast<std::ptrdiff_t>(coeffs.count),
+                     [](NodePtr<> coeff) {
+                       return coeff == nullptr || number(coeff) != nullptr;
+                     });
+}
+
+std::size_t
+PolyVisitor::_terms(Coeffs coeffs) const
+{
+  auto begin = _stack.begin() + static_cast<std::ptrdiff_t>(coeffs.offset);
+  return static_cast<std::size_t>(
+    std::count_if(begin,
+                  begin + static_cast<std::ptrdiff_t>(coeffs.count),
+                  [](NodePtr<> coeff) { return coeff != nullptr; }));
+}
+
+bool
+PolyVisitor::_take(std::size_t nodes)
+{
+  if (nodes > _room) {
+    _room = 0;
+    return false;
+  }
+
+  _room -= nodes;
+  return true;
+}
+
+PolyVisitor::Coeffs
+PolyVisitor::_collapse(std::size_t offset, Coeffs result)
+{
+  auto begin = _stack.begin() + static_cast<std::ptrdiff_t>(result.offset);
+  std::copy(begin,
+            begin + static_cast<std::ptrdiff_t>(result.count),
+            _stack.begin() + static_cast<std::ptrdiff_t>(offset));
+  _stack.resize(offset + result.count);
+
+  return { offset, result.count };
+}
+
+NodePtr<>
+PolyVisitor::_add(NodePtr<> lhs, NodePtr<> rhs)
+{
+  if (lhs == nullptr || rhs == nullptr) {
+    return lhs == nullptr ? rhs : lhs;
+  }
+
+  auto* left = number(lhs);
+  auto* right = number(rhs);
+  if (left != nullptr && right != nullptr) {
+    return _number(left->value() + right->value());
+  }
+
+  return _arena->make<BinaryOpNode>(NodeType::BINARY_PLUS, lhs, rhs);
+}
+
+NodePtr<>
+PolyVisitor::_mul(NodePtr<> lhs, NodePtr<> rhs)
+{
+  if (lhs == nullptr || rhs == nullptr) {
+    return nullptr;
+  }
+
+  auto* left = number(lhs);
+  auto* right = number(rhs);
+  if (left != nullptr && right != nullptr) {
+    return _number(left->value() * right->value());
+  }
+  if (left != nullptr && left->value() == 1) {
+    return rhs;
+  }
+  if (right != nullptr && right->value() == 1) {
+    return lhs;
+  }
+
+  return _arena->make<BinaryOpNode>(NodeType::BINARY_MULTIPLY, lhs, rhs);
+}
+
+NodePtr<>
+PolyVisitor::_neg(NodePtr<> node)
+{
+  if (node == nullptr) {
+    return nullptr;
+  }
+
+  if (auto* value = number(node); value != nullptr) {
+    return _number(-value->value());
+  }
+  if (node->type() == NodeType::UNARY_MINUS) {
+    return static_cast<NodePtr<UnaryOpNode>>(node)->operand();
+  }
+
+  return _arena->make<UnaryOpNode>(NodeType::UNARY_MINUS, node);
+}
+
+NodePtr<>
+PolyVisitor::_clone(NodePtr<> node)
+{
+  if (node == nullptr) {
+    return nullptr;
+  }
+
+  // atoms hold no calls, cloning them cannot fail
+  auto cloner = CloneVisitor{ *_arena };
+  return *cloner.visit(node);
+}
+
+NodePtr<>
+PolyVisitor::_number(double value)
+{
+  return _arena->make<NumberNode>(value);
+}
+
+}
@@ -3,6 +3,7 @@
 #include "tcalc/ast/binaryop.hpp"
 #include "tcalc/ast/node.hpp"
 #include "tcalc/ast/program.hpp"
+#include "tcalc/symbol.hpp"
 #include "tcalc/visitor/print.hpp"
 
 namespace tcalc::ast {
@@ -76,8 +77,8 @@ error::Result<void>
 PrintVisitor::visit_fdef(NodePtr<FdefNode>& node)
 {
   *_os << _gen_indent() << "FDEF: " << node->name() << ":";
-  for (auto& arg : node->args()) {
-    *_os << " " << arg;
+  for (auto arg : node->args()) {
+    *_os << " " << symbols().name(arg);
   }
 
   *_os << "\n";
@@ -124,4 +125,19 @@ PrintVisitor::visit_import(NodePtr<ProgramImportNode>& node)
   return error::ok<void>();
 }
 
+error::Result<void>
+PrintVisitor::visit_poly(NodePtr<PolyNode>& node)
+{
+  *_os << _gen_indent() << "POLY:\n";
+
+  _step_indent();
+  ret_err(visit(node->var()));
+  for (auto& coeff : node->coeffs()) {
+    ret_err(visit(coeff));
+  }
+  _unstep_indent();
+
+  return error::ok<void>();
+}
+
 }
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cstddef>
+
+#include "tcalc/ast/variable.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/visitor/children.hpp"
+#include "tcalc/visitor/purity.hpp"
+
+namespace tcalc::ast {
+
+error::Result<void>
+DependencyVisitor::visit_bin_op(NodePtr<BinaryOpNode>& node)
+{
+  auto spine = Spine{ node };
+  ret_err(visit(spine.leaf()));
+  for (std::size_t i = 0; i < spine.size(); ++i) {
+    ret_err(visit(spine[i]->right()));
+  }
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+DependencyVisitor::visit_unary_op(NodePtr<UnaryOpNode>& node)
+{
+  return visit(node->operand());
+}
+
+error::Result<void>
+DependencyVisitor::visit_varref(NodePtr<VarRefNode>& node)
+{
+  if (node->binding().kind == BindingKind::PARAM ||
+      std::find(_params.begin(), _params.end(), node->symbol()) !=
+        _params.end()) {
+    return error::ok<void>();
+  }
+
+  _deps->globals.push_back(node->symbol());
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+DependencyVisitor::visit_varassign(NodePtr<VarAssignNode>& node)
+{
+  _deps->pure = false;
+
+  return visit(node->body());
+}
+
+error::Result<void>
+DependencyVisitor::visit_fcall(NodePtr<FcallNode>& node)
+{
+  for (auto& arg : node->args()) {
+    ret_err(visit(arg));
+  }
+
+  _deps->calls.push_back(node->symbol());
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+DependencyVisitor::visit_fdef(NodePtr<FdefNode>& /*node*/)
+{
+  _deps->pure = false;
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+DependencyVisitor::visit_if(NodePtr<IfNode>& node)
+{
+  ret_err(visit(node->cond()));
+  ret_err(visit(node->then()));
+  return visit(node->else_());
+}
+
+error::Result<void>
+DependencyVisitor::visit_import(NodePtr<ProgramImportNode>& /*node*/)
+{
+  _deps->pure = false;
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+DependencyVisitor::visit_poly(NodePtr<PolyNode>& node)
+{
+  ret_err(visit(node->var()));
+  for (auto& coeff : node->coeffs()) {
+    ret_err(visit(coeff));
+  }
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+DependencyVisitor::visit_program(NodePtr<ProgramNode>& node)
+{
+  for (auto& stmt : node->statements()) {
+    ret_err(visit(stmt));
+  }
+
+  return error::ok<void>();
+}
+
+void
+FlatDependencyVisitor::visit()
+{
+  const auto root = _tree->root();
+  auto params = _tree->list(_tree->node(root).b);
+
+  for (FlatIndex i = 0; i < root; ++i) {
+    const auto& node = _tree->node(i);
+
+    switch (node.type) {
+      case NodeType::VARREF:
+        if (static_cast<BindingKind>(node.b) != BindingKind::PARAM &&
+            std::find(params.begin(), params.end(), node.a) == params.end()) {
+          _deps->globals.push_back(node.a);
+        }
+        break;
+      case NodeType::FCALL:
+        _deps->calls.push_back(node.a);
+        break;
+      case NodeType::VARASSIGN:
+      case NodeType::FDEF:
+      case NodeType::IMPORT:
+        _deps->pure = false;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+}
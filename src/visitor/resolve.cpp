@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "tcalc/ast/variable.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/symbol.hpp"
+#include "tcalc/visitor/children.hpp"
+#include "tcalc/visitor/resolve.hpp"
+
+namespace tcalc::ast {
+
+namespace {
+
+auto
+undefined_error(SymbolId id)
+{
+  auto name = symbols().name(id);
+  return error::err(error::Code::UNDEFINED_VAR,
+                    "Undefined variable: %.*s",
+                    static_cast<int>(name.size()),
+                    name.data());
+}
+
+}
+
+error::Result<void>
+ResolveVisitor::visit_bin_op(NodePtr<BinaryOpNode>& node)
+{
+  auto spine = Spine{ node };
+  ret_err(visit(spine.leaf()));
+  for (std::size_t i = 0; i < spine.size(); ++i) {
+    ret_err(visit(spine[i]->right()));
+  }
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+ResolveVisitor::visit_unary_op(NodePtr<UnaryOpNode>& node)
+{
+  return visit(node->operand());
+}
+
+error::Result<void>
+ResolveVisitor::visit_varref(NodePtr<VarRefNode>& node)
+{
+  auto it = std::find(_params.begin(), _params.end(), node->symbol());
+  if (it != _params.end()) {
+    node->binding({ BindingKind::PARAM,
+                    static_cast<uint32_t>(it - _params.begin()) });
+    return error::ok<void>();
+  }
+
+  node->binding(
+    { BindingKind::GLOBAL, unwrap_err(_bind_global(node->symbol())) });
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+ResolveVisitor::visit_varassign(NodePtr<VarAssignNode>& node)
+{
+  ret_err(visit(node->body()));
+
+  _assigned.push_back(node->symbol());
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+ResolveVisitor::visit_fcall(NodePtr<FcallNode>& node)
+{
+  for (auto& arg : node->args()) {
+    ret_err(visit(arg));
+  }
+
+  // functions defined by the program itself are checked when called
+  if (_ctx == nullptr || _late ||
+      std::find(_defined.begin(), _defined.end(), node->symbol()) !=
+        _defined.end()) {
+    return error::ok<void>();
+  }
+
+  return _ctx->check_args(node->symbol(), node->args().size());
+}
+
+error::Result<void>
+ResolveVisitor::visit_fdef(NodePtr<FdefNode>& node)
+{
+  auto visitor = ResolveVisitor{ nullptr, node->args() };
+  ret_err(visitor.visit(node->body()));
+
+  _defined.push_back(node->symbol());
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+ResolveVisitor::visit_if(NodePtr<IfNode>& node)
+{
+  ret_err(visit(node->cond()));
+  ret_err(visit(node->then()));
+  return visit(node->else_());
+}
+
+error::Result<void>
+ResolveVisitor::visit_import(NodePtr<ProgramImportNode>& /*node*/)
+{
+  // the imported program may define anything
+  _late = true;
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+ResolveVisitor::visit_poly(NodePtr<PolyNode>& node)
+{
+  ret_err(visit(node->var()));
+  for (auto& coeff : node->coeffs()) {
+    ret_err(visit(coeff));
+  }
+
+  return error::ok<void>();
+}
+
+error::Result<void>
+ResolveVisitor::visit_program(NodePtr<ProgramNode>& node)
+{
+  for (auto& stmt : node->statements()) {
+    ret_err(visit(stmt));
+  }
+
+  return error::ok<void>();
+}
+
+error::Result<SymbolId>
+ResolveVisitor::_bind_global(SymbolId id)
+{
+  if (_ctx == nullptr || _late || _ctx->defined(id) ||
+      std::find(_assigned.begin(), _assigned.end(), id) != _assigned.end()) {
+    return id;
+  }
+
+  return undefined_error(id);
+}
+
+error::Result<void>
+FlatResolveVisitor::visit(FlatIndex index)
+{
+  // function body, the node range ending at the body root
+  struct Scope
+  {
+    FlatIndex first;
+    FlatIndex last;
+    FlatIndex def;
+  };
+
+  auto begin = _tree->first(index);
+
+  // definitions follow their body, collect the bodies before binding
+  auto scopes = std::vector<Scope>{};
+  for (auto i = begin; i <= index; ++i) {
+    const auto& node = _tree->node(i);
+    if (node.type == NodeType::FDEF) {
+      scopes.push_back({ _tree->first(node.c), node.c, i });
+    }
+  }
+
+  auto assigned = std::vector<SymbolId>{};
+  auto defined = std::vector<SymbolId>{};
+  auto late = _ctx == nullptr;
+  auto scope = scopes.begin();
+
+  for (auto i = begin; i <= index; ++i) {
+    while (scope != scopes.end() && scope->last < i) {
+      ++scope;
+    }
+    auto in_body = scope != scopes.end() && scope->first <= i;
+
+    auto& node = _tree->node(i);
+    if (node.type == NodeType::VARREF) {
+      if (in_body) {
+        auto params = _tree->list(_tree->node(scope->def).b);
+        auto it = std::find(params.begin(), params.end(), node.a);
+        if (it != params.end()) {
+          node.b = static_cast<FlatIndex>(BindingKind::PARAM);
+          node.c = static_cast<FlatIndex>(it - params.begin());
+          continue;
+        }
+      }
+
+      if (!in_body && !late && !_ctx->defined(node.a) &&
+          std::find(assigned.begin(), assigned.end(), node.a) ==
+            assigned.end()) {
+        return undefined_error(node.a);
+      }
+
+      node.b = static_cast<FlatIndex>(BindingKind::GLOBAL);
+      node.c = node.a;
+    } else if (node.type == NodeType::FCALL) {
+      if (!in_body && !late &&
+          std::find(defined.begin(), defined.end(), node.a) == defined.end()) {
+        ret_err(_ctx->check_args(node.a, _tree->list(node.b).size()));
+      }
+    } else if (node.type == NodeType::FDEF) {
+      defined.push_back(node.a);
+    } else if (node.type == NodeType::VARASSIGN) {
+      assigned.push_back(node.a);
+    } else if (node.type == NodeType::IMPORT) {
+      late = true;
+    }
+  }
+
+  return error::ok<void>();
+}
+
+}
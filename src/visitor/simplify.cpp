@@ -0,0 +1,439 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "tcalc/ast/variable.hpp"
+#include "tcalc/builtins.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/symbol.hpp"
+#include "tcalc/visitor/simplify.hpp"
+
+namespace tcalc::ast {
+
+namespace {
+
+using builtins::EXP;
+using builtins::LOG;
+using builtins::POW;
+using builtins::SQRT;
+
+/**
+ * @brief Native signature of a built-in function.
+ *
+ */
+template<typename F>
+struct Signature : Signature<decltype(&F::operator())>
+{};
+
+template<typename C, typename R, typename... Args>
+struct Signature<R (C::*)(Args...) const>
+{
+  using type = R(Args...);
+};
+
+std::optional<double>
+constant(NodePtr<> node)
+{
+  if (node->type() != NodeType::NUMBER) {
+    return std::nullopt;
+  }
+
+  return static_cast<NodePtr<NumberNode>>(node)->value();
+}
+
+auto
+power_of_two(double value)
+{
+  // the reciprocal is exact if it is a normal number with the same mantissa
+  int exp = 0;
+  return std::abs(std::frexp(value, &exp)) == 0.5 && std::isnormal(1 / value);
+}
+
+auto
+same(NodePtr<> lhs, NodePtr<> rhs)
+{
+  if (lhs->type() != rhs->type()) {
+    return false;
+  }
+
+  switch (lhs->type()) {
+    case NodeType::NUMBER:
+      return constant(lhs) == constant(rhs);
+    case NodeType::VARREF: {
+      const auto& left = static_cast<NodePtr<VarRefNode>>(lhs)->binding();
+      const auto& right = static_cast<NodePtr<VarRefNode>>(rhs)->binding();
+      return static_cast<NodePtr<VarRefNode>>(lhs)->symbol() ==
+               static_cast<NodePtr<VarRefNode>>(rhs)->symbol() &&
+             left.kind == right.kind && left.index == right.index;
+    }
+    default:
+      return false;
+  }
+}
+
+template<typename T>
+auto
+contains(const std::vector<T>& items, const T& item)
+{
+  return std::find(items.begin(), items.end(), item) != items.end();
+}
+
+}
+
+error::Result<NodePtr<>>
+SimplifyVisitor::visit_bin_op(NodePtr<BinaryOpNode>& node)
+{
+  auto left = unwrap_err(visit(node->left()));
+  auto right = unwrap_err(visit(node->right()));
+  node->left(left);
+  node->right(right);
+
+  return error::ok<NodePtr<>>(_bin_op(node));
+}
+
+error::Result<NodePtr<>>
+SimplifyVisitor::visit_unary_op(NodePtr<UnaryOpNode>& node)
+{
+  auto operand = unwrap_err(visit(node->operand()));
+  node->operand(operand);
+
+  switch (node->type()) {
+    case NodeType::UNARY_PLUS:
+      return error::ok<NodePtr<>>(operand);
+    case NodeType::UNARY_MINUS:
+      return error::ok<NodePtr<>>(_negate(node));
+    default:
+      return error::ok<NodePtr<>>(node);
+  }
+}
+
+error::Result<NodePtr<>>
+SimplifyVisitor::visit_number(NodePtr<NumberNode>& node)
+{
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+SimplifyVisitor::visit_varref(NodePtr<VarRefNode>& node)
+{
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+SimplifyVisitor::visit_varassign(NodePtr<VarAssignNode>& node)
+{
+  auto body = unwrap_err(visit(node->body()));
+  node->body(body);
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+SimplifyVisitor::visit_fcall(NodePtr<FcallNode>& node)
+{
+  for (auto& arg : node->args()) {
+    arg = unwrap_err(visit(arg));
+  }
+
+  if (_fast_math) {
+    if (auto* inner = _inverse(node); inner != nullptr) {
+      return error::ok<NodePtr<>>(inner);
+    }
+  }
+
+  if (_calls(node, POW)) {
+    return error::ok<NodePtr<>>(_pow(node));
+  }
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+SimplifyVisitor::visit_fdef(NodePtr<FdefNode>& node)
+{
+  auto visitor = SimplifyVisitor{ *_arena, nullptr, _fast_math };
+  auto body = unwrap_err(visitor.visit(node->body()));
+  node->body(body);
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+SimplifyVisitor::visit_if(NodePtr<IfNode>& node)
+{
+  auto cond = unwrap_err(visit(node->cond()));
+  auto then = unwrap_err(visit(node->then()));
+  auto else_ = unwrap_err(visit(node->else_()));
+  node->cond(cond);
+  node->then(then);
+  node->else_(else_);
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+SimplifyVisitor::visit_import(NodePtr<ProgramImportNode>& node)
+{
+  _late = true;
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+SimplifyVisitor::visit_poly(NodePtr<PolyNode>& node)
+{
+  auto var = unwrap_err(visit(node->var()));
+  node->var(var);
+  for (auto& coeff : node->coeffs()) {
+    coeff = unwrap_err(visit(coeff));
+  }
+
+  return error::ok<NodePtr<>>(node);
+}
+
+error::Result<NodePtr<>>
+SimplifyVisitor::visit_program(NodePtr<ProgramNode>& node)
+{
+  // built-ins the program redefines are never recognized
+  for (auto* stmt : node->statements()) {
+    if (stmt->type() == NodeType::FDEF) {
+      _defined.push_back(static_cast<NodePtr<FdefNode>>(stmt)->symbol());
+    }
+  }
+
+  for (auto& stmt : node->statements()) {
+    stmt = unwrap_err(visit(stmt));
+  }
+
+  return error::ok<NodePtr<>>(node);
+}
+
+NodePtr<>
+SimplifyVisitor::_bin_op(NodePtr<BinaryOpNode> node)
+{
+  auto type = node->type();
+
+  // sums and products commute exactly, keep their constant on the right
+  if ((type == NodeType::BINARY_PLUS || type == NodeType::BINARY_MULTIPLY) &&
+      constant(node->left()) && !constant(node->right())) {
+    auto* left = node->left();
+    node->left(node->right());
+    node->right(left);
+  }
+
+  auto* left = node->left();
+  auto value = constant(node->right());
+  if (!value || constant(left)) {
+    return node;
+  }
+
+  auto rval = *value;
+  switch (type) {
+    case NodeType::BINARY_PLUS:
+      // x + 0 is +0 for x = -0, x + -0 is always x
+      if (rval == 0 && (std::signbit(rval) || _fast_math)) {
+        return left;
+      }
+      if (_fast_math && left->type() == NodeType::BINARY_PLUS) {
+        auto* inner = static_cast<NodePtr<BinaryOpNode>>(left);
+        if (auto lval = constant(inner->right())) {
+          return _binary(type, inner->left(), _number(*lval + rval));
+        }
+      }
+      break;
+    case NodeType::BINARY_MINUS:
+      if (rval == 0 && (!std::signbit(rval) || _fast_math)) {
+        return left;
+      }
+      if (_fast_math) {
+        return _binary(NodeType::BINARY_PLUS, left, _number(-rval));
+      }
+      break;
+    case NodeType::BINARY_MULTIPLY:
+      if (rval == 1) {
+        return left;
+      }
+      if (rval == -1) {
+        return _negate(_arena->make<UnaryOpNode>(NodeType::UNARY_MINUS, left));
+      }
+      if (_fast_math && left->type() == NodeType::BINARY_MULTIPLY) {
+        auto* inner = static_cast<NodePtr<BinaryOpNode>>(left);
+        if (auto lval = constant(inner->right())) {
+          return _binary(type, inner->left(), _number(*lval * rval));
+        }
+      }
+      break;
+    case NodeType::BINARY_DIVIDE:
+      if (rval == 1) {
+        return left;
+      }
+      if (rval == -1) {
+        return _negate(_arena->make<UnaryOpNode>(NodeType::UNARY_MINUS, left));
+      }
+      if (power_of_two(rval) ||
+          (_fast_math && std::isfinite(rval) && std::isnormal(1 / rval))) {
+        return _binary(NodeType::BINARY_MULTIPLY, left, _number(1 / rval));
+      }
+      break;
+    default:
+      break;
+  }
+
+  return node;
+}
+
+NodePtr<>
+SimplifyVisitor::_pow(NodePtr<FcallNode> node)
+{
+  auto args = node->args();
+  auto* base = args[0];
+  auto value = constant(args[1]);
+  if (!value) {
+    return node;
+  }
+
+  // only pow(x, 1) is exact, pow need not round like the rewritten form
+  auto exponent = *value;
+  if (exponent == 1) {
+    return base;
+  }
+  if (!_fast_math) {
+    return node;
+  }
+  if (exponent == -1) {
+    return _arena->make<BinaryOpNode>(
+      NodeType::BINARY_DIVIDE, _number(1), base);
+  }
+
+  if (exponent == 0.5) {
+    auto sqrt = symbols().find("sqrt");
+    if (sqrt != NO_SYMBOL && _reaches(sqrt, 1, SQRT)) {
+      node->symbol(sqrt);
+      node->args(args.first(1));
+    }
+    return node;
+  }
+
+  if (exponent != std::trunc(exponent) || std::abs(exponent) < 2 ||
+      std::abs(exponent) > MAX_POWER) {
+    return node;
+  }
+
+  NodePtr<> product = _copy(base);
+  if (product == nullptr) {
+    return node;
+  }
+  for (auto i = 1; i < static_cast<int>(std::abs(exponent)); ++i) {
+    product = _arena->make<BinaryOpNode>(
+      NodeType::BINARY_MULTIPLY, product, _copy(base));
+  }
+
+  if (exponent < 0) {
+    return _arena->make<BinaryOpNode>(
+      NodeType::BINARY_DIVIDE, _number(1), product);
+  }
+
+  return product;
+}
+
+NodePtr<>
+SimplifyVisitor::_inverse(NodePtr<FcallNode> node)
+{
+  auto args = node->args();
+
+  // exp(log(e, x)) and log(e, exp(x))
+  if (_calls(node, EXP) && _calls(args[0], LOG)) {
+    auto inner = static_cast<NodePtr<FcallNode>>(args[0])->args();
+    return constant(inner[0]) == M_E ? inner[1] : nullptr;
+  }
+  if (_calls(node, LOG) && _calls(args[1], EXP)) {
+    auto inner = static_cast<NodePtr<FcallNode>>(args[1])->args();
+    return constant(args[0]) == M_E ? inner[0] : nullptr;
+  }
+
+  // pow(b, log(b, x)) and log(b, pow(b, x))
+  if (_calls(node, POW) && _calls(args[1], LOG)) {
+    auto inner = static_cast<NodePtr<FcallNode>>(args[1])->args();
+    return same(args[0], inner[0]) ? inner[1] : nullptr;
+  }
+  if (_calls(node, LOG) && _calls(args[1], POW)) {
+    auto inner = static_cast<NodePtr<FcallNode>>(args[1])->args();
+    return same(args[0], inner[0]) ? inner[1] : nullptr;
+  }
+
+  return nullptr;
+}
+
+template<typename F>
+bool
+SimplifyVisitor::_calls(NodePtr<> node, const F& fn) const
+{
+  if (node->type() != NodeType::FCALL) {
+    return false;
+  }
+
+  auto* call = static_cast<NodePtr<FcallNode>>(node);
+  return _reaches(call->symbol(), call->args().size(), fn);
+}
+
+template<typename F>
+bool
+SimplifyVisitor::_reaches(SymbolId id,
+                          std::size_t argc,
+                          const F& /*fn*/) const
+{
+  // every built-in has its own closure type, finding it is enough
+  using Thunk = builtins::NativeThunk<typename Signature<F>::type, F>;
+  if (_late || argc != Thunk::ARITY || contains(_defined, id)) {
+    return false;
+  }
+
+  const auto* func = _ctx->find_func(id);
+  return func != nullptr && func->template target<Thunk>() != nullptr;
+}
+
+NodePtr<>
+SimplifyVisitor::_copy(NodePtr<> node)
+{
+  switch (node->type()) {
+    case NodeType::NUMBER:
+      return _number(static_cast<NodePtr<NumberNode>>(node)->value());
+    case NodeType::VARREF: {
+      auto* ref = static_cast<NodePtr<VarRefNode>>(node);
+      auto* copy = _arena->make<VarRefNode>(ref->symbol());
+      copy->binding(ref->binding());
+      return copy;
+    }
+    default:
+      return nullptr;
+  }
+}
+
+NodePtr<>
+SimplifyVisitor::_negate(NodePtr<UnaryOpNode> node)
+{
+  // negation is exact, two of them cancel
+  auto* operand = node->operand();
+  if (operand->type() == NodeType::UNARY_MINUS) {
+    return static_cast<NodePtr<UnaryOpNode>>(operand)->operand();
+  }
+
+  return node;
+}
+
+NodePtr<>
+SimplifyVisitor::_number(double value)
+{
+  return _arena->make<NumberNode>(value);
+}
+
+NodePtr<>
+SimplifyVisitor::_binary(NodeType type, NodePtr<> left, NodePtr<> right)
+{
+  return _bin_op(_arena->make<BinaryOpNode>(type, left, right));
+}
+
+}
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "tcalc/builtins.hpp"
+#include "tcalc/bytecode.hpp"
+#include "tcalc/error.hpp"
+#include "tcalc/eval.hpp"
+#include "tcalc/symbol.hpp"
+#include "tcalc/vm.hpp"
+
+#define __vm_binary_op(lhs, rhs, expr)                                         \
+  {                                                                            \
+    auto rhs = _stack.back();                                                  \
+    _stack.pop_back();                                                         \
+    auto lhs = _stack.back();                                                  \
+    _stack.back() = (expr);                                                    \
+    break;                                                                     \
+  }
+
+#define __vm_unary_op(val, expr)                                               \
+  {                                                                            \
+    auto val = _stack.back();                                                  \
+    _stack.back() = (expr);                                                    \
+    break;                                                                     \
+  }
+
+namespace tcalc::bytecode {
+
+VM::VM()
+{
+  _stack.reserve(INIT_STACK_SIZE);
+}
+
+error::Result<double>
+VM::run(const Chunk& chunk, EvalContext& ctx)
+{
+  _ctx = &ctx;
+  return _exec(chunk, nullptr);
+}
+
+error::Result<std::vector<double>>
+VM::run_prog(const Chunk& chunk, EvalContext& ctx)
+{
+  _ctx = &ctx;
+  auto results = std::vector<double>{};
+  ret_err(_exec(chunk, &results));
+
+  return error::ok<std::vector<double>>(std::move(results));
+}
+
+error::Result<double>
+VM::_exec(const Chunk& chunk, std::vector<double>* results) // NOLINT
+{
+  _stack.clear();
+  _frames.clear();
+
+  auto frame = Frame{ &chunk, chunk.code().data(), 0, nullptr };
+
+  while (true) {
+    const auto& ins = *frame.pc++;
+
+    switch (ins.op) {
+      case OpCode::CONST:
+        _stack.push_back(frame.chunk->consts()[ins.arg]);
+        break;
+      case OpCode::LOAD:
+        _stack.push_back(unwrap_err(_ctx->global(ins.arg)));
+        break;
+      case OpCode::LOAD_ARG:
+        _stack.push_back(_stack[frame.base + ins.arg]);
+        break;
+      case OpCode::STORE:
+        _ctx->global(ins.arg, _stack.back());
+        break;
+      case OpCode::ADD:
+        __vm_binary_op(lhs, rhs, lhs + rhs);
+      case OpCode::SUB:
+        __vm_binary_op(lhs, rhs, lhs - rhs);
+      case OpCode::MUL:
+        __vm_binary_op(lhs, rhs, lhs * rhs);
+      case OpCode::DIV:
+        __vm_binary_op(lhs, rhs, lhs / rhs);
+      case OpCode::EQ:
+        __vm_binary_op(lhs, rhs, _double_eq(lhs, rhs));
+      case OpCode::NE:
+        __vm_binary_op(lhs, rhs, _double_noeq(lhs, rhs));
+      case OpCode::GT:
+        __vm_binary_op(lhs, rhs, lhs > rhs);
+      case OpCode::GE:
+        __vm_binary_op(lhs, rhs, lhs >= rhs);
+      case OpCode::LT:
+        __vm_binary_op(lhs, rhs, lhs < rhs);
+      case OpCode::LE:
+        __vm_binary_op(lhs, rhs, lhs <= rhs);
+      case OpCode::POS:
+        break;
+      case OpCode::NEG:
+        __vm_unary_op(val, -val);
+      case OpCode::NOT:
+        __vm_unary_op(val, val == 0);
+      case OpCode::FMA: {
+        auto addend = _stack.back();
+        _stack.pop_back();
+        auto var = _stack.back();
+        _stack.pop_back();
+        _stack.back() = std::fma(_stack.back(), var, addend);
+        break;
+      }
+      case OpCode::JUMP:
+        frame.pc = frame.chunk->code().data() + ins.arg;
+        break;
+      case OpCode::JUMP_IF_FALSE: {
+        auto cond = _stack.back();
+        _stack.pop_back();
+        if (!_double_noeq(cond, 0)) {
+          frame.pc = frame.chunk->code().data() + ins.arg;
+        }
+        break;
+      }
+      case OpCode::AND_JUMP:
+        if (_stack.back() == 0) {
+          _stack.back() = 0;
+          frame.pc = frame.chunk->code().data() + ins.arg;
+        } else {
+          _stack.pop_back();
+        }
+        break;
+      case OpCode::OR_JUMP:
+        if (_stack.back() != 0) {
+          _stack.back() = 1;
+          frame.pc = frame.chunk->code().data() + ins.arg;
+        } else {
+          _stack.pop_back();
+        }
+        break;
+      case OpCode::TRUTH:
+        __vm_unary_op(val, val != 0);
+      case OpCode::CALL:
+      case OpCode::TAIL_CALL: {
+        const auto& site = frame.chunk->calls()[ins.arg];
+        auto func = unwrap_err(_ctx->func(site.symbol, site.argc, site.cache));
+
+        const auto* wrapper = func.get().target<builtins::FunctionWrapper>();
+        if (wrapper == nullptr || wrapper->chunk() == nullptr) {
+          auto res = unwrap_err(_call_generic(func, site.argc));
+          _stack.push_back(res);
+          break;
+        }
+
+        if (site.argc != wrapper->node()->args().size()) {
+          return error::err(error::Code::MISMATCHED_ARGS,
+                            "Wrong number of arguments, expected %zu, got %zu",
+                            wrapper->node()->args().size(),
+                            static_cast<std::size_t>(site.argc));
+        }
+
+        const auto& node = wrapper->node();
+        auto argv = std::span<const double>{ _stack }.last(site.argc);
+        const auto* hit = _ctx->memo_find(node->symbol(), node, argv);
+        if (hit != nullptr) {
+          auto value = *hit;
+          _stack.resize(_stack.size() - site.argc);
+          _stack.push_back(value);
+          break;
+        }
+
+        if (ins.op == OpCode::TAIL_CALL) {
+          // the callee takes over the frame, its arguments move to the base
+          std::copy(_stack.end() - site.argc,
+                    _stack.end(),
+                    _stack.begin() + static_cast<std::ptrdiff_t>(frame.base));
+          _stack.resize(frame.base + site.argc);
+          frame = Frame{ wrapper->chunk().get(),
+                         wrapper->chunk()->code().data(),
+                         frame.base,
+                         wrapper };
+          break;
+        }
+
+        if (_frames.size() + 1 + _ctx->call_depth() >=
+            EvalContext::MAX_CALL_DEPTH) {
+          auto name = symbols().name(site.symbol);
+          return error::err(
+            error::Code::RECURSION_LIMIT,
+            "Function call `%.*s' exceeded maximum recursion depth",
+            static_cast<int>(name.size()),
+            name.data());
+        }
+
+        _frames.push_back(frame);
+        frame = Frame{ wrapper->chunk().get(),
+                       wrapper->chunk()->code().data(),
+                       _stack.size() - site.argc,
+                       wrapper };
+        break;
+      }
+      case OpCode::DEF: {
+        const auto& proto = frame.chunk->protos()[ins.arg];
+        _ctx->func(
+          proto.node->symbol(),
+          builtins::FunctionWrapper{ proto.arena, proto.node, proto.chunk },
+          { proto.node->args().size(), false });
+        _stack.push_back(0);
+        break;
+      }
+      case OpCode::IMPORT: {
+        auto wrapper =
+          builtins::ImportWrapper{ frame.chunk->imports()[ins.arg] };
+        ret_err(wrapper.import(*_ctx));
+        _stack.push_back(0);
+        break;
+      }
+      case OpCode::YIELD:
+        if (results != nullptr) {
+          results->push_back(_stack.back());
+        }
+        _stack.pop_back();
+        break;
+      case OpCode::RETURN: {
+        auto ret = _stack.back();
+        if (_frames.empty()) {
+          return error::ok<double>(ret);
+        }
+
+        // after tail calls the frame holds the arguments of the last callee
+        const auto& node = frame.func->node();
+        _ctx->memo_store(
+          node->symbol(),
+          node,
+          std::span<const double>{ _stack }.subspan(frame.base,
+                                                    node->args().size()),
+          ret);
+
+        _stack.resize(frame.base);
+        _stack.push_back(ret);
+
+        frame = _frames.back();
+        _frames.pop_back();
+        break;
+      }
+    }
+  }
+}
+
+error::Result<double>
+VM::_call_generic(const builtins::Function& func, std::size_t argc)
+{
+  // the arguments are passed in place, callees never touch the VM stack
+  auto res = func(std::span<const double>{ _stack }.last(argc), *_ctx);
+  _stack.resize(_stack.size() - argc);
+
+  return res;
+}
+
+bool
+VM::_double_eq(double a, double b)
+{
+  return std::abs(a - b) < std::numeric_limits<double>::epsilon();
+}
+
+bool
+VM::_double_noeq(double a, double b)
+{
+  return std::abs(a - b) > std::numeric_limits<double>::epsilon();
+}
+
+}
@@ -1,5 +1,9 @@
 #include <gtest/gtest.h>
+#include <sstream>
 #include <tcalc/parser.hpp>
+#include <tcalc/visitor/base.hpp>
+#include <tcalc/visitor/flat_print.hpp>
+#include <tcalc/visitor/print.hpp>
 
 namespace {
 
@@ -52,4 +56,185 @@ TEST(ParserTest, MultipleStatements)
   EXPECT_TRUE(res.has_value());
 }
 
+TEST(ParserTest, Precedence)
+{
+  auto parser = tcalc::ast::Parser{};
+
+  auto res = parser.parse("1 - 2 - 3 * 4 / 5 == 6 && !7 || 8; import m;");
+  EXPECT_TRUE(res.has_value());
+
+  auto out = std::stringstream{};
+  auto printer = tcalc::ast::PrintVisitor{ out };
+  EXPECT_TRUE(printer.visit(res.value().root()).has_value());
+
+  EXPECT_EQ(out.str(),
+            "PROGRAM:\n"
+            "  BINARY_OR:\n"
+            "    BINARY_AND:\n"
+            "      BINARY_EQUAL:\n"
+            "        BINARY_MINUS:\n"
+            "          BINARY_MINUS:\n"
+            "            NUMBER: 1:\n"
+            "            NUMBER: 2:\n"
+            "          BINARY_DIVIDE:\n"
+            "            BINARY_MULTIPLY:\n"
+            "              NUMBER: 3:\n"
+            "              NUMBER: 4:\n"
+            "            NUMBER: 5:\n"
+            "        NUMBER: 6:\n"
+            "      UNARY_NOT:\n"
+            "        NUMBER: 7:\n"
+            "    NUMBER: 8:\n"
+            "  IMPORT: m:\n");
+
+  // semicolons only terminate statements
+  EXPECT_FALSE(parser.parse("(1;)").has_value());
+  EXPECT_FALSE(parser.parse("1;;").has_value());
+}
+
+TEST(ParserTest, DepthLimit)
+{
+  auto parser = tcalc::ast::Parser{};
+  auto flat_parser = tcalc::ast::FlatParser{};
+  parser.max_depth(4);
+  flat_parser.max_depth(4);
+
+  for (const auto* input :
+       { "((1))", "-f(-1)", "1 + 2 * 3", "1 - 2 + 3 * 4 - 5 + 6 - 7" }) {
+    EXPECT_TRUE(parser.parse(input).has_value()) << input;
+    EXPECT_TRUE(flat_parser.parse(input).has_value()) << input;
+  }
+
+  for (const auto* input : { "(((((1)))))", "- - - -1", "f(g(h(i(1))))" }) {
+    auto res = parser.parse(input);
+    EXPECT_FALSE(res.has_value()) << input;
+    EXPECT_EQ(res.error().code(), tcalc::error::Code::RECURSION_LIMIT);
+
+    auto flat = flat_parser.parse(input);
+    EXPECT_FALSE(flat.has_value()) << input;
+    EXPECT_EQ(flat.error().code(), tcalc::error::Code::RECURSION_LIMIT);
+  }
+
+  // pointer trees are walked recursively, flat trees are not
+  parser.max_depth(tcalc::ast::Parser::MAX_DEPTH * 2);
+  flat_parser.max_depth(tcalc::ast::Parser::MAX_DEPTH * 2);
+  EXPECT_EQ(parser.max_depth(), tcalc::ast::Parser::MAX_DEPTH);
+  EXPECT_EQ(flat_parser.max_depth(), tcalc::ast::Parser::MAX_DEPTH * 2);
+}
+
+TEST(ParserTest, ArenaReuse)
+{
+  auto parser = tcalc::ast::Parser{};
+  auto arena = tcalc::ast::Arena{};
+
+  auto res = parser.parse("def f(x, y) x * y + 1", arena);
+  EXPECT_TRUE(res.has_value());
+
+  auto capacity = arena.capacity();
+  EXPECT_GT(capacity, 0);
+
+  for (int i = 0; i < 100; ++i) {
+    arena.reset();
+    res = parser.parse("def f(x, y) x * y + 1", arena);
+    EXPECT_TRUE(res.has_value());
+  }
+  EXPECT_EQ(arena.capacity(), capacity);
+}
+
+TEST(FlatParserTest, MatchesTree)
+{
+  const auto* input = "import something def func(x, y) if x > y then -x else "
+                      "func(y, x) * 2; let x = 1; let y = !2; func(x, y)";
+
+  auto parser = tcalc::ast::Parser{};
+  auto tree = parser.parse(input);
+  EXPECT_TRUE(tree.has_value());
+
+  auto flat_parser = tcalc::ast::FlatParser{};
+  auto flat = flat_parser.parse(input);
+  EXPECT_TRUE(flat.has_value());
+
+  auto tree_out = std::stringstream{};
+  auto tree_printer = tcalc::ast::PrintVisitor{ tree_out };
+  EXPECT_TRUE(tree_printer.visit(tree.value().root()).has_value());
+
+  auto flat_out = std::stringstream{};
+  auto flat_printer = tcalc::ast::FlatPrintVisitor{ flat.value(), flat_out };
+  EXPECT_TRUE(flat_printer.visit(flat.value().root()).has_value());
+
+  EXPECT_EQ(tree_out.str(), flat_out.str());
+}
+
+TEST(FlatParserTest, Subtree)
+{
+  auto flat_parser = tcalc::ast::FlatParser{};
+  auto flat = flat_parser.parse("let a = 1; def f(x) x + a; f(2)");
+  EXPECT_TRUE(flat.has_value());
+
+  const auto& tree = flat.value();
+  auto stmts = tree.list(tree.node(tree.root()).a);
+  EXPECT_EQ(stmts.size(), 3);
+
+  auto def = tree.subtree(stmts[1]);
+  EXPECT_EQ(def.nodes().size(), 4);
+  EXPECT_EQ(def.node(def.root()).type, tcalc::ast::NodeType::FDEF);
+  EXPECT_EQ(def.name(def.node(def.root()).a), "f");
+}
+
+class CountVisitor : public tcalc::ast::BaseVisitor<void>
+{
+public:
+  std::size_t binops{ 0 };
+  std::size_t numbers{ 0 };
+  std::size_t calls{ 0 };
+
+  tcalc::error::Result<void> visit_program(
+    tcalc::ast::NodePtr<tcalc::ast::ProgramNode>& node) override
+  {
+    for (auto& stmt : node->statements()) {
+      ret_err(visit(stmt));
+    }
+    return tcalc::error::ok<void>();
+  }
+
+  tcalc::error::Result<void> visit_bin_op(
+    tcalc::ast::NodePtr<tcalc::ast::BinaryOpNode>& node) override
+  {
+    ++binops;
+    ret_err(visit(node->left()));
+    return visit(node->right());
+  }
+
+  tcalc::error::Result<void> visit_number(
+    tcalc::ast::NodePtr<tcalc::ast::NumberNode>& /*node*/) override
+  {
+    ++numbers;
+    return tcalc::error::ok<void>();
+  }
+
+  tcalc::error::Result<void> visit_fcall(
+    tcalc::ast::NodePtr<tcalc::ast::FcallNode>& node) override
+  {
+    ++calls;
+    for (auto& arg : node->args()) {
+      ret_err(visit(arg));
+    }
+    return tcalc::error::ok<void>();
+  }
+};
+
+TEST(VisitorTest, Dispatch)
+{
+  auto parser = tcalc::ast::Parser{};
+
+  auto res = parser.parse("1 + 2 * 3 / sqrt(pow(3, 2)) - pi");
+  EXPECT_TRUE(res.has_value());
+
+  auto visitor = CountVisitor{};
+  EXPECT_TRUE(visitor.visit(res.value().root()).has_value());
+  EXPECT_EQ(visitor.binops, 4);
+  EXPECT_EQ(visitor.numbers, 5);
+  EXPECT_EQ(visitor.calls, 2);
+}
+
 }
@@ -1,7 +1,77 @@
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <cstdlib>
 #include <gtest/gtest.h>
 #include <limits>
+#include <new>
+#include <span>
+#include <string>
+#include <string_view>
 #include <tcalc/eval.hpp>
+#include <tcalc/visitor/children.hpp>
+#include <tcalc/visitor/cse.hpp>
+#include <tcalc/visitor/inline.hpp>
+#include <tcalc/visitor/poly.hpp>
+#include <tcalc/visitor/resolve.hpp>
+#include <tcalc/visitor/simplify.hpp>
+#include <vector>
+
+namespace {
+
+std::size_t allocations = 0;
+
+/**
+ * @brief Parse and resolve a program, then run a single pass over it.
+ *
+ * @tparam Pass Callable taking the program as `tcalc::ast::NodePtr<>&`, which
+ * it may replace.
+ * @param input Program string.
+ * @param arena Arena owning the tree.
+ * @param ctx Evaluation context to resolve against.
+ * @param pass Pass to run.
+ * @return tcalc::ast::ProgramNode* Rewritten program.
+ */
+template<typename Pass>
+tcalc::ast::ProgramNode*
+optimize(std::string_view input,
+         tcalc::ast::Arena& arena,
+         const tcalc::EvalContext& ctx,
+         Pass&& pass)
+{
+  auto parser = tcalc::ast::Parser{};
+  auto node = parser.parse(input, arena);
+  EXPECT_TRUE(node.has_value());
+  auto resolver = tcalc::ast::ResolveVisitor{ &ctx };
+  EXPECT_TRUE(resolver.visit(*node).has_value());
+  pass(*node);
+  return static_cast<tcalc::ast::ProgramNode*>(*node);
+}
+
+}
+
+// kept out of line, GCC flags free() on memory from an inlined malloc()
+[[gnu::noinline]] void*
+operator new(std::size_t size)
+{
+  ++allocations;
+  if (auto* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+[[gnu::noinline]] void
+operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+[[gnu::noinline]] void
+operator delete(void* ptr, std::size_t /*size*/) noexcept
+{
+  std::free(ptr);
+}
 
 namespace {
 
@@ -50,6 +120,463 @@ TEST(EvalTest, IfStatement)
   EXPECT_TRUE(std::abs(*res - 1) < std::numeric_limits<double>::epsilon());
 }
 
+TEST(EvalTest, ShortCircuit)
+{
+  auto touched = 0;
+  auto ctx = tcalc::builtins::make_context();
+  ctx.register_fn<double(double)>(
+    "touch",
+    [&touched](double x) {
+      ++touched;
+      return x;
+    },
+    false);
+
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    auto evaluator = tcalc::Evaluator{ ctx };
+    evaluator.engine(engine);
+    touched = 0;
+
+    // the right operand is never evaluated once the left one decides
+    auto res = evaluator.eval_prog(
+      "def forever(x) 1 + forever(x);"
+      "0 && touch(1); 2 || touch(1); 0 && forever(1); 1 || forever(1);"
+      "if 1 then 3 else forever(1)");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value(), (std::vector<double>{ 0, 0, 1, 0, 1, 3 }));
+    EXPECT_EQ(touched, 0);
+
+    res = evaluator.eval_prog("3 && touch(2); 0 || touch(0); 0 || touch(-4)");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value(), (std::vector<double>{ 1, 0, 1 }));
+    EXPECT_EQ(touched, 3);
+  }
+}
+
+TEST(EvalTest, ConstantFolding)
+{
+  auto calls = 0;
+  auto ctx = tcalc::builtins::make_context();
+  ctx.register_fn<double(double)>("square", [&calls](double x) {
+    ++calls;
+    return x * x;
+  });
+
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    auto evaluator = tcalc::Evaluator{ ctx };
+    evaluator.engine(engine);
+    EXPECT_TRUE(evaluator.fold());
+
+    auto res = evaluator.eval_prog(
+      "def forever(x) 1 + forever(x);"
+      "2 * pi * 0.5; if 1 > 0 then square(3) else forever(1);"
+      "def g(x) if 2 > 1 then x * (2 + 3) else forever(x); g(2)");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[1], M_PI);
+    EXPECT_EQ(res.value()[2], 9);
+    EXPECT_EQ(res.value()[4], 10);
+
+    // names the program changes first are not folded
+    res = evaluator.eval_prog("let pi = 3; 2 * pi; def square(x) x; square(4)");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[1], 6);
+    EXPECT_EQ(res.value()[3], 4);
+    EXPECT_FALSE(evaluator.ctx().constant(tcalc::symbols().intern("pi")));
+  }
+
+  // compiled chunks keep folded calls and constants until they change
+  auto evaluator = tcalc::Evaluator{ ctx };
+  calls = 0;
+  EXPECT_EQ(evaluator.eval("square(3) + e").value(), 9 + M_E);
+  EXPECT_EQ(evaluator.eval("square(3) + e").value(), 9 + M_E);
+  EXPECT_EQ(calls, 1);
+
+  EXPECT_TRUE(evaluator.eval("let e = 1").has_value());
+  EXPECT_EQ(evaluator.eval("square(3) + e").value(), 10);
+  EXPECT_TRUE(evaluator.eval("def square(x) x").has_value());
+  EXPECT_EQ(evaluator.eval("square(3) + e").value(), 4);
+
+  evaluator = tcalc::Evaluator{ ctx };
+  evaluator.fold(false);
+  calls = 0;
+  EXPECT_EQ(evaluator.eval("square(3)").value(), 9);
+  EXPECT_EQ(evaluator.eval("square(3)").value(), 9);
+  EXPECT_EQ(calls, 2);
+}
+
+TEST(EvalTest, CommonSubexpressions)
+{
+  auto calls = 0;
+  auto ctx = tcalc::builtins::make_context();
+  ctx.register_fn<double(double, double)>("norm", [&calls](double a, double b) {
+    ++calls;
+    return std::sqrt((a * a) + (b * b));
+  });
+
+  for (auto engine : { tcalc::Engine::TREE, tcalc::Engine::VM }) {
+    auto evaluator = tcalc::Evaluator{ ctx };
+    evaluator.engine(engine);
+    EXPECT_TRUE(evaluator.cse());
+    calls = 0;
+
+    auto res = evaluator.eval_prog(
+      "let a = 3; let b = 4; norm(a, b) * 2 + norm(a, b); norm(a, b) - 1;"
+      "let a = 6; norm(a, b) / norm(a, b); let z = 0;"
+      "z && norm(b, b); norm(b, b) + norm(b, b)");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value(),
+              (std::vector<double>{ 3, 4, 15, 4, 6, 1, 0, 0, 8 * M_SQRT2 }));
+
+    // once before and once after the let, the skipped call does not count
+    EXPECT_EQ(calls, 3);
+
+    // temporaries do not outlive the run, even when it fails
+    EXPECT_FALSE(
+      evaluator.eval_prog("def h(n) 1 + h(n); norm(a, b) + norm(a, b) + h(0)")
+        .has_value());
+    for (std::size_t i = 0; i < 4; ++i) {
+      EXPECT_FALSE(evaluator.ctx().defined(tcalc::temp_symbol(i)));
+    }
+
+    // user names never reach a temporary, even quoted
+    for (const auto* name : { "'$cse0'", "'$t0'" }) {
+      auto src = std::string{ "let x = 2; let " } + name +
+                 " = 100; (x*x+1)*(x*x+1) + " + name + "; " + name;
+      res = evaluator.eval_prog(src);
+      EXPECT_TRUE(res.has_value());
+      EXPECT_EQ(res.value(), (std::vector<double>{ 2, 100, 125, 100 }));
+    }
+
+    // past the reserved temporaries subexpressions are computed again
+    auto many = std::string{};
+    for (std::size_t i = 0; i < tcalc::TEMP_COUNT + 8; ++i) {
+      auto term = "norm(x, " + std::to_string(i) + ")";
+      many += term + " - " + term + ";";
+    }
+    res = evaluator.eval_prog(many);
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value(), std::vector<double>(tcalc::TEMP_COUNT + 8, 0));
+
+    // running known names again interns nothing, temporaries included
+    auto symbols = tcalc::symbols().size();
+    EXPECT_TRUE(evaluator.eval_prog(many).has_value());
+    EXPECT_EQ(tcalc::symbols().size(), symbols);
+
+    evaluator.cse(false);
+    calls = 0;
+    EXPECT_EQ(evaluator.eval("norm(a, b) + norm(a, b)").value(),
+              2 * std::sqrt(52));
+    EXPECT_EQ(calls, 2);
+  }
+
+  ctx.var("a", 3);
+  ctx.var("b", 4);
+  auto arena = tcalc::ast::Arena{};
+  auto pass = tcalc::ast::CsePass{};
+  auto* program = optimize(
+    "sqrt(pow(a, 2) + pow(b, 2)) + sqrt(pow(a, 2) + pow(b, 2))",
+    arena,
+    ctx,
+    [&](tcalc::ast::NodePtr<>& node) {
+      // the second root loses 8 nodes for a load, storing the first costs one
+      EXPECT_EQ(pass.run(node, arena, ctx), 6);
+    });
+
+  const auto* root =
+    static_cast<tcalc::ast::BinaryOpNode*>(program->statements()[0]);
+  EXPECT_EQ(root->left()->type(), tcalc::ast::NodeType::VARASSIGN);
+  EXPECT_EQ(root->right()->type(), tcalc::ast::NodeType::VARREF);
+}
+
+TEST(EvalTest, AlgebraicSimplification)
+{
+  auto ctx = tcalc::builtins::make_context();
+  ctx.var("x", 3);
+  ctx.var("z", -0.0);
+
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    auto evaluator = tcalc::Evaluator{ ctx };
+    evaluator.engine(engine);
+    EXPECT_TRUE(evaluator.simplify());
+    EXPECT_FALSE(evaluator.fast_math());
+
+    auto res = evaluator.eval_prog(
+      "pow(x, 2); x / 4; x * 1 - 0; - -x; pow(x, -1); 1 / (z + 0)");
+    EXPECT_TRUE(res.has_value());
+    auto inf = std::numeric_limits<double>::infinity();
+    EXPECT_EQ(res.value(),
+              (std::vector<double>{ 9, 0.75, 3, 3, 1.0 / 3, inf }));
+
+    evaluator.fast_math(true);
+    res = evaluator.eval_prog(
+      "(x + 1) + 2; x * 2 * 3; pow(x, 3); pow(x, 0.5); exp(log(e, x))");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[0], 6);
+    EXPECT_EQ(res.value()[1], 18);
+    EXPECT_EQ(res.value()[2], 27);
+    EXPECT_DOUBLE_EQ(res.value()[3], std::sqrt(3));
+    EXPECT_DOUBLE_EQ(res.value()[4], 3);
+
+    // a program redefining a built-in keeps its calls
+    res = evaluator.eval_prog("def pow(a, b) a + b; pow(x, 2)");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[1], 5);
+  }
+
+  auto arena = tcalc::ast::Arena{};
+  auto simplify = [&](std::string_view input, bool fast_math) {
+    auto simplifier = tcalc::ast::SimplifyVisitor{ arena, &ctx, fast_math };
+    auto* program =
+      optimize(input, arena, ctx, [&](tcalc::ast::NodePtr<>& node) {
+        node = *simplifier.visit(node);
+      });
+    return program->statements()[0];
+  };
+
+  using tcalc::ast::NodeType;
+  EXPECT_EQ(simplify("x * 1 - 0", false)->type(), NodeType::VARREF);
+  EXPECT_EQ(simplify("- -x", false)->type(), NodeType::VARREF);
+  EXPECT_EQ(simplify("pow(x, 1)", false)->type(), NodeType::VARREF);
+  EXPECT_EQ(simplify("x / 4", false)->type(), NodeType::BINARY_MULTIPLY);
+
+  // rewrites which may round differently wait for fast math
+  EXPECT_EQ(simplify("x / 3", false)->type(), NodeType::BINARY_DIVIDE);
+  EXPECT_EQ(simplify("x + 0", false)->type(), NodeType::BINARY_PLUS);
+  EXPECT_EQ(simplify("pow(x, 2)", false)->type(), NodeType::FCALL);
+  EXPECT_EQ(simplify("pow(x, 3)", false)->type(), NodeType::FCALL);
+  EXPECT_EQ(simplify("x + 0", true)->type(), NodeType::VARREF);
+  EXPECT_EQ(simplify("pow(x, 2)", true)->type(), NodeType::BINARY_MULTIPLY);
+  EXPECT_EQ(simplify("pow(x, 3)", true)->type(), NodeType::BINARY_MULTIPLY);
+  EXPECT_EQ(simplify("pow(2, log(2, x))", true)->type(), NodeType::VARREF);
+
+  auto* sum =
+    static_cast<tcalc::ast::BinaryOpNode*>(simplify("1 + x + 2", true));
+  EXPECT_EQ(sum->right()->type(), NodeType::NUMBER);
+  EXPECT_EQ(static_cast<tcalc::ast::NumberNode*>(sum->right())->value(), 3);
+}
+
+TEST(EvalTest, PolynomialRecognition)
+{
+  auto ctx = tcalc::builtins::make_context();
+  ctx.var("x", 1.5);
+  ctx.var("y", -0.5);
+  ctx.var("a", 2);
+  ctx.var("b", 3);
+  ctx.var("c", 4);
+  ctx.var("d", 5);
+
+  auto horner = std::fma(std::fma(std::fma(2.0, 1.5, 3.0), 1.5, 4.0), 1.5, 5.0);
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    auto evaluator = tcalc::Evaluator{ ctx };
+    evaluator.engine(engine);
+    evaluator.fast_math(true);
+
+    auto res = evaluator.eval_prog("a*x*x*x + b*x*x + c*x + d; "
+                                   "x*x*y + 2*x*y*y - (x - y) * (x + y); "
+                                   "def p(t) 3*t*t + 2*t + 1; p(2)");
+    EXPECT_TRUE(res.has_value());
+    // the flat engine evaluates the expression as written
+    if (engine == tcalc::Engine::FLAT) {
+      EXPECT_DOUBLE_EQ(res.value()[0], horner);
+    } else {
+      EXPECT_EQ(res.value()[0], horner);
+    }
+    EXPECT_DOUBLE_EQ(res.value()[1], 1.5 * 1.5 * -0.5 + 2 * 1.5 * 0.25 - 2);
+    EXPECT_EQ(res.value()[3], 17);
+
+    // a shared coefficient is stored by the first one Horner's scheme reads
+    res = evaluator.eval_prog("let q = 7; sqrt(q*q) + sqrt(q*q)");
+    EXPECT_TRUE(res.has_value());
+    res = evaluator.eval_prog("let x = 2; let a = 3; let b = 5; "
+                              "x*x*(a*b) + x*(a*b) + (a*b)");
+    ASSERT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[3], 105);
+  }
+
+  auto arena = tcalc::ast::Arena{};
+  auto recognize = [&](std::string_view input) {
+    auto poly = tcalc::ast::PolyVisitor{ arena };
+    auto* program =
+      optimize(input, arena, ctx, [&](tcalc::ast::NodePtr<>& node) {
+        node = *poly.visit(node);
+      });
+    return program->statements()[0];
+  };
+
+  using tcalc::ast::NodeType;
+  auto* cubic = recognize("a*x*x*x + b*x*x + c*x + d");
+  EXPECT_EQ(cubic->type(), NodeType::POLY);
+  EXPECT_EQ(static_cast<tcalc::ast::PolyNode*>(cubic)->coeffs().size(), 4);
+
+  // Horner's scheme would not save an operation
+  EXPECT_EQ(recognize("x * x")->type(), NodeType::BINARY_MULTIPLY);
+  EXPECT_EQ(recognize("x + sin(x) * x")->type(), NodeType::BINARY_PLUS);
+
+  // a kept chain is not tried again, the arguments of its calls are
+  auto* sum = static_cast<tcalc::ast::BinaryOpNode*>(
+    recognize("sin(x*x*x + x*x + x) + x*x*x + x*x + sin(y)"));
+  EXPECT_EQ(sum->type(), NodeType::BINARY_PLUS);
+  auto* call = static_cast<tcalc::ast::BinaryOpNode*>(
+    static_cast<tcalc::ast::BinaryOpNode*>(sum->left())->left())->left();
+  EXPECT_EQ(call->type(), NodeType::FCALL);
+  EXPECT_EQ(static_cast<tcalc::ast::FcallNode*>(call)->args()[0]->type(),
+            NodeType::POLY);
+
+  // expanding must not multiply the size of the tree
+  auto factors = std::string{ "x" };
+  auto terms = std::string{ "a0" };
+  auto chain = std::string{ "a0*x" };
+  for (auto i = 0; i < 16; ++i) {
+    auto name = "a" + std::to_string(i);
+    ctx.var(name, i);
+    if (i > 0) {
+      factors = "(" + factors + " + 1) * x";
+      terms += " + " + name;
+    }
+  }
+  for (auto i = 1; i < 4000; ++i) {
+    auto name = "v" + std::to_string(i);
+    ctx.var(name, i);
+    chain += " + " + name + "*x";
+  }
+  auto product = std::string{ "(x + a0)" };
+  for (auto i = 1; i < 16; ++i) {
+    product += " * (x + a" + std::to_string(i) + ")";
+  }
+  for (const auto& input :
+       { product, "(" + factors + ") * (" + terms + ")", chain }) {
+    auto* parsed = optimize(
+      input, arena, ctx, [](tcalc::ast::NodePtr<>& /*node*/) {});
+    auto size = tcalc::ast::tree_size(parsed->statements()[0]);
+    EXPECT_LE(tcalc::ast::tree_size(recognize(input)),
+              (tcalc::ast::PolyVisitor::MAX_GROWTH + 1) * size);
+  }
+  EXPECT_EQ(recognize(product)->type(), NodeType::BINARY_MULTIPLY);
+}
+
+TEST(EvalTest, FunctionInlining)
+{
+  auto ticks = 0;
+  auto ctx = tcalc::builtins::make_context();
+  ctx.func(
+    "tick",
+    [&ticks](std::span<const double> /*args*/, tcalc::EvalContext& /*ctx*/)
+      -> tcalc::error::Result<double> { return ++ticks; },
+    { 0, false });
+
+  for (auto engine : { tcalc::Engine::TREE, tcalc::Engine::VM }) {
+    auto evaluator = tcalc::Evaluator{ ctx };
+    evaluator.engine(engine);
+    EXPECT_EQ(evaluator.inline_budget(),
+              tcalc::ast::InlinePass::DEFAULT_BUDGET);
+
+    auto res = evaluator.eval_prog("def sq(x) x * x; "
+                                   "def norm(a, b) sqrt(sq(a) + sq(b)); "
+                                   "let y = 3; norm(y, 4)");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[3], 5);
+
+    // code inlining a function is compiled again once it is redefined, the
+    // body of norm was stored with its call of sq and sees the new one too
+    const auto* input = "norm(y, 4) + sq(2)";
+    EXPECT_EQ(*evaluator.eval(input), 9);
+    EXPECT_TRUE(evaluator.eval_prog("def sq(x) x * x * x").has_value());
+    EXPECT_EQ(*evaluator.eval(input), std::sqrt(27.0 + 64) + 8);
+
+    // an argument with effects is evaluated once
+    ticks = 0;
+    res = evaluator.eval_prog("def twice(x) x + x; twice(tick())");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[1], 2);
+    EXPECT_EQ(ticks, 1);
+  }
+
+  ctx.var("y", 2);
+
+  auto arena = tcalc::ast::Arena{};
+  auto pass = tcalc::ast::InlinePass{};
+  auto inline_last = [&](std::string_view input, std::size_t budget) {
+    auto* program =
+      optimize(input, arena, ctx, [&](tcalc::ast::NodePtr<>& node) {
+        pass.run(node, arena, ctx, budget);
+      });
+    return program->statements().back();
+  };
+
+  using tcalc::ast::NodeType;
+  EXPECT_EQ(inline_last("def sq(x) x * x; sq(y)", 16)->type(),
+            NodeType::BINARY_MULTIPLY);
+  EXPECT_EQ(inline_last("def sq(x) x * x; sq(y)", 2)->type(), NodeType::FCALL);
+
+  // the argument would be computed twice
+  EXPECT_EQ(inline_last("def sq(x) x * x; sq(y + 1)", 16)->type(),
+            NodeType::FCALL);
+  EXPECT_EQ(
+    inline_last("def f(n) if n <= 0 then 0 else f(n - 1); f(3)", 16)->type(),
+    NodeType::FCALL);
+
+  // calls inside a function body are left alone, a later definition of the
+  // callee must still reach them
+  auto* def = static_cast<tcalc::ast::FdefNode*>(
+    inline_last("def sq(x) x * x; def f(y) sq(y) + 1", 16));
+  EXPECT_EQ(def->type(), NodeType::FDEF);
+  const auto* sum = static_cast<tcalc::ast::BinaryOpNode*>(def->body());
+  EXPECT_EQ(sum->left()->type(), NodeType::FCALL);
+}
+
+TEST(EvalTest, OptimizationLevels)
+{
+  using tcalc::OptLevel;
+  using tcalc::Pass;
+
+  static_assert(tcalc::pass_name(Pass::INLINE) == "inline");
+  static_assert(tcalc::pass_name(Pass::CSE) == "cse");
+
+  for (auto engine : { tcalc::Engine::TREE, tcalc::Engine::VM }) {
+    auto evaluator = tcalc::Evaluator{};
+    evaluator.engine(engine);
+    EXPECT_EQ(evaluator.opt_level(), OptLevel::O2);
+    EXPECT_TRUE(evaluator.pass(Pass::INLINE));
+    EXPECT_TRUE(evaluator.pass(Pass::CSE));
+
+    evaluator.opt_level(OptLevel::O1);
+    EXPECT_TRUE(evaluator.fold());
+    EXPECT_TRUE(evaluator.simplify());
+    EXPECT_FALSE(evaluator.cse());
+    EXPECT_EQ(evaluator.inline_budget(), 0);
+
+    evaluator.opt_level(OptLevel::O0);
+    evaluator.collect_stats(true);
+    EXPECT_EQ(*evaluator.eval("2 * 3 + 1"), 7);
+    for (std::size_t i = 0; i < tcalc::PASS_COUNT; ++i) {
+      auto pass = static_cast<Pass>(i);
+      EXPECT_FALSE(evaluator.pass(pass));
+      EXPECT_EQ(evaluator.passes().stats(pass).runs, 0);
+    }
+
+    // a single pass can be switched on top of the level
+    evaluator.pass(Pass::FOLD, true);
+    EXPECT_EQ(*evaluator.eval("2 * 3 + 1"), 7);
+    const auto& fold = evaluator.passes().stats(Pass::FOLD);
+    EXPECT_EQ(fold.runs, 1);
+    EXPECT_LT(fold.nodes_after, fold.nodes_before);
+
+    evaluator.opt_level(OptLevel::O2);
+    evaluator.pass(Pass::CSE, false);
+    EXPECT_FALSE(evaluator.cse());
+    EXPECT_TRUE(evaluator.pass(Pass::SIMPLIFY));
+    auto res = evaluator.eval_prog("def sq(x) x * x; let y = 3; sq(y) + 1");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[2], 10);
+    EXPECT_EQ(evaluator.passes().stats(Pass::INLINE).runs, 1);
+    EXPECT_EQ(evaluator.passes().stats(Pass::CSE).runs, 0);
+  }
+}
+
 TEST(EvalTest, ImportStatement)
 {
   auto evaluator = tcalc::Evaluator{};
@@ -75,4 +602,400 @@ TEST(EvalTest, MultipleStatements)
   EXPECT_TRUE(std::abs(values[3] - 3) < std::numeric_limits<double>::epsilon());
 }
 
+TEST(EvalTest, DefinitionOutlivesInput)
+{
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    auto evaluator = tcalc::Evaluator{};
+    evaluator.engine(engine);
+
+    EXPECT_TRUE(evaluator.eval("def square(x) x * x").has_value());
+    for (int i = 0; i < 10; ++i) {
+      EXPECT_TRUE(evaluator.eval("let y = 1 + 2 * 3").has_value());
+    }
+
+    auto res = evaluator.eval("square(y)");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_TRUE(std::abs(*res - 49) < std::numeric_limits<double>::epsilon());
+  }
+}
+
+TEST(EvalTest, CallFrames)
+{
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    auto evaluator = tcalc::Evaluator{};
+    evaluator.engine(engine);
+
+    // parameters are only visible in their own function body
+    auto res = evaluator.eval_prog(
+      "let x = 1; def g() x; def f(x) g() + x; f(5); x");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[3], 6);
+    EXPECT_EQ(res.value()[4], 1);
+
+    // frames are popped when a call fails
+    auto err = evaluator.eval_prog("def h(n) 1 + h(n + 1); h(0)");
+    EXPECT_FALSE(err.has_value());
+    EXPECT_EQ(err.error().code(), tcalc::error::Code::RECURSION_LIMIT);
+    EXPECT_EQ(evaluator.ctx().call_depth(), 0);
+
+    auto mismatched = evaluator.eval("f(1, 2)");
+    EXPECT_FALSE(mismatched.has_value());
+    EXPECT_EQ(mismatched.error().code(), tcalc::error::Code::MISMATCHED_ARGS);
+    EXPECT_EQ(evaluator.ctx().call_depth(), 0);
+  }
+}
+
+TEST(EvalTest, TailCalls)
+{
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    auto evaluator = tcalc::Evaluator{};
+    evaluator.engine(engine);
+
+    // far deeper than the call depth limit
+    auto res = evaluator.eval_prog(
+      "def loop(i, acc) if i == 0 then acc else loop(i - 1, acc + i);"
+      "def even(n) if n == 0 then 1 else odd(n - 1);"
+      "def odd(n) if n == 0 then 0 else even(n - 1);"
+      "loop(100000, 0); even(10001)");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[3], 5000050000);
+    EXPECT_EQ(res.value()[4], 0);
+    EXPECT_EQ(evaluator.ctx().call_depth(), 0);
+
+    // iterations reuse the frame, the cost does not depend on the count
+    EXPECT_TRUE(evaluator.eval("let n = 10").has_value());
+    EXPECT_TRUE(evaluator.eval("loop(n, 0)").has_value());
+    auto before = allocations;
+    EXPECT_TRUE(evaluator.eval("loop(n, 0)").has_value());
+    auto short_loop = allocations - before;
+
+    EXPECT_TRUE(evaluator.eval("let n = 10000").has_value());
+    before = allocations;
+    EXPECT_TRUE(evaluator.eval("loop(n, 0)").has_value());
+    EXPECT_EQ(allocations - before, short_loop);
+
+    auto err = evaluator.eval_prog("def m(x) if x then m(1, 2) else 0; m(1)");
+    EXPECT_FALSE(err.has_value());
+    EXPECT_EQ(err.error().code(), tcalc::error::Code::MISMATCHED_ARGS);
+    EXPECT_EQ(evaluator.ctx().call_depth(), 0);
+  }
+}
+
+TEST(EvalTest, Memoize)
+{
+  auto ticks = 0.0;
+  auto ctx = tcalc::builtins::make_context();
+  ctx.register_fn<double()>("tick", [&ticks]() { return ticks++; }, false);
+  ctx.memoize(256);
+
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    auto evaluator = tcalc::Evaluator{ ctx };
+    evaluator.engine(engine);
+
+    // exponential without the memo tables
+    auto res = evaluator.eval_prog(
+      "def fib(n) if n <= 1 then n else fib(n - 1) + fib(n - 2); fib(60)");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[1], 1548008755920);
+    EXPECT_GT(evaluator.ctx().memo_stats().hits, 0);
+    EXPECT_LE(evaluator.ctx().memo_stats().misses, 61);
+
+    // globals and callees are dependencies
+    res = evaluator.eval_prog("def g(x) x * k; def h(x) g(x) + 1; let k = 2;"
+                              "h(3); let k = 3; h(3); def g(x) x; h(3)");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[3], 7);
+    EXPECT_EQ(res.value()[5], 10);
+    EXPECT_EQ(res.value()[7], 4);
+
+    auto deps = evaluator.ctx().dependencies(tcalc::symbols().intern("h"));
+    EXPECT_TRUE(deps.pure);
+    EXPECT_EQ(deps.calls.size(), 2);
+    EXPECT_TRUE(deps.globals.empty());
+
+    // impure host functions make their callers impure
+    auto misses = evaluator.ctx().memo_stats().misses;
+    res = evaluator.eval_prog("def t(x) tick() + x; t(0) == t(0)");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[1], 0);
+    EXPECT_EQ(evaluator.ctx().memo_stats().misses, misses);
+    EXPECT_FALSE(
+      evaluator.ctx().dependencies(tcalc::symbols().intern("t")).pure);
+  }
+}
+
+TEST(EvalTest, ResolveGlobals)
+{
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    auto evaluator = tcalc::Evaluator{};
+    evaluator.engine(engine);
+
+    // undefined names are reported before anything runs
+    auto res = evaluator.eval_prog("let q = 5; if 1 then q else undefined");
+    EXPECT_FALSE(res.has_value());
+    EXPECT_EQ(res.error().code(), tcalc::error::Code::UNDEFINED_VAR);
+    EXPECT_FALSE(evaluator.eval("q").has_value());
+
+    // function bodies bind late, rebinding keeps their slots valid
+    res = evaluator.eval_prog("def f() late; let late = 3; f()");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[2], 3);
+
+    EXPECT_TRUE(evaluator.eval("let late = 4").has_value());
+    auto rebound = evaluator.eval("f() + late");
+    EXPECT_TRUE(rebound.has_value());
+    EXPECT_EQ(*rebound, 8);
+  }
+}
+
+TEST(EvalTest, CallCache)
+{
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    auto evaluator = tcalc::Evaluator{};
+    evaluator.engine(engine);
+
+    auto generation = evaluator.ctx().generation();
+    auto res = evaluator.eval_prog("def g() 1; def f() g(); f()");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[2], 1);
+    EXPECT_NE(evaluator.ctx().generation(), generation);
+
+    // redefinitions invalidate call sites which already cached the callee
+    res = evaluator.eval_prog("def g() 2; f()");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value()[1], 2);
+
+    // copies share function bodies but never each other's cache entries
+    auto copy = tcalc::Evaluator{ evaluator.ctx() };
+    copy.engine(engine);
+    EXPECT_NE(copy.ctx().generation(), evaluator.ctx().generation());
+    EXPECT_TRUE(copy.eval("def g() 3").has_value());
+
+    auto copied = copy.eval("f()");
+    EXPECT_TRUE(copied.has_value());
+    EXPECT_EQ(*copied, 3);
+
+    auto original = evaluator.eval("f()");
+    EXPECT_TRUE(original.has_value());
+    EXPECT_EQ(*original, 2);
+  }
+}
+
+TEST(EvalTest, NoCallAllocation)
+{
+  for (auto engine : { tcalc::Engine::TREE, tcalc::Engine::VM }) {
+    auto evaluator = tcalc::Evaluator{};
+    evaluator.engine(engine);
+
+    auto res = evaluator.eval_prog(
+      "def f(n) if n <= 0 then 0 else sin(n) * cos(n) + pow(tan(n), 2) + "
+      "f(n - 1); let x = 0.5");
+    EXPECT_TRUE(res.has_value());
+
+    // the first run grows the stacks to the deepest call
+    const auto* input = "f(100) + sqrt(x) * atan(exp(x))";
+    EXPECT_TRUE(evaluator.eval(input).has_value());
+
+    auto before = allocations;
+    EXPECT_TRUE(evaluator.eval(input).has_value());
+    EXPECT_EQ(allocations, before);
+  }
+}
+
+TEST(EvalTest, VectorFunctionAdapter)
+{
+  auto ctx = tcalc::builtins::make_context();
+  ctx.func("sum",
+           tcalc::builtins::VectorFunctionAdapter{
+             [](const std::vector<double>& args,
+                const tcalc::EvalContext& /*ctx*/)
+               -> tcalc::error::Result<double> {
+               auto sum = 0.0;
+               for (auto arg : args) {
+                 sum += arg;
+               }
+               return sum;
+             } });
+
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    auto evaluator = tcalc::Evaluator{ ctx };
+    evaluator.engine(engine);
+
+    auto res = evaluator.eval("sum(1, 2, sum(3, 4))");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(*res, 10);
+  }
+}
+
+TEST(EvalTest, RegisterFn)
+{
+  auto ctx = tcalc::builtins::make_context();
+  ctx.register_fn<double(double, double)>(
+    "hypot", [](double x, double y) { return std::hypot(x, y); });
+  ctx.register_fn<double(double, double)>("logb",
+                                          &tcalc::builtins::log_base);
+  ctx.register_fn<double(double, double, double)>(
+    "clamp",
+    [](double x, double lo, double hi) { return std::clamp(x, lo, hi); });
+  ctx.register_fn<int(int)>(
+    "ticks", [](int n) { return n * 2; }, false);
+
+  const auto* info = ctx.func_info("clamp");
+  ASSERT_NE(info, nullptr);
+  EXPECT_EQ(info->arity, 3);
+  EXPECT_TRUE(info->pure);
+  EXPECT_FALSE(ctx.func_info("ticks")->pure);
+  EXPECT_EQ(ctx.func_info("undefined"), nullptr);
+
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    auto evaluator = tcalc::Evaluator{ ctx };
+    evaluator.engine(engine);
+
+    auto res = evaluator.eval(
+      "hypot(3, 4) + clamp(7, 0, 2) + ticks(2.5) + logb(2, 8)");
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(*res, 14);
+
+    // mismatched arguments are reported before anything runs
+    auto mismatched = evaluator.eval_prog("let q = 1; pow(1)");
+    EXPECT_FALSE(mismatched.has_value());
+    EXPECT_EQ(mismatched.error().code(), tcalc::error::Code::MISMATCHED_ARGS);
+    EXPECT_FALSE(evaluator.eval("q").has_value());
+
+    // calls in function bodies are checked when they first run
+    EXPECT_TRUE(evaluator.eval("def f(x) hypot(x)").has_value());
+    auto late = evaluator.eval("f(1)");
+    EXPECT_FALSE(late.has_value());
+    EXPECT_EQ(late.error().code(), tcalc::error::Code::MISMATCHED_ARGS);
+    EXPECT_EQ(evaluator.ctx().func_info("f")->arity, 1);
+  }
+
+  // the deprecated table still builds a working context
+  auto legacy = tcalc::Evaluator{ tcalc::EvalContext{
+    tcalc::builtins::BUILTIN_VARIABLES, tcalc::builtins::BUILTIN_FUNCTIONS } };
+  EXPECT_EQ(*legacy.eval("sqrt(16) + pow(2, 3)"), 12);
+  auto legacy_mismatched = legacy.eval("sqrt(1, 2)");
+  EXPECT_FALSE(legacy_mismatched.has_value());
+  EXPECT_EQ(legacy_mismatched.error().code(),
+            tcalc::error::Code::MISMATCHED_ARGS);
+}
+
+TEST(EvalTest, DeepNesting)
+{
+  constexpr std::size_t DEPTH = 100000;
+
+  auto parens = std::string(DEPTH, '(') + "1" + std::string(DEPTH, ')');
+  auto negations = std::string{};
+  for (std::size_t i = 0; i < DEPTH; ++i) {
+    negations += "-";
+  }
+  negations += "2";
+
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    auto evaluator = tcalc::Evaluator{};
+    evaluator.engine(engine);
+
+    for (const auto& input : { parens, negations }) {
+      auto res = evaluator.eval(input);
+      EXPECT_FALSE(res.has_value());
+      EXPECT_EQ(res.error().code(), tcalc::error::Code::RECURSION_LIMIT);
+    }
+  }
+
+  // the tree walker nests every body it enters on the native stack, left as
+  // written the negations make the calls too deep for it
+  auto calls = "def f(n) if n == 0 then 0 else " + std::string(50, '-') +
+               "f(n - 1); f(990)";
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    for (auto simplify : { true, false }) {
+      auto evaluator = tcalc::Evaluator{};
+      evaluator.engine(engine);
+      evaluator.simplify(simplify);
+
+      auto res = evaluator.eval_prog(calls);
+      if (engine == tcalc::Engine::TREE && !simplify) {
+        EXPECT_FALSE(res.has_value());
+        EXPECT_EQ(res.error().code(), tcalc::error::Code::RECURSION_LIMIT);
+        EXPECT_EQ(evaluator.ctx().call_depth(), 0);
+      } else {
+        ASSERT_TRUE(res.has_value());
+        EXPECT_EQ(res.value()[1], 0);
+      }
+    }
+  }
+
+  // parsing and evaluating flat trees do not recurse on the native stack
+  auto evaluator = tcalc::Evaluator{};
+  evaluator.engine(tcalc::Engine::FLAT);
+  evaluator.max_depth(2 * DEPTH);
+
+  auto res = evaluator.eval(parens);
+  EXPECT_TRUE(res.has_value());
+  EXPECT_EQ(*res, 1);
+
+  res = evaluator.eval(negations);
+  EXPECT_TRUE(res.has_value());
+  EXPECT_EQ(*res, 2);
+}
+
+TEST(EvalTest, DeepChains)
+{
+  constexpr std::size_t TERMS = 12000;
+  constexpr auto LIMIT = tcalc::ast::Parser::MAX_DEPTH;
+
+  // chains of left-associative operators do not nest
+  auto sum = std::string{ "1" };
+  auto body = std::string{ "def f(x) x" };
+  for (std::size_t i = 1; i < TERMS; ++i) {
+    sum += "+1";
+    body += "+x";
+  }
+
+  // the recursive passes and engines survive the deepest accepted nesting
+  auto calls = std::string{};
+  auto negations = std::string(LIMIT - 1, '-') + "2";
+  for (std::size_t i = 1; i < LIMIT; ++i) {
+    calls += "sqrt(";
+  }
+  calls += "1" + std::string(LIMIT - 1, ')');
+
+  for (auto engine :
+       { tcalc::Engine::TREE, tcalc::Engine::VM, tcalc::Engine::FLAT }) {
+    for (auto fast_math : { false, true }) {
+      auto evaluator = tcalc::Evaluator{};
+      evaluator.engine(engine);
+      evaluator.fast_math(fast_math);
+
+      EXPECT_EQ(*evaluator.eval(sum), TERMS);
+      EXPECT_TRUE(evaluator.eval_prog(body).has_value());
+      EXPECT_EQ(*evaluator.eval("f(1) + 1"), TERMS + 1);
+      EXPECT_EQ(*evaluator.eval(calls), 1);
+      EXPECT_EQ(*evaluator.eval(negations), -2);
+    }
+  }
+
+  // the tree and VM engines recurse, their limit is clamped
+  auto deep = std::string(100000, '-') + "2";
+  for (auto engine : { tcalc::Engine::TREE, tcalc::Engine::VM }) {
+    auto evaluator = tcalc::Evaluator{};
+    evaluator.engine(engine);
+    evaluator.max_depth(1000000);
+    EXPECT_EQ(evaluator.max_depth(), LIMIT);
+
+    auto res = evaluator.eval(deep);
+    EXPECT_FALSE(res.has_value());
+    EXPECT_EQ(res.error().code(), tcalc::error::Code::RECURSION_LIMIT);
+  }
+}
+
 }
@@ -1,9 +1,44 @@
+#include <cstddef>
+#include <cstdlib>
 #include <gtest/gtest.h>
+#include <new>
+#include <string>
+#include <string_view>
+#include <tcalc/scan.hpp>
+#include <tcalc/symbol.hpp>
 #include <tcalc/tokenizer.hpp>
 #include <vector>
 
 namespace {
 
+std::size_t allocations = 0;
+
+}
+
+void*
+operator new(std::size_t size)
+{
+  ++allocations;
+  if (auto* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::size_t /*size*/) noexcept
+{
+  std::free(ptr);
+}
+
+namespace {
+
 TEST(TokenizerTest, Success)
 {
   auto tokens = tcalc::token::Tokenizer{
@@ -69,4 +104,140 @@ TEST(TokenizerTest, Failure)
   EXPECT_FALSE(res2.has_value());
 }
 
+TEST(TokenizerTest, WholeWordKeywords)
+{
+  auto tokens = tcalc::token::Tokenizer{ "define ifx if elsewhere a>=b!=!c" };
+  using tcalc::token::TokenType;
+  auto expected_types = std::vector<TokenType>{
+    TokenType::IDENTIFIER, TokenType::IDENTIFIER,   TokenType::IF,
+    TokenType::IDENTIFIER, TokenType::IDENTIFIER,   TokenType::GREATEREQUAL,
+    TokenType::IDENTIFIER, TokenType::NOTEQUAL,     TokenType::NOT,
+    TokenType::IDENTIFIER, TokenType::EOI,
+  };
+
+  for (auto type : expected_types) {
+    auto res = tokens.next();
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value().type, type);
+  }
+
+  auto tokens2 = tcalc::token::Tokenizer{ "a & b" };
+  EXPECT_TRUE(tokens2.next().has_value());
+  EXPECT_FALSE(tokens2.next().has_value());
+}
+
+TEST(TokenizerTest, Numbers)
+{
+  auto tokens = tcalc::token::Tokenizer{
+    "0 123.456 1e3 2.5E-2 7e+1 0x1F 0x1.8p1 0X.8P-1 0xA.8 2e"
+  };
+  auto expected = std::vector<double>{ 0,   123.456, 1000, 0.025, 70,
+                                       31,  3,       0.25, 10.5,  2 };
+
+  for (auto value : expected) {
+    auto res = tokens.next();
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res.value().type, tcalc::token::TokenType::NUMBER);
+    EXPECT_DOUBLE_EQ(res.value().value, value);
+  }
+
+  // `2e` is a number followed by an identifier
+  auto res = tokens.next();
+  EXPECT_TRUE(res.has_value());
+  EXPECT_EQ(res.value().type, tcalc::token::TokenType::IDENTIFIER);
+
+  for (const auto* input : { "1.", "0x", "0x.", "1e999", "0x1.p1" }) {
+    auto failed = tcalc::token::Tokenizer{ input };
+    EXPECT_FALSE(failed.next().has_value()) << input;
+  }
+}
+
+TEST(TokenizerTest, NoAllocation)
+{
+  auto input = std::string_view{
+    "def f(x, y) if x >= y then x * 1.5 else 'quoted id'; "
+    "let abc_1 = f(2, 3) && !0 || f(1, 0) != 2"
+  };
+
+  auto lex = [](std::string_view input) {
+    auto tokens = tcalc::token::Tokenizer{ input };
+    while (true) {
+      auto res = tokens.next();
+      if (!res.has_value() ||
+          res.value().type == tcalc::token::TokenType::EOI) {
+        break;
+      }
+    }
+  };
+
+  // the first pass interns the identifiers, known names never allocate
+  lex(input);
+
+  auto before = allocations;
+  lex(input);
+
+  EXPECT_EQ(allocations, before);
+}
+
+TEST(TokenizerTest, Symbols)
+{
+  auto tokens = tcalc::token::Tokenizer{ "foo bar 'foo' foo(def)" };
+
+  auto ids = std::vector<tcalc::SymbolId>{};
+  while (true) {
+    auto token = tokens.next().value();
+    if (token.type == tcalc::token::TokenType::EOI) {
+      break;
+    }
+    ids.push_back(token.symbol);
+  }
+
+  ASSERT_EQ(ids.size(), 7);
+  EXPECT_NE(ids[0], tcalc::NO_SYMBOL);
+  EXPECT_NE(ids[0], ids[1]);
+  EXPECT_EQ(ids[0], ids[2]);
+  EXPECT_EQ(ids[0], ids[3]);
+  EXPECT_EQ(ids[4], tcalc::NO_SYMBOL);
+  EXPECT_EQ(ids[5], tcalc::NO_SYMBOL);
+  EXPECT_EQ(tcalc::symbols().name(ids[1]), "bar");
+}
+
+
+TEST(TokenizerTest, ScanKernels)
+{
+  using tcalc::token::ScanLevel;
+
+  const auto& scalar = tcalc::token::scan_kernels(ScanLevel::SCALAR);
+  auto fills = std::vector<std::string>{ " \t\n\v\f\r", "0123456789",
+                                         "aZ_9bY8cX" };
+
+  for (auto level : { ScanLevel::SSE2, ScanLevel::AVX2 }) {
+    const auto& kernels = tcalc::token::scan_kernels(level);
+
+    for (const auto& fill : fills) {
+      // run lengths around the 16 and 32 byte block boundaries, stopped by
+      // every kind of byte
+      for (std::size_t len = 0; len < 70; ++len) {
+        for (auto stop : std::string{ " 0a_+\x80\xff\x1f/:@[`{" }) {
+          auto input = std::string{};
+          for (std::size_t i = 0; i < len; ++i) {
+            input += fill[i % fill.size()];
+          }
+          input += stop;
+          input += "xxxx";
+
+          const auto* begin = input.data();
+          const auto* end = input.data() + input.size();
+          EXPECT_EQ(kernels.skip_space(begin, end),
+                    scalar.skip_space(begin, end));
+          EXPECT_EQ(kernels.skip_digit(begin, end),
+                    scalar.skip_digit(begin, end));
+          EXPECT_EQ(kernels.skip_ident(begin, end),
+                    scalar.skip_ident(begin, end));
+        }
+      }
+    }
+  }
+}
+
 }
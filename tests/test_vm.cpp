@@ -0,0 +1,81 @@
+#include <cmath>
+#include <gtest/gtest.h>
+#include <limits>
+#include <string_view>
+#include <tcalc/eval.hpp>
+
+namespace {
+
+double
+eval_with(tcalc::Engine engine, std::string_view input)
+{
+  auto evaluator = tcalc::Evaluator{};
+  evaluator.engine(engine);
+
+  auto res = evaluator.eval_prog(input);
+  EXPECT_TRUE(res.has_value());
+
+  return res.value().back();
+}
+
+TEST(VMTest, MatchesTreeWalker)
+{
+  const auto inputs = {
+    "1 + 2 * 3 / sqrt(pow(3, 2)) - -pi",
+    "(1 + 2) * 3 - 4 / 5",
+    "!0 + !1 + (1 == 1) + (1 != 1) + (2 >= 1) + (2 <= 1)",
+    "(1 && 0) + (1 || 0) + (0 > 1) + (0 < 1)",
+    "let x = 3; let y = x * 2; x + y",
+    "def f(x, y) x * y + 1; f(2, 3)",
+    "def fib(n) if n <= 1 then n else fib(n - 1) + fib(n - 2); fib(15)",
+    "if 0 then 1 else if 1 then 2 else 3",
+    "let x = 1; def g() x; def f(x) g() + x; f(5)",
+  };
+
+  for (const auto* input : inputs) {
+    auto tree = eval_with(tcalc::Engine::TREE, input);
+    auto vm = eval_with(tcalc::Engine::VM, input);
+    auto flat = eval_with(tcalc::Engine::FLAT, input);
+    EXPECT_TRUE(std::abs(tree - vm) < std::numeric_limits<double>::epsilon())
+      << input;
+    EXPECT_TRUE(std::abs(tree - flat) < std::numeric_limits<double>::epsilon())
+      << input;
+  }
+}
+
+TEST(VMTest, ProgramResults)
+{
+  auto evaluator = tcalc::Evaluator{};
+  evaluator.engine(tcalc::Engine::VM);
+
+  auto res = evaluator.eval_prog("def f(x) x + 1; let x = 1; f(x)");
+  EXPECT_TRUE(res.has_value());
+
+  const auto& values = res.value();
+  EXPECT_EQ(values.size(), 3);
+  EXPECT_TRUE(std::abs(values[2] - 2) < std::numeric_limits<double>::epsilon());
+}
+
+TEST(VMTest, Errors)
+{
+  auto evaluator = tcalc::Evaluator{};
+  evaluator.engine(tcalc::Engine::VM);
+
+  auto res = evaluator.eval("undefined + 1");
+  EXPECT_FALSE(res.has_value());
+  EXPECT_EQ(res.error().code(), tcalc::error::Code::UNDEFINED_VAR);
+
+  res = evaluator.eval("undefined(1)");
+  EXPECT_FALSE(res.has_value());
+  EXPECT_EQ(res.error().code(), tcalc::error::Code::UNDEFINED_FUNC);
+
+  auto prog = evaluator.eval_prog("def f(x) x; f(1, 2)");
+  EXPECT_FALSE(prog.has_value());
+  EXPECT_EQ(prog.error().code(), tcalc::error::Code::MISMATCHED_ARGS);
+
+  prog = evaluator.eval_prog("def g(x) 1 + g(x + 1); g(0)");
+  EXPECT_FALSE(prog.has_value());
+  EXPECT_EQ(prog.error().code(), tcalc::error::Code::RECURSION_LIMIT);
+}
+
+}